@@ -0,0 +1,351 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Camera calibration tools of the Kawasaki servo examples.
+ *
+ *****************************************************************************/
+
+/*!
+  \example calibrationKawasaki.cpp
+  Calibration of the camera mounted on the Kawasaki robot, from images acquired beforehand. The results
+  are the files read by the servo examples.
+
+  With --calibrate_intrinsic <config file> command line option, the intrinsic parameters are computed from
+  the images of a chessboard or of a symmetric circles grid described by a configuration file like
+  default-chessboard.cfg:
+  \code
+BoardSize_Width: 9
+BoardSize_Height: 6
+Square_Size: 0.026
+Calibrate_Pattern: CHESSBOARD
+Input: chessboard-%02d.png
+  \endcode
+  The images are numbered from 1 in the directory of the configuration file. The pattern is found in all
+  the images in parallel, then the parameters without and with distortion are refined together with the
+  poses of the pattern (see vpIntrinsicCalibrator). Both models are saved with vpXmlParserCamera in
+  --intrinsic <camera.xml>, by default camera.xml in the directory of the configuration file. This is the
+  file read by the servo examples with their --intrinsic option.
+
+  With --hand_eye <directory> command line option, the directory contains the images of a fixed chessboard
+  image-<i>.png and the corresponding robot poses pose_fPe_<i>.yaml, with i starting at 1. The chessboard
+  is found in all the images in parallel, then the pose of the camera in the end-effector frame is computed
+  (see vpHandEyeCalibrator) and saved in --output <file>, by default eMc.yaml in the same directory. The
+  reprojection error of each image is printed, to remove the bad ones.
+
+  The intrinsic parameters are read with vpXmlParserCamera from --intrinsic <camera.xml>, with the
+  distortion model of the camera named --camera_name <name>. With both options, the hand-eye calibration
+  uses the intrinsic parameters that have just been computed. The chessboard has --board_size <w>x<h>
+  inner corners and squares of --square_size <m> meter.
+*/
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <visp3/core/vpCameraParameters.h>
+#include <visp3/core/vpIoTools.h>
+#include <visp3/core/vpPoseVector.h>
+#include <visp3/core/vpTime.h>
+#include <visp3/core/vpXmlParserCamera.h>
+#include <vpHandEyeCalibrator.h>
+#include <vpIntrinsicCalibrator.h>
+
+#if defined(VISP_HAVE_OPENCV) && defined(VISP_HAVE_PUGIXML) && (VISP_CXX_STANDARD >= VISP_CXX_STANDARD_11)
+
+namespace
+{
+// Read the configuration file of the intrinsic calibration, "Key: value" per line and # for comments
+bool readConfig(const std::string &filename, vpIntrinsicCalibrator::vpPatternType &type, unsigned int &width,
+                unsigned int &height, double &square_size, std::string &input)
+{
+  std::ifstream file(filename.c_str());
+  if (!file.is_open()) {
+    return false;
+  }
+  std::string line;
+  while (std::getline(file, line)) {
+    line = line.substr(0, line.find('#'));
+    size_t sep = line.find(':');
+    if (sep == std::string::npos) {
+      continue;
+    }
+    std::string key = line.substr(0, sep);
+    std::istringstream value(line.substr(sep + 1));
+    if (key == "BoardSize_Width") {
+      value >> width;
+    } else if (key == "BoardSize_Height") {
+      value >> height;
+    } else if (key == "Square_Size") {
+      value >> square_size;
+    } else if (key == "Calibrate_Pattern") {
+      std::string pattern;
+      value >> pattern;
+      if (pattern == "CHESSBOARD") {
+        type = vpIntrinsicCalibrator::CHESSBOARD;
+      } else if (pattern == "CIRCLES_GRID") {
+        type = vpIntrinsicCalibrator::CIRCLES_GRID;
+      } else {
+        std::cout << "Unknown pattern " << pattern << " in " << filename << std::endl;
+        return false;
+      }
+    } else if (key == "Input") {
+      value >> input;
+    }
+  }
+  return !input.empty();
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  std::string opt_intrinsic_config = "";
+  std::string opt_hand_eye_dirname = "";
+  std::string opt_intrinsic_filename = "";
+  std::string opt_camera_name = "Camera";
+  std::string opt_output_filename = "";
+  unsigned int opt_board_width = 9, opt_board_height = 6;
+  double opt_square_size = 0.026;
+
+  for (int i = 1; i < argc; i++) {
+    if (std::string(argv[i]) == "--calibrate_intrinsic" && i + 1 < argc) {
+      opt_intrinsic_config = std::string(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--hand_eye" && i + 1 < argc) {
+      opt_hand_eye_dirname = std::string(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--intrinsic" && i + 1 < argc) {
+      opt_intrinsic_filename = std::string(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--camera_name" && i + 1 < argc) {
+      opt_camera_name = std::string(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--output" && i + 1 < argc) {
+      opt_output_filename = std::string(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--board_size" && i + 1 < argc) {
+      if (sscanf(argv[i + 1], "%ux%u", &opt_board_width, &opt_board_height) != 2) {
+        std::cout << "Invalid board size " << argv[i + 1] << ", use <width>x<height>" << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else if (std::string(argv[i]) == "--square_size" && i + 1 < argc) {
+      opt_square_size = std::stod(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--help" || std::string(argv[i]) == "-h") {
+      std::cout << argv[0] << " [--calibrate_intrinsic <config file>] [--hand_eye <directory>]"
+                << " [--intrinsic <camera xml file; default camera.xml, in the directory of the config file"
+                << " with --calibrate_intrinsic>] [--camera_name <name; default " << opt_camera_name
+                << ">] [--output <file>] [--board_size <w>x<h>; default " << opt_board_width << "x" << opt_board_height
+                << ">] [--square_size <m; default " << opt_square_size << ">] [--help] [-h]"
+                << "\n";
+      return EXIT_SUCCESS;
+    }
+  }
+
+  if (opt_intrinsic_config.empty() && opt_hand_eye_dirname.empty()) {
+    std::cout << "Nothing to calibrate, use --calibrate_intrinsic <config file> or --hand_eye <directory>. See --help"
+              << std::endl;
+    return EXIT_SUCCESS;
+  }
+  if (opt_intrinsic_filename.empty()) {
+    opt_intrinsic_filename = opt_intrinsic_config.empty()
+                                 ? "camera.xml"
+                                 : vpIoTools::createFilePath(vpIoTools::getParent(opt_intrinsic_config), "camera.xml");
+  }
+
+  try {
+    vpCameraParameters cam;
+    if (!opt_intrinsic_config.empty()) {
+      vpIntrinsicCalibrator::vpPatternType pattern = vpIntrinsicCalibrator::CHESSBOARD;
+      unsigned int width = opt_board_width, height = opt_board_height;
+      double square_size = opt_square_size;
+      std::string input;
+      if (!readConfig(opt_intrinsic_config, pattern, width, height, square_size, input)) {
+        std::cout << "Can not read the configuration file " << opt_intrinsic_config << std::endl;
+        return EXIT_FAILURE;
+      }
+
+      // Images numbered from 1 like the ViSP calibration tool
+      std::vector<std::string> image_files;
+      for (unsigned int i = 1;; i++) {
+        char filename[FILENAME_MAX];
+        snprintf(filename, FILENAME_MAX, input.c_str(), i);
+        std::string image_filename = vpIoTools::createFilePath(vpIoTools::getParent(opt_intrinsic_config), filename);
+        if (!vpIoTools::checkFilename(image_filename)) {
+          break;
+        }
+        image_files.push_back(image_filename);
+      }
+      std::cout << image_files.size() << " images " << input << " for the intrinsic calibration" << std::endl;
+
+      vpIntrinsicCalibrator calibrator;
+      calibrator.setPattern(pattern, width, height, square_size);
+      double t_start = vpTime::measureTimeMs();
+      unsigned int nb_valid = calibrator.detect(image_files);
+      double t_detect = vpTime::measureTimeMs() - t_start;
+      if (!calibrator.calibrate()) {
+        std::cout << "Intrinsic calibration failed, the pattern is found in " << nb_valid << " images" << std::endl;
+        return EXIT_FAILURE;
+      }
+      std::cout << "Pattern found in " << nb_valid << " images in " << t_detect << " ms, calibration in "
+                << vpTime::measureTimeMs() - t_start - t_detect << " ms" << std::endl;
+
+      const std::vector<vpIntrinsicCalibrator::vpView> &views = calibrator.getViews();
+      for (size_t i = 0; i < views.size(); i++) {
+        std::cout << "  " << views[i].filename << ": ";
+        if (views[i].valid) {
+          std::cout << views[i].residual << " pixel" << std::endl;
+        } else {
+          std::cout << "pattern not found" << std::endl;
+        }
+      }
+      std::cout << "Reprojection error: " << calibrator.getResidual(false) << " pixel without distortion, "
+                << calibrator.getResidual(true) << " pixel with distortion" << std::endl;
+      std::cout << "cam without distortion:\n" << calibrator.getCameraParameters(false) << "\n";
+
+      std::stringstream ss_additional_info;
+      ss_additional_info << "<date>" << vpTime::getDateTime() << "</date>";
+      ss_additional_info << "<nb_calibration_images>" << nb_valid << "</nb_calibration_images>";
+      ss_additional_info << "<calibration_pattern_type>"
+                         << (pattern == vpIntrinsicCalibrator::CHESSBOARD ? "Chessboard" : "Circles grid")
+                         << "</calibration_pattern_type>";
+      ss_additional_info << "<board_size>" << width << "x" << height << "</board_size>";
+      ss_additional_info << "<square_size>" << square_size << "</square_size>";
+      ss_additional_info << "<global_reprojection_error>";
+      ss_additional_info << "<without_distortion>" << calibrator.getResidual(false) << "</without_distortion>";
+      ss_additional_info << "<with_distortion>" << calibrator.getResidual(true) << "</with_distortion>";
+      ss_additional_info << "</global_reprojection_error>";
+
+      // vpXmlParserCamera doesn't overwrite an existing camera
+      if (vpIoTools::checkFilename(opt_intrinsic_filename)) {
+        std::cout << "Overwrite " << opt_intrinsic_filename << std::endl;
+        vpIoTools::remove(opt_intrinsic_filename);
+      }
+      vpXmlParserCamera xml;
+      if (xml.save(calibrator.getCameraParameters(false), opt_intrinsic_filename, opt_camera_name,
+                   calibrator.getImageWidth(), calibrator.getImageHeight(),
+                   ss_additional_info.str()) != vpXmlParserCamera::SEQUENCE_OK ||
+          xml.save(calibrator.getCameraParameters(true), opt_intrinsic_filename, opt_camera_name,
+                   calibrator.getImageWidth(), calibrator.getImageHeight()) != vpXmlParserCamera::SEQUENCE_OK) {
+        std::cout << "Can not write " << opt_intrinsic_filename << std::endl;
+        return EXIT_FAILURE;
+      }
+      std::cout << "Camera parameters saved in " << opt_intrinsic_filename << std::endl;
+      cam = calibrator.getCameraParameters(true);
+    } else {
+      vpXmlParserCamera parser;
+      if (parser.parse(cam, opt_intrinsic_filename, opt_camera_name,
+                       vpCameraParameters::perspectiveProjWithDistortion) != vpXmlParserCamera::SEQUENCE_OK) {
+        std::cout << "Can not read the camera " << opt_camera_name << " in " << opt_intrinsic_filename << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+    std::cout << "cam:\n" << cam << "\n";
+
+    if (!opt_hand_eye_dirname.empty()) {
+      // Images and robot poses numbered from 1
+      std::vector<std::string> image_files;
+      std::vector<vpHomogeneousMatrix> fMe;
+      for (unsigned int i = 1;; i++) {
+        std::string image_filename =
+            vpIoTools::createFilePath(opt_hand_eye_dirname, "image-" + std::to_string(i) + ".png");
+        std::string pose_filename =
+            vpIoTools::createFilePath(opt_hand_eye_dirname, "pose_fPe_" + std::to_string(i) + ".yaml");
+        if (!vpIoTools::checkFilename(image_filename) || !vpIoTools::checkFilename(pose_filename)) {
+          break;
+        }
+        vpPoseVector fPe;
+        if (!vpPoseVector::loadYAML(pose_filename, fPe)) {
+          std::cout << "Can not read the robot pose " << pose_filename << std::endl;
+          return EXIT_FAILURE;
+        }
+        image_files.push_back(image_filename);
+        fMe.push_back(vpHomogeneousMatrix(fPe));
+      }
+      std::cout << image_files.size() << " images with robot poses in " << opt_hand_eye_dirname << std::endl;
+
+      vpHandEyeCalibrator calibrator;
+      calibrator.setCameraParameters(cam);
+      calibrator.setChessboard(opt_board_width, opt_board_height, opt_square_size);
+
+      double t_start = vpTime::measureTimeMs();
+      unsigned int nb_valid = calibrator.detect(image_files, fMe);
+      double t_detect = vpTime::measureTimeMs() - t_start;
+      vpHomogeneousMatrix eMc;
+      if (!calibrator.calibrate(eMc)) {
+        std::cout << "Hand-eye calibration failed, the chessboard is found in " << nb_valid << " images"
+                  << std::endl;
+        return EXIT_FAILURE;
+      }
+      std::cout << "Chessboard found in " << nb_valid << " images in " << t_detect << " ms, calibration in "
+                << vpTime::measureTimeMs() - t_start - t_detect << " ms" << std::endl;
+
+      const std::vector<vpHandEyeCalibrator::vpView> &views = calibrator.getViews();
+      for (size_t i = 0; i < views.size(); i++) {
+        std::cout << "  " << views[i].filename << ": ";
+        if (views[i].valid) {
+          std::cout << views[i].residual << " pixel" << std::endl;
+        } else {
+          std::cout << "chessboard not found" << std::endl;
+        }
+      }
+      std::cout << "Reprojection error: " << calibrator.getResidual() << " pixel (closed-form solution: "
+                << calibrator.getInitialResidual() << " pixel)" << std::endl;
+
+      vpPoseVector ePc(eMc);
+      std::cout << "eMc:\n" << eMc << "\nePc: " << ePc.t() << std::endl;
+      std::string output_filename = opt_output_filename.empty()
+                                        ? vpIoTools::createFilePath(opt_hand_eye_dirname, "eMc.yaml")
+                                        : opt_output_filename;
+      if (!vpPoseVector::saveYAML(output_filename, ePc)) {
+        std::cout << "Can not write " << output_filename << std::endl;
+        return EXIT_FAILURE;
+      }
+      std::cout << "eMc saved in " << output_filename << std::endl;
+    }
+  } catch (const vpException &e) {
+    std::cout << "ViSP exception: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+#else
+int main()
+{
+#if !defined(VISP_HAVE_OPENCV)
+  std::cout << "Install OpenCV to find the calibration patterns" << std::endl;
+#endif
+#if !defined(VISP_HAVE_PUGIXML)
+  std::cout << "Build ViSP with pugixml to read the camera parameters" << std::endl;
+#endif
+#if (VISP_CXX_STANDARD < VISP_CXX_STANDARD_11)
+  std::cout << "Build ViSP with c++11 or higher compiler flag (cmake -DUSE_CXX_STANDARD=11)." << std::endl;
+#endif
+  return 0;
+}
+#endif
@@ -0,0 +1,326 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Hand-eye calibration from a set of chessboard images and robot poses.
+ *
+ *****************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+#include <visp3/core/vpConfig.h>
+#include <visp3/core/vpException.h>
+#include <visp3/core/vpExponentialMap.h>
+#include <visp3/core/vpImage.h>
+#include <visp3/core/vpImageConvert.h>
+#include <visp3/core/vpMatrix.h>
+#include <visp3/core/vpPixelMeterConversion.h>
+#include <visp3/core/vpVelocityTwistMatrix.h>
+#include <visp3/io/vpImageIo.h>
+#include <visp3/vision/vpHandEyeCalibration.h>
+#include <visp3/vision/vpPose.h>
+
+#if defined(VISP_HAVE_OPENCV)
+#include <opencv2/calib3d/calib3d.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#endif
+
+/*!
+  \file vpHandEyeCalibrator.cpp
+  Hand-eye calibration from a set of chessboard images and robot poses.
+*/
+
+#include <vpHandEyeCalibrator.h>
+
+namespace
+{
+const unsigned int max_iterations = 100;
+
+// Interaction matrix of the normalized coordinates of a point wrt the camera velocity
+void pointInteraction(double x, double y, double Z, vpMatrix &Lx)
+{
+  Lx[0][0] = -1. / Z;
+  Lx[0][1] = 0;
+  Lx[0][2] = x / Z;
+  Lx[0][3] = x * y;
+  Lx[0][4] = -(1 + x * x);
+  Lx[0][5] = y;
+  Lx[1][0] = 0;
+  Lx[1][1] = -1. / Z;
+  Lx[1][2] = y / Z;
+  Lx[1][3] = 1 + y * y;
+  Lx[1][4] = -x * y;
+  Lx[1][5] = -x;
+}
+} // namespace
+
+vpHandEyeCalibrator::vpHandEyeCalibrator()
+  : m_cam(), m_boardWidth(9), m_boardHeight(6), m_squareSize(0.026), m_nbThreads(0), m_views(), m_fMo(),
+    m_initialResidual(0), m_residual(0)
+{
+}
+
+/*!
+  Compute eMc from the views found by detect(), with vpHandEyeCalibration then with the refinement of the
+  reprojection error.
+
+  \return false if less than 3 views are valid or if vpHandEyeCalibration fails.
+ */
+bool vpHandEyeCalibrator::calibrate(vpHomogeneousMatrix &eMc)
+{
+  std::vector<vpHomogeneousMatrix> cMo, fMe;
+  for (size_t i = 0; i < m_views.size(); i++) {
+    if (m_views[i].valid) {
+      cMo.push_back(m_views[i].cMo);
+      fMe.push_back(m_views[i].fMe);
+    }
+  }
+  if (cMo.size() < 3) {
+    return false;
+  }
+  if (vpHandEyeCalibration::calibrate(cMo, fMe, eMc) != 0) {
+    return false;
+  }
+
+  // Initial chessboard pose: mean over the views in the tangent space of the first one
+  vpHomogeneousMatrix fMo_0 = fMe[0] * eMc * cMo[0];
+  vpColVector v_mean(6);
+  for (size_t i = 0; i < cMo.size(); i++) {
+    v_mean += vpExponentialMap::inverse(fMo_0.inverse() * fMe[i] * eMc * cMo[i]);
+  }
+  m_fMo = fMo_0 * vpExponentialMap::direct(v_mean / static_cast<double>(cMo.size()));
+  m_initialResidual = residual(eMc, m_fMo, false);
+
+  // Levenberg-Marquardt over eMc = eMc exp(dc) and fMo = fMo exp(do)
+  double cost = m_initialResidual;
+  double mu = 0.001;
+  bool converged = false;
+  vpMatrix Lx(2, 6);
+  for (unsigned int iter = 0; iter < max_iterations && !converged; iter++) {
+    vpMatrix H(12, 12);
+    vpColVector g(12);
+    for (size_t i = 0; i < m_views.size(); i++) {
+      const vpView &view = m_views[i];
+      if (!view.valid) {
+        continue;
+      }
+      vpHomogeneousMatrix cMo_i = (view.fMe * eMc).inverse() * m_fMo;
+      vpMatrix Lo = vpMatrix(vpVelocityTwistMatrix(cMo_i));
+      for (size_t j = 0; j < view.points.size(); j++) {
+        vpPoint P = view.points[j];
+        P.track(cMo_i);
+        pointInteraction(P.get_x(), P.get_y(), P.get_Z(), Lx);
+        vpMatrix J(2, 12);
+        J.insert(Lx, 0, 0);
+        J.insert(-Lx * Lo, 0, 6);
+        vpColVector r(2);
+        r[0] = P.get_x() - view.points[j].get_x();
+        r[1] = P.get_y() - view.points[j].get_y();
+        H += J.AtA();
+        g += J.t() * r;
+      }
+    }
+
+    bool improved = false;
+    while (!improved && mu < 1e10) {
+      vpMatrix Hs = H;
+      for (unsigned int k = 0; k < 12; k++) {
+        Hs[k][k] += mu * H[k][k];
+      }
+      vpColVector delta = -(Hs.pseudoInverse() * g);
+      vpColVector dc(6), d_o(6);
+      for (unsigned int k = 0; k < 6; k++) {
+        dc[k] = delta[k];
+        d_o[k] = delta[k + 6];
+      }
+      vpHomogeneousMatrix eMc_new = eMc * vpExponentialMap::direct(dc);
+      vpHomogeneousMatrix fMo_new = m_fMo * vpExponentialMap::direct(d_o);
+      double cost_new = residual(eMc_new, fMo_new, false);
+      if (cost_new < cost) {
+        improved = true;
+        eMc = eMc_new;
+        m_fMo = fMo_new;
+        mu /= 10.;
+        converged = (cost - cost_new < 1e-9 * cost);
+        cost = cost_new;
+      } else {
+        mu *= 10.;
+      }
+    }
+    converged = converged || !improved;
+  }
+
+  m_residual = residual(eMc, m_fMo, true);
+  return true;
+}
+
+/*!
+  Load the images and find the chessboard in parallel.
+
+  \param[in] image_files : Image of each view.
+  \param[in] fMe : Robot pose of each view.
+  \return The number of views where the chessboard is found.
+ */
+unsigned int vpHandEyeCalibrator::detect(const std::vector<std::string> &image_files,
+                                         const std::vector<vpHomogeneousMatrix> &fMe)
+{
+  if (image_files.size() != fMe.size()) {
+    throw(vpException(vpException::dimensionError, "%d images for %d robot poses",
+                      static_cast<int>(image_files.size()), static_cast<int>(fMe.size())));
+  }
+  m_views.resize(image_files.size());
+  for (size_t i = 0; i < m_views.size(); i++) {
+    m_views[i].filename = image_files[i];
+    m_views[i].fMe = fMe[i];
+    m_views[i].valid = false;
+    m_views[i].residual = 0;
+  }
+
+  unsigned int nb_threads = m_nbThreads;
+  if (nb_threads == 0) {
+    nb_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < m_views.size(); i = next++) {
+      detectView(m_views[i]);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned int i = 0; i < nb_threads; i++) {
+    threads.push_back(std::thread(worker));
+  }
+  for (size_t i = 0; i < threads.size(); i++) {
+    threads[i].join();
+  }
+
+  unsigned int nb_valid = 0;
+  for (size_t i = 0; i < m_views.size(); i++) {
+    if (m_views[i].valid) {
+      nb_valid++;
+    }
+  }
+  return nb_valid;
+}
+
+// Find the chessboard corners in the image of the view and compute its pose
+void vpHandEyeCalibrator::detectView(vpView &view) const
+{
+#if defined(VISP_HAVE_OPENCV)
+  vpImage<unsigned char> I;
+  try {
+    vpImageIo::read(I, view.filename);
+  } catch (const vpException &) {
+    return;
+  }
+  cv::Mat matImg;
+  vpImageConvert::convert(I, matImg);
+
+  std::vector<cv::Point2f> corners;
+  cv::Size board_size(static_cast<int>(m_boardWidth), static_cast<int>(m_boardHeight));
+  if (!cv::findChessboardCorners(matImg, board_size, corners,
+                                 cv::CALIB_CB_ADAPTIVE_THRESH | cv::CALIB_CB_FAST_CHECK | cv::CALIB_CB_NORMALIZE_IMAGE)) {
+    return;
+  }
+  cv::cornerSubPix(matImg, corners, cv::Size(11, 11), cv::Size(-1, -1),
+                   cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::COUNT, 30, 0.1));
+
+  view.points.resize(corners.size());
+  vpPose pose;
+  for (unsigned int i = 0; i < m_boardHeight; i++) {
+    for (unsigned int j = 0; j < m_boardWidth; j++) {
+      const size_t k = i * m_boardWidth + j;
+      double x = 0, y = 0;
+      vpPixelMeterConversion::convertPoint(m_cam, corners[k].x, corners[k].y, x, y);
+      view.points[k].setWorldCoordinates(j * m_squareSize, i * m_squareSize, 0);
+      view.points[k].set_x(x);
+      view.points[k].set_y(y);
+      pose.addPoint(view.points[k]);
+    }
+  }
+
+  // Keep the best linear pose to initialize the non linear one
+  vpHomogeneousMatrix cMo_dementhon, cMo_lagrange;
+  pose.computePose(vpPose::DEMENTHON, cMo_dementhon);
+  pose.computePose(vpPose::LAGRANGE, cMo_lagrange);
+  view.cMo = (pose.computeResidual(cMo_dementhon) < pose.computeResidual(cMo_lagrange)) ? cMo_dementhon : cMo_lagrange;
+  pose.computePose(vpPose::VIRTUAL_VS, view.cMo);
+  view.valid = true;
+#else
+  (void)view;
+  throw(vpException(vpException::fatalError, "OpenCV is required to find the chessboard"));
+#endif
+}
+
+/*!
+  RMS reprojection error in pixel of the corners of all the views for the given eMc and fMo. With
+  \e update_views, the residual of each view is updated.
+ */
+double vpHandEyeCalibrator::residual(const vpHomogeneousMatrix &eMc, const vpHomogeneousMatrix &fMo,
+                                     bool update_views)
+{
+  double sum = 0;
+  size_t nb = 0;
+  for (size_t i = 0; i < m_views.size(); i++) {
+    vpView &view = m_views[i];
+    if (!view.valid) {
+      continue;
+    }
+    vpHomogeneousMatrix cMo_i = (view.fMe * eMc).inverse() * fMo;
+    double view_sum = 0;
+    for (size_t j = 0; j < view.points.size(); j++) {
+      vpPoint P = view.points[j];
+      P.track(cMo_i);
+      const double du = (P.get_x() - view.points[j].get_x()) * m_cam.get_px();
+      const double dv = (P.get_y() - view.points[j].get_y()) * m_cam.get_py();
+      view_sum += du * du + dv * dv;
+    }
+    if (update_views) {
+      view.residual = std::sqrt(view_sum / view.points.size());
+    }
+    sum += view_sum;
+    nb += view.points.size();
+  }
+  return nb > 0 ? std::sqrt(sum / nb) : 0.;
+}
+
+void vpHandEyeCalibrator::setChessboard(unsigned int width, unsigned int height, double square_size)
+{
+  if (width < 2 || height < 2 || square_size <= 0) {
+    throw(vpException(vpException::badValue, "Invalid chessboard %dx%d with %f m squares", width, height,
+                      square_size));
+  }
+  m_boardWidth = width;
+  m_boardHeight = height;
+  m_squareSize = square_size;
+}
@@ -0,0 +1,125 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Hand-eye calibration from a set of chessboard images and robot poses.
+ *
+ *****************************************************************************/
+
+
+#ifndef vpHandEyeCalibrator_h
+#define vpHandEyeCalibrator_h
+
+/*!
+  \file vpHandEyeCalibrator.h
+  Hand-eye calibration from a set of chessboard images and robot poses.
+*/
+
+#include <string>
+#include <vector>
+
+#include <visp3/core/vpConfig.h>
+
+#include <visp3/core/vpCameraParameters.h>
+#include <visp3/core/vpHomogeneousMatrix.h>
+#include <visp3/core/vpPoint.h>
+
+/*!
+
+  \class vpHandEyeCalibrator
+  \brief Compute the pose eMc of the camera in the end-effector frame from images of a fixed chessboard
+  taken at several robot poses.
+
+  For each view, the image is loaded, the chessboard corners are extracted at sub-pixel precision and the
+  pose cMo of the chessboard is computed with vpPose. The views are processed in parallel on all the cores.
+  The closed-form solution of vpHandEyeCalibration is then refined with Levenberg-Marquardt, minimizing the
+  reprojection error of all the corners of all the views over eMc and the chessboard pose fMo in the robot
+  reference frame:
+  \f[ {\bf x}_{ij} = \pi\left(({^f}{\bf M}_{e,i}\, {^e}{\bf M}_c)^{-1}\, {^f}{\bf M}_o\, {^o}{\bf X}_j\right) \f]
+
+  \code
+  vpHandEyeCalibrator calibrator;
+  calibrator.setCameraParameters(cam);
+  calibrator.setChessboard(9, 6, 0.026);
+  calibrator.detect(image_files, fMe);
+  vpHomogeneousMatrix eMc;
+  if (calibrator.calibrate(eMc)) {
+    std::cout << "Residual: " << calibrator.getResidual() << " pixel" << std::endl;
+  }
+  \endcode
+
+*/
+class vpHandEyeCalibrator
+{
+public:
+  //! Data of an image.
+  struct vpView {
+    std::string filename;
+    vpHomogeneousMatrix fMe;    //!< Robot pose
+    vpHomogeneousMatrix cMo;    //!< Chessboard pose
+    std::vector<vpPoint> points; //!< Chessboard corners with their measured normalized coordinates
+    bool valid;                 //!< True if the chessboard is found
+    double residual;            //!< RMS reprojection error in pixel after calibrate()
+  };
+
+  vpHandEyeCalibrator();
+
+  bool calibrate(vpHomogeneousMatrix &eMc);
+  unsigned int detect(const std::vector<std::string> &image_files, const std::vector<vpHomogeneousMatrix> &fMe);
+
+  //! Return the chessboard pose in the robot reference frame estimated by calibrate().
+  const vpHomogeneousMatrix &get_fMo() const { return m_fMo; }
+  //! Return the RMS reprojection error in pixel of the closed-form solution.
+  double getInitialResidual() const { return m_initialResidual; }
+  //! Return the RMS reprojection error in pixel over all the views after calibrate().
+  double getResidual() const { return m_residual; }
+  //! Return the views given to detect().
+  const std::vector<vpView> &getViews() const { return m_views; }
+
+  void setCameraParameters(const vpCameraParameters &cam) { m_cam = cam; }
+  void setChessboard(unsigned int width, unsigned int height, double square_size);
+  //! Set the number of threads, 0 to use all the cores.
+  void setNbThreads(unsigned int nb) { m_nbThreads = nb; }
+
+protected:
+  void detectView(vpView &view) const;
+  double residual(const vpHomogeneousMatrix &eMc, const vpHomogeneousMatrix &fMo, bool update_views);
+
+  vpCameraParameters m_cam;
+  unsigned int m_boardWidth;  //!< Number of inner corners per row
+  unsigned int m_boardHeight; //!< Number of inner corners per column
+  double m_squareSize;
+  unsigned int m_nbThreads;
+  std::vector<vpView> m_views;
+  vpHomogeneousMatrix m_fMo;
+  double m_initialResidual;
+  double m_residual;
+};
+#endif
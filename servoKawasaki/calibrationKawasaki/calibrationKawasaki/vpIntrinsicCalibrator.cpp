@@ -0,0 +1,461 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Intrinsic calibration from a set of chessboard or circles grid images.
+ *
+ *****************************************************************************/
+
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+#include <visp3/core/vpConfig.h>
+#include <visp3/core/vpException.h>
+#include <visp3/core/vpExponentialMap.h>
+#include <visp3/core/vpImage.h>
+#include <visp3/core/vpImageConvert.h>
+#include <visp3/core/vpMatrix.h>
+#include <visp3/core/vpPixelMeterConversion.h>
+#include <visp3/io/vpImageIo.h>
+#include <visp3/vision/vpPose.h>
+
+#if defined(VISP_HAVE_OPENCV)
+#include <opencv2/calib3d/calib3d.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#endif
+
+/*!
+  \file vpIntrinsicCalibrator.cpp
+  Intrinsic calibration from a set of chessboard or circles grid images.
+*/
+
+#include <vpIntrinsicCalibrator.h>
+
+namespace
+{
+const unsigned int max_iterations = 100;
+const unsigned int nb_intrinsics = 5;
+
+// Run job(i) for i in [0, n) on nb_threads threads
+template <typename Job> void parallelFor(size_t n, unsigned int nb_threads, const Job &job)
+{
+  if (nb_threads == 0) {
+    nb_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  nb_threads = static_cast<unsigned int>(std::min<size_t>(nb_threads, n));
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < n; i = next++) {
+      job(i);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned int i = 1; i < nb_threads; i++) {
+    threads.push_back(std::thread(worker));
+  }
+  worker();
+  for (size_t i = 0; i < threads.size(); i++) {
+    threads[i].join();
+  }
+}
+} // namespace
+
+vpIntrinsicCalibrator::vpIntrinsicCalibrator()
+  : m_type(CHESSBOARD), m_boardWidth(9), m_boardHeight(6), m_squareSize(0.026), m_nbThreads(0), m_width(0),
+    m_height(0), m_views(), m_cam(), m_camDist(), m_residual(0), m_residualDist(0)
+{
+}
+
+/*!
+  Compute the intrinsic parameters without then with distortion from the views found by detect().
+
+  \return false if the pattern is found in less than 3 views.
+ */
+bool vpIntrinsicCalibrator::calibrate()
+{
+  unsigned int nb_valid = 0;
+  for (size_t i = 0; i < m_views.size(); i++) {
+    if (m_views[i].valid) {
+      nb_valid++;
+    }
+  }
+  if (nb_valid < 3) {
+    return false;
+  }
+
+  // The poses of detect() are computed with the same initial parameters
+  m_cam.initPersProjWithoutDistortion(m_width, m_width, m_width / 2., m_height / 2.);
+  m_residual = refine(m_cam, false);
+
+  m_camDist.initPersProjWithDistortion(m_cam.get_px(), m_cam.get_py(), m_cam.get_u0(), m_cam.get_v0(), 0, 0);
+  m_residualDist = refine(m_camDist, true);
+  fitInverseDistortion(m_camDist);
+  return true;
+}
+
+/*!
+  Load the images and find the pattern in parallel. Views with a size different from the first valid one
+  are discarded.
+
+  \param[in] image_files : Image of each view.
+  \return The number of views where the pattern is found.
+ */
+unsigned int vpIntrinsicCalibrator::detect(const std::vector<std::string> &image_files)
+{
+  m_views.resize(image_files.size());
+  std::vector<unsigned int> width(m_views.size(), 0), height(m_views.size(), 0);
+  for (size_t i = 0; i < m_views.size(); i++) {
+    m_views[i].filename = image_files[i];
+    m_views[i].valid = false;
+    m_views[i].residual = 0;
+  }
+  parallelFor(m_views.size(), m_nbThreads, [&](size_t i) { detectView(m_views[i], width[i], height[i]); });
+
+  m_width = 0;
+  m_height = 0;
+  unsigned int nb_valid = 0;
+  for (size_t i = 0; i < m_views.size(); i++) {
+    if (!m_views[i].valid) {
+      continue;
+    }
+    if (m_width == 0) {
+      m_width = width[i];
+      m_height = height[i];
+    }
+    if (width[i] != m_width || height[i] != m_height) {
+      m_views[i].valid = false;
+      continue;
+    }
+    nb_valid++;
+  }
+  return nb_valid;
+}
+
+// Find the pattern in the image of the view and compute its pose with the initial parameters of calibrate()
+void vpIntrinsicCalibrator::detectView(vpView &view, unsigned int &width, unsigned int &height) const
+{
+#if defined(VISP_HAVE_OPENCV)
+  vpImage<unsigned char> I;
+  try {
+    vpImageIo::read(I, view.filename);
+  } catch (const vpException &) {
+    return;
+  }
+  width = I.getWidth();
+  height = I.getHeight();
+  cv::Mat matImg;
+  vpImageConvert::convert(I, matImg);
+
+  std::vector<cv::Point2f> corners;
+  cv::Size board_size(static_cast<int>(m_boardWidth), static_cast<int>(m_boardHeight));
+  if (m_type == CHESSBOARD) {
+    if (!cv::findChessboardCorners(matImg, board_size, corners, cv::CALIB_CB_ADAPTIVE_THRESH |
+                                                                    cv::CALIB_CB_FAST_CHECK |
+                                                                    cv::CALIB_CB_NORMALIZE_IMAGE)) {
+      return;
+    }
+    cv::cornerSubPix(matImg, corners, cv::Size(11, 11), cv::Size(-1, -1),
+                     cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::COUNT, 30, 0.1));
+  } else if (!cv::findCirclesGrid(matImg, board_size, corners, cv::CALIB_CB_SYMMETRIC_GRID)) {
+    return;
+  }
+
+  vpCameraParameters cam(width, width, width / 2., height / 2.);
+  view.points.resize(corners.size());
+  view.corners.resize(corners.size());
+  vpPose pose;
+  for (unsigned int i = 0; i < m_boardHeight; i++) {
+    for (unsigned int j = 0; j < m_boardWidth; j++) {
+      const size_t k = i * m_boardWidth + j;
+      double x = 0, y = 0;
+      view.corners[k].set_uv(corners[k].x, corners[k].y);
+      vpPixelMeterConversion::convertPoint(cam, view.corners[k], x, y);
+      view.points[k].setWorldCoordinates(j * m_squareSize, i * m_squareSize, 0);
+      view.points[k].set_x(x);
+      view.points[k].set_y(y);
+      pose.addPoint(view.points[k]);
+    }
+  }
+
+  // Keep the best linear pose to initialize the non linear one
+  vpHomogeneousMatrix cMo_dementhon, cMo_lagrange;
+  pose.computePose(vpPose::DEMENTHON, cMo_dementhon);
+  pose.computePose(vpPose::LAGRANGE, cMo_lagrange);
+  view.cMo = (pose.computeResidual(cMo_dementhon) < pose.computeResidual(cMo_lagrange)) ? cMo_dementhon : cMo_lagrange;
+  pose.computePose(vpPose::VIRTUAL_VS, view.cMo);
+  view.valid = true;
+#else
+  (void)view;
+  (void)width;
+  (void)height;
+  throw(vpException(vpException::fatalError, "OpenCV is required to find the calibration pattern"));
+#endif
+}
+
+/*!
+  Reprojection errors of all the valid views for the parameters \e cam and the poses \e cMo, one per view.
+  Each view is evaluated by a single thread over arrays of points: the points are first transformed in the
+  camera frame, then their residuals and Jacobians are accumulated in the normal equations of the view.
+
+  \param[in] cam : Intrinsic parameters, kud is used with vpCameraParameters::perspectiveProjWithDistortion.
+  \param[in] cMo : Pose of each view.
+  \param[out] normal : If not NULL, normal equations of each view.
+  \param[out] costs : If not NULL, sum of the squared errors in pixel of each view.
+  \return Sum of the squared errors in pixel of all the views.
+ */
+double vpIntrinsicCalibrator::evaluate(const vpCameraParameters &cam, const std::vector<vpHomogeneousMatrix> &cMo,
+                                       std::vector<vpNormalEquations> *normal, std::vector<double> *costs) const
+{
+  const double px = cam.get_px(), py = cam.get_py(), u0 = cam.get_u0(), v0 = cam.get_v0();
+  const double kud =
+      (cam.get_projModel() == vpCameraParameters::perspectiveProjWithDistortion) ? cam.get_kud() : 0.;
+  std::vector<double> view_costs(m_views.size(), 0.);
+  if (normal != NULL) {
+    normal->resize(m_views.size());
+  }
+
+  parallelFor(m_views.size(), m_nbThreads, [&](size_t i) {
+    const vpView &view = m_views[i];
+    if (!view.valid) {
+      return;
+    }
+    const size_t n = view.points.size();
+    std::vector<double> x(n), y(n), Z(n);
+    const vpHomogeneousMatrix &M = cMo[i];
+    const double r00 = M[0][0], r01 = M[0][1], r02 = M[0][2], t0 = M[0][3];
+    const double r10 = M[1][0], r11 = M[1][1], r12 = M[1][2], t1 = M[1][3];
+    const double r20 = M[2][0], r21 = M[2][1], r22 = M[2][2], t2 = M[2][3];
+    for (size_t j = 0; j < n; j++) {
+      const double oX = view.points[j].get_oX(), oY = view.points[j].get_oY(), oZ = view.points[j].get_oZ();
+      Z[j] = r20 * oX + r21 * oY + r22 * oZ + t2;
+      x[j] = (r00 * oX + r01 * oY + r02 * oZ + t0) / Z[j];
+      y[j] = (r10 * oX + r11 * oY + r12 * oZ + t1) / Z[j];
+    }
+
+    double cost = 0;
+    vpNormalEquations *eq = (normal != NULL) ? &(*normal)[i] : NULL;
+    if (eq != NULL) {
+      std::memset(eq, 0, sizeof(vpNormalEquations));
+    }
+    for (size_t j = 0; j < n; j++) {
+      const double r2 = x[j] * x[j] + y[j] * y[j];
+      const double d = 1 + kud * r2;
+      const double ru = u0 + px * x[j] * d - view.corners[j].get_u();
+      const double rv = v0 + py * y[j] * d - view.corners[j].get_v();
+      cost += ru * ru + rv * rv;
+      if (eq == NULL) {
+        continue;
+      }
+
+      // Jacobian of (u, v) wrt (px, py, u0, v0, kud) then wrt the camera velocity
+      double Ju[11] = {x[j] * d, 0, 1, 0, px * x[j] * r2};
+      double Jv[11] = {0, y[j] * d, 0, 1, py * y[j] * r2};
+      const double iZ = 1. / Z[j], xy = x[j] * y[j];
+      const double Lx[6] = {-iZ, 0, x[j] * iZ, xy, -(1 + x[j] * x[j]), y[j]};
+      const double Ly[6] = {0, -iZ, y[j] * iZ, 1 + y[j] * y[j], -xy, -x[j]};
+      const double a = px * (d + 2 * kud * x[j] * x[j]), b = px * 2 * kud * xy;
+      const double c = py * 2 * kud * xy, e = py * (d + 2 * kud * y[j] * y[j]);
+      for (unsigned int k = 0; k < 6; k++) {
+        Ju[nb_intrinsics + k] = a * Lx[k] + b * Ly[k];
+        Jv[nb_intrinsics + k] = c * Lx[k] + e * Ly[k];
+      }
+      for (unsigned int k = 0; k < 11; k++) {
+        for (unsigned int l = k; l < 11; l++) {
+          eq->H[k][l] += Ju[k] * Ju[l] + Jv[k] * Jv[l];
+        }
+        eq->g[k] += Ju[k] * ru + Jv[k] * rv;
+      }
+    }
+    if (eq != NULL) {
+      for (unsigned int k = 0; k < 11; k++) {
+        for (unsigned int l = 0; l < k; l++) {
+          eq->H[k][l] = eq->H[l][k];
+        }
+      }
+      eq->cost = cost;
+    }
+    view_costs[i] = cost;
+  });
+
+  double sum = 0;
+  for (size_t i = 0; i < view_costs.size(); i++) {
+    sum += view_costs[i];
+  }
+  if (costs != NULL) {
+    *costs = view_costs;
+  }
+  return sum;
+}
+
+// Least squares fit of kdu such that the measured points undistorted with kdu match the projected ones
+void vpIntrinsicCalibrator::fitInverseDistortion(vpCameraParameters &cam) const
+{
+  const double px = cam.get_px(), py = cam.get_py(), u0 = cam.get_u0(), v0 = cam.get_v0();
+  double num = 0, den = 0;
+  for (size_t i = 0; i < m_views.size(); i++) {
+    const vpView &view = m_views[i];
+    if (!view.valid) {
+      continue;
+    }
+    for (size_t j = 0; j < view.points.size(); j++) {
+      vpPoint P = view.points[j];
+      P.track(view.cMo);
+      const double du = view.corners[j].get_u() - u0, dv = view.corners[j].get_v() - v0;
+      const double rd2 = (du / px) * (du / px) + (dv / py) * (dv / py);
+      num += du * rd2 * (P.get_x() * px - du) + dv * rd2 * (P.get_y() * py - dv);
+      den += du * rd2 * du * rd2 + dv * rd2 * dv * rd2;
+    }
+  }
+  cam.initPersProjWithDistortion(px, py, u0, v0, cam.get_kud(), den > 0 ? num / den : 0.);
+}
+
+/*!
+  Levenberg-Marquardt refinement of the intrinsic parameters and of the poses of all the valid views, kud
+  being estimated with \e distortion. The poses and the residuals of the views are updated.
+
+  \return RMS reprojection error in pixel.
+ */
+double vpIntrinsicCalibrator::refine(vpCameraParameters &cam, bool distortion)
+{
+  const unsigned int nc = distortion ? nb_intrinsics : nb_intrinsics - 1;
+  std::vector<size_t> valid;
+  std::vector<vpHomogeneousMatrix> cMo(m_views.size());
+  size_t nb_points = 0;
+  for (size_t i = 0; i < m_views.size(); i++) {
+    cMo[i] = m_views[i].cMo;
+    if (m_views[i].valid) {
+      valid.push_back(i);
+      nb_points += m_views[i].points.size();
+    }
+  }
+  const unsigned int dim = nc + 6 * static_cast<unsigned int>(valid.size());
+
+  std::vector<vpNormalEquations> normal;
+  double cost = evaluate(cam, cMo, &normal, NULL);
+  double mu = 0.001;
+  bool converged = false;
+  for (unsigned int iter = 0; iter < max_iterations && !converged; iter++) {
+    // Normal equations of all the views: intrinsic block then one pose block per view
+    vpMatrix H(dim, dim);
+    vpColVector g(dim);
+    for (size_t k = 0; k < valid.size(); k++) {
+      const vpNormalEquations &eq = normal[valid[k]];
+      const unsigned int offset = nc + 6 * static_cast<unsigned int>(k);
+      for (unsigned int a = 0; a < nc; a++) {
+        for (unsigned int b = 0; b < nc; b++) {
+          H[a][b] += eq.H[a][b];
+        }
+        for (unsigned int b = 0; b < 6; b++) {
+          H[a][offset + b] = eq.H[a][nb_intrinsics + b];
+          H[offset + b][a] = eq.H[a][nb_intrinsics + b];
+        }
+        g[a] += eq.g[a];
+      }
+      for (unsigned int a = 0; a < 6; a++) {
+        for (unsigned int b = 0; b < 6; b++) {
+          H[offset + a][offset + b] = eq.H[nb_intrinsics + a][nb_intrinsics + b];
+        }
+        g[offset + a] = eq.g[nb_intrinsics + a];
+      }
+    }
+
+    bool improved = false;
+    while (!improved && mu < 1e10) {
+      vpMatrix Hs = H;
+      for (unsigned int k = 0; k < dim; k++) {
+        Hs[k][k] += mu * H[k][k];
+      }
+      vpColVector delta = -(Hs.pseudoInverse() * g);
+      vpCameraParameters cam_new;
+      if (distortion) {
+        cam_new.initPersProjWithDistortion(cam.get_px() + delta[0], cam.get_py() + delta[1], cam.get_u0() + delta[2],
+                                           cam.get_v0() + delta[3], cam.get_kud() + delta[4], 0);
+      } else {
+        cam_new.initPersProjWithoutDistortion(cam.get_px() + delta[0], cam.get_py() + delta[1],
+                                              cam.get_u0() + delta[2], cam.get_v0() + delta[3]);
+      }
+      std::vector<vpHomogeneousMatrix> cMo_new = cMo;
+      for (size_t k = 0; k < valid.size(); k++) {
+        vpColVector v(6);
+        for (unsigned int l = 0; l < 6; l++) {
+          v[l] = delta[nc + 6 * static_cast<unsigned int>(k) + l];
+        }
+        cMo_new[valid[k]] = vpExponentialMap::direct(v).inverse() * cMo[valid[k]];
+      }
+      std::vector<vpNormalEquations> normal_new;
+      double cost_new = evaluate(cam_new, cMo_new, &normal_new, NULL);
+      if (cost_new < cost) {
+        improved = true;
+        cam = cam_new;
+        cMo = cMo_new;
+        normal.swap(normal_new);
+        mu /= 10.;
+        converged = (cost - cost_new < 1e-10 * cost);
+        cost = cost_new;
+      } else {
+        mu *= 10.;
+      }
+    }
+    converged = converged || !improved;
+  }
+
+  std::vector<double> costs;
+  cost = evaluate(cam, cMo, NULL, &costs);
+  for (size_t k = 0; k < valid.size(); k++) {
+    vpView &view = m_views[valid[k]];
+    view.cMo = cMo[valid[k]];
+    view.residual = std::sqrt(costs[valid[k]] / view.points.size());
+  }
+  return nb_points > 0 ? std::sqrt(cost / nb_points) : 0.;
+}
+
+/*!
+  Set the calibration pattern.
+
+  \param[in] type : Chessboard or symmetric circles grid.
+  \param[in] width, height : Number of inner corners or of circles per row and per column.
+  \param[in] square_size : Size of a square or distance between two circle centers in meter.
+ */
+void vpIntrinsicCalibrator::setPattern(vpPatternType type, unsigned int width, unsigned int height,
+                                       double square_size)
+{
+  if (width < 2 || height < 2 || square_size <= 0) {
+    throw(vpException(vpException::badValue, "Invalid pattern %dx%d with %f m squares", width, height,
+                      square_size));
+  }
+  m_type = type;
+  m_boardWidth = width;
+  m_boardHeight = height;
+  m_squareSize = square_size;
+}
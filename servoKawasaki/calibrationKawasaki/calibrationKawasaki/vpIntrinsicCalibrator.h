@@ -0,0 +1,142 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Intrinsic calibration from a set of chessboard or circles grid images.
+ *
+ *****************************************************************************/
+
+
+#ifndef vpIntrinsicCalibrator_h
+#define vpIntrinsicCalibrator_h
+
+/*!
+  \file vpIntrinsicCalibrator.h
+  Intrinsic calibration from a set of chessboard or circles grid images.
+*/
+
+#include <string>
+#include <vector>
+
+#include <visp3/core/vpConfig.h>
+
+#include <visp3/core/vpCameraParameters.h>
+#include <visp3/core/vpHomogeneousMatrix.h>
+#include <visp3/core/vpImagePoint.h>
+#include <visp3/core/vpPoint.h>
+
+/*!
+
+  \class vpIntrinsicCalibrator
+  \brief Compute the intrinsic parameters of a camera, with and without distortion, from images of a
+  chessboard or a symmetric circles grid.
+
+  The pattern is extracted from all the images in parallel. Starting from the image center and a focal
+  length equal to the image width, the pose of each view is computed with vpPose. The intrinsic
+  parameters and all the poses are then refined together by Levenberg-Marquardt, minimizing the
+  reprojection error of all the points: first without distortion, then with the \f$k_{ud}\f$ distortion of
+  vpCameraParameters::perspectiveProjWithDistortion. The reprojection errors and their Jacobian are evaluated
+  view by view on all the cores, over arrays of points. The inverse distortion \f$k_{du}\f$ is finally fitted
+  on the measured points.
+
+  \code
+  vpIntrinsicCalibrator calibrator;
+  calibrator.setPattern(vpIntrinsicCalibrator::CHESSBOARD, 9, 6, 0.026);
+  calibrator.detect(image_files);
+  if (calibrator.calibrate()) {
+    vpCameraParameters cam = calibrator.getCameraParameters(true);
+    std::cout << "Residual: " << calibrator.getResidual(true) << " pixel" << std::endl;
+  }
+  \endcode
+
+*/
+class vpIntrinsicCalibrator
+{
+public:
+  //! Calibration pattern.
+  typedef enum {
+    CHESSBOARD,  //!< Inner corners of a chessboard
+    CIRCLES_GRID //!< Centers of a symmetric circles grid
+  } vpPatternType;
+
+  //! Data of an image.
+  struct vpView {
+    std::string filename;
+    std::vector<vpPoint> points;       //!< Pattern points in the pattern frame
+    std::vector<vpImagePoint> corners; //!< Measured pattern points
+    vpHomogeneousMatrix cMo;           //!< Pattern pose
+    bool valid;                        //!< True if the pattern is found
+    double residual;                   //!< RMS reprojection error in pixel with distortion
+  };
+
+  vpIntrinsicCalibrator();
+
+  bool calibrate();
+  unsigned int detect(const std::vector<std::string> &image_files);
+
+  //! Return the calibration result, with or without distortion.
+  const vpCameraParameters &getCameraParameters(bool distortion) const { return distortion ? m_camDist : m_cam; }
+  //! Return the size of the images given to detect().
+  unsigned int getImageHeight() const { return m_height; }
+  unsigned int getImageWidth() const { return m_width; }
+  //! Return the RMS reprojection error in pixel over all the views, with or without distortion.
+  double getResidual(bool distortion) const { return distortion ? m_residualDist : m_residual; }
+  //! Return the views given to detect().
+  const std::vector<vpView> &getViews() const { return m_views; }
+
+  //! Set the number of threads, 0 to use all the cores.
+  void setNbThreads(unsigned int nb) { m_nbThreads = nb; }
+  void setPattern(vpPatternType type, unsigned int width, unsigned int height, double square_size);
+
+protected:
+  //! Normal equations of a view over (px, py, u0, v0, kud) and the 6 pose parameters.
+  struct vpNormalEquations {
+    double H[11][11];
+    double g[11];
+    double cost; //!< Sum of the squared reprojection errors in pixel
+  };
+
+  void detectView(vpView &view, unsigned int &width, unsigned int &height) const;
+  double evaluate(const vpCameraParameters &cam, const std::vector<vpHomogeneousMatrix> &cMo,
+                  std::vector<vpNormalEquations> *normal, std::vector<double> *costs) const;
+  void fitInverseDistortion(vpCameraParameters &cam) const;
+  double refine(vpCameraParameters &cam, bool distortion);
+
+  vpPatternType m_type;
+  unsigned int m_boardWidth;  //!< Number of points per row
+  unsigned int m_boardHeight; //!< Number of points per column
+  double m_squareSize;
+  unsigned int m_nbThreads;
+  unsigned int m_width, m_height;
+  std::vector<vpView> m_views;
+  vpCameraParameters m_cam, m_camDist;
+  double m_residual, m_residualDist;
+};
+#endif
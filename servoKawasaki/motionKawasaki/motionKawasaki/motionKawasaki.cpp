@@ -0,0 +1,256 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Motion process of the Kawasaki robot, driven by the servo examples.
+ *
+ *****************************************************************************/
+
+/*!
+  \example motionKawasaki.cpp
+  Motion process of the Kawasaki robot. It owns the IPMC motion controller and sends the velocity of the
+  servo process to the drives at a fixed period, whatever the servo process is doing: image acquisition,
+  detection and display can stall or crash without stalling the robot control.
+
+  The velocities are exchanged through a shared-memory mailbox (see vpMotionMailbox). The servo process
+  writes end-effector velocity twists or joint velocities, and the control mode of the robot; the motion
+  process publishes the joint positions, the robot state and a heartbeat at each period. Start the motion
+  process first, then the servo example with the same mailbox name:
+  \code
+motionKawasaki --name KawasakiMotion --period 4
+servoKawasakiPBVS --motion_server KawasakiMotion
+  \endcode
+
+  A twist is converted in joint velocities at each period with the last joint positions. When no new
+  set-point is received during --timeout <ms>, the servo process is considered silent and the last velocity
+  is ramped down to zero in --ramp_time <ms>. The robot then stays in velocity control with a zero velocity
+  until the servo process sends new set-points or requests another control mode. The servo process throws an
+  exception when the heartbeat of the motion process stops.
+
+  With --rt_profile <file> command line option, the motion loop runs with the real-time priority and on the
+  cores of the profile (see vpRealTimeProfile), and the distribution of its period is printed when it stops
+  (see vpLoopJitter). With --trace <file>, the periods and the robot calls are saved in <file> as a Chrome
+  trace (see vpTrace). The process stops on Ctrl+C.
+*/
+
+#include <algorithm>
+#include <csignal>
+#include <iostream>
+#include <string>
+
+#include <visp3/core/vpColVector.h>
+#include <visp3/core/vpConfig.h>
+#include <visp3/core/vpTime.h>
+#include <vpLoopJitter.h>
+#include <vpMotionMailbox.h>
+#include <vpRealTimeProfile.h>
+#include <vpRobotKawasaki.h>
+#include <vpTrace.h>
+
+#if (VISP_CXX_STANDARD >= VISP_CXX_STANDARD_11)
+
+namespace
+{
+volatile std::sig_atomic_t quit = 0;
+
+void signalHandler(int) { quit = 1; }
+} // namespace
+
+int main(int argc, char **argv)
+{
+  std::string opt_name = "KawasakiMotion";
+  double opt_period = 4.;
+  double opt_timeout = 200.;
+  double opt_ramp_time = 300.;
+  std::string opt_rt_profile_filename = "";
+  std::string opt_trace_filename = "";
+  bool opt_verbose = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (std::string(argv[i]) == "--name" && i + 1 < argc) {
+      opt_name = std::string(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--period" && i + 1 < argc) {
+      opt_period = std::stod(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--timeout" && i + 1 < argc) {
+      opt_timeout = std::stod(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--ramp_time" && i + 1 < argc) {
+      opt_ramp_time = std::max(1., std::stod(argv[i + 1]));
+    } else if (std::string(argv[i]) == "--rt_profile" && i + 1 < argc) {
+      opt_rt_profile_filename = std::string(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--trace" && i + 1 < argc) {
+      opt_trace_filename = std::string(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--verbose") {
+      opt_verbose = true;
+    } else if (std::string(argv[i]) == "--help" || std::string(argv[i]) == "-h") {
+      std::cout << argv[0] << " [--name <mailbox name; default " << opt_name << ">] [--period <ms; default "
+                << opt_period << ">] [--timeout <ms; default " << opt_timeout << ">] [--ramp_time <ms; default "
+                << opt_ramp_time << ">] [--rt_profile <profile file>] [--trace <json file>] [--verbose] [--help] [-h]"
+                << "\n";
+      return EXIT_SUCCESS;
+    }
+  }
+
+  // Scheduling of the process if --rt_profile is used
+  vpRealTimeProfile rt_profile;
+  bool use_rt_profile = !opt_rt_profile_filename.empty();
+  if (use_rt_profile) {
+    if (!rt_profile.load(opt_rt_profile_filename)) {
+      std::cout << "Can not read the real-time profile " << opt_rt_profile_filename << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (!rt_profile.preflight(std::cout)) {
+      std::cout << "The real-time profile can not be applied, fix the errors above." << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (!rt_profile.applyProcess() || !rt_profile.applyControlThread()) {
+      std::cout << "Warning: the real-time profile is not fully applied." << std::endl;
+    }
+  }
+
+  if (!opt_trace_filename.empty()) {
+    if (!vpTrace::isCompiled()) {
+      std::cout << "Warning: build with VP_TRACE defined to record a trace in " << opt_trace_filename << std::endl;
+    }
+    vpTrace::start();
+  }
+
+  vpRobotKawasaki robot;
+
+  try {
+    if (robot.connect() == EXIT_FAILURE) {
+      std::cout << "Can not connect to the robot." << std::endl;
+      return EXIT_FAILURE;
+    }
+    std::cout << "Successfully connect to the robot." << std::endl;
+
+    vpMotionMailbox mailbox;
+    if (!mailbox.create(opt_name)) {
+      std::cout << "Can not create the mailbox " << opt_name << std::endl;
+      return EXIT_FAILURE;
+    }
+    std::signal(SIGINT, signalHandler);
+    std::signal(SIGTERM, signalHandler);
+    std::cout << "Mailbox " << opt_name << " ready, period " << opt_period << " ms" << std::endl;
+
+    vpLoopJitter jitter(opt_period);
+    vpMotionMailbox::vpSetPoint set_point;
+    vpMotionMailbox::vpMotionState state;
+    vpRobot::vpControlFrameType frame = vpRobot::JOINT_STATE;
+    vpColVector velocity(6, 0), velocity_scaled(6), q(6);
+    unsigned int sequence = 0;
+    double t_set_point = vpTime::measureTimeMs();
+    bool ramping_down = false;
+    VP_TRACE_THREAD("motion");
+
+    while (!quit) {
+      double t_start = vpTime::measureTimeMs();
+      jitter.tick(t_start);
+      VP_TRACE_ZONE(zone_period, "period");
+
+      // Control mode requested by the servo process, switching the drives takes seconds
+      vpRobot::vpRobotStateType requested_state = mailbox.getRequestedRobotState();
+      if (requested_state != robot.getRobotState()) {
+        robot.setRobotState(requested_state);
+        velocity = 0;
+        t_set_point = t_start = vpTime::measureTimeMs();
+        // The jitter is measured from the last change of the control mode
+        jitter.reset();
+      }
+
+      if (mailbox.readSetPoint(set_point) && set_point.sequence != sequence) {
+        sequence = set_point.sequence;
+        frame = set_point.frame;
+        for (unsigned int i = 0; i < 6; i++) {
+          velocity[i] = set_point.velocity[i];
+        }
+        t_set_point = t_start;
+      }
+
+      // Ramp down the last velocity when the servo process is silent
+      double silence = t_start - t_set_point;
+      double scale = 1.;
+      if (silence > opt_timeout) {
+        scale = std::max(0., 1. - (silence - opt_timeout) / opt_ramp_time);
+        if (!ramping_down && robot.getRobotState() == vpRobot::STATE_VELOCITY_CONTROL) {
+          std::cout << "No set-point since " << silence << " ms, ramp down the velocity" << std::endl;
+        }
+      } else if (ramping_down && opt_verbose) {
+        std::cout << "Set-points received again" << std::endl;
+      }
+      ramping_down = silence > opt_timeout;
+
+      if (robot.getRobotState() == vpRobot::STATE_VELOCITY_CONTROL) {
+        for (unsigned int i = 0; i < 6; i++) {
+          velocity_scaled[i] = scale * velocity[i];
+        }
+        robot.setVelocity(frame, velocity_scaled);
+      }
+
+      robot.getPosition(vpRobot::JOINT_STATE, q);
+      for (unsigned int i = 0; i < 6; i++) {
+        state.q[i] = q[i];
+      }
+      state.robotState = robot.getRobotState();
+      state.rampingDown = ramping_down;
+      mailbox.writeState(state);
+      VP_TRACE_ZONE_END(zone_period);
+
+      vpTime::wait(t_start, opt_period);
+    }
+
+    std::cout << "Stop the robot " << std::endl;
+    robot.setRobotState(vpRobot::STATE_STOP);
+    if (use_rt_profile || opt_verbose) {
+      std::cout << jitter.getReport() << std::endl;
+    }
+    if (!opt_trace_filename.empty()) {
+      vpTrace::stop();
+      if (vpTrace::save(opt_trace_filename)) {
+        std::cout << "Trace saved in " << opt_trace_filename << std::endl;
+      } else {
+        std::cout << "Can not write " << opt_trace_filename << std::endl;
+      }
+    }
+  } catch (const vpException &e) {
+    std::cout << "ViSP exception: " << e.what() << std::endl;
+    std::cout << "Stop the robot " << std::endl;
+    robot.setRobotState(vpRobot::STATE_STOP);
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+#else
+int main()
+{
+  std::cout << "Build ViSP with c++11 or higher compiler flag (cmake -DUSE_CXX_STANDARD=11)." << std::endl;
+  return 0;
+}
+#endif
@@ -0,0 +1,462 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Compile-time Denavit-Hartenberg kinematics of the Kawasaki arms.
+ *
+ *****************************************************************************/
+
+#ifndef vpDHKinematics_h
+#define vpDHKinematics_h
+
+/*!
+  \file vpDHKinematics.h
+  Compile-time Denavit-Hartenberg kinematics of the Kawasaki arms.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+/*!
+  Link of a serial arm in the modified Denavit-Hartenberg convention: the transformation from the frame of
+  link i-1 to the frame of link i is RotX(alpha) TransX(a) RotZ(theta + q_i) TransZ(d).
+*/
+struct vpDHLink {
+  double cosAlpha;
+  double sinAlpha;
+  double a;     //!< Distance in meter along the x axis of link i-1
+  double d;     //!< Distance in meter along the z axis of link i
+  double theta; //!< Offset of the joint angle in rad
+
+  //! Link twisted by \e alpha in degree, whose cosine and sine are computed at compile time.
+  constexpr vpDHLink(double alpha, double a_, double d_, double theta_ = 0)
+    : cosAlpha(cosDeg(alpha)), sinAlpha(cosDeg(alpha - 90)), a(a_), d(d_), theta(theta_)
+  {
+  }
+
+  //! Return the cosine of an angle in degree, exact for the multiples of 90 degrees.
+  static constexpr double cosDeg(double angle)
+  {
+    while (angle < 0) {
+      angle += 360;
+    }
+    while (angle >= 360) {
+      angle -= 360;
+    }
+    if (angle == 0) {
+      return 1;
+    }
+    if (angle == 90 || angle == 270) {
+      return 0;
+    }
+    if (angle == 180) {
+      return -1;
+    }
+    // Taylor series on [-180, 180]
+    const double x = (angle > 180 ? angle - 360 : angle) * 3.14159265358979323846 / 180;
+    double term = 1, sum = 1;
+    for (int k = 1; k < 30; k++) {
+      term *= -x * x / ((2 * k - 1) * (2 * k));
+      sum += term;
+    }
+    return sum;
+  }
+};
+
+//! Drive of a joint, whose angle is measured by the encoder of the motor behind a reducer.
+struct vpJointDrive {
+  long encoderHome;      //!< Encoder position in increments at the home position
+  double homeAngle;      //!< Joint angle in degree at the home position
+  double reductionRatio; //!< Turns of the motor per turn of the joint
+  int direction;         //!< 1 if the motor turns with the joint, -1 otherwise
+};
+
+/*!
+
+  \class vpKawasakiArm
+  \brief Description of the Kawasaki arm of the cell used by vpDHKinematics.
+
+  Another arm of the family, or the arm of another cell, is described by a structure with the same members,
+  whose tables are defined in vpDHKinematics.cpp.
+
+*/
+struct vpKawasakiArm {
+  static constexpr unsigned int dof = 6;
+  //! Increments per turn of the motor encoders.
+  static constexpr long encoderResolution = 131072;
+
+  static constexpr vpDHLink link[dof] = {vpDHLink(0, 0, 0.36),    vpDHLink(90, 0, 0),  vpDHLink(0, 0.355, 0),
+                                         vpDHLink(90, 0, 0.375),  vpDHLink(-90, 0, 0), vpDHLink(90, 0, 0.078)};
+
+  static constexpr vpJointDrive drive[dof] = {{103319, 0, 80.008, 1},  {92992, 90, 99.902, 1},
+                                              {116630, 90, 78.433, -1}, {31953, 0, 50.001, 1},
+                                              {111221, 0, 64.001, -1},  {91157, 0, 40.000, 1}};
+
+  /*!
+    Joint angles q = coupling * q_m, with q_m the angles measured behind the reducers. The matrix has to be
+    lower triangular with a unit diagonal. The joint 6 turns with the joint 5.
+   */
+  static constexpr double coupling[dof][dof] = {{1, 0, 0, 0, 0, 0}, {0, 1, 0, 0, 0, 0}, {0, 0, 1, 0, 0, 0},
+                                                {0, 0, 0, 1, 0, 0}, {0, 0, 0, 0, 1, 0}, {0, 0, 0, 0, 0.01248916, 1}};
+
+  //! Joint limits in degree.
+  static constexpr double jointMin[dof] = {-180, -135, -155, -200, -125, -360};
+  static constexpr double jointMax[dof] = {180, 135, 155, 200, 125, 360};
+};
+
+/*!
+
+  \class vpDHKinematics
+  \brief Kinematics of the serial arm described by \e Model, generated at compile time.
+
+  The model gives the modified Denavit-Hartenberg parameters of its links, the drives and the coupling of
+  the joints, like vpKawasakiArm. The products of the link transformations, the columns of the Jacobian and
+  the coupling of the joints are unrolled by templates on the joint index, so that the constant parameters
+  (0 or 1 for the twists, zero lengths and couplings) are folded by the compiler, and nothing is allocated.
+
+  The matrices are row-major arrays, like the elements of a vpMatrix or a vpHomogeneousMatrix:
+  \code
+  vpHomogeneousMatrix fMe;
+  vpDHKinematics<vpKawasakiArm>::get_fMe(q.data, fMe.data);
+  vpMatrix eJe(6, vpKawasakiArm::dof);
+  vpDHKinematics<vpKawasakiArm>::get_eJe(q.data, eJe.data);
+  \endcode
+
+*/
+template <typename Model> class vpDHKinematics
+{
+public:
+  static constexpr unsigned int dof = Model::dof;
+
+  /*!
+    Compute the transformation between the reference frame and the end-effector frame.
+
+    \param[in] q : Joint positions in rad.
+    \param[out] fMe : 4x4 forward kinematics.
+   */
+  static void get_fMe(const double *q, double *fMe)
+  {
+    double T[dof + 1][12];
+    setIdentity(T[0]);
+    frames(q, T, index<0>());
+    std::copy(T[dof], T[dof] + 12, fMe);
+    fMe[12] = fMe[13] = fMe[14] = 0;
+    fMe[15] = 1;
+  }
+
+  /*!
+    Compute the Jacobian expressed in the reference frame, whose column i is [z_i x p_i; z_i], with z_i the
+    axis of the joint i and p_i the vector from its origin to the end-effector.
+
+    \param[in] q : Joint positions in rad.
+    \param[out] fJe : 6 x dof Jacobian.
+   */
+  static void get_fJe(const double *q, double *fJe)
+  {
+    double T[dof + 1][12];
+    setIdentity(T[0]);
+    frames(q, T, index<0>());
+    jacobian(T, fJe, index<0>());
+  }
+
+  /*!
+    Compute the Jacobian expressed in the end-effector frame, eJe = [eRf 0; 0 eRf] fJe.
+
+    \param[in] q : Joint positions in rad.
+    \param[out] eJe : 6 x dof Jacobian.
+   */
+  static void get_eJe(const double *q, double *eJe)
+  {
+    double T[dof + 1][12];
+    double fJe[6 * dof];
+    setIdentity(T[0]);
+    frames(q, T, index<0>());
+    jacobian(T, fJe, index<0>());
+    const double *fMe = T[dof];
+    for (unsigned int i = 0; i < 3; i++) {
+      for (unsigned int j = 0; j < dof; j++) {
+        eJe[i * dof + j] = fMe[i] * fJe[j] + fMe[4 + i] * fJe[dof + j] + fMe[8 + i] * fJe[2 * dof + j];
+        eJe[(i + 3) * dof + j] =
+            fMe[i] * fJe[3 * dof + j] + fMe[4 + i] * fJe[4 * dof + j] + fMe[8 + i] * fJe[5 * dof + j];
+      }
+    }
+  }
+
+  //! Compute the joint positions in rad from the encoder positions in increments.
+  static void encoderToJoint(const long *encoder, double *q)
+  {
+    double q_m[dof];
+    for (unsigned int i = 0; i < dof; i++) {
+      const vpJointDrive &drive = Model::drive[i];
+      q_m[i] = (encoder[i] - drive.encoderHome) * drive.direction * 2 * pi() /
+                   (Model::encoderResolution * drive.reductionRatio) +
+               drive.homeAngle * pi() / 180;
+    }
+    couple(q_m, q, index<0>());
+  }
+
+  //! Compute the encoder positions in increments, rounded, from the joint positions in rad.
+  static void jointToEncoder(const double *q, long *encoder)
+  {
+    double q_m[dof];
+    decouple(q, q_m, index<0>());
+    for (unsigned int i = 0; i < dof; i++) {
+      const vpJointDrive &drive = Model::drive[i];
+      encoder[i] = drive.encoderHome + static_cast<long>(std::floor(
+                                           (q_m[i] - drive.homeAngle * pi() / 180) * drive.direction *
+                                               Model::encoderResolution * drive.reductionRatio / (2 * pi()) +
+                                           0.5));
+    }
+  }
+
+  //! Compute the encoder velocities in increments/s from the joint velocities in rad/s.
+  static void jointToEncoderVelocity(const double *qdot, double *encoder_velocity)
+  {
+    double qdot_m[dof];
+    decouple(qdot, qdot_m, index<0>());
+    for (unsigned int i = 0; i < dof; i++) {
+      const vpJointDrive &drive = Model::drive[i];
+      encoder_velocity[i] =
+          qdot_m[i] * drive.direction * drive.reductionRatio * Model::encoderResolution / (2 * pi());
+    }
+  }
+
+  /*!
+    Compute the joint positions that reach the end-effector pose \e fMe, by damped least squares iterations
+    from the joint positions \e q_init. The closest solution to \e q_init is found, without joint limits.
+
+    \param[in] fMe : 4x4 transformation between the reference frame and the end-effector frame.
+    \param[in] q_init : Initial joint positions in rad.
+    \param[out] q : Joint positions in rad, may be \e q_init.
+    \param[in] max_iter : Maximal number of iterations.
+    \param[in] tolerance : Largest norm of the position (meter) and orientation (rad) error.
+    \return true if the pose is reached.
+   */
+  static bool inverse(const double *fMe, const double *q_init, double *q, unsigned int max_iter = 100,
+                      double tolerance = 1e-9)
+  {
+    const double damping = 1e-3;
+    double T[dof + 1][12];
+    double fJe[6 * dof];
+    std::copy(q_init, q_init + dof, q);
+    setIdentity(T[0]);
+    for (unsigned int iter = 0;; iter++) {
+      frames(q, T, index<0>());
+      double e[6];
+      poseError(fMe, T[dof], e);
+      double norm = 0;
+      for (unsigned int i = 0; i < 6; i++) {
+        norm += e[i] * e[i];
+      }
+      if (std::sqrt(norm) < tolerance) {
+        return true;
+      }
+      if (iter == max_iter) {
+        return false;
+      }
+      // dq = fJe^T (fJe fJe^T + damping^2 I)^-1 e
+      jacobian(T, fJe, index<0>());
+      double A[6][7];
+      for (unsigned int i = 0; i < 6; i++) {
+        for (unsigned int j = 0; j < 6; j++) {
+          double s = (i == j ? damping * damping : 0);
+          for (unsigned int k = 0; k < dof; k++) {
+            s += fJe[i * dof + k] * fJe[j * dof + k];
+          }
+          A[i][j] = s;
+        }
+        A[i][6] = e[i];
+      }
+      if (!solve(A)) {
+        return false;
+      }
+      for (unsigned int k = 0; k < dof; k++) {
+        for (unsigned int i = 0; i < 6; i++) {
+          q[k] += fJe[i * dof + k] * A[i][6];
+        }
+      }
+    }
+  }
+
+private:
+  template <unsigned int I> using index = std::integral_constant<unsigned int, I>;
+
+  static constexpr double pi() { return 3.14159265358979323846; }
+
+  //! Return true if the coupling matrix is lower triangular with a unit diagonal.
+  static constexpr bool isCouplingTriangular()
+  {
+    for (unsigned int i = 0; i < dof; i++) {
+      for (unsigned int j = i; j < dof; j++) {
+        if (Model::coupling[i][j] != (i == j ? 1 : 0)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  //! Set the 3x4 upper part of a homogeneous matrix to identity.
+  static void setIdentity(double *T)
+  {
+    std::fill(T, T + 12, 0.);
+    T[0] = T[5] = T[10] = 1;
+  }
+
+  //! T = T * (transformation of the link I for the joint angle q).
+  template <unsigned int I> static void compose(double *T, double q)
+  {
+    const vpDHLink &link = Model::link[I];
+    const double ct = std::cos(q + link.theta), st = std::sin(q + link.theta);
+    const double ca = link.cosAlpha, sa = link.sinAlpha;
+    for (unsigned int r = 0; r < 3; r++) {
+      double *row = T + 4 * r;
+      const double t0 = row[0], t1 = row[1], t2 = row[2];
+      row[0] = t0 * ct + (t1 * ca + t2 * sa) * st;
+      row[1] = -t0 * st + (t1 * ca + t2 * sa) * ct;
+      row[2] = t2 * ca - t1 * sa;
+      row[3] += t0 * link.a + (t2 * ca - t1 * sa) * link.d;
+    }
+  }
+
+  //! T[I + 1] is the frame of the link I in the reference frame, T[0] has to be the identity.
+  template <unsigned int I> static void frames(const double *q, double (*T)[12], index<I>)
+  {
+    std::copy(T[I], T[I] + 12, T[I + 1]);
+    compose<I>(T[I + 1], q[I]);
+    frames(q, T, index<I + 1>());
+  }
+  static void frames(const double *, double (*)[12], index<dof>) {}
+
+  //! Fill the column I of the Jacobian in the reference frame from the frames of the links.
+  template <unsigned int I> static void jacobian(double (*T)[12], double *fJe, index<I>)
+  {
+    const double *Ti = T[I + 1], *Tn = T[dof];
+    const double z[3] = {Ti[2], Ti[6], Ti[10]};
+    const double p[3] = {Tn[3] - Ti[3], Tn[7] - Ti[7], Tn[11] - Ti[11]};
+    fJe[I] = z[1] * p[2] - p[1] * z[2];
+    fJe[dof + I] = z[2] * p[0] - p[2] * z[0];
+    fJe[2 * dof + I] = z[0] * p[1] - p[0] * z[1];
+    fJe[3 * dof + I] = z[0];
+    fJe[4 * dof + I] = z[1];
+    fJe[5 * dof + I] = z[2];
+    jacobian(T, fJe, index<I + 1>());
+  }
+  static void jacobian(double (*)[12], double *, index<dof>) {}
+
+  //! q[I] = q_m[I] + sum over j < I of coupling[I][j] * q_m[j].
+  template <unsigned int I> static void couple(const double *q_m, double *q, index<I>)
+  {
+    static_assert(isCouplingTriangular(), "The coupling matrix has to be lower triangular with a unit diagonal");
+    double s = q_m[I];
+    for (unsigned int j = 0; j < I; j++) {
+      s += Model::coupling[I][j] * q_m[j];
+    }
+    q[I] = s;
+    couple(q_m, q, index<I + 1>());
+  }
+  static void couple(const double *, double *, index<dof>) {}
+
+  //! Inverse of couple() by forward substitution.
+  template <unsigned int I> static void decouple(const double *q, double *q_m, index<I>)
+  {
+    static_assert(isCouplingTriangular(), "The coupling matrix has to be lower triangular with a unit diagonal");
+    double s = q[I];
+    for (unsigned int j = 0; j < I; j++) {
+      s -= Model::coupling[I][j] * q_m[j];
+    }
+    q_m[I] = s;
+    decouple(q, q_m, index<I + 1>());
+  }
+  static void decouple(const double *, double *, index<dof>) {}
+
+  /*!
+    Error between the desired pose \e fMd (4x4) and the pose \e fMe (3x4): translation fpd - fpe, then the
+    theta u vector of fRd fRe^T, both in the reference frame.
+   */
+  static void poseError(const double *fMd, const double *fMe, double *e)
+  {
+    double R[3][3];
+    for (unsigned int i = 0; i < 3; i++) {
+      e[i] = fMd[4 * i + 3] - fMe[4 * i + 3];
+      for (unsigned int j = 0; j < 3; j++) {
+        R[i][j] = fMd[4 * i] * fMe[4 * j] + fMd[4 * i + 1] * fMe[4 * j + 1] + fMd[4 * i + 2] * fMe[4 * j + 2];
+      }
+    }
+    const double u[3] = {0.5 * (R[2][1] - R[1][2]), 0.5 * (R[0][2] - R[2][0]), 0.5 * (R[1][0] - R[0][1])};
+    const double s = std::sqrt(u[0] * u[0] + u[1] * u[1] + u[2] * u[2]);
+    const double c = 0.5 * (R[0][0] + R[1][1] + R[2][2] - 1);
+    const double theta = std::atan2(s, c);
+    for (unsigned int i = 0; i < 3; i++) {
+      if (s > 1e-12) {
+        e[3 + i] = theta / s * u[i];
+      } else if (c > 0) {
+        e[3 + i] = u[i];
+      } else {
+        // Half turn: the axis is given by the diagonal, up to its signs
+        e[3 + i] = theta * std::sqrt(std::max(0., 0.5 * (R[i][i] + 1)));
+      }
+    }
+  }
+
+  //! Solve the 6x6 system A[:, 0:6] x = A[:, 6] in place by Gauss elimination with partial pivoting.
+  static bool solve(double (&A)[6][7])
+  {
+    for (unsigned int k = 0; k < 6; k++) {
+      unsigned int pivot = k;
+      for (unsigned int i = k + 1; i < 6; i++) {
+        if (std::fabs(A[i][k]) > std::fabs(A[pivot][k])) {
+          pivot = i;
+        }
+      }
+      if (A[pivot][k] == 0) {
+        return false;
+      }
+      if (pivot != k) {
+        std::swap_ranges(A[k], A[k] + 7, A[pivot]);
+      }
+      for (unsigned int i = 0; i < 6; i++) {
+        if (i == k) {
+          continue;
+        }
+        const double factor = A[i][k] / A[k][k];
+        for (unsigned int j = k; j < 7; j++) {
+          A[i][j] -= factor * A[k][j];
+        }
+      }
+    }
+    for (unsigned int i = 0; i < 6; i++) {
+      A[i][6] /= A[i][i];
+    }
+    return true;
+  }
+};
+#endif
@@ -0,0 +1,123 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Jitter of the servo loop period.
+ *
+ *****************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+#include <visp3/core/vpTime.h>
+
+/*!
+  \file vpLoopJitter.cpp
+  Jitter of the servo loop period.
+*/
+
+#include <vpLoopJitter.h>
+
+/*!
+  \param period : Expected period of the loop in ms.
+  \param capacity : Number of periods kept for the percentiles.
+ */
+vpLoopJitter::vpLoopJitter(double period, size_t capacity)
+  : m_period(period), m_deadline(1.5 * period), m_samples(), m_tPrev(-1), m_nb(0), m_nbMisses(0), m_sum(0),
+    m_sumSquare(0), m_min(std::numeric_limits<double>::max()), m_max(0)
+{
+  m_samples.reserve(capacity);
+}
+
+/*!
+  Return the \e p percentile, \e p in [0, 1], of the stored periods in ms.
+ */
+double vpLoopJitter::getPercentile(double p) const
+{
+  if (m_samples.empty()) {
+    return 0;
+  }
+  std::vector<double> samples = m_samples;
+  size_t k = static_cast<size_t>(std::min(1., std::max(0., p)) * (samples.size() - 1) + 0.5);
+  std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+  return samples[k];
+}
+
+std::string vpLoopJitter::getReport() const
+{
+  std::stringstream ss;
+  if (m_nb == 0) {
+    ss << "Loop period: no iteration";
+    return ss.str();
+  }
+  const double mean = m_sum / m_nb;
+  const double std_dev = std::sqrt(std::max(0., m_sumSquare / m_nb - mean * mean));
+  ss << "Loop period over " << m_nb << " iterations (expected " << m_period << " ms): mean " << mean
+     << " ms, std " << std_dev << " ms, min " << m_min << " ms, max " << m_max << " ms, p99 "
+     << getPercentile(0.99) << " ms, p99.9 " << getPercentile(0.999) << " ms, " << m_nbMisses
+     << " deadline misses (> " << m_deadline << " ms)";
+  return ss.str();
+}
+
+void vpLoopJitter::reset()
+{
+  m_samples.clear();
+  m_tPrev = -1;
+  m_nb = 0;
+  m_nbMisses = 0;
+  m_sum = m_sumSquare = 0;
+  m_min = std::numeric_limits<double>::max();
+  m_max = 0;
+}
+
+//! Start of an iteration at the current time.
+void vpLoopJitter::tick() { tick(vpTime::measureTimeMs()); }
+
+//! Start of an iteration at time \e t in ms.
+void vpLoopJitter::tick(double t)
+{
+  if (m_tPrev >= 0) {
+    const double period = t - m_tPrev;
+    if (m_samples.size() < m_samples.capacity()) {
+      m_samples.push_back(period);
+    }
+    m_nb++;
+    m_sum += period;
+    m_sumSquare += period * period;
+    m_min = std::min(m_min, period);
+    m_max = std::max(m_max, period);
+    if (period > m_deadline) {
+      m_nbMisses++;
+    }
+  }
+  m_tPrev = t;
+}
@@ -0,0 +1,131 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Shared-memory mailbox between the servo and the motion processes.
+ *
+ *****************************************************************************/
+
+#ifndef vpMotionMailbox_h
+#define vpMotionMailbox_h
+
+/*!
+  \file vpMotionMailbox.h
+  Shared-memory mailbox between the servo and the motion processes.
+*/
+
+#include <string>
+
+#include <visp3/core/vpConfig.h>
+
+#include <visp3/core/vpColVector.h>
+#include <visp3/robot/vpRobot.h>
+
+/*!
+
+  \class vpMotionMailbox
+  \brief Lock-free mailbox in shared memory between a servo process, that computes the velocities, and the
+  motion process that drives the robot (see motionKawasaki.cpp).
+
+  The mailbox holds two records, each one written by a single process and protected by a sequence counter:
+  the writer makes the counter odd, writes the record and makes it even again, and the reader copies the
+  record and retries if the counter was odd or has changed. Neither side ever waits on the other one: a
+  process that stalls or crashes in the middle of a write leaves an odd counter, that the other side sees as
+  no new data. Either process may be restarted while the other one keeps running: the restarted writer
+  completes the interrupted write with its first one.
+  - The set-point is written by the servo process: an end-effector velocity twist or joint velocities, and
+    the requested robot state. Its counter is the heartbeat of the servo process.
+  - The motion state is written by the motion process at each of its periods: joint positions, robot
+    state, and a heartbeat counter.
+
+  \code
+  // Motion process
+  vpMotionMailbox mailbox;
+  mailbox.create("KawasakiMotion");
+  vpMotionMailbox::vpSetPoint set_point;
+  if (mailbox.readSetPoint(set_point)) {
+    ...
+  }
+  mailbox.writeState(state);
+
+  // Servo process
+  vpMotionMailbox mailbox;
+  mailbox.open("KawasakiMotion");
+  mailbox.writeSetPoint(vpRobot::END_EFFECTOR_FRAME, v_e);
+  \endcode
+
+*/
+class vpMotionMailbox
+{
+public:
+  //! Velocity set-point of the servo process.
+  struct vpSetPoint {
+    vpRobot::vpControlFrameType frame; //!< vpRobot::END_EFFECTOR_FRAME or vpRobot::JOINT_STATE
+    double velocity[6];                //!< m/s and rad/s
+    unsigned int sequence;             //!< Number of set-points written so far
+  };
+
+  //! State of the robot published by the motion process.
+  struct vpMotionState {
+    double q[6]; //!< Joint positions in rad
+    vpRobot::vpRobotStateType robotState;
+    bool rampingDown;       //!< The servo process is silent, the velocity is ramped down
+    unsigned int heartbeat; //!< Incremented at each period of the motion process
+  };
+
+  vpMotionMailbox();
+  vpMotionMailbox(const vpMotionMailbox &) = delete;
+  virtual ~vpMotionMailbox();
+  vpMotionMailbox &operator=(const vpMotionMailbox &) = delete;
+
+  void close();
+  bool create(const std::string &name);
+  vpRobot::vpRobotStateType getRequestedRobotState() const;
+  //! Return true when the mailbox is created or opened.
+  bool isOpen() const { return m_data != nullptr; }
+  bool open(const std::string &name);
+  bool readSetPoint(vpSetPoint &set_point) const;
+  bool readState(vpMotionState &state) const;
+  void requestRobotState(vpRobot::vpRobotStateType state);
+  void writeSetPoint(vpRobot::vpControlFrameType frame, const vpColVector &velocity);
+  void writeState(const vpMotionState &state);
+
+protected:
+  struct vpSharedData;
+
+  bool map(const std::string &name, bool create);
+
+  vpSharedData *m_data;
+  bool m_owner;
+  std::string m_name;
+  void *m_handle; //!< File mapping handle on Windows
+  int m_fd;       //!< Shared memory file descriptor on Linux
+};
+#endif
@@ -0,0 +1,130 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Real-time scheduling profile of the servo process.
+ *
+ *****************************************************************************/
+
+#ifndef vpRealTimeProfile_h
+#define vpRealTimeProfile_h
+
+/*!
+  \file vpRealTimeProfile.h
+  Real-time scheduling profile of the servo process.
+*/
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include <visp3/core/vpConfig.h>
+
+/*!
+
+  \class vpRealTimeProfile
+  \brief Scheduling of the servo process: priority and cores of the control thread, cores of the other
+  threads, memory locking.
+
+  The profile is read from a file with one "key: value" per line, # starting a comment:
+  \code
+# Real-time priority of the control thread: SCHED_FIFO 1 to 99 on Linux, mapped to the thread priorities
+# on Windows. 0 keeps the default scheduling.
+control_priority: 80
+# Cores of the control thread, and of the other threads of the process. Empty for all the cores.
+control_cpus: 3
+other_cpus: 0,1,2
+# Lock the process memory (mlockall on Linux, working set on Windows) and pre-fault the control thread stack
+lock_memory: 1
+stack_prefault: 524288
+# Expected period of the control loop in ms, used by the jitter report
+period: 33
+  \endcode
+
+  applyProcess() must be called first, before the camera and the other threads are created since they inherit
+  the cores of the process. applyControlThread() is then called by the control thread. On Linux, threads
+  created afterwards by the control thread inherit its policy and cores. preflight() checks that the platform
+  can apply the profile: permissions, cores, and on Linux isolated cores and frequency governor.
+
+  \code
+  vpRealTimeProfile profile;
+  if (!profile.load("rt-profile.cfg") || !profile.preflight(std::cout)) {
+    return EXIT_FAILURE;
+  }
+  profile.applyProcess();
+  ...
+  profile.applyControlThread();
+  while (servo) {
+    ...
+  }
+  \endcode
+
+*/
+class vpRealTimeProfile
+{
+public:
+  vpRealTimeProfile();
+
+  bool applyControlThread() const;
+  bool applyProcess() const;
+
+  //! Return the cores of the control thread, empty for all.
+  const std::vector<int> &getControlCpus() const { return m_controlCpus; }
+  //! Return the priority of the control thread, 0 for the default scheduling.
+  int getControlPriority() const { return m_controlPriority; }
+  //! Return the cores of the other threads, empty for all.
+  const std::vector<int> &getOtherCpus() const { return m_otherCpus; }
+  //! Return the expected period of the control loop in ms.
+  double getPeriod() const { return m_period; }
+
+  bool load(const std::string &filename);
+  static void prefaultStack(size_t size);
+  bool preflight(std::ostream &os) const;
+
+  void setControlCpus(const std::vector<int> &cpus) { m_controlCpus = cpus; }
+  //! Set the priority of the control thread, 0 for the default scheduling.
+  void setControlPriority(int priority) { m_controlPriority = priority; }
+  //! Lock the memory of the process.
+  void setLockMemory(bool lock) { m_lockMemory = lock; }
+  void setOtherCpus(const std::vector<int> &cpus) { m_otherCpus = cpus; }
+  //! Set the expected period of the control loop in ms.
+  void setPeriod(double period) { m_period = period; }
+  //! Set the stack size in bytes pre-faulted by applyControlThread().
+  void setStackPrefault(size_t size) { m_stackPrefault = size; }
+
+protected:
+  int m_controlPriority;
+  std::vector<int> m_controlCpus;
+  std::vector<int> m_otherCpus;
+  bool m_lockMemory;
+  size_t m_stackPrefault;
+  double m_period;
+};
+#endif
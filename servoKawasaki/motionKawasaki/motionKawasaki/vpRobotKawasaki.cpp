@@ -0,0 +1,882 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Defines a robot just to show which function you must implement.
+ *
+ * Authors:
+ * Fabien Spindler
+ *
+ *****************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include <visp3/core/vpConfig.h>
+#include <visp3/robot/vpRobotException.h>
+
+/*!
+  \file vpRobotKawasaki.cpp
+  Defines a robot just to show which function you must implement.
+*/
+
+#include <visp3/core/vpHomogeneousMatrix.h>
+#include <vpMotionMailbox.h>
+#include <vpRobotKawasaki.h>
+#include <vpTrace.h>
+// The vendor header of the IPMC motion card uses WINAPI without including windows.h
+#include <windows.h>
+#include <IPMCMOTION.h>
+
+using namespace std;
+
+static_assert(vpKawasakiArm::dof == ROBOT_DOF, "The arm description doesn't match the robot");
+
+namespace
+{
+/*!
+  Saturate the velocity \e v in \e v_sat like vpRobot::saturateVelocities(), without allocation: all the
+  components are scaled by the same factor so that none of them exceeds its maximal value in \e v_max.
+ */
+void saturateVelocity(const vpColVector &v, const double *v_max, double *v_sat, bool verbose)
+{
+  double scale = 1;
+  int imax = -1;
+  for (unsigned int i = 0; i < v.size(); i++) {
+    double v_i = std::fabs(v[i]);
+    double v_max_i = std::fabs(v_max[i]);
+    if (v_i > v_max_i) {
+      double alpha_i = v_max_i / v_i;
+      if (alpha_i < scale) {
+        scale = alpha_i;
+        imax = static_cast<int>(i);
+      }
+    }
+  }
+  for (unsigned int i = 0; i < v.size(); i++) {
+    v_sat[i] = v[i] * scale;
+  }
+  if (imax >= 0 && verbose) {
+    std::cout << "Excess velocity " << v[static_cast<unsigned int>(imax)] << " axis nr. " << imax << std::endl;
+  }
+}
+
+/*!
+  Cancel in the inverse Jacobian \e J the terms that diverge near the singularities of the wrist (s5 = 0), of
+  the elbow (c3 = 0) and of the shoulder. Return true if the joint positions \e q are near a singularity.
+ */
+template <typename Matrix> bool removeSingularDirections(const vpColVector &q, Matrix &J, double a2, double d4)
+{
+	double q2 = q[1];
+	double q3 = q[2];
+	double q5 = q[4];
+	
+	double c2 = cos(q2);
+	double c3 = cos(q3);
+	double s23 = sin(q2 + q3);
+	double s5 = sin(q5);
+	
+	bool cond1 = fabs(s5) < 1e-1;
+	bool cond2 = fabs(c3) < 1e-1;
+	bool cond3 = fabs(c2 * a2 + s23 * d4) < 1e-1;
+
+	if (cond1) 
+	{
+		J[3][0] = 0;
+		J[5][0] = 0;
+		J[3][1] = 0;
+		J[5][1] = 0;
+		J[3][2] = 0;
+		J[5][2] = 0;
+		J[3][3] = 0;
+		J[5][3] = 0;
+		J[3][4] = 0;
+		J[5][4] = 0;
+		J[3][5] = 0;
+		J[5][5] = 0;
+		return true;	
+	}
+	if (cond2)
+	{
+		J[1][0] = 0;
+		J[2][0] = 0;
+		J[3][0] = 0;
+		J[4][0] = 0;
+		J[5][0] = 0;
+		J[1][1] = 0;
+		J[2][1] = 0;
+		J[3][1] = 0;
+		J[4][1] = 0;
+		J[5][1] = 0;
+		J[1][2] = 0;
+		J[2][2] = 0;
+		J[3][2] = 0;
+		J[4][2] = 0;
+		J[5][2] = 0;
+		return true;
+	}
+	if (cond3) 
+	{
+		J[0][0] = 0;
+		J[3][0] = 0;
+		J[4][0] = 0;
+		J[5][0] = 0;
+		J[0][1] = 0;
+		J[3][1] = 0;
+		J[4][1] = 0;
+		J[5][1] = 0;
+		return true;
+	}
+	return false;
+}
+} // namespace
+
+/*!
+  Basic initialization.
+ */
+void vpRobotKawasaki::init()
+{
+  // If you want to control the robot in Cartesian in a tool frame, set the corresponding transformation in m_eMc
+  // that is set to identity by default in the constructor.
+
+  vpRobot::maxRotationVelocity = 0.2;   // maxRotationVelocityDefault=0.2;
+  vpRobot::maxTranslationVelocity = 0.7;// maxTranslationVelocityDefault=0.7;
+
+  // Set here the robot degrees of freedom number
+  vpRobot::nDof = ROBOT_DOF; // If your arm has 6 dof
+}
+
+/*!
+  Default constructor.
+ */
+vpRobotKawasaki::vpRobotKawasaki()
+  : m_motionServer(), m_motionTimeout(200.), m_mailbox(), m_motionQ(), m_motionState(vpRobot::STATE_STOP),
+    m_heartbeat(0), m_heartbeatTime(0)
+{
+  vpRobotKawasaki::init();
+}
+
+/*!
+  Destructor.
+ */
+vpRobotKawasaki::~vpRobotKawasaki()
+{
+  if (m_mailbox) {
+    // Don't wait for the motion process, it stops the robot by itself
+    m_mailbox->requestRobotState(vpRobot::STATE_STOP);
+    return;
+  }
+  vpRobotKawasaki::setRobotState(vpRobot::STATE_STOP);
+  IPMCCloseDevice();
+}
+
+/*!
+  Control the drives through the motion process that created the mailbox \e name, instead of the IPMC motion
+  controller. To call before connect().
+
+  \param name : Name of the mailbox, see motionKawasaki.cpp.
+  \param timeout : Largest time in ms without heartbeat of the motion process.
+ */
+void vpRobotKawasaki::setMotionServer(const std::string &name, double timeout)
+{
+  m_motionServer = name;
+  m_motionTimeout = timeout;
+}
+
+/*!
+  Set the transformation between end-effector and camera frame. It can be called from another thread while
+  the robot is controlled, the next velocity is converted with the new transformation.
+ */
+void vpRobotKawasaki::set_eMc(const vpHomogeneousMatrix &eMc)
+{
+  std::lock_guard<std::mutex> lock(m_eMcMutex);
+  m_eMc = eMc;
+}
+
+vpHomogeneousMatrix vpRobotKawasaki::get_eMc() const
+{
+  std::lock_guard<std::mutex> lock(m_eMcMutex);
+  return m_eMc;
+}
+
+/*!
+  Return the velocity twist matrix that transforms a velocity twist from tool (or camera) frame into
+  end-effector frame, built from m_eMc in \e arena as vpVelocityTwistMatrix(get_eMc()).
+ */
+vpArenaMatrix vpRobotKawasaki::get_eVc(vpTickArena &arena) const
+{
+  vpArenaMatrix eVc = arena.matrix(6, 6);
+  std::lock_guard<std::mutex> lock(m_eMcMutex);
+  const double t[3] = {m_eMc[0][3], m_eMc[1][3], m_eMc[2][3]};
+  // eVc = [eRc [t]x*eRc; 0 eRc]
+  for (unsigned int j = 0; j < 3; j++) {
+    for (unsigned int i = 0; i < 3; i++) {
+      eVc[i][j] = eVc[i + 3][j + 3] = m_eMc[i][j];
+    }
+    eVc[0][j + 3] = t[1] * m_eMc[2][j] - t[2] * m_eMc[1][j];
+    eVc[1][j + 3] = t[2] * m_eMc[0][j] - t[0] * m_eMc[2][j];
+    eVc[2][j + 3] = t[0] * m_eMc[1][j] - t[1] * m_eMc[0][j];
+  }
+  return eVc;
+}
+
+//ӻ˿
+int vpRobotKawasaki::connect()
+{
+  if (isRemote()) {
+    // The motion process enables the drives before creating its mailbox
+    m_mailbox.reset(new vpMotionMailbox);
+    double time_initial = vpTime::measureTimeSecond();
+    while (!m_mailbox->open(m_motionServer)) {
+      if (vpTime::measureTimeSecond() - time_initial > 30) {
+        m_mailbox.reset();
+        return EXIT_FAILURE;
+      }
+      vpTime::sleepMs(10);
+    }
+    m_heartbeatTime = vpTime::measureTimeMs();
+    readMotionState();
+    return EXIT_SUCCESS;
+  }
+
+  IPMCOpenDevice();
+  bool enable = false;
+  double time_initial = vpTime::measureTimeSecond();
+  while (!enable) {
+    //жǷѾʹ
+    unsigned long Value[ROBOT_DOF];
+    for (int i = 0; i < ROBOT_DOF; i++) {
+      IPMCGetDriverState(i, &Value[i]);
+    }
+    if (Value[0] == 8 && Value[1] == 8 && Value[2] == 8 && Value[3] == 8 && Value[4] == 8 && Value[5] == 8) {
+      enable = true;
+    }
+	
+	double time_connect= vpTime::measureTimeSecond();
+	if (!enable && (time_connect - time_initial) > 30)
+	{
+		IPMCCloseDevice();
+		return EXIT_FAILURE;
+	}
+	if (!enable) {
+	  // Poll the drives without burning a core, their enabling takes seconds
+	  vpTime::sleepMs(10);
+	}
+  }
+  return EXIT_SUCCESS;
+}
+
+
+/*
+
+  At least one of these function has to be implemented to control the robot with a
+  Cartesian velocity:
+  - get_eJe()
+  - get_fJe()
+
+*/
+
+/*!
+  Get the robot Jacobian expressed in the end-effector frame.
+
+  \param[out] eJe : End-effector frame Jacobian.
+*/
+void vpRobotKawasaki::get_eJe(vpMatrix &eJe)
+{
+  m_q.resize(ROBOT_DOF, false);
+  vpRobotKawasaki::getJointPosition(m_q);
+  get_eJe(m_q, eJe);
+}
+
+/*!
+  Get the robot Jacobian expressed in the end-effector frame for given joint positions.
+  It doesn't need the robot to be connected.
+
+  \param[in] q : Joint positions in rad.
+  \param[out] eJe : End-effector frame Jacobian.
+*/
+void vpRobotKawasaki::get_eJe(const vpColVector &q, vpMatrix &eJe) const
+{
+  VP_TRACE_SCOPE("get_eJe");
+  vpTickArena &arena = vpTickArena::getThreadArena();
+  vpTickArena::vpScope scope(arena);
+  vpTickArena::copy(get_eJe(arena, q), eJe);
+}
+
+/*!
+  Return the robot Jacobian expressed in the end-effector frame for given joint positions, allocated in
+  \e arena.
+
+  \param[in] arena : Arena of the calling thread.
+  \param[in] q : Joint positions in rad.
+*/
+vpArenaMatrix vpRobotKawasaki::get_eJe(vpTickArena &arena, const vpColVector &q) const
+{
+  vpArenaMatrix eJe = arena.matrix(6, ROBOT_DOF);
+  vpArmKinematics::get_eJe(q.data, eJe.data);
+  return eJe;
+}
+
+/*!
+  Get the transformation between the robot reference frame and the end-effector frame for given joint
+  positions. It doesn't need the robot to be connected.
+
+  \param[in] q : Joint positions in rad.
+  \param[out] fMe : Forward kinematics.
+*/
+void vpRobotKawasaki::get_fMe(const vpColVector &q, vpHomogeneousMatrix &fMe) const
+{
+  vpArmKinematics::get_fMe(q.data, fMe.data);
+}
+
+/*!
+  Get the joint positions that reach a transformation between the robot reference frame and the end-effector
+  frame, the closest to the given joint positions. It doesn't need the robot to be connected.
+
+  \param[in] fMe : Transformation to reach.
+  \param[in,out] q : Initial joint positions in rad, replaced by the solution.
+  \return true if the transformation is reached, false if \e q is left unchanged.
+*/
+bool vpRobotKawasaki::getInverseKinematics(const vpHomogeneousMatrix &fMe, vpColVector &q) const
+{
+  if (q.size() != ROBOT_DOF) {
+    throw(vpException(vpException::dimensionError, "Cannot start the inverse kinematics from a %d-dim vector",
+                      q.size()));
+  }
+  double q_ik[ROBOT_DOF];
+  if (!vpArmKinematics::inverse(fMe.data, q.data, q_ik)) {
+    return false;
+  }
+  std::copy(q_ik, q_ik + ROBOT_DOF, q.data);
+  return true;
+}
+
+/*!
+  Get the robot Jacobian expressed in the robot reference frame.
+
+  \param[out] fJe : Base (or reference) frame Jacobian.
+*/
+void vpRobotKawasaki::get_fJe(vpMatrix &fJe)
+{
+  (void)fJe;
+  std::cout << "Not implemented ! " << std::endl;
+}
+
+/*
+
+  At least one of these function has to be implemented to control the robot:
+  - setCartVelocity()
+  - setJointVelocity()
+
+*/
+
+/*!
+  Send to the controller a 6-dim velocity twist vector expressed in a Cartesian frame.
+
+  \param[in] frame : Cartesian control frame (either tool frame or end-effector) in which the velocity \e v is
+  expressed. Units are m/s for translation and rad/s for rotation velocities.
+
+  \param[in] v : 6-dim vector that contains the 6 components of the velocity twist to send to the robot.
+  Units are m/s and rad/s.
+*/
+void vpRobotKawasaki::setCartVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &v)
+{
+  VP_TRACE_SCOPE("setCartVelocity");
+  if (v.size() != 6) {
+    throw(vpException(vpException::fatalError,
+                      "Cannot send a velocity twist vector in tool frame that is not 6-dim (%d)", v.size()));
+  }
+
+  vpTickArena &arena = vpTickArena::getThreadArena();
+  vpTickArena::vpScope scope(arena);
+  // This is the velocity that the robot is able to apply in the end-effector frame
+  vpArenaMatrix v_e = arena.vector(0);
+  switch (frame) {
+  case vpRobot::TOOL_FRAME: {
+    // We have to transform the requested velocity in the end-effector frame.
+    // Knowing that the constant transformation between the tool frame and the end-effector frame obtained
+    // by extrinsic calibration is set in m_eMc we can compute the velocity twist matrix eVc that transform
+    // a velocity twist from tool (or camera) frame into end-effector frame
+    v_e = arena.multiply(get_eVc(arena), arena.view(v));
+    break;
+  }
+
+  case vpRobot::END_EFFECTOR_FRAME:
+  case vpRobot::REFERENCE_FRAME: {
+    v_e = arena.view(v);
+    break;
+  }
+  case vpRobot::JOINT_STATE:
+  case vpRobot::MIXT_FRAME:
+    // Out of the scope
+    break;
+  }
+
+  // Implement your stuff here to send the end-effector velocity twist v_e
+  // - If the SDK allows to send cartesian velocities in the end-effector, it's done. Just wrap data in v_e
+  // - If the SDK allows to send cartesian velocities in the reference (or base) frame you have to implement
+  //   the robot Jacobian in set_fJe() and call:
+  //   vpColVector v = get_fJe().inverse() * v_e;
+  //   At this point you have to wrap data in v that is the 6-dim velocity to apply to the robot
+  // - If the SDK allows to send only joint velocities you have to implement the robot Jacobian in set_eJe()
+  //   and call:
+  //   vpColVector qdot = get_eJe().inverse() * v_e;
+  //   setJointVelocity(qdot);
+  // - If the SDK allows to send only a cartesian position trajectory of the end-effector position in the base frame
+  //   called fMe (for fix frame to end-effector homogeneous transformation) you can transform the cartesian
+  //   velocity in the end-effector into a displacement eMe using the exponetial map:
+  //   double delta_t = 0.010; // in sec
+  //   vpHomogenesousMatrix eMed = vpExponentialMap::direct(v_e, delta_t);
+  //   vpHomogenesousMatrix fMe = getPosition(vpRobot::REFERENCE_FRAME);
+  //   the new position to reach is than given by fMe * eMed
+  //   vpColVector fped(vpPoseVector(fMe * eMed));
+  //   setPosition(vpRobot::REFERENCE_FRAME, fped);
+
+  // std::cout << "Not implemented ! " << std::endl;
+  // std::cout << "To implement me you need : " << std::endl;
+  // std::cout << "\t to knKawasaki the robot jacobian expressed in ";
+  // std::cout << "the end-effector frame (eJe) " << std::endl;
+  // std::cout << "\t the frame transformation  between tool or camera frame ";
+  // std::cout << "and end-effector frame (cMe)" << std::endl;
+
+  if (m_mailbox) {
+    // The motion process converts the twist with its own joint positions, fresher than ours
+    vpTickArena::copy(v_e, m_velocity);
+    m_mailbox->writeSetPoint(vpRobot::END_EFFECTOR_FRAME, m_velocity);
+    return;
+  }
+
+  m_q.resize(ROBOT_DOF, false);
+  vpRobotKawasaki::getJointPosition(m_q);
+  vpArenaMatrix eJe = get_eJe(arena, m_q);
+  VP_TRACE_ZONE(zone_inverse, "eJe inverse");
+  vpArenaMatrix eJe_inv = arena.inverse(eJe);
+  VP_TRACE_ZONE_END(zone_inverse);
+
+  isSingular(m_q, eJe_inv);
+
+  vpTickArena::copy(arena.multiply(eJe_inv, v_e), m_qdot);
+
+  vpRobotKawasaki::setJointVelocity(m_qdot);
+}
+
+/*!
+  Send a joint velocity to the controller.
+  \param[in] qdot : Joint velocities vector. Units are rad/s for a robot arm.
+ */
+void vpRobotKawasaki::setJointVelocity(const vpColVector &qdot)
+{
+  VP_TRACE_SCOPE("IPMCSetVelCommand");
+  if (m_mailbox) {
+    m_mailbox->writeSetPoint(vpRobot::JOINT_STATE, qdot);
+    return;
+  }
+  // Implement your stuff here to send the joint velocities qdot
+  //ofstream out("MotorPulse.txt", ios::app);
+  double encoder_velocity[ROBOT_DOF];
+  vpArmKinematics::jointToEncoderVelocity(qdot.data, encoder_velocity);
+  for (int i = 0; i < ROBOT_DOF; i++) {
+    long velocity2pulse = (long)encoder_velocity[i];
+	//out << velocity2pulse << "  ";
+	IPMCSetVelCommand(i, velocity2pulse);
+  }
+  //out << endl;
+  //out.close();
+}
+
+/*!
+  Send to the controller a velocity in a given frame.
+
+  \param[in] frame : Control frame in which the velocity \e vel is expressed.
+  Velocities could be joint velocities, or cartesian velocities. Units are m/s for translation and
+  rad/s for rotation velocities.
+
+  \param[in] vel : Vector that contains the velocity to apply to the robot.
+ */
+void vpRobotKawasaki::setVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &vel)
+{
+  if (vpRobot::STATE_VELOCITY_CONTROL != vpRobot::getRobotState()) {
+    throw vpRobotException(vpRobotException::wrongStateError,
+                           "Cannot send a velocity to the robot. "
+                           "Call setRobotState(vpRobot::STATE_VELOCITY_CONTROL) once before "
+                           "entering your control loop.");
+  }
+
+  // Velocity saturation
+  switch (frame) {
+  // Saturation in cartesian space
+  case vpRobot::TOOL_FRAME:
+  case vpRobot::REFERENCE_FRAME:
+  case vpRobot::END_EFFECTOR_FRAME:
+  case vpRobot::MIXT_FRAME: {
+    if (vel.size() != 6) {
+      throw(vpException(vpException::dimensionError,
+                        "Cannot apply a Cartesian velocity that is not a 6-dim vector (%d)", vel.size()));
+    }
+    double vel_max[6];
+
+    for (unsigned int i = 0; i < 3; i++)
+      vel_max[i] = vpRobot::getMaxTranslationVelocity();
+    for (unsigned int i = 3; i < 6; i++)
+      vel_max[i] = vpRobot::getMaxRotationVelocity();
+
+    m_velSat.resize(6, false);
+    saturateVelocity(vel, vel_max, m_velSat.data, true);
+
+    vpRobotKawasaki::setCartVelocity(frame, m_velSat);
+    break;
+  }
+  // Saturation in joint space
+  case vpRobot::JOINT_STATE: {
+    if (vel.size() != static_cast<size_t>(nDof)) {
+      throw(vpException(vpException::dimensionError, "Cannot apply a joint velocity that is not a %-dim vector (%d)",
+                        nDof, vel.size()));
+    }
+    double vel_max[ROBOT_DOF];
+
+    // Since the robot has only rotation axis all the joint max velocities are set to getMaxRotationVelocity()
+    std::fill(vel_max, vel_max + ROBOT_DOF, vpRobot::getMaxRotationVelocity());
+
+    m_velSat.resize(ROBOT_DOF, false);
+    saturateVelocity(vel, vel_max, m_velSat.data, true);
+
+    vpRobotKawasaki::setJointVelocity(m_velSat);
+  }
+  }
+}
+
+/*
+
+  THESE FUNCTIONS ARE NOT MENDATORY BUT ARE USUALLY USEFUL
+
+*/
+
+/*!
+  Get robot joint positions.
+
+  \param[in] q : Joint velocities in rad/s.
+ */
+void vpRobotKawasaki:: getJointPosition(vpColVector &q)
+{
+  VP_TRACE_SCOPE("IPMCGetDriverPos");
+  if (m_mailbox) {
+    readMotionState();
+    for (int i = 0; i < ROBOT_DOF; i++) {
+      q[i] = m_motionQ[i];
+    }
+    return;
+  }
+
+  long dJointCurrentPos[ROBOT_DOF] = {0};
+
+  for (int i = 0; i < ROBOT_DOF; i++) {
+    IPMCGetDriverPos(i, &dJointCurrentPos[i]);
+  }
+
+  vpArmKinematics::encoderToJoint(dJointCurrentPos, q.data);
+}
+
+/*!
+  Read the joint positions and the robot state published by the motion process.
+
+  \exception vpRobotException::communicationError : The heartbeat of the motion process didn't change for
+  more than the timeout given to setMotionServer().
+ */
+void vpRobotKawasaki::readMotionState()
+{
+  vpMotionMailbox::vpMotionState state;
+  double t = vpTime::measureTimeMs();
+  // A failed read means that the motion process is writing, or stalled while writing: keep the last state
+  if (m_mailbox->readState(state)) {
+    for (int i = 0; i < ROBOT_DOF; i++) {
+      m_motionQ[i] = state.q[i];
+    }
+    m_motionState = state.robotState;
+    if (state.heartbeat != m_heartbeat) {
+      m_heartbeat = state.heartbeat;
+      m_heartbeatTime = t;
+    }
+  }
+  if (t - m_heartbeatTime > m_motionTimeout) {
+    throw vpRobotException(vpRobotException::communicationError, "The motion process %s doesn't answer since %.0f ms",
+                           m_motionServer.c_str(), t - m_heartbeatTime);
+  }
+}
+
+/*!
+  Get robot position.
+
+  \param[in] frame : Considered cartesian frame or joint state.
+  \param[out] q : Position of the arm.
+ */
+void vpRobotKawasaki::getPosition(const vpRobot::vpControlFrameType frame, vpColVector &q)
+{
+  if (frame == JOINT_STATE) {
+    vpRobotKawasaki::getJointPosition(q);
+  } else {
+    std::cout << "Not implemented ! " << std::endl;
+  }
+}
+
+/*!
+  Get the joint limits.
+
+  \param[out] q_min : Minimal joint positions in rad.
+  \param[out] q_max : Maximal joint positions in rad.
+ */
+void vpRobotKawasaki::getJointLimits(vpColVector &q_min, vpColVector &q_max) const
+{
+  q_min.resize(ROBOT_DOF);
+  q_max.resize(ROBOT_DOF);
+  for (int i = 0; i < ROBOT_DOF; i++) {
+    q_min[i] = vpKawasakiArm::jointMin[i] * Deg2Rad;
+    q_max[i] = vpKawasakiArm::jointMax[i] * Deg2Rad;
+  }
+}
+
+/*!
+  Set a position to reach.
+
+  \param[in] frame : Considered cartesian frame or joint state.
+  \param[in] q : Position to reach.
+ */
+void vpRobotKawasaki::setPosition(const vpRobot::vpControlFrameType frame, const vpColVector &q)
+{
+  (void)frame;
+  (void)q;
+  std::cout << "Not implemented ! " << std::endl;
+}
+
+/*!
+  Get a displacement.
+
+  \param[in] frame : Considered cartesian frame or joint state.
+  \param[out] q : Displacement in meter and rad.
+ */
+void vpRobotKawasaki::getDisplacement(const vpRobot::vpControlFrameType frame, vpColVector &q)
+{
+  (void)frame;
+  (void)q;
+  std::cout << "Not implemented ! " << std::endl;
+}
+
+vpRobot::vpRobotStateType vpRobotKawasaki::setRobotState(vpRobot::vpRobotStateType newState)
+{
+  VP_TRACE_SCOPE("setRobotState");
+  if (m_mailbox) {
+    // The motion process changes the control mode of the drives, it takes seconds
+    m_mailbox->requestRobotState(newState);
+    double time_initial = vpTime::measureTimeSecond();
+    do {
+      vpTime::sleepMs(10);
+      if (vpTime::measureTimeSecond() - time_initial > 30) {
+        throw vpRobotException(vpRobotException::stateModificationError,
+                               "The motion process didn't change the robot state");
+      }
+      // Its heartbeat stops while the drives are switched
+      m_heartbeatTime = vpTime::measureTimeMs();
+      readMotionState();
+    } while (m_motionState != newState);
+    return vpRobot::setRobotState(newState);
+  }
+
+  switch (newState) {
+  case vpRobot::STATE_STOP: {
+    if (vpRobot::STATE_VELOCITY_CONTROL == vpRobot::getRobotState()) {
+	  std::cout << "Stop the robot from velocity control." << std::endl;
+      for (int i = 0; i < ROBOT_DOF; i++) {
+        IPMCSetVelCommand(i, 0);
+      }
+    } else if (vpRobot::STATE_POSITION_CONTROL == vpRobot::getRobotState()) {
+	  std::cout << "Stop the robot from position control." << std::endl;
+	  IPMCStopAllAxis(0);
+    }
+	long pos[6];
+	for (int i = 0; i < ROBOT_DOF; i++) {
+		IPMCGetDriverPos(i, &pos[i]);
+		IPMCSetAxisPosition(i, pos[i]);
+		Sleep(100);
+		IPMCSetAxisCommandMode(i, 0);
+	}
+    break;
+  }
+  case vpRobot::STATE_POSITION_CONTROL: {
+    if (vpRobot::STATE_STOP == vpRobot::getRobotState()) {
+      std::cout << "Change the control mode from stop to position control." << std::endl;
+    } 
+	else if (vpRobot::STATE_VELOCITY_CONTROL == vpRobot::getRobotState()) {
+      std::cout << "Change the control mode from velocity to position control." << std::endl;
+	  for (int i = 0; i < ROBOT_DOF; i++) {
+		  IPMCSetVelCommand(i, 0);
+	  }
+    }
+    long pos[6];
+	for (int i = 0; i < ROBOT_DOF; i++) {
+      IPMCGetDriverPos(i, &pos[i]);
+      IPMCSetAxisPosition(i, pos[i]);
+	  Sleep(1000);
+      IPMCSetAxisCommandMode(i, 0);
+    }
+    break;
+  }
+  case vpRobot::STATE_VELOCITY_CONTROL: {
+    if (vpRobot::STATE_VELOCITY_CONTROL == vpRobot::getRobotState()) {
+      // Already enabled, e.g. during the startup, don't wait again for the drives
+      break;
+    }
+    if (vpRobot::STATE_STOP == vpRobot::getRobotState()) {
+      std::cout << "Change the control mode from stop to velocity control." << std::endl;
+    } 
+	else if (vpRobot::STATE_POSITION_CONTROL == vpRobot::getRobotState()) {
+      std::cout << "Change the control mode from position to velocity control." << std::endl;
+	  IPMCStopAllAxis(0);
+    }
+	long pos[6];
+	for (int i = 0; i < ROBOT_DOF; i++) {
+		IPMCSetVelCommand(i, 0);
+	}
+	for (int i = 0; i < ROBOT_DOF; i++) {
+	  Sleep(1000);
+	  IPMCSetAxisCommandMode(i, 1);
+    }
+	Sleep(1000);
+    break;
+  }
+  default:
+    break;
+  }
+
+  return vpRobot::setRobotState(newState);
+}
+
+vpColVector vpRobotKawasaki::getAxisVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &vel)
+{
+	vpColVector qdot_Axis;
+	getAxisVelocity(frame, vel, qdot_Axis);
+	return qdot_Axis;
+}
+
+/*!
+  Get the joint velocities in deg/s that setVelocity() would send for the velocity \e vel, in \e qdot_axis
+  that is only allocated if its size changes. With \e verbose, the saturated velocities are printed.
+ */
+void vpRobotKawasaki::getAxisVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &vel,
+                                      vpColVector &qdot_axis, bool verbose)
+{
+	if (vpRobot::STATE_VELOCITY_CONTROL != vpRobot::getRobotState()) {
+		throw vpRobotException(vpRobotException::wrongStateError,
+			"Cannot send a velocity to the robot. "
+			"Call setRobotState(vpRobot::STATE_VELOCITY_CONTROL) once before "
+			"entering your control loop.");
+	}
+
+	vpTickArena &arena = vpTickArena::getThreadArena();
+	vpTickArena::vpScope scope(arena);
+
+	// Velocity saturation
+	switch (frame) {
+	// Saturation in cartesian space
+	case vpRobot::TOOL_FRAME:
+	case vpRobot::REFERENCE_FRAME:
+	case vpRobot::END_EFFECTOR_FRAME:
+	case vpRobot::MIXT_FRAME: {
+		if (vel.size() != 6) {
+			throw(vpException(vpException::dimensionError,
+				"Cannot apply a Cartesian velocity that is not a 6-dim vector (%d)", vel.size()));
+		}
+		double vel_max[6];
+
+		for (unsigned int i = 0; i < 3; i++)
+			vel_max[i] = vpRobot::getMaxTranslationVelocity();
+		for (unsigned int i = 3; i < 6; i++)
+			vel_max[i] = vpRobot::getMaxRotationVelocity();
+
+		vpArenaMatrix v_e = arena.vector(6);
+		saturateVelocity(vel, vel_max, v_e.data, verbose);
+
+		if (frame == vpRobot::TOOL_FRAME)
+		{
+			v_e = arena.multiply(get_eVc(arena), v_e);
+		}
+
+		m_q.resize(ROBOT_DOF, false);
+		vpRobotKawasaki::getJointPosition(m_q);
+		vpArenaMatrix eJe_inv = arena.inverse(get_eJe(arena, m_q));
+
+		//isSingular(m_q, eJe_inv);
+
+		vpTickArena::copy(arena.multiply(eJe_inv, v_e), qdot_axis);
+		qdot_axis *= Rad2Deg;
+		break;
+	}
+    // Saturation in joint space
+	case vpRobot::JOINT_STATE: {
+		if (vel.size() != static_cast<size_t>(nDof)) {
+			throw(vpException(vpException::dimensionError, "Cannot apply a joint velocity that is not a %-dim vector (%d)",
+				nDof, vel.size()));
+		}
+		double vel_max[ROBOT_DOF];
+
+		// Since the robot has only rotation axis all the joint max velocities are set to getMaxRotationVelocity()
+		std::fill(vel_max, vel_max + ROBOT_DOF, vpRobot::getMaxRotationVelocity());
+
+		qdot_axis.resize(ROBOT_DOF, false);
+		saturateVelocity(vel, vel_max, qdot_axis.data, verbose);
+		qdot_axis *= Rad2Deg;
+		break;
+	}
+	}
+}
+
+vpColVector vpRobotKawasaki::getMotorVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &vel)
+{
+	// Already printed by getAxisVelocity() if the velocity is saturated
+	vpColVector qdot_Axis;
+	getAxisVelocity(frame, vel, qdot_Axis, false);
+	vpColVector qdot_Motor(ROBOT_DOF);
+	for (int i = 0; i < ROBOT_DOF; i++) 
+	{
+		qdot_Motor[i] = (qdot_Axis[i] * vpKawasakiArm::drive[i].direction * vpKawasakiArm::drive[i].reductionRatio);
+	}
+
+	return qdot_Motor;
+}
+
+bool vpRobotKawasaki::isSingular(const vpColVector &q, vpMatrix &J)
+{
+  return removeSingularDirections(q, J, vpKawasakiArm::link[2].a, vpKawasakiArm::link[3].d);
+}
+
+//! Same as isSingular() for an inverse Jacobian computed in a vpTickArena.
+bool vpRobotKawasaki::isSingular(const vpColVector &q, const vpArenaMatrix &J) const
+{
+  return removeSingularDirections(q, J, vpKawasakiArm::link[2].a, vpKawasakiArm::link[3].d);
+}
@@ -0,0 +1,166 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Defines a robot just to show which function you must implement.
+ *
+ * Authors:
+ * Eric Marchand
+ * Fabien Spindler
+ *
+ *****************************************************************************/
+
+#ifndef vpRobotKawasaki_h
+#define vpRobotKawasaki_h
+
+#define PI 3.1415926535897932384626433832795
+#define Deg2Rad 0.01745329251994329576923690768489
+#define Rad2Deg 57.295779513082320876798154814105
+
+#define ROBOT_DOF 6
+
+/*!
+  \file vpRobotKawasaki.h
+  Defines a robot just to show which function you must implement.
+*/
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <visp3/core/vpConfig.h>
+
+#include <visp3/core/vpHomogeneousMatrix.h>
+#include <visp3/robot/vpRobot.h>
+
+#include <vpDHKinematics.h>
+#include <vpTickArena.h>
+
+class vpMotionMailbox;
+
+/*!
+
+  \class vpRobotKawasaki
+  \ingroup group_robot_real_Kawasaki
+  \brief Class that defines a robot just to show which function you must implement.
+
+  By default the drives are controlled by this process through the IPMC motion controller. After
+  setMotionServer(), connect() opens the mailbox of a motion process (see vpMotionMailbox and
+  motionKawasaki.cpp) that owns the drives: the velocities are sent to it as end-effector twists or joint
+  velocities, the joint positions and the robot state are read from it. A vpRobotException is thrown if the
+  motion process stops publishing its heartbeat.
+
+  The link parameters, the drives and the coupling of the joints are described by vpKawasakiArm, from which
+  vpDHKinematics generates the forward and inverse kinematics, the Jacobian and the encoder mapping.
+
+  The Jacobian, its inverse and the velocity conversions of an iteration are computed in the vpTickArena of
+  the calling thread. The vectors that cross the API keep their size from one iteration to the next, so that
+  setVelocity() doesn't allocate once the first command is sent.
+
+*/
+class vpRobotKawasaki : public vpRobot
+{
+public:
+  vpRobotKawasaki();
+  ~vpRobotKawasaki();
+
+  int connect();
+
+
+  void get_eJe(vpMatrix &eJe);
+  void get_eJe(const vpColVector &q, vpMatrix &eJe) const;
+  void get_fJe(vpMatrix &fJe);
+  void get_fMe(const vpColVector &q, vpHomogeneousMatrix &fMe) const;
+  bool getInverseKinematics(const vpHomogeneousMatrix &fMe, vpColVector &q) const;
+
+  /*!
+    Return constant transformation between end-effector and tool frame.
+    If your tool is a camera, this transformation is obtained by hand-eye calibration.
+   */
+  vpHomogeneousMatrix get_eMc() const;
+
+  void getDisplacement(const vpRobot::vpControlFrameType frame, vpColVector &q);
+  void getJointLimits(vpColVector &q_min, vpColVector &q_max) const;
+  void getPosition(const vpRobot::vpControlFrameType frame, vpColVector &q);
+
+  /*!
+    Set constant transformation between end-effector and tool frame.
+    If your tool is a camera, this transformation is obtained by hand-eye calibration.
+   */
+  void set_eMc(const vpHomogeneousMatrix &eMc);
+  void setPosition(const vpRobot::vpControlFrameType frame, const vpColVector &q);
+  void setVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &vel);
+
+  vpRobot::vpRobotStateType setRobotState(vpRobot::vpRobotStateType newState);
+
+  vpColVector getMotorVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &vel);
+  vpColVector getAxisVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &vel);
+  void getAxisVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &vel, vpColVector &qdot_axis,
+                       bool verbose = true);
+
+  bool isSingular(const vpColVector &q, vpMatrix &J);
+
+  //! Return true if the drives are controlled by a motion process, see setMotionServer().
+  bool isRemote() const { return !m_motionServer.empty(); }
+  void setMotionServer(const std::string &name, double timeout = 200.);
+
+protected:
+  void init();
+  vpArenaMatrix get_eJe(vpTickArena &arena, const vpColVector &q) const;
+  vpArenaMatrix get_eVc(vpTickArena &arena) const;
+  void getJointPosition(vpColVector &q);
+  bool isSingular(const vpColVector &q, const vpArenaMatrix &J) const;
+  void setCartVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &v);
+  void setJointVelocity(const vpColVector &qdot);
+  void readMotionState();
+
+  double imPulse = 0.001; //嵱
+
+  //! Kinematics and drives of the arm
+  typedef vpDHKinematics<vpKawasakiArm> vpArmKinematics;
+
+  vpHomogeneousMatrix m_eMc; //!< Constant transformation between end-effector and tool (or camera) frame
+  mutable std::mutex m_eMcMutex; //!< Protects m_eMc, updated online by vpOnlineHandEye
+
+  // Allocated by the first command, then reused
+  vpColVector m_q;        //!< Joint positions of the last velocity conversion
+  vpColVector m_qdot;     //!< Joint velocities sent by setCartVelocity()
+  vpColVector m_velocity; //!< End-effector twist sent to the motion process
+  vpColVector m_velSat;   //!< Saturated velocity of setVelocity()
+
+  std::string m_motionServer;                 //!< Mailbox name of the motion process, empty to use the IPMC
+  double m_motionTimeout;                     //!< Largest time in ms without heartbeat of the motion process
+  std::unique_ptr<vpMotionMailbox> m_mailbox; //!< Opened by connect()
+  double m_motionQ[ROBOT_DOF];                //!< Last joint positions published by the motion process
+  vpRobot::vpRobotStateType m_motionState;    //!< Last robot state published by the motion process
+  unsigned int m_heartbeat;                   //!< Last heartbeat of the motion process
+  double m_heartbeatTime;                     //!< Time in ms of the last heartbeat change
+};
+#endif
@@ -0,0 +1,203 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Bump-pointer arena for the temporaries of a servo iteration.
+ *
+ *****************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+
+#include <visp3/core/vpException.h>
+
+/*!
+  \file vpTickArena.cpp
+  Bump-pointer arena for the temporaries of a servo iteration.
+*/
+
+#include <vpTickArena.h>
+
+/*!
+  Allocate and touch \e capacity bytes, so that the arena doesn't page fault in the loop.
+ */
+vpTickArena::vpTickArena(size_t capacity)
+  : m_buffer(new double[(capacity + sizeof(double) - 1) / sizeof(double)]),
+    m_capacity((capacity + sizeof(double) - 1) / sizeof(double) * sizeof(double)), m_used(0), m_peak(0)
+{
+  std::fill(m_buffer.get(), m_buffer.get() + m_capacity / sizeof(double), 0.);
+}
+
+/*!
+  Return \e n doubles, not initialized, valid until the arena is rewound.
+
+  \exception vpException::memoryAllocationError : The arena is full, its capacity is too small or it is never
+  rewound.
+ */
+double *vpTickArena::allocate(size_t n)
+{
+  size_t size = n * sizeof(double);
+  if (m_used + size > m_capacity) {
+    throw(vpException(vpException::memoryAllocationError, "The arena of %u bytes is full",
+                      static_cast<unsigned int>(m_capacity)));
+  }
+  double *p = m_buffer.get() + m_used / sizeof(double);
+  m_used += size;
+  m_peak = std::max(m_peak, m_used);
+  return p;
+}
+
+//! Return the arena of the calling thread, created on the first call.
+vpTickArena &vpTickArena::getThreadArena()
+{
+  thread_local vpTickArena arena;
+  return arena;
+}
+
+//! Return a \e rows x \e cols matrix initialized to zero.
+vpArenaMatrix vpTickArena::matrix(unsigned int rows, unsigned int cols)
+{
+  vpArenaMatrix A;
+  A.data = allocate(static_cast<size_t>(rows) * cols);
+  A.rows = rows;
+  A.cols = cols;
+  std::fill(A.data, A.data + static_cast<size_t>(rows) * cols, 0.);
+  return A;
+}
+
+/*!
+  Return the inverse of the square matrix \e A by Gauss-Jordan elimination with partial pivoting, as
+  vpMatrix::inverseByLU() for the small Jacobians of the robot.
+
+  \exception vpException::divideByZeroError : \e A is singular.
+ */
+vpArenaMatrix vpTickArena::inverse(const vpArenaMatrix &A)
+{
+  if (A.rows != A.cols) {
+    throw(vpException(vpException::dimensionError, "Cannot inverse a non square matrix (%ux%u)", A.rows, A.cols));
+  }
+  const unsigned int n = A.rows;
+  vpArenaMatrix M = matrix(n, n);
+  std::copy(A.data, A.data + static_cast<size_t>(n) * n, M.data);
+  vpArenaMatrix M_inv = matrix(n, n);
+  for (unsigned int i = 0; i < n; i++) {
+    M_inv[i][i] = 1;
+  }
+
+  for (unsigned int k = 0; k < n; k++) {
+    unsigned int pivot = k;
+    for (unsigned int i = k + 1; i < n; i++) {
+      if (std::fabs(M[i][k]) > std::fabs(M[pivot][k])) {
+        pivot = i;
+      }
+    }
+    if (M[pivot][k] == 0) {
+      throw(vpException(vpException::divideByZeroError, "Cannot inverse a singular matrix"));
+    }
+    if (pivot != k) {
+      std::swap_ranges(M[k], M[k] + n, M[pivot]);
+      std::swap_ranges(M_inv[k], M_inv[k] + n, M_inv[pivot]);
+    }
+    const double scale = 1. / M[k][k];
+    for (unsigned int j = 0; j < n; j++) {
+      M[k][j] *= scale;
+      M_inv[k][j] *= scale;
+    }
+    for (unsigned int i = 0; i < n; i++) {
+      const double factor = M[i][k];
+      if (i == k || factor == 0) {
+        continue;
+      }
+      for (unsigned int j = 0; j < n; j++) {
+        M[i][j] -= factor * M[k][j];
+        M_inv[i][j] -= factor * M_inv[k][j];
+      }
+    }
+  }
+  return M_inv;
+}
+
+//! Return A * B.
+vpArenaMatrix vpTickArena::multiply(const vpArenaMatrix &A, const vpArenaMatrix &B)
+{
+  if (A.cols != B.rows) {
+    throw(vpException(vpException::dimensionError, "Cannot multiply a %ux%u matrix by a %ux%u matrix", A.rows, A.cols,
+                      B.rows, B.cols));
+  }
+  vpArenaMatrix C = matrix(A.rows, B.cols);
+  for (unsigned int i = 0; i < A.rows; i++) {
+    for (unsigned int k = 0; k < A.cols; k++) {
+      const double a = A[i][k];
+      for (unsigned int j = 0; j < B.cols; j++) {
+        C[i][j] += a * B[k][j];
+      }
+    }
+  }
+  return C;
+}
+
+//! Return the transpose of \e A.
+vpArenaMatrix vpTickArena::transpose(const vpArenaMatrix &A)
+{
+  vpArenaMatrix At = matrix(A.cols, A.rows);
+  for (unsigned int i = 0; i < A.rows; i++) {
+    for (unsigned int j = 0; j < A.cols; j++) {
+      At[j][i] = A[i][j];
+    }
+  }
+  return At;
+}
+
+/*!
+  Return a matrix sharing the elements of \e M, without copy, like a vpColVector, a vpMatrix or a
+  vpVelocityTwistMatrix. It must not be written if \e M is const.
+ */
+vpArenaMatrix vpTickArena::view(const vpArray2D<double> &M)
+{
+  vpArenaMatrix A;
+  A.data = M.data;
+  A.rows = M.getRows();
+  A.cols = M.getCols();
+  return A;
+}
+
+//! Copy the column vector \e A in \e v, that is only allocated if its size changes.
+void vpTickArena::copy(const vpArenaMatrix &A, vpColVector &v)
+{
+  v.resize(A.rows * A.cols, false);
+  std::copy(A.data, A.data + static_cast<size_t>(A.rows) * A.cols, v.data);
+}
+
+//! Copy \e A in \e M, that is only allocated if its size changes.
+void vpTickArena::copy(const vpArenaMatrix &A, vpMatrix &M)
+{
+  M.resize(A.rows, A.cols, false, false);
+  std::copy(A.data, A.data + static_cast<size_t>(A.rows) * A.cols, M.data);
+}
@@ -0,0 +1,139 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Bump-pointer arena for the temporaries of a servo iteration.
+ *
+ *****************************************************************************/
+
+#ifndef vpTickArena_h
+#define vpTickArena_h
+
+/*!
+  \file vpTickArena.h
+  Bump-pointer arena for the temporaries of a servo iteration.
+*/
+
+#include <cstddef>
+#include <memory>
+
+#include <visp3/core/vpConfig.h>
+
+#include <visp3/core/vpArray2D.h>
+#include <visp3/core/vpColVector.h>
+#include <visp3/core/vpMatrix.h>
+
+/*!
+  Row-major matrix whose elements are in a vpTickArena. It is only valid until the arena is rewound.
+*/
+struct vpArenaMatrix {
+  double *data;
+  unsigned int rows;
+  unsigned int cols;
+
+  double *operator[](unsigned int i) const { return data + i * cols; }
+};
+
+/*!
+
+  \class vpTickArena
+  \brief Arena of the short-lived matrices and vectors of an iteration of the servo loop.
+
+  vpMatrix and vpColVector allocate their elements on the heap, which may take a lock and page faults in the
+  middle of the control loop. The temporaries of the kinematics are instead drawn from a buffer allocated and
+  touched once: an allocation only moves a pointer, and the whole arena is rewound at the end of the iteration
+  by reset(), or at the end of a function by a vpScope. Only the results that leave the robot API, like
+  eJe or qdot, are ViSP types, whose size doesn't change from one iteration to the next.
+
+  Each thread has its own arena, returned by getThreadArena(), so that the kinematics can be evaluated by
+  several threads like in vpGainTuner.
+
+  \code
+  void velocity(const vpColVector &v_e, vpColVector &qdot)
+  {
+    vpTickArena &arena = vpTickArena::getThreadArena();
+    vpTickArena::vpScope scope(arena); // Rewinds the arena on return
+    vpArenaMatrix eJe_inv = arena.inverse(arena.view(eJe));
+    vpTickArena::copy(arena.multiply(eJe_inv, arena.view(v_e)), qdot);
+  }
+  \endcode
+
+*/
+class vpTickArena
+{
+public:
+  //! Rewind the arena to its state at the construction of the scope.
+  class vpScope
+  {
+  public:
+    explicit vpScope(vpTickArena &arena) : m_arena(arena), m_mark(arena.m_used) {}
+    vpScope(const vpScope &) = delete;
+    vpScope &operator=(const vpScope &) = delete;
+    ~vpScope() { m_arena.m_used = m_mark; }
+
+  private:
+    vpTickArena &m_arena;
+    size_t m_mark;
+  };
+
+  explicit vpTickArena(size_t capacity = 64 * 1024);
+  vpTickArena(const vpTickArena &) = delete;
+  vpTickArena &operator=(const vpTickArena &) = delete;
+
+  double *allocate(size_t n);
+  vpArenaMatrix matrix(unsigned int rows, unsigned int cols);
+  vpArenaMatrix vector(unsigned int rows) { return matrix(rows, 1); }
+
+  //! Return the size in bytes of the arena.
+  size_t getCapacity() const { return m_capacity; }
+  //! Return the largest number of bytes used since the construction.
+  size_t getPeak() const { return m_peak; }
+  //! Return the number of bytes in use.
+  size_t getUsed() const { return m_used; }
+  //! Release all the temporaries, at the end of an iteration.
+  void reset() { m_used = 0; }
+
+  static vpTickArena &getThreadArena();
+
+  vpArenaMatrix inverse(const vpArenaMatrix &A);
+  vpArenaMatrix multiply(const vpArenaMatrix &A, const vpArenaMatrix &B);
+  vpArenaMatrix transpose(const vpArenaMatrix &A);
+  vpArenaMatrix view(const vpArray2D<double> &M);
+
+  static void copy(const vpArenaMatrix &A, vpColVector &v);
+  static void copy(const vpArenaMatrix &A, vpMatrix &M);
+
+protected:
+  std::unique_ptr<double[]> m_buffer;
+  size_t m_capacity; //!< In bytes
+  size_t m_used;     //!< In bytes
+  size_t m_peak;     //!< In bytes
+};
+#endif
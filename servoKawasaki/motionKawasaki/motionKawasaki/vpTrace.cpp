@@ -0,0 +1,182 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Low-overhead tracing of the servo loop stages.
+ *
+ *****************************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*!
+  \file vpTrace.cpp
+  Low-overhead tracing of the servo loop stages.
+*/
+
+#include <vpTrace.h>
+
+namespace
+{
+struct vpTraceEvent {
+  const char *name;
+  int64_t begin; // ns since the start of the trace
+  int64_t end;
+};
+
+// Zones of one thread, only written by this thread
+struct vpTraceBuffer {
+  std::vector<vpTraceEvent> events;
+  size_t next; // Oldest event once the buffer is full
+  int tid;
+  std::string name;
+};
+
+std::atomic<bool> trace_enabled(false);
+std::mutex trace_mutex; // Protects the list of buffers
+std::vector<std::unique_ptr<vpTraceBuffer> > trace_buffers;
+size_t trace_capacity = 65536;
+const std::chrono::steady_clock::time_point trace_origin = std::chrono::steady_clock::now();
+thread_local vpTraceBuffer *thread_buffer = nullptr;
+
+vpTraceBuffer &getThreadBuffer()
+{
+  if (thread_buffer == nullptr) {
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    std::unique_ptr<vpTraceBuffer> buffer(new vpTraceBuffer);
+    buffer->events.reserve(trace_capacity);
+    buffer->next = 0;
+    buffer->tid = static_cast<int>(trace_buffers.size()) + 1;
+    thread_buffer = buffer.get();
+    trace_buffers.push_back(std::move(buffer));
+  }
+  return *thread_buffer;
+}
+
+void writeString(std::ofstream &file, const std::string &text)
+{
+  file << '"';
+  for (size_t i = 0; i < text.size(); i++) {
+    if (text[i] == '"' || text[i] == '\\') {
+      file << '\\';
+    }
+    file << text[i];
+  }
+  file << '"';
+}
+} // namespace
+
+//! Return true between start() and stop().
+bool vpTrace::isEnabled() { return trace_enabled.load(std::memory_order_relaxed); }
+
+//! Return the time of the monotonic clock in ns.
+int64_t vpTrace::now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - trace_origin)
+      .count();
+}
+
+//! Record a zone of the calling thread, \e name must be a string literal and the times come from now().
+void vpTrace::record(const char *name, int64_t begin, int64_t end)
+{
+  vpTraceBuffer &buffer = getThreadBuffer();
+  vpTraceEvent event = {name, begin, end};
+  if (buffer.events.size() < buffer.events.capacity()) {
+    buffer.events.push_back(event);
+  } else if (!buffer.events.empty()) {
+    buffer.events[buffer.next] = event;
+    buffer.next = (buffer.next + 1) % buffer.events.size();
+  }
+}
+
+/*!
+  Save the zones of all the threads as Chrome trace-event JSON. To call once the traced threads are stopped or
+  idle, since their buffers are read without synchronization.
+
+  \return false if the file can not be written.
+ */
+bool vpTrace::save(const std::string &filename)
+{
+  std::ofstream file(filename.c_str());
+  if (!file.is_open()) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(trace_mutex);
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  file.setf(std::ios::fixed);
+  file.precision(3);
+  for (size_t i = 0; i < trace_buffers.size(); i++) {
+    const vpTraceBuffer &buffer = *trace_buffers[i];
+    if (!buffer.name.empty()) {
+      file << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer.tid
+           << ",\"args\":{\"name\":";
+      writeString(file, buffer.name);
+      file << "}}";
+      first = false;
+    }
+    for (size_t j = 0; j < buffer.events.size(); j++) {
+      const vpTraceEvent &event = buffer.events[j];
+      file << (first ? "\n" : ",\n") << "{\"name\":";
+      writeString(file, event.name);
+      file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer.tid << ",\"ts\":" << event.begin / 1000.
+           << ",\"dur\":" << (event.end - event.begin) / 1000. << "}";
+      first = false;
+    }
+  }
+  file << "\n]}\n";
+  return file.good();
+}
+
+//! Name the calling thread in the trace.
+void vpTrace::setThreadName(const char *name) { getThreadBuffer().name = name; }
+
+/*!
+  Start recording the zones.
+
+  \param capacity : Number of zones kept per thread, set by the first call before any zone is recorded.
+ */
+void vpTrace::start(size_t capacity)
+{
+  {
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    if (trace_buffers.empty()) {
+      trace_capacity = capacity;
+    }
+  }
+  trace_enabled.store(true);
+}
+
+//! Stop recording the zones, the recorded ones are kept for save().
+void vpTrace::stop() { trace_enabled.store(false); }
@@ -0,0 +1,148 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Low-overhead tracing of the servo loop stages.
+ *
+ *****************************************************************************/
+
+#ifndef vpTrace_h
+#define vpTrace_h
+
+/*!
+  \file vpTrace.h
+  Low-overhead tracing of the servo loop stages.
+*/
+
+#include <cstdint>
+#include <string>
+
+#include <visp3/core/vpConfig.h>
+
+/*!
+  \def VP_TRACE_SCOPE(name)
+  Trace the enclosing scope as a zone named \e name, a string literal.
+  \def VP_TRACE_ZONE(zone, name)
+  Start a zone named \e name, a string literal, that ends with VP_TRACE_ZONE_END(zone) or at the end of the scope.
+  \def VP_TRACE_THREAD(name)
+  Name the calling thread in the trace.
+
+  These macros compile to nothing unless VP_TRACE is defined, as in the Debug|x64 configuration of the
+  projects.
+*/
+#if defined(VP_TRACE)
+#define VP_TRACE_CONCAT_(a, b) a##b
+#define VP_TRACE_CONCAT(a, b) VP_TRACE_CONCAT_(a, b)
+#define VP_TRACE_SCOPE(name) vpTraceZone VP_TRACE_CONCAT(vp_trace_zone_, __LINE__)(name)
+#define VP_TRACE_ZONE(zone, name) vpTraceZone zone(name)
+#define VP_TRACE_ZONE_END(zone) zone.end()
+#define VP_TRACE_THREAD(name) vpTrace::setThreadName(name)
+#else
+#define VP_TRACE_SCOPE(name)
+#define VP_TRACE_ZONE(zone, name)
+#define VP_TRACE_ZONE_END(zone)
+#define VP_TRACE_THREAD(name)
+#endif
+
+/*!
+
+  \class vpTrace
+  \brief Record timed zones of all the threads and save them as a Chrome trace-event JSON file, that can be
+  opened in chrome://tracing or https://ui.perfetto.dev to see the stages of each loop iteration on a
+  timeline.
+
+  Each thread writes its zones in its own buffer, allocated at its first zone with a fixed capacity: when
+  it is full, the oldest zones are overwritten, so that the trace keeps the end of a long run. The times
+  are read from a monotonic clock. Zone names are not copied and must be string literals.
+
+  \code
+  vpTrace::start();
+  VP_TRACE_THREAD("servo");
+  while (servo) {
+    VP_TRACE_SCOPE("iteration");
+    VP_TRACE_ZONE(zone_detection, "detection");
+    detector.detect(I);
+    VP_TRACE_ZONE_END(zone_detection);
+    ...
+  }
+  vpTrace::save("trace.json");
+  \endcode
+
+*/
+class vpTrace
+{
+public:
+  //! Return true if the tracing macros are compiled, see VP_TRACE_SCOPE().
+  static bool isCompiled()
+  {
+#if defined(VP_TRACE)
+    return true;
+#else
+    return false;
+#endif
+  }
+  static bool isEnabled();
+  static int64_t now();
+  static void record(const char *name, int64_t begin, int64_t end);
+  static bool save(const std::string &filename);
+  static void setThreadName(const char *name);
+  static void start(size_t capacity = 65536);
+  static void stop();
+};
+
+/*!
+
+  \class vpTraceZone
+  \brief Zone of vpTrace, recorded from its construction to end() or its destruction. Use VP_TRACE_SCOPE()
+  or VP_TRACE_ZONE() rather than this class, so that it compiles to nothing without VP_TRACE.
+
+*/
+class vpTraceZone
+{
+public:
+  explicit vpTraceZone(const char *name) : m_name(name), m_begin(vpTrace::isEnabled() ? vpTrace::now() : -1) {}
+  vpTraceZone(const vpTraceZone &) = delete;
+  ~vpTraceZone() { end(); }
+  vpTraceZone &operator=(const vpTraceZone &) = delete;
+
+  //! End the zone before the end of its scope.
+  void end()
+  {
+    if (m_begin >= 0) {
+      vpTrace::record(m_name, m_begin, vpTrace::now());
+      m_begin = -1;
+    }
+  }
+
+protected:
+  const char *m_name;
+  int64_t m_begin;
+};
+#endif
@@ -54,33 +54,71 @@
   This file could be obtained following extrinsic camera calibration tutorial:
   https://visp-doc.inria.fr/doxygen/visp-daily/tutorial-calibration-extrinsic.html
 
-  Camera intrinsic parameters are retrieved from the Realsense SDK.
+  The intrinsic parameters are read with vpXmlParserCamera from --intrinsic <camera.xml> file, with the
+  distortion model of the camera named --camera_name <name> calibrated at the 640x480 image size. This
+  file is computed by calibrationKawasaki --calibrate_intrinsic. The files of the D435 and SR300 devices
+  are provided with the examples.
 
   The target is an AprilTag that is by default 12cm large. To print your own tag, see
   https://visp-doc.inria.fr/doxygen/visp-daily/tutorial-detection-apriltag.html
   You can specify the size of your tag using --tag_size command line option.
 
+  The other command line options are described by --help. They enable the modules whose class
+  documents the details: vpServoEngine and vpFixedServo for the features and the control law, vpServoMPC,
+  vpTagBundle, vpDepthSampler, vpTagCornerTracker, vpTagCornerRefinement, vpGainTuner, vpConvergenceMonitor,
+  vpTargetLossHandler, vpOnlineHandEye, vpStartupOrchestrator, vpRealTimeProfile, vpMotionMailbox, vpTrace,
+  vpMetricsServer and vpAllocationCounter.
+
 */
 
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
 #include <iostream>
+#include <limits>
+#include <memory>
 
 #include <visp3/core/vpCameraParameters.h>
+#include <visp3/core/vpImageConvert.h>
+#include <visp3/core/vpMeterPixelConversion.h>
+#include <visp3/core/vpPixelMeterConversion.h>
+#include <visp3/core/vpVelocityTwistMatrix.h>
+#include <visp3/core/vpXmlParserCamera.h>
 #include <visp3/gui/vpDisplayGDI.h>
 #include <visp3/gui/vpDisplayX.h>
 #include <visp3/gui/vpDisplayOpenCV.h>
 #include <visp3/io/vpImageIo.h>
 #include <visp3/sensor/vpRealSense2.h>
+#include <visp3/vision/vpPose.h>
 #include <visp3/detection/vpDetectorAprilTag.h>
-#include <visp3/visual_features/vpFeatureBuilder.h>
 #include <visp3/visual_features/vpFeaturePoint.h>
 #include <visp3/vs/vpServo.h>
 #include <visp3/vs/vpServoDisplay.h>
 #include <visp3/gui/vpPlot.h>
 #include <IPMCMOTION.h>
+#include <vpAllocationCounter.h>
+#include <vpConvergenceMonitor.h>
+#include <vpDepthSampler.h>
+#include <vpFramePool.h>
+#include <vpGainTuner.h>
+#include <vpLoopJitter.h>
+#include <vpMetrics.h>
+#include <vpMetricsServer.h>
+#include <vpOnlineHandEye.h>
+#include <vpRealTimeProfile.h>
 #include <vpRobotKawasaki.h>
+#include <vpServoEngine.h>
+#include <vpServoMPC.h>
+#include <vpStartupOrchestrator.h>
+#include <vpTagBundle.h>
+#include <vpTagCornerRefinement.h>
+#include <vpTagCornerTracker.h>
+#include <vpTargetLossHandler.h>
+#include <vpTickArena.h>
+#include <vpTrace.h>
 
 #if defined(VISP_HAVE_REALSENSE2) && (VISP_CXX_STANDARD >= VISP_CXX_STANDARD_11) && \
-(defined(VISP_HAVE_X11) || defined(VISP_HAVE_GDI)) 
+defined(VISP_HAVE_PUGIXML) && (defined(VISP_HAVE_X11) || defined(VISP_HAVE_GDI)) 
 
 void display_point_trajectory(const vpImage<unsigned char> &I, const std::vector<vpImagePoint> &vip,
                               std::vector<vpImagePoint> *traj_vip)
@@ -103,17 +141,70 @@ void display_point_trajectory(const vpImage<unsigned char> &I, const std::vector
   }
 }
 
+/*
+  Display a printf-like text. The text is formatted in \e text, whose capacity is reserved before the servo loop,
+  so that it is not allocated at each iteration.
+*/
+void display_text(const vpImage<unsigned char> &I, int i, int j, const vpColor &color, std::string &text,
+                  const char *format, ...)
+{
+  char buffer[256];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  text.assign(buffer);
+  vpDisplay::displayText(I, i, j, text, color);
+}
+
+/*
+  Return true if the velocity \e v sent in \e frame is saturated by vpRobotKawasaki::setVelocity().
+*/
+bool is_saturated(const vpRobot &robot, vpRobot::vpControlFrameType frame, const vpColVector &v)
+{
+  for (unsigned int i = 0; i < v.size(); i++) {
+    double v_max = (frame != vpRobot::JOINT_STATE && i < 3) ? robot.getMaxTranslationVelocity()
+                                                            : robot.getMaxRotationVelocity();
+    if (std::fabs(v[i]) > v_max) {
+      return true;
+    }
+  }
+  return false;
+}
+
 int main(int argc, char **argv)
 {
   double opt_tagSize = 0.096;
   std::string opt_eMc_filename = "eMc.yaml";
+  std::string opt_intrinsic_filename = "camera.xml";
+  std::string opt_camera_name = "Camera";
+  std::string opt_tag_bundle_filename = "";
+  std::string opt_online_eMc_filename = "";
+  std::string opt_rt_profile_filename = "";
+  std::string opt_motion_server = "";
+  std::string opt_trace_filename = "";
+  int opt_metrics_port = 0;
+  bool opt_count_allocations = false;
   bool display_tag = true;
   int opt_quad_decimate = 2;
+  int opt_detection_period = 1;
+  double opt_refine_corners = 0.;
+  bool opt_fixed_control_law = false;
+  bool opt_check_control_law = false;
+  bool opt_joint_space = false;
+  bool opt_mpc = false;
+  std::string opt_gain_filename = "";
+  std::string opt_tune_gain_filename = "";
+  double opt_tune_period = 33., opt_tune_latency = 50., opt_tune_noise = 0.5;
   bool opt_verbose = false;
   bool opt_plot = true;
   bool opt_adaptive_gain = false;
   bool opt_task_sequencing = false;
-  double convergence_threshold = 0.; //0.00005
+  bool opt_depth_Z = false;
+  double convergence_threshold = 0.00005;
+  double opt_settle_time = 0.3;
+  int opt_coasting_frames = 5;
+  double opt_startup_timeout = 40.;
 
   for (int i = 1; i < argc; i++) {
     if (std::string(argv[i]) == "--tag_size" && i + 1 < argc) {
@@ -122,6 +213,15 @@ int main(int argc, char **argv)
     else if (std::string(argv[i]) == "--eMc" && i + 1 < argc) {
       opt_eMc_filename = std::string(argv[i + 1]);
     }
+    else if (std::string(argv[i]) == "--intrinsic" && i + 1 < argc) {
+      opt_intrinsic_filename = std::string(argv[i + 1]);
+    }
+    else if (std::string(argv[i]) == "--camera_name" && i + 1 < argc) {
+      opt_camera_name = std::string(argv[i + 1]);
+    }
+    else if (std::string(argv[i]) == "--tag_bundle" && i + 1 < argc) {
+      opt_tag_bundle_filename = std::string(argv[i + 1]);
+    }
     else if (std::string(argv[i]) == "--verbose") {
       opt_verbose = true;
     }
@@ -134,40 +234,228 @@ int main(int argc, char **argv)
     else if (std::string(argv[i]) == "--task_sequencing") {
       opt_task_sequencing = true;
     }
+    else if (std::string(argv[i]) == "--fixed_control_law") {
+      opt_fixed_control_law = true;
+    }
+    else if (std::string(argv[i]) == "--check_control_law") {
+      opt_check_control_law = true;
+    }
+    else if (std::string(argv[i]) == "--joint_space") {
+      opt_joint_space = true;
+    }
+    else if (std::string(argv[i]) == "--mpc") {
+      opt_mpc = true;
+      opt_joint_space = true;
+    }
+    else if (std::string(argv[i]) == "--gain" && i + 1 < argc) {
+      opt_gain_filename = std::string(argv[i + 1]);
+    }
+    else if (std::string(argv[i]) == "--tune_gain" && i + 1 < argc) {
+      opt_tune_gain_filename = std::string(argv[i + 1]);
+    }
+    else if (std::string(argv[i]) == "--tune_period" && i + 1 < argc) {
+      opt_tune_period = std::stod(argv[i + 1]);
+    }
+    else if (std::string(argv[i]) == "--tune_latency" && i + 1 < argc) {
+      opt_tune_latency = std::stod(argv[i + 1]);
+    }
+    else if (std::string(argv[i]) == "--tune_noise" && i + 1 < argc) {
+      opt_tune_noise = std::stod(argv[i + 1]);
+    }
+    else if (std::string(argv[i]) == "--convergence_threshold" && i + 1 < argc) {
+      convergence_threshold = std::stod(argv[i + 1]);
+    }
+    else if (std::string(argv[i]) == "--online_eMc" && i + 1 < argc) {
+      opt_online_eMc_filename = std::string(argv[i + 1]);
+    }
+    else if (std::string(argv[i]) == "--rt_profile" && i + 1 < argc) {
+      opt_rt_profile_filename = std::string(argv[i + 1]);
+    }
+    else if (std::string(argv[i]) == "--motion_server" && i + 1 < argc) {
+      opt_motion_server = std::string(argv[i + 1]);
+    }
+    else if (std::string(argv[i]) == "--trace" && i + 1 < argc) {
+      opt_trace_filename = std::string(argv[i + 1]);
+    }
+    else if (std::string(argv[i]) == "--metrics_port" && i + 1 < argc) {
+      opt_metrics_port = std::stoi(argv[i + 1]);
+    }
+    else if (std::string(argv[i]) == "--count_allocations") {
+      opt_count_allocations = true;
+    }
+    else if (std::string(argv[i]) == "--depth_Z") {
+      opt_depth_Z = true;
+    }
     else if (std::string(argv[i]) == "--quad_decimate" && i + 1 < argc) {
       opt_quad_decimate = std::stoi(argv[i + 1]);
     }
+    else if (std::string(argv[i]) == "--detection_period" && i + 1 < argc) {
+      opt_detection_period = std::max(1, std::stoi(argv[i + 1]));
+    }
+    else if (std::string(argv[i]) == "--refine_corners" && i + 1 < argc) {
+      opt_refine_corners = std::stod(argv[i + 1]);
+    }
+    else if (std::string(argv[i]) == "--settle_time" && i + 1 < argc) {
+      opt_settle_time = std::stod(argv[i + 1]);
+    }
+    else if (std::string(argv[i]) == "--startup_timeout" && i + 1 < argc) {
+      opt_startup_timeout = std::stod(argv[i + 1]);
+    }
+    else if (std::string(argv[i]) == "--coasting_frames" && i + 1 < argc) {
+      opt_coasting_frames = std::max(0, std::stoi(argv[i + 1]));
+    }
     else if (std::string(argv[i]) == "--no-convergence-threshold") {
       convergence_threshold = 0.;
     }
     else if (std::string(argv[i]) == "--help" || std::string(argv[i]) == "-h") {
-      std::cout << argv[0] << "[--tag_size <marker size in meter; default " << opt_tagSize << ">] [--eMc <eMc extrinsic file>] "
-                           << "[--quad_decimate <decimation; default " << opt_quad_decimate << ">] [--adaptive_gain] [--plot] [--task_sequencing] [--no-convergence-threshold] [--verbose] [--help] [-h]"
+      std::cout << argv[0] << "[--tag_size <marker size in meter; default " << opt_tagSize << ">] [--eMc <eMc extrinsic file>] [--tag_bundle <tag bundle file>] "
+                           << "[--intrinsic <camera xml file; default " << opt_intrinsic_filename << ">] "
+                           << "[--camera_name <name; default " << opt_camera_name << ">] "
+                           << "[--quad_decimate <decimation; default " << opt_quad_decimate << ">] "
+                           << "[--detection_period <period in frames; default " << opt_detection_period << ">] "
+                           << "[--refine_corners <features error>] [--adaptive_gain] [--plot] [--task_sequencing] [--fixed_control_law] [--check_control_law] [--joint_space] [--mpc] "
+                           << "[--gain <gain file>] [--tune_gain <gain file>] [--tune_period <ms; default " << opt_tune_period << ">] "
+                           << "[--tune_latency <ms; default " << opt_tune_latency << ">] [--tune_noise <pixel; default " << opt_tune_noise << ">] "
+                           << "[--depth_Z] [--online_eMc <eMc output file>] [--convergence_threshold <features error; default " << convergence_threshold << ">] "
+                           << "[--settle_time <s; default " << opt_settle_time << ">] [--no-convergence-threshold] "
+                           << "[--coasting_frames <n; default " << opt_coasting_frames << ">] "
+                           << "[--startup_timeout <s; default " << opt_startup_timeout << ">] [--rt_profile <profile file>] "
+                           << "[--motion_server <mailbox name>] [--trace <json file>] [--metrics_port <port>] "
+                           << "[--count_allocations] [--verbose] [--help] [-h]"
                            << "\n";
+      std::cout
+          << "  --intrinsic <file>           Camera parameters with distortion of --camera_name at 640x480, computed\n"
+          << "                               by calibrationKawasaki --calibrate_intrinsic\n"
+          << "  --tag_bundle <file>          Tags with known poses in the object frame, the other tags are ignored\n"
+          << "  --depth_Z                    Read the features depth in the depth map at the corners, the pose is\n"
+          << "                               only estimated to compute the desired features\n"
+          << "  --detection_period <n>       Detect the tag every n frames and track its corners in between\n"
+          << "  --refine_corners <error>     Sub-pixel tag corners below this features error\n"
+          << "  --fixed_control_law          Compute the control law with vpFixedServo, without dynamic allocation\n"
+          << "  --check_control_law          Compare vpFixedServo with vpServo::computeControlLaw() for pbvs, ibvs\n"
+          << "                               and 2.5d, at random poses around the default desired pose, and quit\n"
+          << "  --joint_space                Compute the joint velocities with the task Jacobian L cVe eJe\n"
+          << "  --mpc                        Model predictive control within the joint limits, keeping the tag in the\n"
+          << "                               image; implies --joint_space\n"
+          << "  --gain <file>                Constant or adaptive gain written by --tune_gain\n"
+          << "  --tune_gain <file>           Simulate servo episodes around the current joint positions with\n"
+          << "                               --tune_period, --tune_latency and --tune_noise, and save the gain that\n"
+          << "                               converges the fastest\n"
+          << "  --settle_time <s>            Time the error stays below --convergence_threshold, 0 to stop at once\n"
+          << "  --coasting_frames <n>        Frames servoed on the predicted features after a tag loss\n"
+          << "  --startup_timeout <s>        Time to start the robot, the camera and the detector concurrently\n"
+          << "  --online_eMc <file>          Refine eMc during the servo, the tag being still, and save it at the end\n"
+          << "  --rt_profile <file>          Real-time scheduling of the threads, checked before the startup\n"
+          << "  --motion_server <name>       Send the velocities to motionKawasaki --name <name> in shared memory\n"
+          << "  --trace <file>               Save a Chrome trace of the iterations, with VP_TRACE defined\n"
+          << "  --metrics_port <port>        Serve the loop metrics at http://127.0.0.1:<port>/metrics\n"
+          << "  --count_allocations          Fail if the image path allocates, or with --fixed_control_law the\n"
+          << "                               features and the control law; print the allocations of the iteration,\n"
+          << "                               with VP_COUNT_ALLOCATIONS defined\n";
       return EXIT_SUCCESS;
     }
   }
 
-  vpRobotKawasaki robot;
+  // If --check_control_law is used, compare the fixed control law with vpServo offline and quit
+  if (opt_check_control_law) {
+    std::vector<vpPoint> points(4);
+    points[0].setWorldCoordinates(-opt_tagSize/2., -opt_tagSize/2., 0);
+    points[1].setWorldCoordinates( opt_tagSize/2., -opt_tagSize/2., 0);
+    points[2].setWorldCoordinates( opt_tagSize/2.,  opt_tagSize/2., 0);
+    points[3].setWorldCoordinates(-opt_tagSize/2.,  opt_tagSize/2., 0);
+    vpHomogeneousMatrix cdMo( vpTranslationVector(0, 0, opt_tagSize * 3), vpRotationMatrix( {1, 0, 0, 0, -1, 0, 0, 0, -1} ) );
+    return vpServoEngine::checkFixedControlLaw(std::cout, points, cdMo) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
 
-  try {
-    if (robot.connect() == EXIT_FAILURE)
-    {
-  	    std::cout << "Can not connect to the robot." << std::endl;
-  	    return EXIT_FAILURE;
+  // Scheduling of the process if --rt_profile is used, before any thread is created
+  vpRealTimeProfile rt_profile;
+  bool use_rt_profile = !opt_rt_profile_filename.empty();
+  if (use_rt_profile) {
+    if (!rt_profile.load(opt_rt_profile_filename)) {
+      std::cout << "Can not read the real-time profile " << opt_rt_profile_filename << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (!rt_profile.preflight(std::cout)) {
+      std::cout << "The real-time profile can not be applied, fix the errors above." << std::endl;
+      return EXIT_FAILURE;
     }
-    else
-    {
-  	    std::cout << "Successfully connect to the robot." << std::endl;
+    if (!rt_profile.applyProcess()) {
+      std::cout << "Warning: the cores or the memory locking of the real-time profile are not applied." << std::endl;
     }
+  }
 
+  if (!opt_trace_filename.empty()) {
+    if (!vpTrace::isCompiled()) {
+      std::cout << "Warning: build with VP_TRACE defined to record a trace in " << opt_trace_filename << std::endl;
+    }
+    vpTrace::start();
+  }
+
+  // Metrics of the servo loop, served on localhost if --metrics_port is used
+  vpMetricsRegistry metrics;
+  vpMetricsServer metrics_server(metrics);
+  if (opt_metrics_port > 0) {
+    try {
+      metrics_server.start(static_cast<unsigned short>(opt_metrics_port));
+    }
+    catch (const vpException &e) {
+      std::cout << "Warning: " << e.getStringMessage() << ", the metrics are not served." << std::endl;
+    }
+  }
+
+  if (opt_count_allocations && !vpAllocationCounter::isCompiled()) {
+    std::cout << "Warning: build with VP_COUNT_ALLOCATIONS defined to count the allocations" << std::endl;
+  }
+  bool allocation_test_passed = true;
+
+  vpRobotKawasaki robot;
+  if (!opt_motion_server.empty()) {
+    // connect() opens the mailbox of the motion process instead of the motion controller
+    robot.setMotionServer(opt_motion_server);
+  }
+
+  try {
+    // The objects used by the startup threads are declared first, to outlive their threads that the
+    // orchestrator joins when it is destroyed, on an early return or when wait() throws
     vpRealSense2 rs;
     rs2::config config;
+    vpDetectorAprilTag::vpAprilTagFamily tagFamily = vpDetectorAprilTag::TAG_36h11;
+    vpDetectorAprilTag::vpPoseEstimationMethod poseEstimationMethod = vpDetectorAprilTag::HOMOGRAPHY_VIRTUAL_VS;
+    //vpDetectorAprilTag::vpPoseEstimationMethod poseEstimationMethod = vpDetectorAprilTag::BEST_RESIDUAL_VIRTUAL_VS;
+    std::unique_ptr<vpDetectorAprilTag> detector_ptr;
+    // Enabling the velocity control takes seconds, do it during the startup if the servo runs
+    bool servo = opt_tune_gain_filename.empty();
+
+    // Bring up the robot drives, the camera and the tag detector concurrently
+    vpStartupOrchestrator startup(opt_startup_timeout);
+    startup.launch("robot", [&]() {
+      if (robot.connect() == EXIT_FAILURE) {
+        std::cout << "Can not connect to the robot." << std::endl;
+        return false;
+      }
+      std::cout << "Successfully connect to the robot." << std::endl;
+      if (servo) {
+        robot.setRobotState(vpRobot::STATE_VELOCITY_CONTROL);
+      }
+      return true;
+    });
+
     unsigned int width = 640, height = 480;
     config.enable_stream(RS2_STREAM_COLOR, 640, 480, RS2_FORMAT_RGBA8, 60);
     config.enable_stream(RS2_STREAM_DEPTH, 640, 480, RS2_FORMAT_Z16, 60);
     config.enable_stream(RS2_STREAM_INFRARED, 640, 480, RS2_FORMAT_Y8, 60);
-    rs.open(config);
+    startup.launch("camera", [&]() {
+      rs.open(config);
+      return true;
+    });
+
+    startup.launch("detector", [&]() {
+      detector_ptr.reset(new vpDetectorAprilTag(tagFamily));
+      detector_ptr->setAprilTagPoseEstimationMethod(poseEstimationMethod);
+      detector_ptr->setDisplayTag(display_tag);
+      detector_ptr->setAprilTagQuadDecimate(opt_quad_decimate);
+      return true;
+    });
 
     // Get camera extrinsics
     vpPoseVector ePc;
@@ -177,7 +465,11 @@ int main(int argc, char **argv)
 
     // If provided, read camera extrinsics from --eMc <file>
     if (!opt_eMc_filename.empty()) {
-      ePc.loadYAML(opt_eMc_filename, ePc);
+      if (!vpPoseVector::loadYAML(opt_eMc_filename, ePc)) {
+        std::cout << "Can not read " << opt_eMc_filename << ", compute it with calibrationKawasaki --hand_eye"
+                  << std::endl;
+        return EXIT_FAILURE;
+      }
     }
     else {
       std::cout << "Warning, opt_eMc_filename is empty! Use hard coded values." << "\n";
@@ -185,60 +477,164 @@ int main(int argc, char **argv)
     vpHomogeneousMatrix eMc(ePc);
     std::cout << "eMc:\n" << eMc << "\n";
 
-    // Get camera intrinsics
+    // Get camera intrinsics from --intrinsic <file>
     //vpCameraParameters cam = rs.getCameraParameters(RS2_STREAM_COLOR, vpCameraParameters::perspectiveProjWithDistortion);
-	vpCameraParameters cam(611.1634091225, 612.4700916733, 345.5597302213, 235.2964336455, 0.0743932293, -0.0725463672);
+    vpCameraParameters cam;
+    vpXmlParserCamera parser;
+    if (parser.parse(cam, opt_intrinsic_filename, opt_camera_name, vpCameraParameters::perspectiveProjWithDistortion,
+                     width, height) != vpXmlParserCamera::SEQUENCE_OK) {
+      std::cout << "Can not read the " << width << "x" << height << " camera " << opt_camera_name << " in "
+                << opt_intrinsic_filename << ", compute it with calibrationKawasaki --calibrate_intrinsic" << std::endl;
+      return EXIT_FAILURE;
+    }
     std::cout << "cam:\n" << cam << "\n";
 
+    // Desired pose used to compute the desired features
+    vpHomogeneousMatrix cdMo( vpTranslationVector(0, 0, opt_tagSize * 3), // 3 times tag with along camera z axis
+                              vpRotationMatrix( {1, 0, 0, 0, -1, 0, 0, 0, -1} ) );
+
+    // If --tune_gain is used, tune the gain around the current robot position and quit
+    if (!opt_tune_gain_filename.empty()) {
+      startup.wait("robot");
+      vpColVector q_desired(6);
+      robot.getPosition(vpRobot::JOINT_STATE, q_desired);
+      vpGainTuner tuner(robot, vpGainTuner::IMAGE_BASED);
+      tuner.setCameraParameters(cam, width, height);
+      tuner.set_eMc(eMc);
+      tuner.setDesiredPose(cdMo);
+      tuner.setJointPosition(q_desired);
+      tuner.setTagSize(opt_tagSize);
+      tuner.setConvergenceThreshold(convergence_threshold);
+      tuner.setSamplingTime(opt_tune_period / 1000.);
+      tuner.setLatency(opt_tune_latency / 1000.);
+      tuner.setImageNoise(opt_tune_noise);
+
+      std::cout << "Tuning the gain..." << std::endl;
+      double t_tune = vpTime::measureTimeMs();
+      bool feasible = tuner.tune();
+      const vpGainTuner::vpGainScore &score = tuner.getBestScore();
+      std::cout << "Tuning done in " << (vpTime::measureTimeMs() - t_tune) / 1000. << " s" << std::endl;
+      if (!feasible) {
+        std::cout << "Warning: no gain satisfies the overshoot and saturation constraints, keep the fastest one" << std::endl;
+      }
+      std::cout << "Gain: " << tuner.getBestGain() << "\nMean time to converge: " << score.time
+                << " s, converged episodes: " << 100 * score.success << "%, overshoot: " << 100 * score.overshoot
+                << "%, saturated velocities: " << 100 * score.saturation << "%" << std::endl;
+      if (!tuner.saveGain(opt_tune_gain_filename)) {
+        std::cout << "Can not write the gain file " << opt_tune_gain_filename << std::endl;
+        return EXIT_FAILURE;
+      }
+      std::cout << "Gain saved in " << opt_tune_gain_filename << std::endl;
+      return EXIT_SUCCESS;
+    }
+
     vpImage<unsigned char> I(height, width);
+    vpImage<vpRGBa> Ic(height, width);
+    vpImage<uint16_t> I_depth_raw(height, width);
+    rs2::align align_to(RS2_STREAM_COLOR);
+    // Frames of the servo loop, with one spare frame
+    vpFramePool frame_pool(2, height, width);
 
+    // The display is created in the main thread while the other components start
 #if defined(VISP_HAVE_X11)
-    vpDisplayX dc(I, 10, 10, "Color image");
+    vpDisplayX dc;
 #elif defined(VISP_HAVE_GDI)
-    vpDisplayGDI dc(I, 10, 10, "Color image");
+    vpDisplayGDI dc;
 #elif defined(VISP_HAVE_OPENCV)
-	vpDisplayOpenCV dc(I, 10, 10, "Color image");
+    vpDisplayOpenCV dc;
 #endif
+    startup.run("display", [&]() {
+      dc.init(I, 10, 10, "Color image");
+      return true;
+    });
+    startup.wait("camera");
+
+    // Read the features depth in the depth map if --depth_Z is used
+    vpDepthSampler depth_sampler;
+    depth_sampler.setDepthScale(rs.getDepthScale());
+
+    startup.wait("detector");
+    vpDetectorAprilTag &detector = *detector_ptr;
+
+    // If provided, read the tag bundle from --tag_bundle <file>. Otherwise a single tag is used
+    vpTagBundle bundle;
+    bool use_bundle = !opt_tag_bundle_filename.empty();
+    if (use_bundle) {
+      if (!bundle.load(opt_tag_bundle_filename)) {
+        std::cout << "Can not read the tag bundle file " << opt_tag_bundle_filename << std::endl;
+        return EXIT_FAILURE;
+      }
+      std::cout << "Tag bundle with " << bundle.getNbTags() << " tags, reference tag id: " << bundle.getReferenceId() << "\n";
+    }
 
-    vpDetectorAprilTag::vpAprilTagFamily tagFamily = vpDetectorAprilTag::TAG_36h11;
-    vpDetectorAprilTag::vpPoseEstimationMethod poseEstimationMethod = vpDetectorAprilTag::HOMOGRAPHY_VIRTUAL_VS;
-    //vpDetectorAprilTag::vpPoseEstimationMethod poseEstimationMethod = vpDetectorAprilTag::BEST_RESIDUAL_VIRTUAL_VS;
-    vpDetectorAprilTag detector(tagFamily);
-    detector.setAprilTagPoseEstimationMethod(poseEstimationMethod);
-    detector.setDisplayTag(display_tag);
-    detector.setAprilTagQuadDecimate(opt_quad_decimate);
+    // If --detection_period > 1, track the tag corners between two detections
+    vpTagCornerTracker tracker;
+    int nb_tracked_frames = 0;
+    // If --refine_corners is used, refine the tag corners near the convergence
+    vpTagCornerRefinement corner_refinement;
+    double last_error = std::numeric_limits<double>::max();
+    // Keep the servo running when the tag is missed, search it when it is lost
+    vpTargetLossHandler loss;
+    loss.setQuadDecimate(static_cast<float>(opt_quad_decimate));
+    loss.setMaxCoastingFrames(static_cast<unsigned int>(opt_coasting_frames));
 
     // Servo
     vpHomogeneousMatrix cdMc, cMo, oMo;
 
-    // Desired pose used to compute the desired features
-    vpHomogeneousMatrix cdMo( vpTranslationVector(0, 0, opt_tagSize * 3), // 3 times tag with along camera z axis
-                              vpRotationMatrix( {1, 0, 0, 0, -1, 0, 0, 0, -1} ) );
-
-    // Create visual features
-    std::vector<vpFeaturePoint> p(4), pd(4); // We use 4 points
-
     // Define 4 3D points corresponding to the CAD model of the Apriltag
     std::vector<vpPoint> point(4);
     point[0].setWorldCoordinates(-opt_tagSize/2., -opt_tagSize/2., 0);
     point[1].setWorldCoordinates( opt_tagSize/2., -opt_tagSize/2., 0);
     point[2].setWorldCoordinates( opt_tagSize/2.,  opt_tagSize/2., 0);
     point[3].setWorldCoordinates(-opt_tagSize/2.,  opt_tagSize/2., 0);
+    if (use_bundle) {
+      // The features are the corners of the bundle reference tag
+      point = bundle.getTagCorners(bundle.getReferenceId());
+    }
 
-    vpServo task;
-    // Add the 4 visual feature points
-    for (size_t i = 0; i < p.size(); i++) {
-      task.addFeature(p[i], pd[i]);
+    // Create the 4 visual feature points
+    vpServoEngine engine;
+    engine.init(vpServoEngine::IMAGE_BASED, point);
+    engine.setFixedControlLaw(opt_fixed_control_law);
+    // Velocities are computed and sent either in the camera frame or in the joint space
+    vpRobot::vpControlFrameType control_frame = opt_joint_space ? vpRobot::JOINT_STATE : vpRobot::CAMERA_FRAME;
+    vpVelocityTwistMatrix cVe(eMc.inverse());
+    vpMatrix eJe;
+    if (opt_joint_space) {
+      engine.setJointSpace(cVe);
     }
-    task.setServo(vpServo::EYEINHAND_CAMERA);
-    task.setInteractionMatrixType(vpServo::CURRENT);
 
-    if (opt_adaptive_gain) {
+    // Constrained control law if --mpc is used
+    vpServoMPC mpc;
+    vpColVector q(6), qdot_sent(6);
+    const double max_joint_acceleration = 1.5; // rad/s^2
+    if (opt_mpc) {
+      vpColVector q_min, q_max;
+      robot.getJointLimits(q_min, q_max);
+      mpc.setJointLimits(q_min, q_max);
+      mpc.setJointVelocityLimits(vpColVector(6, robot.getMaxRotationVelocity()));
+      mpc.setJointAccelerationLimits(vpColVector(6, max_joint_acceleration));
+      mpc.setImageBounds(cam, I.getWidth(), I.getHeight(), 20);
+    }
+    double t_mpc_prev = 0;
+    bool mpc_feasible = true; // To report the transitions to an infeasible QP only
+
+    if (!opt_gain_filename.empty()) {
+      // Gain tuned by --tune_gain
+      vpAdaptiveGain lambda;
+      if (!vpGainTuner::loadGain(opt_gain_filename, lambda)) {
+        std::cout << "Can not read the gain file " << opt_gain_filename << std::endl;
+        return EXIT_FAILURE;
+      }
+      std::cout << "Gain: " << lambda << std::endl;
+      engine.setLambda(lambda);
+    }
+    else if (opt_adaptive_gain) {
       vpAdaptiveGain lambda(1.5, 0.4, 30); // lambda(0)=4, lambda(oo)=0.4 and lambda'(0)=30
-      task.setLambda(lambda);
+      engine.setLambda(lambda);
     }
     else {
-      task.setLambda(0.5);
+      engine.setLambda(0.5);
     }
 
     vpPlot *plotter = nullptr;
@@ -247,7 +643,7 @@ int main(int argc, char **argv)
     if (opt_plot) {
       plotter = new vpPlot(2, static_cast<int>(250 * 2), 500, static_cast<int>(I.getWidth()) + 80, 10, "Real time curves plotter");
       plotter->setTitle(0, "Visual features error");
-      plotter->setTitle(1, "Camera velocities");
+      plotter->setTitle(1, opt_joint_space ? "Camera velocities (from joint velocities)" : "Camera velocities");
       plotter->initGraph(0, 8);
       plotter->initGraph(1, 6);
       plotter->setLegend(0, 0, "error_feat_p1_x");
@@ -272,73 +668,298 @@ int main(int argc, char **argv)
     bool servo_started = false;
     std::vector<vpImagePoint> *traj_corners = nullptr; // To memorize point trajectory
 
+    // Convergence on the features error
+    vpConvergenceMonitor convergence;
+    vpColVector convergence_errors(1);
+    convergence.setTolerance(vpColVector(1, convergence_threshold));
+    convergence.setSettleTime(opt_settle_time);
+
     static double t_init_servo = vpTime::measureTimeMs();
 
     robot.set_eMc(eMc); // Set location of the camera wrt end-effector frame
-    robot.setRobotState(vpRobot::STATE_VELOCITY_CONTROL);
+    // Velocity control is enabled by the startup
+    startup.waitAll();
+    frame_pool.setDisplay(I);
+    std::cout << startup.getReport() << std::endl;
+
+    // Refinement of eMc in a background thread if --online_eMc is used
+    bool use_online_eMc = !opt_online_eMc_filename.empty();
+    vpOnlineHandEye online_hand_eye(robot);
+    unsigned int nb_eMc_updates = 0;
+    vpColVector q_image(6);
+    if (use_online_eMc) {
+      online_hand_eye.start(eMc);
+    }
+
+    // The other threads are created, the control loop can take its priority and cores
+    if (use_rt_profile && !rt_profile.applyControlThread()) {
+      std::cout << "Warning: the control thread scheduling of the real-time profile is not applied." << std::endl;
+    }
+    vpLoopJitter jitter(use_rt_profile ? rt_profile.getPeriod() : 33.);
+    VP_TRACE_THREAD("servo");
+
+    vpMetricCounter &metric_frames = metrics.addCounter("servo_frames_total", "Number of processed frames");
+    vpMetricGauge &metric_frame_rate = metrics.addGauge("servo_frame_rate_hz", "Frame rate of the servo loop");
+    vpMetricHistogram &metric_detection = metrics.addHistogram("servo_detection_ms", "Detection and tracking time");
+    vpMetricHistogram &metric_period = metrics.addHistogram("servo_loop_period_ms", "Period of the servo loop");
+    vpMetricHistogram &metric_command_jitter =
+        metrics.addHistogram("servo_command_jitter_ms", "Deviation of the velocity command interval from the period");
+    vpMetricCounter &metric_deadline_misses =
+        metrics.addCounter("servo_deadline_misses_total", "Periods longer than the deadline of the loop");
+    vpMetricCounter &metric_missed_detections =
+        metrics.addCounter("servo_missed_detections_total", "Frames without tag corners");
+    vpMetricCounter &metric_saturations =
+        metrics.addCounter("servo_saturations_total", "Velocity commands saturated by the robot");
+    double expected_period = use_rt_profile ? rt_profile.getPeriod() : 33.;
+    double t_prev = -1, t_command_prev = -1;
+
+    // Containers of each iteration, allocated once
+    std::vector<vpHomogeneousMatrix> cMo_vec;
+    std::vector<vpImagePoint> corners;
+    cMo_vec.reserve(16);
+    corners.reserve(16);
+    std::string text;
+    text.reserve(256);
+    vpColVector v_c(6); // Camera velocity, or joint velocity with --joint_space
+    vpColVector v_cam(6);
+    vpColVector task_error(engine.getDimension());
+    vpMatrix L(engine.getDimension(), 6); // Interaction matrix used by the MPC
+    vpColVector cP(4), p(3); // A tag corner in the camera frame and its projection
+    vpPose corner_pose; // Pose updated from the tracked corners
+    std::vector<vpPoint> visibility_points(engine.getNbPoints());
+
+    // Allocations per iteration with --count_allocations, after the warm-up of the detector and the display. The
+    // image path is checked, and the features and the control law with vpFixedServo, since vpServo, the MPC and
+    // the comparison of --verbose allocate their matrices. The detection, the pose and the display of the
+    // features use ViSP temporaries, the allocations of the whole iteration are only printed.
+    const unsigned int allocation_warmup = 30;
+    const bool check_control_allocations = opt_fixed_control_law && !opt_mpc && !opt_verbose;
+    unsigned int nb_counted_iterations = 0;
+    uint64_t max_image_allocations = 0, max_control_allocations = 0;
+    uint64_t max_iteration_allocations = 0, sum_iteration_allocations = 0;
 
     while (!has_converged && !final_quit) {
       double t_start = vpTime::measureTimeMs();
+      jitter.tick(t_start);
+      if (t_prev >= 0) {
+        double period = t_start - t_prev;
+        metric_period.record(period);
+        metric_frame_rate.set(period > 0 ? 1000. / period : 0);
+        if (period > 1.5 * expected_period) {
+          metric_deadline_misses.inc();
+        }
+      }
+      t_prev = t_start;
+      metric_frames.inc();
+      VP_TRACE_SCOPE("iteration");
+      uint64_t nb_allocations = vpAllocationCounter::getCount();
+
+      VP_TRACE_ZONE(zone_acquisition, "acquisition");
+      // The images of the iteration are the ones of a frame of the ring, acquired in place
+      vpFrameHandle frame = frame_pool.acquire();
+      vpImage<unsigned char> &I = frame->I;
+      vpImage<vpRGBa> &Ic = frame->Ic;
+      vpImage<uint16_t> &I_depth_raw = frame->depthRaw;
+      frame->timestamp = t_start;
+      if (opt_depth_Z) {
+        rs.acquire(reinterpret_cast<unsigned char *>(Ic.bitmap), reinterpret_cast<unsigned char *>(I_depth_raw.bitmap),
+                   NULL, NULL, &align_to);
+        vpImageConvert::convert(Ic, I);
+      }
+      else {
+        rs.acquire(I);
+      }
+      VP_TRACE_ZONE_END(zone_acquisition);
+      if (use_online_eMc) {
+        // Robot pose at the image acquisition
+        robot.getPosition(vpRobot::JOINT_STATE, q_image);
+      }
 
-      rs.acquire(I);
-
+      VP_TRACE_ZONE(zone_display_image, "display");
       vpDisplay::display(I);
+      VP_TRACE_ZONE_END(zone_display_image);
+      uint64_t nb_image_allocations = vpAllocationCounter::getCount() - nb_allocations;
+
+      cMo_vec.clear();
+      bool has_target = false;
+      bool has_pose = false; // True if cMo is measured in this image
+      int ref_index = -1; // Index in the detector of the tag whose corners are the features
+      bool tracked = false;
+      double t_detection = vpTime::measureTimeMs();
+      VP_TRACE_ZONE(zone_detection, "detection");
+      if (tracker.isInitialized() && ++nb_tracked_frames % opt_detection_period != 0) {
+        // Between two detections, only track the tag corners
+        tracked = tracker.track(I);
+        if (tracked && !opt_depth_Z) {
+          // Update the pose from the tracked corners, starting from the previous one, to get the features depth
+          for (size_t i = 0; i < point.size(); i++) {
+            double x = 0, y = 0;
+            vpPixelMeterConversion::convertPoint(cam, tracker.getCorners()[i], x, y);
+            point[i].set_x(x);
+            point[i].set_y(y);
+          }
+          vpTagBundle::setPosePoints(corner_pose, point);
+          tracked = corner_pose.computePose(vpPose::VIRTUAL_VS, cMo);
+          has_pose = tracked;
+        }
+        has_target = tracked;
+      }
 
-      std::vector<vpHomogeneousMatrix> cMo_vec;
-      detector.detect(I, opt_tagSize, cam, cMo_vec);
-
-      std::stringstream ss;
-      ss << "Left click to " << (send_velocities ? "stop the robot" : "servo the robot") << ", right click to quit.";
-      vpDisplay::displayText(I, 20, 20, ss.str(), vpColor::red);
+      if (!tracked) {
+        detector.setAprilTagQuadDecimate(loss.getQuadDecimate());
+        if (opt_depth_Z && loss.getState() != vpTargetLossHandler::SEARCHING) {
+          // The depth is read in the depth map: only the corners of the reference tag are needed
+          detector.detect(I);
+          if (use_bundle) {
+            for (size_t i = 0; i < detector.getNbObjects() && ref_index < 0; i++) {
+              if (vpTagBundle::getTagId(detector.getMessage(i)) == bundle.getReferenceId()) {
+                ref_index = static_cast<int>(i);
+              }
+            }
+          }
+          else if (detector.getNbObjects() == 1) {
+            ref_index = 0;
+          }
+          has_target = (ref_index >= 0);
+        }
+        else if (use_bundle) {
+          // Fuse the corners of all the bundle tags, other tags are ignored
+          detector.detect(I);
+          has_target = bundle.computePose(detector, cam, cMo);
+          has_pose = has_target;
+          ref_index = bundle.getDetectionIndex(bundle.getReferenceId());
+        }
+        else {
+          detector.detect(I, opt_tagSize, cam, cMo_vec);
+          // Only one tag is detected
+          if (cMo_vec.size() == 1) {
+            cMo = cMo_vec[0];
+            has_target = true;
+            has_pose = true;
+            ref_index = 0;
+          }
+        }
+        if (ref_index >= 0 && opt_detection_period > 1) {
+          tracker.init(I, detector.getPolygon(static_cast<size_t>(ref_index)));
+          nb_tracked_frames = 0;
+        }
+      }
 
-      vpColVector v_c(6);
+      VP_TRACE_ZONE_END(zone_detection);
+      metric_detection.record(vpTime::measureTimeMs() - t_detection);
+      if (!has_target) {
+        metric_missed_detections.inc();
+      }
 
-      // Only one tag is detected
-      if (cMo_vec.size() == 1) {
-        cMo = cMo_vec[0];
+      // With --depth_Z, the pose is only measured when the tag is reacquired
+      vpTargetLossHandler::vpTrackingState previous_state = loss.getState();
+      vpTargetLossHandler::vpTrackingState state = (has_target && !has_pose)
+          ? loss.update(vpTime::measureTimeSecond(), true) : loss.update(vpTime::measureTimeSecond(), has_target, cMo);
+      if (state != previous_state &&
+          (opt_verbose || state == vpTargetLossHandler::SEARCHING || state == vpTargetLossHandler::REACQUIRED)) {
+        std::cout << "Tag " << vpTargetLossHandler::getStateName(state) << std::endl;
+      }
 
-        static bool first_time = true;
-        if (first_time) {
-          // Introduce security wrt tag positionning in order to avoid PI rotation
-          std::vector<vpHomogeneousMatrix> v_oMo(2), v_cdMc(2);
-          v_oMo[1].buildFrom(0, 0, 0, 0, 0, M_PI);
-          for (size_t i = 0; i < 2; i++) {
-            v_cdMc[i] = cdMo * v_oMo[i] * cMo.inverse();
+      if (use_online_eMc) {
+        if (state == vpTargetLossHandler::TRACKING && has_pose) {
+          online_hand_eye.addMeasurement(q_image, cMo);
+        }
+        else if (state == vpTargetLossHandler::SEARCHING && previous_state != vpTargetLossHandler::SEARCHING) {
+          // The tag may be moved before being found again
+          online_hand_eye.reset();
+        }
+        if (online_hand_eye.getNbUpdates() != nb_eMc_updates) {
+          // The robot already uses the new eMc, update the joint space control law
+          nb_eMc_updates = online_hand_eye.getNbUpdates();
+          eMc = online_hand_eye.get_eMc();
+          cVe.buildFrom(eMc.inverse());
+          if (opt_joint_space) {
+            engine.setJointSpace(cVe);
           }
-          if (std::fabs(v_cdMc[0].getThetaUVector().getTheta()) < std::fabs(v_cdMc[1].getThetaUVector().getTheta())) {
-            oMo = v_oMo[0];
+          if (opt_verbose) {
+            std::cout << "eMc update " << nb_eMc_updates << ": " << vpPoseVector(eMc).t() << std::endl;
           }
-          else {
+        }
+      }
+
+      display_text(I, 20, 20, vpColor::red, text, "Left click to %s, right click to quit.",
+                   send_velocities ? "stop the robot" : "servo the robot");
+
+      v_c = 0;
+
+      uint64_t nb_control_allocations = 0;
+      if (state != vpTargetLossHandler::SEARCHING) {
+        if (state == vpTargetLossHandler::REACQUIRED) {
+          // Introduce security wrt tag positionning in order to avoid PI rotation, again after each loss
+          if (loss.updateSymmetry(cdMo, cMo, oMo)) {
             std::cout << "Desired frame modified to avoid PI rotation of the camera" << std::endl;
-            oMo = v_oMo[1];   // Introduce PI rotation
           }
+          convergence.reset();
 
           // Compute the desired position of the features from the desired pose
+          engine.setDesiredPose(cdMo * oMo);
+        }
+
+        // Get tag corners
+        uint64_t nb_allocations_features = vpAllocationCounter::getCount();
+        VP_TRACE_ZONE(zone_features, "features");
+        corners.clear();
+        if (state == vpTargetLossHandler::COASTING) {
+          // Move the feature points of the previous frame with the predicted camera motion
+          corners.resize(engine.getNbPoints());
+          const vpHomogeneousMatrix &motion = loss.getFrameMotion();
+          for (unsigned int i = 0; i < engine.getNbPoints(); i++) {
+            const vpFeaturePoint &feature = engine.getPoint(i);
+            double X = feature.get_x() * feature.get_Z(), Y = feature.get_y() * feature.get_Z(), Z = feature.get_Z();
+            for (unsigned int j = 0; j < 3; j++) {
+              cP[j] = motion[j][0] * X + motion[j][1] * Y + motion[j][2] * Z + motion[j][3];
+            }
+            engine.setPoint(i, cP[0] / cP[2], cP[1] / cP[2], cP[2]);
+            vpMeterPixelConversion::convertPoint(cam, cP[0] / cP[2], cP[1] / cP[2], corners[i]);
+          }
+        }
+        else if (tracked) {
+          corners = tracker.getCorners();
+        }
+        else if (ref_index >= 0) {
+          corners = detector.getPolygon(static_cast<size_t>(ref_index));
+        }
+        else {
+          // The reference tag is hidden: use the projection of its corners from the bundle pose
+          corners.resize(point.size());
           for (size_t i = 0; i < point.size(); i++) {
-            vpColVector cP, p;
-            point[i].changeFrame(cdMo * oMo, cP);
+            point[i].changeFrame(cMo, cP);
             point[i].projection(cP, p);
-
-            pd[i].set_x(p[0]);
-            pd[i].set_y(p[1]);
-            pd[i].set_Z(cP[2]);
+            vpMeterPixelConversion::convertPoint(cam, p[0], p[1], corners[i]);
           }
         }
+        if (opt_refine_corners > 0 && (tracked || ref_index >= 0) && last_error < opt_refine_corners) {
+          corner_refinement.refine(I, corners);
+        }
 
-        // Get tag corners
-        std::vector<vpImagePoint> corners = detector.getPolygon(0);
-
-        // Update visual features
-        for (size_t i = 0; i < corners.size(); i++) {
+        // Update visual features, already predicted while coasting
+        for (unsigned int i = 0; i < corners.size() && state != vpTargetLossHandler::COASTING; i++) {
           // Update the point feature from the tag corners location
-          vpFeatureBuilder::create(p[i], cam, corners[i]);
-          // Set the feature Z coordinate from the pose
-          vpColVector cP;
-          point[i].changeFrame(cMo, cP);
-
-          p[i].set_Z(cP[2]);
+          double x = 0, y = 0, Z = 0;
+          vpPixelMeterConversion::convertPoint(cam, corners[i], x, y);
+          // Set the feature Z coordinate from the depth map if --depth_Z is used
+          if (!opt_depth_Z || !depth_sampler.getDepth(I_depth_raw, corners[i], Z)) {
+            if (!opt_depth_Z || state == vpTargetLossHandler::REACQUIRED) {
+              // Set the feature Z coordinate from the pose
+              point[i].changeFrame(cMo, cP);
+
+              Z = cP[2];
+            }
+            else {
+              // No depth is available around the corner: keep the one of the previous frame
+              Z = engine.getPoint(i).get_Z();
+            }
+          }
+          engine.setPoint(i, x, y, Z);
         }
+        VP_TRACE_ZONE_END(zone_features);
 
+        double t_sequencing = 0;
         if (opt_task_sequencing) {
           if (! servo_started) {
             if (send_velocities) {
@@ -346,57 +967,109 @@ int main(int argc, char **argv)
             }
             t_init_servo = vpTime::measureTimeMs();
           }
-          v_c = task.computeControlLaw((vpTime::measureTimeMs() - t_init_servo)/1000.);
+          t_sequencing = (vpTime::measureTimeMs() - t_init_servo)/1000.;
+        }
+
+        if (opt_joint_space) {
+          robot.get_eJe(eJe);
+          engine.set_eJe(eJe);
+        }
+
+        VP_TRACE_ZONE(zone_control_law, "control law");
+        if (opt_mpc) {
+          // Predict over the measured loop period
+          double t_mpc = vpTime::measureTimeMs();
+          if (t_mpc_prev > 0) {
+            mpc.setSamplingTime(std::min(std::max((t_mpc - t_mpc_prev) / 1000., 0.01), 0.1));
+          }
+          t_mpc_prev = t_mpc;
+
+          robot.getPosition(vpRobot::JOINT_STATE, q);
+          mpc.set_cVe_eJe(cVe, eJe);
+          mpc.setJointState(q, qdot_sent);
+          // The feature points have to stay visible
+          for (unsigned int i = 0; i < engine.getNbPoints(); i++) {
+            visibility_points[i].set_x(engine.getPoint(i).get_x());
+            visibility_points[i].set_y(engine.getPoint(i).get_y());
+            visibility_points[i].set_Z(engine.getPoint(i).get_Z());
+          }
+          mpc.setVisibilityPoints(visibility_points);
+
+          engine.computeInteractionMatrix(L, task_error);
+          bool feasible = mpc.computeControlLaw(L, task_error, v_c);
+          if (!feasible && (mpc_feasible || opt_verbose)) {
+            std::cout << "MPC: no feasible solution, decelerate" << std::endl;
+          }
+          mpc_feasible = feasible;
+          if (opt_verbose) {
+            std::cout << "MPC: " << vpTime::measureTimeMs() - t_mpc
+                      << " ms, predicted error: " << mpc.getPredictedError().t() << std::endl;
+          }
         }
         else {
-          v_c = task.computeControlLaw();
+          if (opt_task_sequencing) {
+            engine.computeControlLaw(t_sequencing, v_c, task_error);
+          }
+          else {
+            engine.computeControlLaw(v_c, task_error);
+          }
+        }
+        VP_TRACE_ZONE_END(zone_control_law);
+        nb_control_allocations = vpAllocationCounter::getCount() - nb_allocations_features;
+        if (state == vpTargetLossHandler::COASTING) {
+          // Keep moving towards the predicted features while slowing down
+          v_c *= loss.getVelocityScale();
         }
 
         // Display the current and desired feature points in the image display
-        vpServoDisplay::display(task, cam, I);
+        VP_TRACE_ZONE(zone_display_features, "display");
+        engine.display(cam, I);
         for (size_t i = 0; i < corners.size(); i++) {
-          std::stringstream ss;
-          ss << i;
           // Display current point indexes
-          vpDisplay::displayText(I, corners[i]+vpImagePoint(15, 15), ss.str(), vpColor::red);
+          display_text(I, static_cast<int>(corners[i].get_i()) + 15, static_cast<int>(corners[i].get_j()) + 15,
+                       vpColor::red, text, "%u", static_cast<unsigned int>(i));
           // Display desired point indexes
           vpImagePoint ip;
-          vpMeterPixelConversion::convertPoint(cam, pd[i].get_x(), pd[i].get_y(), ip);
-          vpDisplay::displayText(I, ip+vpImagePoint(15, 15), ss.str(), vpColor::red);
+          vpMeterPixelConversion::convertPoint(cam, engine.getDesiredPoint(static_cast<unsigned int>(i)).get_x(),
+                                               engine.getDesiredPoint(static_cast<unsigned int>(i)).get_y(), ip);
+          vpDisplay::displayText(I, ip+vpImagePoint(15, 15), text, vpColor::red);
         }
-        if (first_time) {
+        if (traj_corners == nullptr) {
            traj_corners = new std::vector<vpImagePoint> [corners.size()];
         }
         // Display the trajectory of the points used as features
         //display_point_trajectory(I, corners, traj_corners);
+        VP_TRACE_ZONE_END(zone_display_features);
 
         if (opt_plot) {
-          plotter->plot(0, iter_plot, task.getError());
-          plotter->plot(1, iter_plot, v_c);
+          plotter->plot(0, iter_plot, task_error);
+          plotter->plot(1, iter_plot, opt_joint_space ? vpColVector(cVe * eJe * v_c) : v_c);
           iter_plot++;
         }
 
         if (opt_verbose) {
-          std::cout << "v_c: " << v_c.t() << std::endl;
+          std::cout << (opt_joint_space ? "qdot: " : "v_c: ") << v_c.t() << std::endl;
         }
 
-        double error = task.getError().sumSquare();
-        ss.str("");
-        ss << "error: " << error;
-        vpDisplay::displayText(I, 20, static_cast<int>(I.getWidth()) - 150, ss.str(), vpColor::red);
+        double error = task_error.sumSquare();
+        last_error = error;
+        display_text(I, 20, static_cast<int>(I.getWidth()) - 150, vpColor::red, text, "error: %g", error);
 
         if (opt_verbose)
           std::cout << "error: " << error << std::endl;
 
-        if (error < convergence_threshold) {
+        convergence_errors[0] = error;
+        if (state != vpTargetLossHandler::COASTING) {
+          // Predicted errors are not measures
+          convergence.addSample(vpTime::measureTimeSecond(), convergence_errors, v_c.infinityNorm());
+        }
+        if (convergence.hasConverged()) {
           has_converged = true;
-          std::cout << "Servo task has converged" << "\n";
+          std::cout << "Servo task has converged in " << convergence.getConvergenceTime() << " s"
+                    << (convergence.isAtNoiseFloor() ? " (error at the noise floor)" : "") << "\n";
           vpDisplay::displayText(I, 100, 20, "Servo task has converged", vpColor::red);
         }
-        if (first_time) {
-          first_time = false;
-        }
-      } // end if (cMo_vec.size() == 1)
+      } // end if (state != vpTargetLossHandler::SEARCHING)
       else {
         v_c = 0;
       }
@@ -406,18 +1079,41 @@ int main(int argc, char **argv)
       }
 
       // Send to the robot
-      robot.setVelocity(vpRobot::CAMERA_FRAME, v_c);
+      VP_TRACE_ZONE(zone_velocity, "setVelocity");
+      robot.setVelocity(control_frame, v_c);
+      VP_TRACE_ZONE_END(zone_velocity);
+      double t_command = vpTime::measureTimeMs();
+      if (t_command_prev >= 0) {
+        metric_command_jitter.record(std::fabs(t_command - t_command_prev - expected_period));
+      }
+      t_command_prev = t_command;
+      if (is_saturated(robot, control_frame, v_c)) {
+        metric_saturations.inc();
+      }
+      qdot_sent = v_c;
+      // Camera velocity used to predict the features if the next detection is missed
+      if (opt_joint_space && eJe.getRows() == 6) {
+        vpTickArena &arena = vpTickArena::getThreadArena();
+        vpTickArena::vpScope scope(arena);
+        vpTickArena::copy(arena.multiply(arena.view(cVe), arena.multiply(arena.view(eJe), arena.view(v_c))), v_cam);
+        loss.setCameraVelocity(v_cam);
+      }
+      else {
+        loss.setCameraVelocity(v_c);
+      }
 
-      ss.str("");
-      ss << "Loop time: " << vpTime::measureTimeMs() - t_start << " ms";
-      vpDisplay::displayText(I, 40, 20, ss.str(), vpColor::red);
+      display_text(I, 40, 20, vpColor::red, text, "Loop time: %g ms", vpTime::measureTimeMs() - t_start);
+      display_text(I, 60, 20, vpColor::red, text, "Tag: %s", vpTargetLossHandler::getStateName(state));
+      VP_TRACE_ZONE(zone_flush, "display");
       vpDisplay::flush(I);
+      VP_TRACE_ZONE_END(zone_flush);
 
       vpMouseButton::vpMouseButtonType button;
       if (vpDisplay::getClick(I, button, false)) {
         switch (button) {
         case vpMouseButton::button1:
           send_velocities = !send_velocities;
+          convergence.reset();
           break;
 
         case vpMouseButton::button3:
@@ -429,17 +1125,75 @@ int main(int argc, char **argv)
           break;
         }
       }
+
+      if (opt_count_allocations && metric_frames.get() > allocation_warmup) {
+        uint64_t nb_iteration_allocations = vpAllocationCounter::getCount() - nb_allocations;
+        max_image_allocations = std::max(max_image_allocations, nb_image_allocations);
+        max_control_allocations = std::max(max_control_allocations, nb_control_allocations);
+        max_iteration_allocations = std::max(max_iteration_allocations, nb_iteration_allocations);
+        sum_iteration_allocations += nb_iteration_allocations;
+        nb_counted_iterations++;
+        if (check_control_allocations && nb_control_allocations > 0 && allocation_test_passed) {
+          std::cout << "Allocation test failed: " << nb_control_allocations << " allocations in the features and "
+                    << "the control law at iteration " << metric_frames.get() << std::endl;
+          allocation_test_passed = false;
+        }
+        else if (nb_image_allocations > 0 && allocation_test_passed) {
+          std::cout << "Allocation test failed: " << nb_image_allocations << " allocations in the acquisition and "
+                    << "the display of the image at iteration " << metric_frames.get() << std::endl;
+          allocation_test_passed = false;
+        }
+      }
     }
     std::cout << "Stop the robot " << std::endl;
     robot.setRobotState(vpRobot::STATE_STOP);
 
+    if (use_rt_profile || opt_verbose) {
+      std::cout << jitter.getReport() << std::endl;
+    }
+
+    if (opt_count_allocations && nb_counted_iterations > 0) {
+      std::cout << "Allocations per iteration over " << nb_counted_iterations
+                << " iterations: image acquisition and display max " << max_image_allocations
+                << ", features and control law max " << max_control_allocations
+                << ", whole iteration mean " << static_cast<double>(sum_iteration_allocations) / nb_counted_iterations
+                << ", max " << max_iteration_allocations << std::endl;
+      std::cout << "Tick arena peak usage: " << vpTickArena::getThreadArena().getPeak() << " bytes of "
+                << vpTickArena::getThreadArena().getCapacity() << std::endl;
+    }
+
+    if (use_online_eMc) {
+      online_hand_eye.stop();
+      double error_t = 0, error_tu = 0;
+      online_hand_eye.getResidual(error_t, error_tu);
+      std::cout << "eMc updated " << online_hand_eye.getNbUpdates() << " times with " << online_hand_eye.getNbSamples()
+                << " robot poses, residual: " << error_t << " m, " << vpMath::deg(error_tu) << " deg" << std::endl;
+      vpPoseVector ePc_refined(online_hand_eye.get_eMc());
+      if (online_hand_eye.getNbUpdates() > 0) {
+        if (vpPoseVector::saveYAML(opt_online_eMc_filename, ePc_refined)) {
+          std::cout << "eMc saved in " << opt_online_eMc_filename << ": " << ePc_refined.t() << std::endl;
+        }
+        else {
+          std::cout << "Can not write " << opt_online_eMc_filename << std::endl;
+        }
+      }
+    }
+
+    if (!opt_trace_filename.empty()) {
+      vpTrace::stop();
+      if (vpTrace::save(opt_trace_filename)) {
+        std::cout << "Trace saved in " << opt_trace_filename << std::endl;
+      }
+      else {
+        std::cout << "Can not write " << opt_trace_filename << std::endl;
+      }
+    }
+
     if (opt_plot && plotter != nullptr) {
       delete plotter;
       plotter = nullptr;
     }
 
-    task.kill();
-
     if (!final_quit) {
       while (!final_quit) {
         rs.acquire(I);
@@ -470,7 +1224,7 @@ int main(int argc, char **argv)
     return EXIT_FAILURE;
   }
 
-  return 0;
+  return allocation_test_passed ? 0 : EXIT_FAILURE;
 }
 #else
 int main()
@@ -478,6 +1232,9 @@ int main()
 #if !defined(VISP_HAVE_REALSENSE2)
   std::cout << "Install librealsense-2.x" << std::endl;
 #endif
+#if !defined(VISP_HAVE_PUGIXML)
+  std::cout << "Build ViSP with pugixml to read the camera parameters" << std::endl;
+#endif
 #if (VISP_CXX_STANDARD < VISP_CXX_STANDARD_11)
   std::cout << "Build ViSP with c++11 or higher compiler flag (cmake -DUSE_CXX_STANDARD=11)." << std::endl;
 #endif
@@ -0,0 +1,115 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Sampling of the depth map aligned on the color image at sub-pixel locations.
+ *
+ *****************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+
+#include <visp3/core/vpConfig.h>
+#include <visp3/core/vpMath.h>
+
+/*!
+  \file vpDepthSampler.cpp
+  Sampling of the depth map aligned on the color image at sub-pixel locations.
+*/
+
+#include <vpDepthSampler.h>
+
+/*!
+  Default constructor.
+ */
+vpDepthSampler::vpDepthSampler() : m_depthScale(0.001), m_minZ(0.1), m_maxZ(2.0), m_holeRadius(5) {}
+
+/*!
+  Get the depth at a sub-pixel location.
+
+  \param[in] I_depth_raw : Raw depth map aligned on the color image.
+  \param[in] ip : Location in the image.
+  \param[out] Z : Depth in meter.
+  \return true if a valid depth was found, false otherwise. In that case \e Z is unchanged.
+ */
+bool vpDepthSampler::getDepth(const vpImage<uint16_t> &I_depth_raw, const vpImagePoint &ip, double &Z) const
+{
+  const int width = static_cast<int>(I_depth_raw.getWidth()), height = static_cast<int>(I_depth_raw.getHeight());
+  if (width < 2 || height < 2 || ip.get_u() < 0 || ip.get_v() < 0 || ip.get_u() > width - 1 ||
+      ip.get_v() > height - 1) {
+    return false;
+  }
+
+  // Bilinear interpolation on the valid neighbours
+  int u0 = std::min(static_cast<int>(ip.get_u()), width - 2);
+  int v0 = std::min(static_cast<int>(ip.get_v()), height - 2);
+  double du = ip.get_u() - u0, dv = ip.get_v() - v0;
+  const double w[4] = {(1 - du) * (1 - dv), du * (1 - dv), (1 - du) * dv, du * dv};
+  const double d[4] = {I_depth_raw[v0][u0] * m_depthScale, I_depth_raw[v0][u0 + 1] * m_depthScale,
+                       I_depth_raw[v0 + 1][u0] * m_depthScale, I_depth_raw[v0 + 1][u0 + 1] * m_depthScale};
+  double sum_w = 0, sum_wd = 0;
+  for (unsigned int i = 0; i < 4; i++) {
+    if (isValid(d[i])) {
+      sum_w += w[i];
+      sum_wd += w[i] * d[i];
+    }
+  }
+  if (sum_w > 1e-6) {
+    Z = sum_wd / sum_w;
+    return true;
+  }
+
+  // Hole filling: average of the valid depths on the smallest ring around the location
+  const int uc = vpMath::round(ip.get_u()), vc = vpMath::round(ip.get_v());
+  for (int r = 1; r <= static_cast<int>(m_holeRadius); r++) {
+    double sum = 0;
+    unsigned int nb = 0;
+    for (int v = std::max(0, vc - r); v <= std::min(height - 1, vc + r); v++) {
+      // Only the border of the square: full rows at the top and bottom, two pixels otherwise
+      int step = (v == vc - r || v == vc + r) ? 1 : 2 * r;
+      for (int u = uc - r; u <= uc + r; u += step) {
+        if (u < 0 || u >= width) {
+          continue;
+        }
+        double Zi = I_depth_raw[v][u] * m_depthScale;
+        if (isValid(Zi)) {
+          sum += Zi;
+          nb++;
+        }
+      }
+    }
+    if (nb > 0) {
+      Z = sum / nb;
+      return true;
+    }
+  }
+
+  return false;
+}
@@ -0,0 +1,97 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Sampling of the depth map aligned on the color image at sub-pixel locations.
+ *
+ *****************************************************************************/
+
+#ifndef vpDepthSampler_h
+#define vpDepthSampler_h
+
+/*!
+  \file vpDepthSampler.h
+  Sampling of the depth map aligned on the color image at sub-pixel locations.
+*/
+
+#include <visp3/core/vpConfig.h>
+
+#include <visp3/core/vpImage.h>
+#include <visp3/core/vpImagePoint.h>
+
+/*!
+
+  \class vpDepthSampler
+  \brief Read the depth in meter at a sub-pixel location of the raw depth map aligned on the color image.
+
+  The depth is bilinearly interpolated between the 4 neighbour pixels. Neighbours without a valid
+  depth (holes, out of range values) are dropped and the remaining bilinear weights are normalized.
+  When the 4 neighbours are holes, the depth is the average of the valid pixels found on the
+  smallest square ring around the location, up to a maximal radius.
+
+  \code
+  vpDepthSampler sampler;
+  sampler.setDepthScale(rs.getDepthScale());
+  double Z;
+  if (sampler.getDepth(I_depth_raw, corners[i], Z)) {
+    p[i].set_Z(Z);
+  }
+  \endcode
+
+*/
+class vpDepthSampler
+{
+public:
+  vpDepthSampler();
+
+  bool getDepth(const vpImage<uint16_t> &I_depth_raw, const vpImagePoint &ip, double &Z) const;
+
+  /*!
+    Set the factor that converts raw depth values in meter, given by vpRealSense2::getDepthScale().
+   */
+  void setDepthScale(double depth_scale) { m_depthScale = depth_scale; }
+  //! Set the depth range in meter that is considered as valid.
+  void setDepthRange(double min_Z, double max_Z)
+  {
+    m_minZ = min_Z;
+    m_maxZ = max_Z;
+  }
+  //! Set the maximal radius in pixel of the search for valid depth values around a hole.
+  void setHoleRadius(unsigned int radius) { m_holeRadius = radius; }
+
+protected:
+  bool isValid(double Z) const { return Z > m_minZ && Z < m_maxZ; }
+
+  double m_depthScale;
+  double m_minZ;
+  double m_maxZ;
+  unsigned int m_holeRadius;
+};
+#endif
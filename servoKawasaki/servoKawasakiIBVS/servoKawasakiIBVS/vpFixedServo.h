@@ -0,0 +1,467 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Fixed-size eye-in-hand control law.
+ *
+ *****************************************************************************/
+
+#ifndef vpFixedServo_h
+#define vpFixedServo_h
+
+/*!
+  \file vpFixedServo.h
+  Fixed-size eye-in-hand control law.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <visp3/core/vpConfig.h>
+
+#include <visp3/core/vpColVector.h>
+#include <visp3/core/vpHomogeneousMatrix.h>
+#include <visp3/core/vpMath.h>
+#include <visp3/core/vpMatrix.h>
+#include <visp3/core/vpVelocityTwistMatrix.h>
+#include <visp3/vs/vpAdaptiveGain.h>
+
+/*!
+
+  \class vpFixedServo
+  \brief Eye-in-hand control law \f${\bf v}_c = -\lambda {\bf L}^{+} {\bf e}\f$ for a task of fixed
+  dimension \e N, computed without any dynamic allocation.
+
+  This is the control law computed by vpServo::computeControlLaw() with vpServo::EYEINHAND_CAMERA,
+  vpServo::CURRENT interaction matrix and vpServo::PSEUDO_INVERSE, specialized for the two feature
+  sets used by the servo examples:
+  - N = 6: vpFeatureTranslation::cdMc followed by vpFeatureThetaU::cdRc, see setPoseFeatures();
+  - N = 8: 4 vpFeaturePoint, see setPointFeature();
+  - N = 6: 2 1/2 D features, a vpFeaturePoint, a vpFeatureDepth and vpFeatureThetaU::cdRc, see
+    setHybridFeatures().
+
+  The interaction matrix is built in closed form. The pseudo-inverse is obtained by a one-sided
+  Jacobi SVD on stack arrays, with the same relative threshold (1e-6) on the singular values as vpServo.
+  The task sequencing term of vpServo::computeControlLaw(double) is also available. Both laws are compared
+  by vpServoEngine::checkFixedControlLaw().
+
+  After a call to set_cVe_eJe(), the law becomes the one of vpServo::EYEINHAND_L_cVe_eJe: the task
+  Jacobian is \f${\bf L}\,{^c}{\bf V}_e\,{^e}{\bf J}_e\f$ and the computed velocity is the 6-dim joint
+  velocity \f$\dot{\bf q}\f$.
+
+  \code
+  vpFixedServo<8> fixed_task;
+  fixed_task.setLambda(0.5);
+  for (unsigned int i = 0; i < 4; i++) {
+    fixed_task.setPointFeature(i, p[i].get_x(), p[i].get_y(), p[i].get_Z(), pd[i].get_x(), pd[i].get_y());
+  }
+  fixed_task.computeControlLaw(v_c);
+  \endcode
+
+*/
+template <unsigned int N> class vpFixedServo
+{
+public:
+  vpFixedServo() : m_lambda(), m_mu(4.), m_iteration(0), m_rank(0), m_jointSpace(false)
+  {
+    m_lambda.initFromConstant(0.5);
+    for (unsigned int i = 0; i < 6; i++) {
+      for (unsigned int j = 0; j < 6; j++) {
+        m_cJe[i][j] = 0;
+      }
+    }
+    for (unsigned int i = 0; i < N; i++) {
+      m_e[i] = 0;
+      for (unsigned int j = 0; j < 6; j++) {
+        m_L[i][j] = 0;
+      }
+    }
+    for (unsigned int j = 0; j < 6; j++) {
+      m_e1_initial[j] = 0;
+    }
+  }
+
+  /*!
+    Compute the camera velocity \f${\bf v}_c = -\lambda {\bf L}^{+} {\bf e}\f$ from the features set since the
+    last call.
+
+    \param[out] v : 6-dim camera velocity, or joint velocity after set_cVe_eJe(), resized if needed.
+   */
+  void computeControlLaw(vpColVector &v)
+  {
+    double e1[6];
+    computeVelocity(e1);
+    if (m_iteration == 0) {
+      setInitial(e1);
+    }
+    m_iteration++;
+    const double gain = m_lambda.value_const(infinityNorm(e1));
+    v.resize(6, false);
+    for (unsigned int j = 0; j < 6; j++) {
+      v[j] = -gain * e1[j];
+    }
+  }
+
+  /*!
+    Compute the camera velocity with the task sequencing term of vpServo::computeControlLaw(double):
+    \f${\bf v}_c = -\lambda {\bf L}^{+} {\bf e} + \lambda e^{-\mu t} {\bf L}^{+}(0) {\bf e}(0)\f$.
+
+    \param[in] t : Time in second since the beginning of the servo.
+    \param[out] v : 6-dim camera velocity, or joint velocity after set_cVe_eJe(), resized if needed.
+   */
+  void computeControlLaw(double t, vpColVector &v)
+  {
+    double e1[6];
+    computeVelocity(e1);
+    if (m_iteration == 0) {
+      setInitial(e1);
+    }
+    m_iteration++;
+    const double gain = m_lambda.value_const(infinityNorm(e1));
+    const double decay = std::exp(-m_mu * t);
+    v.resize(6, false);
+    for (unsigned int j = 0; j < 6; j++) {
+      v[j] = -gain * e1[j] + gain * decay * m_e1_initial[j];
+    }
+  }
+
+  //! Return the task dimension.
+  unsigned int getDimension() const { return N; }
+  //! Return the error \f$\bf e = s - s^*\f$ set by the last call to the feature setters.
+  const double *getError() const { return m_e; }
+  //! Copy the error \f$\bf e = s - s^*\f$ in \e e, resized if needed.
+  void getError(vpColVector &e) const
+  {
+    e.resize(N, false);
+    for (unsigned int i = 0; i < N; i++) {
+      e[i] = m_e[i];
+    }
+  }
+  //! Copy the interaction matrix \f$\bf L\f$ of the error in \e L, resized if needed.
+  void getInteractionMatrix(vpMatrix &L) const
+  {
+    L.resize(N, 6, false);
+    for (unsigned int i = 0; i < N; i++) {
+      for (unsigned int j = 0; j < 6; j++) {
+        L[i][j] = m_L[i][j];
+      }
+    }
+  }
+  //! Return the rank of the interaction matrix found by the last control law computation.
+  unsigned int getTaskRank() const { return m_rank; }
+
+  //! Restart the task, the next control law will be the first one for the task sequencing.
+  void reset() { m_iteration = 0; }
+
+  /*!
+    Set the robot Jacobian \f${^c}{\bf V}_e\,{^e}{\bf J}_e\f$ of a 6 joints robot, to be updated at each
+    iteration. The control law then computes joint velocities.
+   */
+  void set_cVe_eJe(const vpVelocityTwistMatrix &cVe, const vpMatrix &eJe)
+  {
+    if (eJe.getRows() != 6 || eJe.getCols() != 6) {
+      throw(vpException(vpException::dimensionError, "Cannot use a %dx%d robot Jacobian, 6x6 expected",
+                        eJe.getRows(), eJe.getCols()));
+    }
+    for (unsigned int i = 0; i < 6; i++) {
+      for (unsigned int j = 0; j < 6; j++) {
+        double sum = 0;
+        for (unsigned int k = 0; k < 6; k++) {
+          sum += cVe[i][k] * eJe[k][j];
+        }
+        m_cJe[i][j] = sum;
+      }
+    }
+    m_jointSpace = true;
+  }
+
+  void setLambda(double c) { m_lambda.initFromConstant(c); }
+  void setLambda(const vpAdaptiveGain &lambda) { m_lambda = lambda; }
+  void setMu(double mu) { m_mu = mu; }
+
+  /*!
+    Set the features of a PBVS task (N = 6) from the pose of the current camera frame in the desired
+    camera frame: the translation \f$^{c^*}{\bf t}_c\f$ (vpFeatureTranslation::cdMc) followed by
+    \f$\theta{\bf u}\f$ of \f$^{c^*}{\bf R}_c\f$ (vpFeatureThetaU::cdRc). The desired features are zero.
+   */
+  void setPoseFeatures(const vpHomogeneousMatrix &cdMc)
+  {
+    for (unsigned int i = 0; i < 3; i++) {
+      m_e[i] = cdMc[i][3];
+      for (unsigned int j = 0; j < 3; j++) {
+        m_L[i][j] = cdMc[i][j];
+        m_L[i][j + 3] = 0;
+      }
+    }
+    setThetaUFeature(3, cdMc);
+  }
+
+  /*!
+    Set the features of a 2 1/2 D task (N = 6): the point feature of the target center, the
+    vpFeatureDepth \f$\log(Z/Z^*)\f$ of the center, and \f$\theta{\bf u}\f$ of \f$^{c^*}{\bf R}_c\f$
+    (vpFeatureThetaU::cdRc). The rotation is only controlled by the last 3 features.
+
+    \param[in] x, y, Z : Current normalized coordinates and depth of the target center.
+    \param[in] xd, yd, Zd : Desired normalized coordinates and depth of the target center.
+    \param[in] cdMc : Pose of the current camera frame in the desired camera frame.
+   */
+  void setHybridFeatures(double x, double y, double Z, double xd, double yd, double Zd,
+                         const vpHomogeneousMatrix &cdMc)
+  {
+    setPointFeature(0, x, y, Z, xd, yd);
+    double *Lz = m_L[2];
+    Lz[0] = 0;
+    Lz[1] = 0;
+    Lz[2] = -1. / Z;
+    Lz[3] = -y;
+    Lz[4] = x;
+    Lz[5] = 0;
+    m_e[2] = std::log(Z / Zd);
+    setThetaUFeature(3, cdMc);
+  }
+
+  /*!
+    Set the point feature \e i of an IBVS task: rows 2i and 2i+1 of the interaction matrix
+    are the ones of vpFeaturePoint.
+
+    \param[in] i : Index of the point, lower than N/2.
+    \param[in] x, y, Z : Current normalized coordinates and depth of the point.
+    \param[in] xd, yd : Desired normalized coordinates of the point.
+   */
+  void setPointFeature(unsigned int i, double x, double y, double Z, double xd, double yd)
+  {
+    double *Lx = m_L[2 * i], *Ly = m_L[2 * i + 1];
+    Lx[0] = -1. / Z;
+    Lx[1] = 0;
+    Lx[2] = x / Z;
+    Lx[3] = x * y;
+    Lx[4] = -(1 + x * x);
+    Lx[5] = y;
+    Ly[0] = 0;
+    Ly[1] = -1. / Z;
+    Ly[2] = y / Z;
+    Ly[3] = 1 + y * y;
+    Ly[4] = -x * y;
+    Ly[5] = -x;
+    m_e[2 * i] = x - xd;
+    m_e[2 * i + 1] = y - yd;
+  }
+
+protected:
+  /*
+    Rows row to row+2: vpFeatureThetaU::cdRc, with an interaction matrix [0 Lw].
+   */
+  void setThetaUFeature(unsigned int row, const vpHomogeneousMatrix &cdMc)
+  {
+    double tu[3];
+    thetaU(cdMc, tu);
+    for (unsigned int i = 0; i < 3; i++) {
+      m_e[row + i] = tu[i];
+      for (unsigned int j = 0; j < 3; j++) {
+        m_L[row + i][j] = 0;
+      }
+    }
+
+    // Lw = I + theta/2 [u]x + (1 - sinc(theta) / sinc^2(theta/2)) [u]x^2
+    double theta = std::sqrt(tu[0] * tu[0] + tu[1] * tu[1] + tu[2] * tu[2]);
+    double Lw[3][3] = {{1, -tu[2] / 2., tu[1] / 2.}, {tu[2] / 2., 1, -tu[0] / 2.}, {-tu[1] / 2., tu[0] / 2., 1}};
+    if (theta >= 1e-6) {
+      double u[3] = {tu[0] / theta, tu[1] / theta, tu[2] / theta};
+      double k = 1 - vpMath::sinc(theta) / vpMath::sqr(vpMath::sinc(theta / 2.));
+      // [u]x^2 = u.u^T - I
+      for (unsigned int i = 0; i < 3; i++) {
+        for (unsigned int j = 0; j < 3; j++) {
+          Lw[i][j] += k * (u[i] * u[j] - (i == j ? 1. : 0.));
+        }
+      }
+    }
+    for (unsigned int i = 0; i < 3; i++) {
+      for (unsigned int j = 0; j < 3; j++) {
+        m_L[row + i][j + 3] = Lw[i][j];
+      }
+    }
+  }
+
+  /*
+    theta u of the rotation of M, as vpThetaUVector::buildFrom(const vpRotationMatrix &) but without the
+    vpRotationMatrix and vpThetaUVector arrays that are allocated on the heap.
+   */
+  static void thetaU(const vpHomogeneousMatrix &M, double tu[3])
+  {
+    double s = std::sqrt(vpMath::sqr(M[1][0] - M[0][1]) + vpMath::sqr(M[2][0] - M[0][2]) +
+                         vpMath::sqr(M[2][1] - M[1][2])) / 2.;
+    double c = (M[0][0] + M[1][1] + M[2][2] - 1.) / 2.;
+    double theta = std::atan2(s, c); // In [0, PI] since s >= 0
+
+    if (1 + c > 0.0001) {
+      double sinc = vpMath::sinc(s, theta);
+      tu[0] = (M[2][1] - M[1][2]) / (2 * sinc);
+      tu[1] = (M[0][2] - M[2][0]) / (2 * sinc);
+      tu[2] = (M[1][0] - M[0][1]) / (2 * sinc);
+      return;
+    }
+
+    // theta near PI: the axis is given by the diagonal, its signs by the symmetric part
+    double u[3];
+    for (unsigned int i = 0; i < 3; i++) {
+      u[i] = (M[i][i] - c > std::numeric_limits<double>::epsilon()) ? std::sqrt((M[i][i] - c) / (1 - c)) : 0;
+    }
+    unsigned int k = (u[0] > u[1] && u[0] > u[2]) ? 0 : (u[1] > u[2] ? 1 : 2);
+    unsigned int k1 = (k + 1) % 3, k2 = (k + 2) % 3;
+    if (M[k2][k1] - M[k1][k2] < 0) {
+      u[k] = -u[k];
+    }
+    for (unsigned int i = 0; i < 3; i++) {
+      if (i != k && vpMath::sign(u[k]) * vpMath::sign(u[i]) != vpMath::sign(M[k][i] + M[i][k])) {
+        u[i] = -u[i];
+      }
+    }
+    for (unsigned int i = 0; i < 3; i++) {
+      tu[i] = theta * u[i];
+    }
+  }
+
+  static double infinityNorm(const double *x)
+  {
+    double norm = 0;
+    for (unsigned int j = 0; j < 6; j++) {
+      norm = std::max(norm, std::fabs(x[j]));
+    }
+    return norm;
+  }
+
+  void setInitial(const double *e1)
+  {
+    for (unsigned int j = 0; j < 6; j++) {
+      m_e1_initial[j] = e1[j];
+    }
+  }
+
+  /*
+    e1 = J^+ e with J = L, or J = L cVe eJe in joint space. The pseudo-inverse is obtained by a one-sided
+    Jacobi SVD of J = U S V^T: the columns of A = J V are orthogonal, with norms equal to the singular values.
+   */
+  void computeVelocity(double e1[6])
+  {
+    double A[N][6], V[6][6];
+    for (unsigned int i = 0; i < N; i++) {
+      for (unsigned int j = 0; j < 6; j++) {
+        if (m_jointSpace) {
+          A[i][j] = 0;
+          for (unsigned int k = 0; k < 6; k++) {
+            A[i][j] += m_L[i][k] * m_cJe[k][j];
+          }
+        } else {
+          A[i][j] = m_L[i][j];
+        }
+      }
+    }
+    for (unsigned int i = 0; i < 6; i++) {
+      for (unsigned int j = 0; j < 6; j++) {
+        V[i][j] = (i == j ? 1. : 0.);
+      }
+    }
+
+    for (unsigned int sweep = 0; sweep < 30; sweep++) {
+      bool rotated = false;
+      for (unsigned int p = 0; p < 5; p++) {
+        for (unsigned int q = p + 1; q < 6; q++) {
+          double alpha = 0, beta = 0, gamma = 0;
+          for (unsigned int i = 0; i < N; i++) {
+            alpha += A[i][p] * A[i][p];
+            beta += A[i][q] * A[i][q];
+            gamma += A[i][p] * A[i][q];
+          }
+          if (std::fabs(gamma) <= 1e-15 * std::sqrt(alpha * beta)) {
+            continue;
+          }
+          rotated = true;
+          double zeta = (beta - alpha) / (2 * gamma);
+          double t = (zeta >= 0 ? 1. : -1.) / (std::fabs(zeta) + std::sqrt(1 + zeta * zeta));
+          double c = 1 / std::sqrt(1 + t * t), s = c * t;
+          for (unsigned int i = 0; i < N; i++) {
+            double ap = A[i][p], aq = A[i][q];
+            A[i][p] = c * ap - s * aq;
+            A[i][q] = s * ap + c * aq;
+          }
+          for (unsigned int i = 0; i < 6; i++) {
+            double vp = V[i][p], vq = V[i][q];
+            V[i][p] = c * vp - s * vq;
+            V[i][q] = s * vp + c * vq;
+          }
+        }
+      }
+      if (!rotated) {
+        break;
+      }
+    }
+
+    double sv2[6], sv2_max = 0;
+    for (unsigned int k = 0; k < 6; k++) {
+      sv2[k] = 0;
+      for (unsigned int i = 0; i < N; i++) {
+        sv2[k] += A[i][k] * A[i][k];
+      }
+      sv2_max = std::max(sv2_max, sv2[k]);
+    }
+
+    // Singular values lower than 1e-6 times the largest one are ignored
+    double w[6];
+    m_rank = 0;
+    for (unsigned int k = 0; k < 6; k++) {
+      w[k] = 0;
+      if (sv2[k] > 1e-12 * sv2_max && sv2[k] > 0) {
+        for (unsigned int i = 0; i < N; i++) {
+          w[k] += A[i][k] * m_e[i];
+        }
+        w[k] /= sv2[k];
+        m_rank++;
+      }
+    }
+    for (unsigned int j = 0; j < 6; j++) {
+      e1[j] = 0;
+      for (unsigned int k = 0; k < 6; k++) {
+        e1[j] += V[j][k] * w[k];
+      }
+    }
+  }
+
+  vpAdaptiveGain m_lambda;
+  double m_mu;
+  unsigned int m_iteration;
+  unsigned int m_rank;
+  bool m_jointSpace;        //!< true when the task Jacobian is L cVe eJe
+  double m_cJe[6][6];       //!< Robot Jacobian cVe eJe
+  double m_L[N][6];         //!< Interaction matrix
+  double m_e[N];            //!< Error s - s*
+  double m_e1_initial[6];   //!< L^+ e at the first iteration, for the task sequencing
+};
+#endif
@@ -0,0 +1,132 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Ring of preallocated camera frames shared by reference-counted handles.
+ *
+ *****************************************************************************/
+
+#include <utility>
+
+#include <visp3/core/vpException.h>
+
+/*!
+  \file vpFramePool.cpp
+  Ring of preallocated camera frames shared by reference-counted handles.
+*/
+
+#include <vpFramePool.h>
+
+vpFrameHandle::vpFrameHandle(const vpFrameHandle &handle) : m_slot(handle.m_slot)
+{
+  if (m_slot != nullptr) {
+    m_slot->useCount.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+vpFrameHandle &vpFrameHandle::operator=(vpFrameHandle handle)
+{
+  std::swap(m_slot, handle.m_slot);
+  return *this;
+}
+
+/*!
+  Release the frame, that goes back to the pool if this handle was the last one.
+ */
+void vpFrameHandle::reset()
+{
+  if (m_slot != nullptr) {
+    // Release the writes to the frame before another thread acquires it
+    m_slot->useCount.fetch_sub(1, std::memory_order_acq_rel);
+    m_slot = nullptr;
+  }
+}
+
+/*!
+  Allocate \e nb_frames frames of \e height x \e width pixels.
+ */
+vpFramePool::vpFramePool(unsigned int nb_frames, unsigned int height, unsigned int width)
+  : m_slots(), m_nbFrames(nb_frames), m_next(0)
+{
+  if (nb_frames == 0) {
+    throw(vpException(vpException::badValue, "The frame pool needs at least one frame"));
+  }
+  m_slots.reset(new vpFrameSlot[nb_frames]);
+  for (unsigned int i = 0; i < nb_frames; i++) {
+    vpFrame &frame = m_slots[i].frame;
+    frame.I.resize(height, width, 0);
+    frame.Ic.resize(height, width, vpRGBa(0));
+    frame.depthRaw.resize(height, width, 0);
+    frame.timestamp = 0;
+    m_slots[i].useCount.store(0);
+  }
+}
+
+/*!
+  Return a handle on the oldest frame that has no handle, the frames keep the images of their previous use.
+  Must be called from a single thread, the handles can be released from any thread.
+
+  \exception vpException::fatalError : All the frames are in use, the ring is too small for the pipeline.
+ */
+vpFrameHandle vpFramePool::acquire()
+{
+  for (unsigned int i = 0; i < m_nbFrames; i++) {
+    vpFrameSlot &slot = m_slots[(m_next + i) % m_nbFrames];
+    unsigned int free_count = 0;
+    if (slot.useCount.compare_exchange_strong(free_count, 1, std::memory_order_acq_rel)) {
+      m_next = (m_next + i + 1) % m_nbFrames;
+      return vpFrameHandle(&slot);
+    }
+  }
+  throw(vpException(vpException::fatalError, "All the %u frames of the pool are in use", m_nbFrames));
+}
+
+//! Return the number of frames that have at least one handle.
+unsigned int vpFramePool::getNbFramesInUse() const
+{
+  unsigned int nb = 0;
+  for (unsigned int i = 0; i < m_nbFrames; i++) {
+    if (m_slots[i].useCount.load(std::memory_order_relaxed) > 0) {
+      nb++;
+    }
+  }
+  return nb;
+}
+
+/*!
+  Attach the gray images of the frames to the display of \e I, created by vpDisplay::init(I). The display
+  must have the size of the frames and exist as long as the frames are displayed.
+ */
+void vpFramePool::setDisplay(const vpImage<unsigned char> &I)
+{
+  for (unsigned int i = 0; i < m_nbFrames; i++) {
+    m_slots[i].frame.I.display = I.display;
+  }
+}
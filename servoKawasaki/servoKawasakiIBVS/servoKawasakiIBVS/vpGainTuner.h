@@ -0,0 +1,211 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Tuning of the servo gain by simulated closed-loop episodes.
+ *
+ *****************************************************************************/
+
+#ifndef vpGainTuner_h
+#define vpGainTuner_h
+
+/*!
+  \file vpGainTuner.h
+  Tuning of the servo gain by simulated closed-loop episodes.
+*/
+
+#include <string>
+#include <vector>
+
+#include <visp3/core/vpConfig.h>
+
+#include <visp3/core/vpCameraParameters.h>
+#include <visp3/core/vpColVector.h>
+#include <visp3/core/vpHomogeneousMatrix.h>
+#include <visp3/vs/vpAdaptiveGain.h>
+
+#include <vpRobotKawasaki.h>
+
+/*!
+
+  \class vpGainTuner
+  \brief Search the constant or adaptive gain that minimizes the time to converge of the servo loop,
+  using closed-loop simulations of the robot.
+
+  Each episode starts from the joint positions at the desired pose, perturbed by a random joint
+  displacement that keeps the tag visible. The camera pose is given by the forward kinematics of the
+  robot and the hand-eye transformation. At each sampling period:
+  - the tag pose (position-based and 2 1/2 D servo) or the tag corners (image-based servo) are measured
+    with the given latency and with a noise derived from the image noise through the camera model;
+  - the control law of vpFixedServo computes the camera velocity, saturated like in vpRobotKawasaki::setVelocity();
+  - the camera velocity is converted in joint velocities with the robot Jacobian and integrated.
+
+  An episode fails if it doesn't converge before the maximal duration, if a joint limit is reached or if
+  the tag leaves the image. Each gain is evaluated on the same set of episodes, spread over all the
+  cores. A gain is feasible when enough episodes succeed, when the error overshoot and the ratio of
+  saturated velocities stay below their limits. The search evaluates constant gains first, then random
+  adaptive gains, and finally refines the best feasible gain.
+
+  The selected gain is saved in a YAML file read by loadGain():
+  \code
+# gain: [gain_at_zero, gain_at_infinity, slope_at_zero]
+rows: 1
+cols: 3
+data:
+  - [2.5, 0.6, 25]
+  \endcode
+  A constant gain is saved with gain_at_zero equal to gain_at_infinity.
+
+  \code
+  vpGainTuner tuner(robot, vpGainTuner::POSITION_BASED);
+  tuner.setCameraParameters(cam, 640, 480);
+  tuner.set_eMc(eMc);
+  tuner.setDesiredPose(cdMo);
+  tuner.setJointPosition(q_desired);
+  if (tuner.tune()) {
+    tuner.saveGain("gain.yaml");
+  }
+  \endcode
+
+*/
+class vpGainTuner
+{
+public:
+  //! Kind of servo to simulate.
+  typedef enum {
+    POSITION_BASED, //!< Pose features vpFeatureTranslation::cdMc and vpFeatureThetaU::cdRc
+    IMAGE_BASED,    //!< The 4 tag corners as vpFeaturePoint
+    HYBRID          //!< 2 1/2 D features of vpServoEngine::HYBRID
+  } vpServoType;
+
+  //! Performance of a gain over all the simulated episodes.
+  struct vpGainScore {
+    double gain_at_zero;
+    double gain_at_infinity;
+    double slope_at_zero;
+    double time;       //!< Mean time to converge in second, the maximal duration for failed episodes
+    double success;    //!< Ratio of converged episodes
+    double overshoot;  //!< Largest overshoot of the error, relative to the initial error
+    double saturation; //!< Mean ratio of saturated velocities
+    bool feasible;
+  };
+
+  vpGainTuner(const vpRobotKawasaki &robot, vpServoType type);
+
+  //! Return the score of the selected gain after tune().
+  const vpGainScore &getBestScore() const { return m_best; }
+  vpAdaptiveGain getBestGain() const;
+
+  static bool loadGain(const std::string &filename, vpAdaptiveGain &lambda);
+  bool saveGain(const std::string &filename) const;
+
+  void setCameraParameters(const vpCameraParameters &cam, unsigned int width, unsigned int height);
+  /*!
+    Set the convergence thresholds used by the servo loop: translation error in meter and rotation error
+    in degree for the position-based and 2 1/2 D servo, sum of the squared errors for the image-based servo in
+    \e threshold_t.
+   */
+  void setConvergenceThreshold(double threshold_t, double threshold_tu = 0)
+  {
+    m_thresholdT = threshold_t;
+    m_thresholdTu = threshold_tu;
+  }
+  //! Set the desired pose of the tag frame in the camera frame.
+  void setDesiredPose(const vpHomogeneousMatrix &cdMo) { m_cdMo = cdMo; }
+  void set_eMc(const vpHomogeneousMatrix &eMc) { m_eMc = eMc; }
+  //! Set the noise of the tag corners in pixel.
+  void setImageNoise(double sigma) { m_noise = sigma; }
+  //! Set the maximal random joint displacement in rad wrt the desired joint positions.
+  void setInitialDisplacement(double amplitude) { m_displacement = amplitude; }
+  //! Set the joint positions in rad when the camera reaches the desired pose.
+  void setJointPosition(const vpColVector &q) { m_q = q; }
+  //! Set the delay in second between the image acquisition and the velocity command.
+  void setLatency(double latency) { m_latency = latency; }
+  //! Set the maximal duration of an episode in second.
+  void setMaxDuration(double duration) { m_maxDuration = duration; }
+  //! Set the largest overshoot of a feasible gain, relative to the initial error.
+  void setMaxOvershoot(double overshoot) { m_maxOvershoot = overshoot; }
+  //! Set the largest mean ratio of saturated velocities of a feasible gain.
+  void setMaxSaturation(double saturation) { m_maxSaturation = saturation; }
+  //! Set the smallest ratio of converged episodes of a feasible gain.
+  void setMinSuccess(double success) { m_minSuccess = success; }
+  //! Set the number of simulated episodes per gain.
+  void setNbEpisodes(unsigned int nb) { m_nbEpisodes = (nb > 0 ? nb : 1); }
+  //! Set the number of random adaptive gains.
+  void setNbCandidates(unsigned int nb) { m_nbCandidates = nb; }
+  //! Set the number of threads, 0 to use all the cores.
+  void setNbThreads(unsigned int nb) { m_nbThreads = nb; }
+  //! Set the period of the servo loop in second.
+  void setSamplingTime(double dt) { m_dt = dt; }
+  void setTagSize(double size) { m_tagSize = size; }
+
+  bool tune();
+
+protected:
+  //! Result of one simulated episode.
+  struct vpEpisodeResult {
+    bool converged;
+    double time;
+    double overshoot;
+    double saturation;
+  };
+
+  void evaluate(std::vector<vpGainScore> &scores);
+  bool initEpisodes();
+  bool isVisible(const vpHomogeneousMatrix &cMo) const;
+  void projectCorners(const vpHomogeneousMatrix &cMo, double x[4], double y[4], double Z[4]) const;
+  vpEpisodeResult simulate(const vpGainScore &gain, unsigned int episode) const;
+
+  const vpRobotKawasaki &m_robot;
+  vpServoType m_type;
+  vpCameraParameters m_cam;
+  unsigned int m_width, m_height;
+  vpHomogeneousMatrix m_eMc;
+  vpHomogeneousMatrix m_cdMo;
+  vpColVector m_q;
+  vpColVector m_qMin, m_qMax;
+  vpHomogeneousMatrix m_fMo;         //!< Tag pose in the robot reference frame
+  double m_tagSize;
+  double m_thresholdT, m_thresholdTu;
+  double m_dt;
+  double m_latency;
+  double m_noise;
+  double m_displacement;
+  double m_maxDuration;
+  double m_maxOvershoot;
+  double m_maxSaturation;
+  double m_minSuccess;
+  unsigned int m_nbEpisodes;
+  unsigned int m_nbCandidates;
+  unsigned int m_nbThreads;
+  std::vector<vpColVector> m_qInit; //!< Initial joint positions of the episodes
+  vpGainScore m_best;
+};
+#endif
@@ -0,0 +1,97 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Jitter of the servo loop period.
+ *
+ *****************************************************************************/
+
+#ifndef vpLoopJitter_h
+#define vpLoopJitter_h
+
+/*!
+  \file vpLoopJitter.h
+  Jitter of the servo loop period.
+*/
+
+#include <string>
+#include <vector>
+
+#include <visp3/core/vpConfig.h>
+
+/*!
+
+  \class vpLoopJitter
+  \brief Measure the period of the servo loop and report its distribution and the deadline misses.
+
+  tick() is called at the start of each iteration. The periods are stored in a buffer reserved by the
+  constructor, so that tick() doesn't allocate in the loop; once the buffer is full, only the mean, the
+  extrema and the deadline misses are updated.
+
+  \code
+  vpLoopJitter jitter(33.);
+  while (servo) {
+    jitter.tick();
+    ...
+  }
+  std::cout << jitter.getReport() << std::endl;
+  \endcode
+
+*/
+class vpLoopJitter
+{
+public:
+  explicit vpLoopJitter(double period = 33., size_t capacity = 100000);
+
+  //! Return the number of measured periods.
+  unsigned int getNbSamples() const { return m_nb; }
+  //! Return the number of periods larger than the deadline.
+  unsigned int getNbMisses() const { return m_nbMisses; }
+  double getPercentile(double p) const;
+  std::string getReport() const;
+
+  void reset();
+  //! Set the period in ms above which an iteration misses its deadline, 1.5 times the period by default.
+  void setDeadline(double deadline) { m_deadline = deadline; }
+
+  void tick();
+  void tick(double t);
+
+protected:
+  double m_period;
+  double m_deadline;
+  std::vector<double> m_samples;
+  double m_tPrev;
+  unsigned int m_nb;
+  unsigned int m_nbMisses;
+  double m_sum, m_sumSquare;
+  double m_min, m_max;
+};
+#endif
@@ -0,0 +1,189 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Metrics of the servo loop: counters, gauges and latency histograms.
+ *
+ *****************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include <visp3/core/vpException.h>
+
+/*!
+  \file vpMetrics.cpp
+  Metrics of the servo loop: counters, gauges and latency histograms.
+*/
+
+#include <vpMetrics.h>
+
+namespace
+{
+const unsigned int linear_buckets = 128; // Exact counts below 128 µs
+const unsigned int sub_buckets = 64;     // Buckets per power of two above
+const unsigned int nb_buckets = linear_buckets + 30 * sub_buckets;
+const uint64_t max_value = (static_cast<uint64_t>(1) << 37) - 1;
+
+unsigned int bucketIndex(uint64_t value)
+{
+  if (value < linear_buckets) {
+    return static_cast<unsigned int>(value);
+  }
+  // Shift so that the value lies in [sub_buckets, 2 * sub_buckets)
+  unsigned int shift = 0;
+  while ((value >> shift) >= 2 * sub_buckets) {
+    shift++;
+  }
+  return linear_buckets + (shift - 1) * sub_buckets + static_cast<unsigned int>((value >> shift) - sub_buckets);
+}
+
+// Middle of the values counted in a bucket, in µs
+double bucketValue(unsigned int index)
+{
+  if (index < linear_buckets) {
+    return index;
+  }
+  unsigned int shift = (index - linear_buckets) / sub_buckets + 1;
+  uint64_t mantissa = (index - linear_buckets) % sub_buckets + sub_buckets;
+  return ((mantissa << shift) + ((mantissa + 1) << shift)) / 2.;
+}
+} // namespace
+
+vpMetricHistogram::vpMetricHistogram()
+  : m_buckets(new std::atomic<uint64_t>[nb_buckets]), m_count(0), m_sum(0), m_max(0)
+{
+  for (unsigned int i = 0; i < nb_buckets; i++) {
+    m_buckets[i].store(0);
+  }
+}
+
+//! Return the largest recorded value in ms.
+double vpMetricHistogram::getMax() const { return m_max.load(std::memory_order_relaxed) / 1000.; }
+
+//! Return the \e p percentile, \e p in [0, 1], of the recorded values in ms.
+double vpMetricHistogram::getPercentile(double p) const
+{
+  uint64_t count = getCount();
+  if (count == 0) {
+    return 0;
+  }
+  uint64_t rank = static_cast<uint64_t>(std::ceil(std::min(1., std::max(0., p)) * count));
+  rank = std::max<uint64_t>(rank, 1);
+  uint64_t cumulated = 0;
+  for (unsigned int i = 0; i < nb_buckets; i++) {
+    cumulated += m_buckets[i].load(std::memory_order_relaxed);
+    if (cumulated >= rank) {
+      return std::min(bucketValue(i), static_cast<double>(m_max.load(std::memory_order_relaxed))) / 1000.;
+    }
+  }
+  return getMax();
+}
+
+//! Return the sum of the recorded values in ms.
+double vpMetricHistogram::getSum() const { return m_sum.load(std::memory_order_relaxed) / 1000.; }
+
+//! Record a value in ms.
+void vpMetricHistogram::record(double value)
+{
+  uint64_t us = (value > 0) ? std::min(static_cast<uint64_t>(value * 1000. + 0.5), max_value) : 0;
+  m_buckets[bucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+  m_sum.fetch_add(us, std::memory_order_relaxed);
+  uint64_t max = m_max.load(std::memory_order_relaxed);
+  while (us > max && !m_max.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+  }
+  m_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+vpMetricsRegistry::vpMetric &vpMetricsRegistry::add(const std::string &name, const std::string &help)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (size_t i = 0; i < m_metrics.size(); i++) {
+    if (m_metrics[i]->name == name) {
+      throw(vpException(vpException::badValue, "Metric %s already exists", name.c_str()));
+    }
+  }
+  m_metrics.push_back(std::unique_ptr<vpMetric>(new vpMetric));
+  m_metrics.back()->name = name;
+  m_metrics.back()->help = help;
+  return *m_metrics.back();
+}
+
+vpMetricCounter &vpMetricsRegistry::addCounter(const std::string &name, const std::string &help)
+{
+  vpMetric &metric = add(name, help);
+  metric.counter.reset(new vpMetricCounter);
+  return *metric.counter;
+}
+
+vpMetricGauge &vpMetricsRegistry::addGauge(const std::string &name, const std::string &help)
+{
+  vpMetric &metric = add(name, help);
+  metric.gauge.reset(new vpMetricGauge);
+  return *metric.gauge;
+}
+
+vpMetricHistogram &vpMetricsRegistry::addHistogram(const std::string &name, const std::string &help)
+{
+  vpMetric &metric = add(name, help);
+  metric.histogram.reset(new vpMetricHistogram);
+  return *metric.histogram;
+}
+
+/*!
+  Return the metrics in the Prometheus text format. The histograms are exported as summaries with their
+  median, 90, 99 and 99.9 percentiles, and their maximum as a gauge.
+ */
+std::string vpMetricsRegistry::getText() const
+{
+  const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+  std::stringstream ss;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (size_t i = 0; i < m_metrics.size(); i++) {
+    const vpMetric &metric = *m_metrics[i];
+    ss << "# HELP " << metric.name << " " << metric.help << "\n";
+    if (metric.counter) {
+      ss << "# TYPE " << metric.name << " counter\n" << metric.name << " " << metric.counter->get() << "\n";
+    } else if (metric.gauge) {
+      ss << "# TYPE " << metric.name << " gauge\n" << metric.name << " " << metric.gauge->get() << "\n";
+    } else if (metric.histogram) {
+      const vpMetricHistogram &histogram = *metric.histogram;
+      ss << "# TYPE " << metric.name << " summary\n";
+      for (size_t j = 0; j < sizeof(quantiles) / sizeof(quantiles[0]); j++) {
+        ss << metric.name << "{quantile=\"" << quantiles[j] << "\"} " << histogram.getPercentile(quantiles[j]) << "\n";
+      }
+      ss << metric.name << "_sum " << histogram.getSum() << "\n";
+      ss << metric.name << "_count " << histogram.getCount() << "\n";
+      ss << "# TYPE " << metric.name << "_max gauge\n" << metric.name << "_max " << histogram.getMax() << "\n";
+    }
+  }
+  return ss.str();
+}
@@ -0,0 +1,161 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Metrics of the servo loop: counters, gauges and latency histograms.
+ *
+ *****************************************************************************/
+
+#ifndef vpMetrics_h
+#define vpMetrics_h
+
+/*!
+  \file vpMetrics.h
+  Metrics of the servo loop: counters, gauges and latency histograms.
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <visp3/core/vpConfig.h>
+
+/*!
+
+  \class vpMetricCounter
+  \brief Monotonic counter, incremented without lock from any thread.
+
+*/
+class vpMetricCounter
+{
+public:
+  vpMetricCounter() : m_value(0) {}
+
+  uint64_t get() const { return m_value.load(std::memory_order_relaxed); }
+  void inc(uint64_t n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+
+protected:
+  std::atomic<uint64_t> m_value;
+};
+
+/*!
+
+  \class vpMetricGauge
+  \brief Last value of a quantity, set without lock from any thread.
+
+*/
+class vpMetricGauge
+{
+public:
+  vpMetricGauge() : m_value(0) {}
+
+  double get() const { return m_value.load(std::memory_order_relaxed); }
+  void set(double value) { m_value.store(value, std::memory_order_relaxed); }
+
+protected:
+  std::atomic<double> m_value;
+};
+
+/*!
+
+  \class vpMetricHistogram
+  \brief High dynamic range histogram of latencies in ms, recorded without lock from any thread.
+
+  The values are counted in µs in log-linear buckets, like HdrHistogram: exact up to 128 µs, then 64 buckets
+  per power of two, so that the percentiles have a relative error below 1.6% from 1 µs to 38 hours.
+
+*/
+class vpMetricHistogram
+{
+public:
+  vpMetricHistogram();
+
+  uint64_t getCount() const { return m_count.load(std::memory_order_relaxed); }
+  double getMax() const;
+  double getPercentile(double p) const;
+  double getSum() const;
+  void record(double value);
+
+protected:
+  std::unique_ptr<std::atomic<uint64_t>[]> m_buckets;
+  std::atomic<uint64_t> m_count;
+  std::atomic<uint64_t> m_sum; //!< In µs
+  std::atomic<uint64_t> m_max; //!< In µs
+};
+
+/*!
+
+  \class vpMetricsRegistry
+  \brief Named metrics of the servo, exported in the Prometheus text format by vpMetricsServer.
+
+  The metrics are added before the loop, which keeps the returned references: recording a value is then an
+  atomic operation, without lock nor allocation. getText() can be called from another thread.
+
+  \code
+  vpMetricsRegistry metrics;
+  vpMetricHistogram &metric_detection = metrics.addHistogram("servo_detection_ms", "Detection time");
+  vpMetricsServer server(metrics);
+  server.start(9100);
+  while (servo) {
+    double t = vpTime::measureTimeMs();
+    detector.detect(I);
+    metric_detection.record(vpTime::measureTimeMs() - t);
+  }
+  \endcode
+
+*/
+class vpMetricsRegistry
+{
+public:
+  vpMetricCounter &addCounter(const std::string &name, const std::string &help);
+  vpMetricGauge &addGauge(const std::string &name, const std::string &help);
+  vpMetricHistogram &addHistogram(const std::string &name, const std::string &help);
+
+  std::string getText() const;
+
+protected:
+  //! Registered metric, only one of the pointers is set.
+  struct vpMetric {
+    std::string name;
+    std::string help;
+    std::unique_ptr<vpMetricCounter> counter;
+    std::unique_ptr<vpMetricGauge> gauge;
+    std::unique_ptr<vpMetricHistogram> histogram;
+  };
+
+  vpMetric &add(const std::string &name, const std::string &help);
+
+  mutable std::mutex m_mutex; //!< Protects the list of metrics, not their values
+  std::vector<std::unique_ptr<vpMetric> > m_metrics;
+};
+#endif
@@ -0,0 +1,333 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Shared-memory mailbox between the servo and the motion processes.
+ *
+ *****************************************************************************/
+
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <thread>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <visp3/core/vpConfig.h>
+#include <visp3/core/vpException.h>
+
+/*!
+  \file vpMotionMailbox.cpp
+  Shared-memory mailbox between the servo and the motion processes.
+*/
+
+#include <vpMotionMailbox.h>
+
+namespace
+{
+const uint32_t mailbox_magic = 0x4b574d42; // "KWMB"
+const uint32_t mailbox_version = 1;
+// Number of copies before giving up when the writer is in the middle of a write
+const int max_read_attempts = 100;
+
+// Start of a write protected by the sequence counter, the counter is odd until endWrite(). The counter is set
+// odd rather than incremented, so that a writer restarted after a crash in the middle of a write does not invert
+// the parity.
+void beginWrite(std::atomic<uint32_t> &sequence)
+{
+  sequence.store(sequence.load(std::memory_order_relaxed) | 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+void endWrite(std::atomic<uint32_t> &sequence)
+{
+  sequence.store((sequence.load(std::memory_order_relaxed) | 1) + 1, std::memory_order_release);
+}
+} // namespace
+
+/*!
+  Layout of the shared memory. Each group of fields is written by a single process and lies on its own cache
+  line. Only lock-free atomics are used, so that they work between processes.
+ */
+struct vpMotionMailbox::vpSharedData {
+  std::atomic<uint32_t> magic;
+  uint32_t version;
+
+  // Written by the servo process
+  alignas(64) std::atomic<uint32_t> setPointSequence;
+  std::atomic<int32_t> setPointFrame;
+  std::atomic<double> setPointVelocity[6];
+  std::atomic<int32_t> requestedState;
+
+  // Written by the motion process
+  alignas(64) std::atomic<uint32_t> stateSequence;
+  std::atomic<double> q[6];
+  std::atomic<int32_t> robotState;
+  std::atomic<int32_t> rampingDown;
+  std::atomic<uint32_t> heartbeat;
+
+  vpSharedData()
+    : magic(0), version(mailbox_version), setPointSequence(0), setPointFrame(vpRobot::END_EFFECTOR_FRAME),
+      requestedState(vpRobot::STATE_STOP), stateSequence(0), robotState(vpRobot::STATE_STOP), rampingDown(0),
+      heartbeat(0)
+  {
+    for (int i = 0; i < 6; i++) {
+      setPointVelocity[i].store(0);
+      q[i].store(0);
+    }
+  }
+};
+
+// An atomic that is not lock-free uses a lock of this process only, that the other process doesn't see
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "The 32-bit atomics of the mailbox have to be lock-free");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && sizeof(double) == sizeof(long long),
+              "The 64-bit atomics of the mailbox have to be lock-free");
+
+vpMotionMailbox::vpMotionMailbox() : m_data(nullptr), m_owner(false), m_name(), m_handle(nullptr), m_fd(-1) {}
+
+vpMotionMailbox::~vpMotionMailbox() { close(); }
+
+/*!
+  Unmap the shared memory. The motion process that created the mailbox also removes it.
+ */
+void vpMotionMailbox::close()
+{
+#if defined(_WIN32)
+  if (m_data != nullptr) {
+    UnmapViewOfFile(m_data);
+  }
+  if (m_handle != nullptr) {
+    CloseHandle(m_handle);
+  }
+#elif defined(__linux__)
+  if (m_data != nullptr) {
+    munmap(m_data, sizeof(vpSharedData));
+  }
+  if (m_fd >= 0) {
+    ::close(m_fd);
+    if (m_owner) {
+      shm_unlink(m_name.c_str());
+    }
+  }
+#endif
+  m_data = nullptr;
+  m_handle = nullptr;
+  m_fd = -1;
+  m_owner = false;
+}
+
+/*!
+  Create the mailbox, called by the motion process.
+
+  \return false if the shared memory can not be created.
+ */
+bool vpMotionMailbox::create(const std::string &name)
+{
+  close();
+  if (!map(name, true)) {
+    return false;
+  }
+  m_owner = true;
+  new (m_data) vpSharedData;
+  // The servo process opens the mailbox once it is initialized
+  m_data->magic.store(mailbox_magic, std::memory_order_release);
+  return true;
+}
+
+//! Return the robot state requested by the servo process.
+vpRobot::vpRobotStateType vpMotionMailbox::getRequestedRobotState() const
+{
+  return static_cast<vpRobot::vpRobotStateType>(m_data->requestedState.load(std::memory_order_acquire));
+}
+
+bool vpMotionMailbox::map(const std::string &name, bool create)
+{
+  // The macros don't cover std::atomic<double>
+  if (!std::atomic<double>().is_lock_free()) {
+    throw(vpException(vpException::notImplementedError, "std::atomic<double> is not lock-free on this platform"));
+  }
+#if defined(_WIN32)
+  std::string path = "Local\\" + name;
+  if (create) {
+    m_handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(vpSharedData),
+                                  path.c_str());
+  } else {
+    m_handle = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, path.c_str());
+  }
+  if (m_handle == nullptr) {
+    return false;
+  }
+  void *data = MapViewOfFile(m_handle, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(vpSharedData));
+  if (data == nullptr) {
+    close();
+    return false;
+  }
+#elif defined(__linux__)
+  m_name = "/" + name;
+  m_fd = shm_open(m_name.c_str(), create ? (O_CREAT | O_RDWR) : O_RDWR, 0600);
+  if (m_fd < 0 || (create && ftruncate(m_fd, sizeof(vpSharedData)) != 0)) {
+    close();
+    return false;
+  }
+  void *data = mmap(nullptr, sizeof(vpSharedData), PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+  if (data == MAP_FAILED) {
+    close();
+    return false;
+  }
+#else
+  (void)name;
+  (void)create;
+  void *data = nullptr;
+  throw(vpException(vpException::notImplementedError, "Shared memory is not supported on this platform"));
+#endif
+  m_data = static_cast<vpSharedData *>(data);
+  return true;
+}
+
+/*!
+  Open the mailbox created by the motion process, called by the servo process.
+
+  \return false if the motion process is not running.
+ */
+bool vpMotionMailbox::open(const std::string &name)
+{
+  close();
+  if (!map(name, false)) {
+    return false;
+  }
+  if (m_data->magic.load(std::memory_order_acquire) != mailbox_magic || m_data->version != mailbox_version) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+/*!
+  Read the last set-point of the servo process.
+
+  \return false if the servo process is in the middle of a write, or stalled or crashed in it.
+ */
+bool vpMotionMailbox::readSetPoint(vpSetPoint &set_point) const
+{
+  for (int attempt = 0; attempt < max_read_attempts; attempt++) {
+    uint32_t begin = m_data->setPointSequence.load(std::memory_order_acquire);
+    if (begin & 1) {
+      std::this_thread::yield();
+      continue;
+    }
+    set_point.frame = static_cast<vpRobot::vpControlFrameType>(m_data->setPointFrame.load(std::memory_order_relaxed));
+    for (int i = 0; i < 6; i++) {
+      set_point.velocity[i] = m_data->setPointVelocity[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (m_data->setPointSequence.load(std::memory_order_relaxed) == begin) {
+      set_point.sequence = begin / 2;
+      return true;
+    }
+  }
+  return false;
+}
+
+/*!
+  Read the last state published by the motion process.
+
+  \return false if the motion process is in the middle of a write, or stalled or crashed in it.
+ */
+bool vpMotionMailbox::readState(vpMotionState &state) const
+{
+  for (int attempt = 0; attempt < max_read_attempts; attempt++) {
+    uint32_t begin = m_data->stateSequence.load(std::memory_order_acquire);
+    if (begin & 1) {
+      std::this_thread::yield();
+      continue;
+    }
+    for (int i = 0; i < 6; i++) {
+      state.q[i] = m_data->q[i].load(std::memory_order_relaxed);
+    }
+    state.robotState = static_cast<vpRobot::vpRobotStateType>(m_data->robotState.load(std::memory_order_relaxed));
+    state.rampingDown = m_data->rampingDown.load(std::memory_order_relaxed) != 0;
+    state.heartbeat = m_data->heartbeat.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (m_data->stateSequence.load(std::memory_order_relaxed) == begin) {
+      return true;
+    }
+  }
+  return false;
+}
+
+//! Request a robot state to the motion process, that publishes it in vpMotionState::robotState once reached.
+void vpMotionMailbox::requestRobotState(vpRobot::vpRobotStateType state)
+{
+  m_data->requestedState.store(state, std::memory_order_release);
+}
+
+/*!
+  Write a velocity set-point, called by the servo process.
+
+  \param frame : vpRobot::END_EFFECTOR_FRAME for a velocity twist of the end-effector, or vpRobot::JOINT_STATE.
+  \param velocity : 6-dim velocity in m/s and rad/s.
+ */
+void vpMotionMailbox::writeSetPoint(vpRobot::vpControlFrameType frame, const vpColVector &velocity)
+{
+  if (velocity.size() != 6) {
+    throw(vpException(vpException::dimensionError, "Cannot write a set-point that is not 6-dim (%d)",
+                      velocity.size()));
+  }
+  beginWrite(m_data->setPointSequence);
+  m_data->setPointFrame.store(frame, std::memory_order_relaxed);
+  for (unsigned int i = 0; i < 6; i++) {
+    m_data->setPointVelocity[i].store(velocity[i], std::memory_order_relaxed);
+  }
+  endWrite(m_data->setPointSequence);
+}
+
+/*!
+  Publish the state of the robot, called by the motion process at each period. The heartbeat is incremented.
+ */
+void vpMotionMailbox::writeState(const vpMotionState &state)
+{
+  beginWrite(m_data->stateSequence);
+  for (int i = 0; i < 6; i++) {
+    m_data->q[i].store(state.q[i], std::memory_order_relaxed);
+  }
+  m_data->robotState.store(state.robotState, std::memory_order_relaxed);
+  m_data->rampingDown.store(state.rampingDown ? 1 : 0, std::memory_order_relaxed);
+  m_data->heartbeat.store(m_data->heartbeat.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  endWrite(m_data->stateSequence);
+}
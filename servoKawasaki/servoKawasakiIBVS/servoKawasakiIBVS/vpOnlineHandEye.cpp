@@ -0,0 +1,351 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Online refinement of the hand-eye transformation during the servo.
+ *
+ *****************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <visp3/core/vpConfig.h>
+#include <visp3/core/vpExponentialMap.h>
+#include <visp3/core/vpMath.h>
+#include <visp3/core/vpMatrix.h>
+#include <visp3/core/vpVelocityTwistMatrix.h>
+
+/*!
+  \file vpOnlineHandEye.cpp
+  Online refinement of the hand-eye transformation during the servo.
+*/
+
+#include <vpOnlineHandEye.h>
+#include <vpTrace.h>
+
+namespace
+{
+const unsigned int min_samples = 6;
+const unsigned int max_iterations = 5;
+const double huber_threshold = 2.;   // Normalized pose error above which a pair is down-weighted
+const double tag_moved_threshold = 20.; // Normalized pose error above which the tag is considered as moved
+
+// Run the calling thread only when the cores are idle
+void lowerPriority()
+{
+#if defined(_WIN32)
+  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#elif defined(__linux__)
+  sched_param param;
+  param.sched_priority = 0;
+  pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+}
+} // namespace
+
+/*!
+  Create the estimator of the camera mounted on \e robot. The robot must exist until stop().
+ */
+vpOnlineHandEye::vpOnlineHandEye(vpRobotKawasaki &robot)
+  : m_robot(robot), m_mutex(), m_condition(), m_thread(), m_running(false), m_reset(false), m_pending(),
+    m_processing(), m_window(), m_eMc(), m_fMo(), m_hasTagPose(false), m_nbUpdates(0), m_nbSamples(0),
+    m_windowSize(50), m_minMotionT(0.01), m_minMotionTu(vpMath::rad(2)), m_sigmaT(0.002), m_sigmaTu(vpMath::rad(0.5)),
+    m_maxSigmaT(0.0005), m_maxSigmaTu(vpMath::rad(0.05)), m_maxStepT(0.0005), m_maxStepTu(vpMath::rad(0.05)),
+    m_residualT(0), m_residualTu(0)
+{
+}
+
+vpOnlineHandEye::~vpOnlineHandEye() { stop(); }
+
+/*!
+  Give a new pair to the estimator thread.
+
+  \param[in] q : Joint positions in rad, read when the image is acquired.
+  \param[in] cMo : Measured tag pose in this image, not a prediction.
+ */
+void vpOnlineHandEye::addMeasurement(const vpColVector &q, const vpHomogeneousMatrix &cMo)
+{
+  vpSample sample;
+  m_robot.get_fMe(q, sample.fMe);
+  sample.cMo = cMo;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_running) {
+    return;
+  }
+  // Keep the most recent pairs if the thread is late
+  if (m_pending.size() >= m_windowSize) {
+    m_pending.erase(m_pending.begin());
+  }
+  m_pending.push_back(sample);
+  m_condition.notify_one();
+}
+
+//! Return the last eMc given to the robot.
+vpHomogeneousMatrix vpOnlineHandEye::get_eMc() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_eMc;
+}
+
+// Add a pair to the window if the end-effector moved enough, clear the window if the tag moved
+bool vpOnlineHandEye::pushSample(const vpSample &sample)
+{
+  if (!m_window.empty()) {
+    vpHomogeneousMatrix eMe = m_window.back().fMe.inverse() * sample.fMe;
+    if (std::sqrt(eMe.getTranslationVector().sumSquare()) < m_minMotionT &&
+        std::sqrt(eMe.getThetaUVector().sumSquare()) < m_minMotionTu) {
+      return false;
+    }
+  }
+
+  vpHomogeneousMatrix fMo = sample.fMe * m_eMc * sample.cMo;
+  if (m_hasTagPose) {
+    vpHomogeneousMatrix oMo = m_fMo.inverse() * fMo;
+    if (std::sqrt(oMo.getTranslationVector().sumSquare()) > tag_moved_threshold * m_sigmaT ||
+        std::sqrt(oMo.getThetaUVector().sumSquare()) > tag_moved_threshold * m_sigmaTu) {
+      m_window.clear();
+      m_hasTagPose = false;
+    }
+  }
+  if (!m_hasTagPose) {
+    m_fMo = fMo;
+    m_hasTagPose = true;
+  }
+
+  m_window.push_back(sample);
+  if (m_window.size() > m_windowSize) {
+    m_window.pop_front();
+  }
+  return true;
+}
+
+/*!
+  Gauss-Newton refinement of eMc and fMo over the window, then bounded update of the robot.
+
+  \return true if the robot eMc is updated.
+ */
+bool vpOnlineHandEye::refine()
+{
+  vpHomogeneousMatrix eMc = m_eMc, fMo = m_fMo;
+  vpColVector W(6); // Inverse variances of the pose errors
+  for (unsigned int k = 0; k < 3; k++) {
+    W[k] = 1. / (m_sigmaT * m_sigmaT);
+    W[k + 3] = 1. / (m_sigmaTu * m_sigmaTu);
+  }
+
+  // Error r = log(fMo^-1 fMe eMc cMo) with eMc = eMc exp(dc) and fMo = fMo exp(do)
+  vpMatrix H_inv;
+  double sum_t = 0, sum_tu = 0;
+  for (unsigned int iter = 0; iter < max_iterations; iter++) {
+    vpMatrix H(12, 12);
+    vpColVector g(12);
+    sum_t = 0;
+    sum_tu = 0;
+    for (size_t i = 0; i < m_window.size(); i++) {
+      const vpSample &sample = m_window[i];
+      vpHomogeneousMatrix T = fMo.inverse() * sample.fMe * eMc * sample.cMo;
+      vpColVector r = vpExponentialMap::inverse(T);
+      vpMatrix J(6, 12);
+      J.insert(vpMatrix(vpVelocityTwistMatrix(sample.cMo.inverse())), 0, 0);
+      J.insert(-vpMatrix(vpVelocityTwistMatrix(T.inverse())), 0, 6);
+
+      // Huber weight of the pair
+      double s = 0;
+      for (unsigned int k = 0; k < 6; k++) {
+        s += W[k] * r[k] * r[k];
+      }
+      s = std::sqrt(s / 6.);
+      const double w = (s > huber_threshold) ? huber_threshold / s : 1.;
+      for (unsigned int a = 0; a < 12; a++) {
+        for (unsigned int k = 0; k < 6; k++) {
+          const double wJ = w * W[k] * J[k][a];
+          for (unsigned int b = a; b < 12; b++) {
+            H[a][b] += wJ * J[k][b];
+          }
+          g[a] += wJ * r[k];
+        }
+      }
+      sum_t += r[0] * r[0] + r[1] * r[1] + r[2] * r[2];
+      sum_tu += r[3] * r[3] + r[4] * r[4] + r[5] * r[5];
+    }
+    for (unsigned int a = 0; a < 12; a++) {
+      for (unsigned int b = 0; b < a; b++) {
+        H[a][b] = H[b][a];
+      }
+    }
+
+    // eMc and fMo are unobservable until the window contains rotations around two different axes
+    if (H.pseudoInverse(H_inv, 1e-12) < 12) {
+      return false;
+    }
+    vpColVector delta = -(H_inv * g);
+    vpColVector dc(6), d_o(6);
+    for (unsigned int k = 0; k < 6; k++) {
+      dc[k] = delta[k];
+      d_o[k] = delta[k + 6];
+    }
+    eMc = eMc * vpExponentialMap::direct(dc);
+    fMo = fMo * vpExponentialMap::direct(d_o);
+    if (dc.frobeniusNorm() < 1e-7 && d_o.frobeniusNorm() < 1e-7) {
+      break;
+    }
+  }
+  m_fMo = fMo;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_residualT = std::sqrt(sum_t / (3 * m_window.size()));
+    m_residualTu = std::sqrt(sum_tu / (3 * m_window.size()));
+  }
+
+  // Standard deviations of eMc from the normal equations
+  double var_t = 0, var_tu = 0;
+  for (unsigned int k = 0; k < 3; k++) {
+    var_t = std::max(var_t, H_inv[k][k]);
+    var_tu = std::max(var_tu, H_inv[k + 3][k + 3]);
+  }
+  if (std::sqrt(var_t) > m_maxSigmaT || std::sqrt(var_tu) > m_maxSigmaTu) {
+    return false;
+  }
+
+  // Bounded step from the eMc used by the robot
+  vpColVector step = vpExponentialMap::inverse(m_eMc.inverse() * eMc);
+  double step_t = std::sqrt(step[0] * step[0] + step[1] * step[1] + step[2] * step[2]);
+  double step_tu = std::sqrt(step[3] * step[3] + step[4] * step[4] + step[5] * step[5]);
+  double scale = 1.;
+  if (step_t > m_maxStepT) {
+    scale = std::min(scale, m_maxStepT / step_t);
+  }
+  if (step_tu > m_maxStepTu) {
+    scale = std::min(scale, m_maxStepTu / step_tu);
+  }
+  vpHomogeneousMatrix eMc_new = m_eMc * vpExponentialMap::direct(scale * step);
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_eMc = eMc_new;
+  }
+  m_robot.set_eMc(eMc_new);
+  m_nbUpdates++;
+  return true;
+}
+
+/*!
+  Clear the window, to call when the tag is lost since it may be moved before being found again.
+ */
+void vpOnlineHandEye::reset()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_pending.clear();
+  m_reset = true;
+  m_condition.notify_one();
+}
+
+// Loop of the estimator thread
+void vpOnlineHandEye::run()
+{
+  lowerPriority();
+  VP_TRACE_THREAD("hand-eye");
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (m_running) {
+    m_condition.wait(lock, [this] { return !m_running || m_reset || !m_pending.empty(); });
+    if (!m_running) {
+      break;
+    }
+    // The pending pairs are taken with their buffer, the next ones reuse the one of the processed pairs
+    m_processing.clear();
+    m_processing.swap(m_pending);
+    bool reset = m_reset;
+    m_reset = false;
+    lock.unlock();
+
+    if (reset) {
+      m_window.clear();
+      m_hasTagPose = false;
+    }
+    bool changed = false;
+    for (size_t i = 0; i < m_processing.size(); i++) {
+      changed = pushSample(m_processing[i]) || changed;
+    }
+    m_nbSamples = static_cast<unsigned int>(m_window.size());
+    if (changed && m_window.size() >= min_samples) {
+      VP_TRACE_SCOPE("hand-eye refine");
+      refine();
+    }
+
+    lock.lock();
+  }
+}
+
+/*!
+  Start the estimator thread from the eMc used by the robot.
+ */
+void vpOnlineHandEye::start(const vpHomogeneousMatrix &eMc)
+{
+  stop();
+  m_eMc = eMc;
+  m_window.clear();
+  m_pending.clear();
+  m_pending.reserve(m_windowSize);
+  m_processing.clear();
+  m_processing.reserve(m_windowSize);
+  m_hasTagPose = false;
+  m_reset = false;
+  m_nbUpdates = 0;
+  m_nbSamples = 0;
+  m_running = true;
+  m_thread = std::thread(&vpOnlineHandEye::run, this);
+}
+
+/*!
+  Stop the estimator thread. The robot keeps the last eMc.
+ */
+void vpOnlineHandEye::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_running = false;
+    m_condition.notify_one();
+  }
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
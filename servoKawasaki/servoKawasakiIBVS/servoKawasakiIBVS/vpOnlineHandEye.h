@@ -0,0 +1,176 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Online refinement of the hand-eye transformation during the servo.
+ *
+ *****************************************************************************/
+
+#ifndef vpOnlineHandEye_h
+#define vpOnlineHandEye_h
+
+/*!
+  \file vpOnlineHandEye.h
+  Online refinement of the hand-eye transformation during the servo.
+*/
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <visp3/core/vpConfig.h>
+
+#include <visp3/core/vpColVector.h>
+#include <visp3/core/vpHomogeneousMatrix.h>
+
+#include <vpRobotKawasaki.h>
+
+/*!
+
+  \class vpOnlineHandEye
+  \brief Refine the camera pose in the end-effector frame eMc from the tag poses measured during the servo.
+
+  While the tag doesn't move, \f${^f}{\bf M}_o = {^f}{\bf M}_e\; {^e}{\bf M}_c\; {^c}{\bf M}_o\f$ is constant
+  for all the pairs of robot pose and tag pose. The pairs given to addMeasurement() are kept in a bounded
+  sliding window, a new pair being kept only when the end-effector moved enough since the last one. Each time
+  the window changes, a low priority thread refines eMc and the tag pose fMo by a few Gauss-Newton iterations
+  over the window, starting from the current estimate, with robust weights on the pose errors of the pairs.
+
+  A new estimate is given to vpRobotKawasaki::set_eMc() only if the window constrains all the directions of eMc,
+  i.e. if the standard deviations of eMc computed from the normal equations are below setMaxUncertainty(). The
+  change of eMc applied by an update is bounded by setMaxStep(), so that the servo sees small steps only.
+
+  The window is cleared when a pair doesn't match the current tag pose, i.e. when the tag has been moved, and
+  it should be cleared with reset() when the tag is lost.
+
+  \code
+  vpOnlineHandEye hand_eye(robot);
+  hand_eye.start(eMc);
+  while (servo) {
+    robot.getPosition(vpRobot::JOINT_STATE, q); // At the image acquisition
+    ...
+    hand_eye.addMeasurement(q, cMo);
+    if (hand_eye.getNbUpdates() != nb_updates) {
+      eMc = hand_eye.get_eMc(); // Already used by the robot
+    }
+  }
+  hand_eye.stop();
+  \endcode
+
+*/
+class vpOnlineHandEye
+{
+public:
+  explicit vpOnlineHandEye(vpRobotKawasaki &robot);
+  virtual ~vpOnlineHandEye();
+
+  void addMeasurement(const vpColVector &q, const vpHomogeneousMatrix &cMo);
+
+  vpHomogeneousMatrix get_eMc() const;
+  //! Return the number of eMc updates sent to the robot since start().
+  unsigned int getNbUpdates() const { return m_nbUpdates; }
+  //! Return the number of pairs in the window.
+  unsigned int getNbSamples() const { return m_nbSamples; }
+  //! Return the RMS translation error in meter and rotation error in rad of the pairs at the last update.
+  void getResidual(double &error_t, double &error_tu) const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    error_t = m_residualT;
+    error_tu = m_residualTu;
+  }
+
+  void reset();
+
+  //! Set the largest translation in meter and rotation in rad applied to eMc by one update.
+  void setMaxStep(double step_t, double step_tu)
+  {
+    m_maxStepT = step_t;
+    m_maxStepTu = step_tu;
+  }
+  //! Set the largest standard deviation in meter and rad of eMc to update the robot.
+  void setMaxUncertainty(double sigma_t, double sigma_tu)
+  {
+    m_maxSigmaT = sigma_t;
+    m_maxSigmaTu = sigma_tu;
+  }
+  //! Set the smallest end-effector motion in meter and rad between two pairs of the window.
+  void setMinMotion(double motion_t, double motion_tu)
+  {
+    m_minMotionT = motion_t;
+    m_minMotionTu = motion_tu;
+  }
+  //! Set the noise of the tag pose in meter and rad, used to weight the pairs.
+  void setNoise(double sigma_t, double sigma_tu)
+  {
+    m_sigmaT = sigma_t;
+    m_sigmaTu = sigma_tu;
+  }
+  //! Set the number of pairs of the window.
+  void setWindowSize(unsigned int size) { m_windowSize = (size > 3 ? size : 3); }
+
+  void start(const vpHomogeneousMatrix &eMc);
+  void stop();
+
+protected:
+  //! Robot pose and tag pose measured at the same time.
+  struct vpSample {
+    vpHomogeneousMatrix fMe;
+    vpHomogeneousMatrix cMo;
+  };
+
+  bool pushSample(const vpSample &sample);
+  bool refine();
+  void run();
+
+  vpRobotKawasaki &m_robot;
+  mutable std::mutex m_mutex; //!< Protects the pending pairs, the estimate and the residuals
+  std::condition_variable m_condition;
+  std::thread m_thread;
+  bool m_running;
+  bool m_reset;
+  std::vector<vpSample> m_pending; //!< Pairs not yet processed by the thread
+  std::vector<vpSample> m_processing; //!< Pairs being processed by the thread
+  std::deque<vpSample> m_window;   //!< Only used by the thread
+  vpHomogeneousMatrix m_eMc;
+  vpHomogeneousMatrix m_fMo;
+  bool m_hasTagPose;
+  std::atomic<unsigned int> m_nbUpdates;
+  std::atomic<unsigned int> m_nbSamples;
+  unsigned int m_windowSize;
+  double m_minMotionT, m_minMotionTu;
+  double m_sigmaT, m_sigmaTu;
+  double m_maxSigmaT, m_maxSigmaTu;
+  double m_maxStepT, m_maxStepTu;
+  double m_residualT, m_residualTu;
+};
+#endif
@@ -0,0 +1,561 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Visual servo task shared by the servo examples.
+ *
+ *****************************************************************************/
+
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <sstream>
+
+#include <visp3/core/vpConfig.h>
+#include <visp3/core/vpException.h>
+#include <visp3/core/vpThetaUVector.h>
+#include <visp3/core/vpTime.h>
+#include <visp3/core/vpTranslationVector.h>
+#include <visp3/vs/vpServoDisplay.h>
+
+/*!
+  \file vpServoEngine.cpp
+  Visual servo task shared by the servo examples.
+*/
+
+#include <vpServoEngine.h>
+
+/*!
+  Default constructor: eye-in-hand task in the camera frame with the current interaction matrix.
+  init() has to be called once to set the features.
+ */
+vpServoEngine::vpServoEngine()
+  : m_mode(POSITION_BASED), m_fixed(false), m_jointSpace(false), m_cVe(), m_task(), m_fixed6(), m_fixed8(),
+    m_points(), m_center(), m_cdMo(), m_cdMc(), m_taskUpdated(true), m_cP(4), m_xy(3),
+    m_t(vpFeatureTranslation::cdMc), m_td(vpFeatureTranslation::cdMc), m_tu(vpFeatureThetaU::cdRc),
+    m_tud(vpFeatureThetaU::cdRc), m_p(), m_pd(), m_c(), m_cd(), m_logZ(), m_logZd(), m_Zd(1.)
+{
+  m_task.setServo(vpServo::EYEINHAND_CAMERA);
+  m_task.setInteractionMatrixType(vpServo::CURRENT);
+}
+
+vpServoEngine::~vpServoEngine() { m_task.kill(); }
+
+/*!
+  Compare offline the velocities of the fixed control law with the ones of vpServo::computeControlLaw(), for
+  the POSITION_BASED, IMAGE_BASED and HYBRID features. The camera is placed at the desired pose, where the
+  error is null, then at random poses around it, every tenth one being rotated by nearly PI around the
+  optical axis. The poses alternate the camera frame and the joint space with a random robot Jacobian, the
+  constant and the adaptive gain, with and without the task sequencing.
+
+  A velocity passes if \f$\|{\bf v} - {\bf v}_{servo}\|_\infty \le \epsilon\,(1 + \|{\bf v}_{servo}\|_\infty)\f$.
+  The largest difference, the number of failures and the mean time of both laws are printed per mode.
+
+  \param[out] os : Output stream of the results.
+  \param[in] points : The 4 target points in the target frame.
+  \param[in] cdMo : Desired pose of the target frame in the camera frame.
+  \param[in] nb_poses : Number of random poses per mode.
+  \param[in] tolerance : Relative tolerance \f$\epsilon\f$.
+  \return true if all the velocities pass.
+ */
+bool vpServoEngine::checkFixedControlLaw(std::ostream &os, const std::vector<vpPoint> &points,
+                                         const vpHomogeneousMatrix &cdMo, unsigned int nb_poses, double tolerance)
+{
+  const vpServoMode modes[3] = {POSITION_BASED, IMAGE_BASED, HYBRID};
+  const double depth = cdMo[2][3];
+  const vpVelocityTwistMatrix cVe(vpHomogeneousMatrix(0, 0, 0.1, 0, 0, 0).inverse());
+  vpAdaptiveGain adaptive_gain;
+  adaptive_gain.initStandard(3, 0.4, 30);
+
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> uniform(-1, 1);
+  bool ok = true;
+
+  for (unsigned int m = 0; m < 3; m++) {
+    double diff_max = 0, t_fixed = 0, t_servo = 0;
+    unsigned int nb_failed = 0;
+    for (unsigned int k = 0; k <= nb_poses; k++) {
+      const bool joint_space = (k % 2 == 1), task_sequencing = (k / 2 % 2 == 1), adaptive = (k / 4 % 2 == 1);
+
+      vpServoEngine engine;
+      engine.init(modes[m], points);
+      engine.setFixedControlLaw(true);
+      if (adaptive) {
+        engine.setLambda(adaptive_gain);
+      } else {
+        engine.setLambda(0.8);
+      }
+      engine.setDesiredPose(cdMo);
+      if (joint_space) {
+        vpMatrix eJe(6, 6);
+        for (unsigned int i = 0; i < 6; i++) {
+          for (unsigned int j = 0; j < 6; j++) {
+            eJe[i][j] = (i == j ? 1. : 0.) + 0.3 * uniform(rng);
+          }
+        }
+        engine.setJointSpace(cVe);
+        engine.set_eJe(eJe);
+      }
+
+      // Pose of the current camera frame in the desired one
+      vpHomogeneousMatrix cdMc;
+      if (k > 0 && k % 10 == 0) {
+        const double theta = (M_PI - 0.001 * std::fabs(uniform(rng))) * (uniform(rng) < 0 ? -1 : 1);
+        cdMc.buildFrom(vpTranslationVector(0.1 * depth * uniform(rng), 0.1 * depth * uniform(rng), 0),
+                       vpThetaUVector(0, 0, theta));
+      } else if (k > 0) {
+        cdMc.buildFrom(vpTranslationVector(0.2 * depth * uniform(rng), 0.2 * depth * uniform(rng),
+                                           0.2 * depth * uniform(rng)),
+                       vpThetaUVector(0.3 * uniform(rng), 0.3 * uniform(rng), 0.3 * uniform(rng)));
+      }
+
+      vpColVector v, v_servo, error;
+      double t = 0;
+      if (task_sequencing) {
+        // The initial term of both laws is taken at the desired pose shifted along the optical axis
+        engine.setPose(vpHomogeneousMatrix(0, 0, 0.2 * depth, 0, 0, 0) * cdMo);
+        engine.computeControlLaw(0., v, error);
+        engine.getTask().computeControlLaw(0.);
+        t = 0.5 * (1 + uniform(rng));
+      }
+      engine.setPose(cdMc.inverse() * cdMo);
+
+      double t0 = vpTime::measureTimeMs();
+      if (task_sequencing) {
+        engine.computeControlLaw(t, v, error);
+      } else {
+        engine.computeControlLaw(v, error);
+      }
+      double t1 = vpTime::measureTimeMs();
+      vpServo &task = engine.getTask();
+      double t2 = vpTime::measureTimeMs();
+      v_servo = task_sequencing ? task.computeControlLaw(t) : task.computeControlLaw();
+      double t3 = vpTime::measureTimeMs();
+      t_fixed += t1 - t0;
+      t_servo += t3 - t2;
+
+      double diff = 0, norm = 0;
+      for (unsigned int j = 0; j < 6; j++) {
+        diff = std::max(diff, std::fabs(v[j] - v_servo[j]));
+        norm = std::max(norm, std::fabs(v_servo[j]));
+      }
+      diff_max = std::max(diff_max, diff);
+      if (diff > tolerance * (1 + norm)) {
+        if (nb_failed == 0) {
+          os << getModeName(modes[m]) << ": pose " << k << (joint_space ? ", joint space" : "")
+             << (task_sequencing ? ", task sequencing" : "") << (adaptive ? ", adaptive gain" : "")
+             << ": fixed law " << v.t() << " instead of " << v_servo.t() << std::endl;
+        }
+        nb_failed++;
+      }
+    }
+
+    os << getModeName(modes[m]) << ": " << nb_poses + 1 << " poses, largest velocity difference " << diff_max
+       << ", " << nb_failed << " above the tolerance " << tolerance << ", mean time " << t_fixed / (nb_poses + 1)
+       << " ms for vpFixedServo, " << t_servo / (nb_poses + 1) << " ms for vpServo" << std::endl;
+    ok = ok && (nb_failed == 0);
+  }
+  return ok;
+}
+
+/*!
+  Compute the velocity from the features set by the last setPose() or setPoint().
+
+  \param[out] v : 6-dim camera velocity, or joint velocity after setJointSpace().
+  \param[out] error : Features error \f${\bf s} - {\bf s}^*\f$.
+ */
+void vpServoEngine::computeControlLaw(vpColVector &v, vpColVector &error)
+{
+  if (m_fixed) {
+    updateFixedFeatures();
+    if (m_mode == IMAGE_BASED) {
+      m_fixed8.computeControlLaw(v);
+      m_fixed8.getError(error);
+    } else {
+      m_fixed6.computeControlLaw(v);
+      m_fixed6.getError(error);
+    }
+  } else {
+    v = m_task.computeControlLaw();
+    error = m_task.getError();
+  }
+}
+
+/*!
+  Compute the velocity with the task sequencing of vpServo::computeControlLaw(double).
+
+  \param[in] t : Time in second since the beginning of the servo.
+  \param[out] v : 6-dim camera velocity, or joint velocity after setJointSpace().
+  \param[out] error : Features error \f${\bf s} - {\bf s}^*\f$.
+ */
+void vpServoEngine::computeControlLaw(double t, vpColVector &v, vpColVector &error)
+{
+  if (m_fixed) {
+    updateFixedFeatures();
+    if (m_mode == IMAGE_BASED) {
+      m_fixed8.computeControlLaw(t, v);
+      m_fixed8.getError(error);
+    } else {
+      m_fixed6.computeControlLaw(t, v);
+      m_fixed6.getError(error);
+    }
+  } else {
+    v = m_task.computeControlLaw(t);
+    error = m_task.getError();
+  }
+}
+
+/*!
+  Compute the interaction matrix and the error of the control law in use, that are vpFixedServo ones after
+  setFixedControlLaw() and vpServo ones otherwise, for instance for vpServoMPC.
+
+  \param[out] L : Interaction matrix of the features, resized if needed.
+  \param[out] error : Features error \f${\bf s} - {\bf s}^*\f$.
+ */
+void vpServoEngine::computeInteractionMatrix(vpMatrix &L, vpColVector &error)
+{
+  if (m_fixed) {
+    updateFixedFeatures();
+    if (m_mode == IMAGE_BASED) {
+      m_fixed8.getInteractionMatrix(L);
+      m_fixed8.getError(error);
+    } else {
+      m_fixed6.getInteractionMatrix(L);
+      m_fixed6.getError(error);
+    }
+  } else {
+    vpServo &task = getTask();
+    error = task.computeError();
+    L = task.computeInteractionMatrix();
+  }
+}
+
+/*!
+  Display the current (green) and desired (red) image features: the points with IMAGE_BASED
+  features, the target center with HYBRID features. Nothing is displayed with POSITION_BASED features.
+ */
+void vpServoEngine::display(const vpCameraParameters &cam, const vpImage<unsigned char> &I) const
+{
+  if (m_mode == IMAGE_BASED) {
+    vpServoDisplay::display(m_task, cam, I);
+  } else if (m_mode == HYBRID) {
+    m_cd.display(cam, I, vpColor::red);
+    m_c.display(cam, I, vpColor::green);
+  }
+}
+
+//! Return the desired feature of the target point \e i, with IMAGE_BASED features.
+const vpFeaturePoint &vpServoEngine::getDesiredPoint(unsigned int i) const
+{
+  if (i >= m_pd.size()) {
+    throw(vpException(vpException::dimensionError, "No image point %d in the servo task", i));
+  }
+  return m_pd[i];
+}
+
+//! Return the dimension of the task.
+unsigned int vpServoEngine::getDimension() const
+{
+  return (m_mode == IMAGE_BASED ? 2 * getNbPoints() : 6);
+}
+
+//! Return the name of the feature \e i, for the plot legends.
+std::string vpServoEngine::getFeatureName(unsigned int i) const
+{
+  const char *pose_names[6] = {"tx", "ty", "tz", "theta_ux", "theta_uy", "theta_uz"};
+  const char *hybrid_names[3] = {"x", "y", "log_Z"};
+  std::stringstream ss;
+  if (m_mode == IMAGE_BASED) {
+    ss << (i % 2 == 0 ? "x" : "y") << i / 2;
+  } else if (m_mode == HYBRID && i < 3) {
+    ss << hybrid_names[i];
+  } else if (i < 6) {
+    ss << pose_names[i];
+  }
+  return ss.str();
+}
+
+//! Return the name of a mode, as read by parseMode().
+std::string vpServoEngine::getModeName(vpServoMode mode)
+{
+  switch (mode) {
+  case POSITION_BASED:
+    return "pbvs";
+  case IMAGE_BASED:
+    return "ibvs";
+  case HYBRID:
+  default:
+    return "2.5d";
+  }
+}
+
+//! Return the feature of the target point \e i, with IMAGE_BASED features.
+const vpFeaturePoint &vpServoEngine::getPoint(unsigned int i) const
+{
+  if (i >= m_p.size()) {
+    throw(vpException(vpException::dimensionError, "No image point %d in the servo task", i));
+  }
+  return m_p[i];
+}
+
+/*!
+  Return the vpServo task, for instance to compute the interaction matrix or to display the features.
+  Its features are the ones of the last setPose(), also with the fixed control law.
+ */
+vpServo &vpServoEngine::getTask()
+{
+  if (!m_taskUpdated) {
+    updateTaskFeatures();
+  }
+  return m_task;
+}
+
+/*!
+  Set the features of the task. To be called once.
+
+  \param[in] mode : Features of the task.
+  \param[in] points : Points of the target in the target frame. Their mean is the target center used by
+  the HYBRID features. 4 points are needed by the fixed control law with IMAGE_BASED features.
+ */
+void vpServoEngine::init(vpServoMode mode, const std::vector<vpPoint> &points)
+{
+  if (points.empty()) {
+    throw(vpException(vpException::dimensionError, "No target point for the servo task"));
+  }
+  m_mode = mode;
+  m_points = points;
+
+  double oX = 0, oY = 0, oZ = 0;
+  for (size_t i = 0; i < m_points.size(); i++) {
+    oX += m_points[i].get_oX();
+    oY += m_points[i].get_oY();
+    oZ += m_points[i].get_oZ();
+  }
+  m_center.setWorldCoordinates(oX / m_points.size(), oY / m_points.size(), oZ / m_points.size());
+
+  switch (m_mode) {
+  case POSITION_BASED:
+    m_task.addFeature(m_t, m_td);
+    m_task.addFeature(m_tu, m_tud);
+    break;
+  case IMAGE_BASED:
+    // The features are not reallocated after being added to the task
+    m_p.resize(m_points.size());
+    m_pd.resize(m_points.size());
+    for (size_t i = 0; i < m_p.size(); i++) {
+      m_task.addFeature(m_p[i], m_pd[i]);
+    }
+    break;
+  case HYBRID:
+    m_task.addFeature(m_c, m_cd);
+    m_task.addFeature(m_logZ, m_logZd);
+    m_task.addFeature(m_tu, m_tud);
+    break;
+  }
+}
+
+/*!
+  Read a mode name: "pbvs", "ibvs" or "2.5d".
+
+  \return false if the name is unknown, \e mode is then unchanged.
+ */
+bool vpServoEngine::parseMode(const std::string &name, vpServoMode &mode)
+{
+  if (name == "pbvs") {
+    mode = POSITION_BASED;
+  } else if (name == "ibvs") {
+    mode = IMAGE_BASED;
+  } else if (name == "2.5d" || name == "2.5D") {
+    mode = HYBRID;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/*!
+  Set the robot Jacobian at each iteration after setJointSpace().
+ */
+void vpServoEngine::set_eJe(const vpMatrix &eJe)
+{
+  m_task.set_eJe(eJe);
+  if (m_jointSpace) {
+    m_fixed6.set_cVe_eJe(m_cVe, eJe);
+    m_fixed8.set_cVe_eJe(m_cVe, eJe);
+  }
+}
+
+/*!
+  Set the desired pose of the target and update the desired features.
+
+  \param[in] cdMo : Desired pose of the target frame in the camera frame, including the rotation
+  chosen to avoid a PI rotation of the camera.
+ */
+void vpServoEngine::setDesiredPose(const vpHomogeneousMatrix &cdMo)
+{
+  m_cdMo = cdMo;
+
+  for (size_t i = 0; i < m_pd.size(); i++) {
+    m_points[i].changeFrame(cdMo, m_cP);
+    m_points[i].projection(m_cP, m_xy);
+    m_pd[i].buildFrom(m_xy[0], m_xy[1], m_cP[2]);
+  }
+
+  m_center.changeFrame(cdMo, m_cP);
+  m_center.projection(m_cP, m_xy);
+  m_Zd = m_cP[2];
+  m_cd.buildFrom(m_xy[0], m_xy[1], m_Zd);
+  m_logZd.buildFrom(m_xy[0], m_xy[1], m_Zd, 0);
+}
+
+/*!
+  Compute the task Jacobian \f${\bf L}\,{^c}{\bf V}_e\,{^e}{\bf J}_e\f$ and the joint velocities
+  (vpServo::EYEINHAND_L_cVe_eJe). set_eJe() has then to be called at each iteration.
+ */
+void vpServoEngine::setJointSpace(const vpVelocityTwistMatrix &cVe)
+{
+  m_jointSpace = true;
+  m_cVe = cVe;
+  m_task.setServo(vpServo::EYEINHAND_L_cVe_eJe);
+  m_task.set_cVe(cVe);
+}
+
+void vpServoEngine::setLambda(double lambda)
+{
+  m_task.setLambda(lambda);
+  m_fixed6.setLambda(lambda);
+  m_fixed8.setLambda(lambda);
+}
+
+void vpServoEngine::setLambda(const vpAdaptiveGain &lambda)
+{
+  m_task.setLambda(lambda);
+  m_fixed6.setLambda(lambda);
+  m_fixed8.setLambda(lambda);
+}
+
+/*!
+  Set a measured target point with IMAGE_BASED features, after setPose().
+
+  \param[in] i : Index of the point.
+  \param[in] x, y, Z : Normalized coordinates and depth of the point.
+ */
+void vpServoEngine::setPoint(unsigned int i, double x, double y, double Z)
+{
+  if (i >= m_p.size()) {
+    throw(vpException(vpException::dimensionError, "No image point %d in the servo task", i));
+  }
+  m_p[i].buildFrom(x, y, Z);
+}
+
+/*!
+  Update the features from the pose of the target.
+
+  \param[in] cMo : Measured or predicted pose of the target frame in the camera frame.
+ */
+void vpServoEngine::setPose(const vpHomogeneousMatrix &cMo)
+{
+  // cdMc = cdMo cMo^-1, with cMo^-1 = [R^T -R^T t], in place
+  for (unsigned int i = 0; i < 3; i++) {
+    double t = m_cdMo[i][3];
+    for (unsigned int j = 0; j < 3; j++) {
+      double r = 0;
+      for (unsigned int k = 0; k < 3; k++) {
+        r += m_cdMo[i][k] * cMo[j][k];
+      }
+      m_cdMc[i][j] = r;
+      t -= r * cMo[j][3];
+    }
+    m_cdMc[i][3] = t;
+  }
+
+  switch (m_mode) {
+  case POSITION_BASED:
+    break;
+  case IMAGE_BASED:
+    for (size_t i = 0; i < m_p.size(); i++) {
+      m_points[i].changeFrame(cMo, m_cP);
+      m_points[i].projection(m_cP, m_xy);
+      m_p[i].buildFrom(m_xy[0], m_xy[1], m_cP[2]);
+    }
+    break;
+  case HYBRID:
+    m_center.changeFrame(cMo, m_cP);
+    m_center.projection(m_cP, m_xy);
+    m_c.buildFrom(m_xy[0], m_xy[1], m_cP[2]);
+    m_logZ.buildFrom(m_xy[0], m_xy[1], m_cP[2], std::log(m_cP[2] / m_Zd));
+    break;
+  }
+
+  m_taskUpdated = false;
+  if (!m_fixed) {
+    updateTaskFeatures();
+  }
+}
+
+/*
+  Copy the features to the fixed size control law.
+ */
+void vpServoEngine::updateFixedFeatures()
+{
+  switch (m_mode) {
+  case POSITION_BASED:
+    m_fixed6.setPoseFeatures(m_cdMc);
+    break;
+  case IMAGE_BASED:
+    if (m_p.size() != 4) {
+      throw(vpException(vpException::dimensionError, "The fixed control law needs 4 image points, not %d",
+                        static_cast<int>(m_p.size())));
+    }
+    for (unsigned int i = 0; i < 4; i++) {
+      m_fixed8.setPointFeature(i, m_p[i].get_x(), m_p[i].get_y(), m_p[i].get_Z(), m_pd[i].get_x(),
+                               m_pd[i].get_y());
+    }
+    break;
+  case HYBRID:
+    m_fixed6.setHybridFeatures(m_c.get_x(), m_c.get_y(), m_c.get_Z(), m_cd.get_x(), m_cd.get_y(), m_Zd, m_cdMc);
+    break;
+  }
+}
+
+/*
+  Update the 3D features of the task from m_cdMc.
+ */
+void vpServoEngine::updateTaskFeatures()
+{
+  if (m_mode == POSITION_BASED) {
+    m_t.buildFrom(m_cdMc);
+  }
+  if (m_mode != IMAGE_BASED) {
+    m_tu.buildFrom(m_cdMc);
+  }
+  m_taskUpdated = true;
+}
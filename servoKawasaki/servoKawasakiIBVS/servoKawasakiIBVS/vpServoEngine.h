@@ -0,0 +1,179 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Visual servo task shared by the servo examples.
+ *
+ *****************************************************************************/
+
+
+#ifndef vpServoEngine_h
+#define vpServoEngine_h
+
+/*!
+  \file vpServoEngine.h
+  Visual servo task shared by the servo examples.
+*/
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <visp3/core/vpConfig.h>
+
+#include <visp3/core/vpCameraParameters.h>
+#include <visp3/core/vpColVector.h>
+#include <visp3/core/vpHomogeneousMatrix.h>
+#include <visp3/core/vpImage.h>
+#include <visp3/core/vpMatrix.h>
+#include <visp3/core/vpPoint.h>
+#include <visp3/core/vpVelocityTwistMatrix.h>
+#include <visp3/visual_features/vpFeatureDepth.h>
+#include <visp3/visual_features/vpFeaturePoint.h>
+#include <visp3/visual_features/vpFeatureThetaU.h>
+#include <visp3/visual_features/vpFeatureTranslation.h>
+#include <visp3/vs/vpAdaptiveGain.h>
+#include <visp3/vs/vpServo.h>
+
+#include <vpFixedServo.h>
+
+/*!
+
+  \class vpServoEngine
+  \brief Eye-in-hand visual servo task on a planar target, with position-based, image-based or
+  2 1/2 D features selected at runtime.
+
+  The features are:
+  - POSITION_BASED: vpFeatureTranslation::cdMc and vpFeatureThetaU::cdRc;
+  - IMAGE_BASED: a vpFeaturePoint per target point;
+  - HYBRID: the 2 1/2 D features, that are the vpFeaturePoint of the target center, the vpFeatureDepth
+    \f$\log(Z/Z^*)\f$ of the center and vpFeatureThetaU::cdRc. The rotation is controlled by
+    \f$\theta{\bf u}\f$ only and the translation by the center, so that the camera goes straight to
+    the desired pose while the target center follows a straight line in the image. The target stays
+    in view like with IMAGE_BASED, without its coupling between rotation and translation, so that
+    a higher gain can be used.
+
+  The engine holds the vpServo task and the equivalent vpFixedServo used with setFixedControlLaw().
+  The features are all updated from the target pose with setPose(). With IMAGE_BASED, the measured
+  points can then be set with setPoint(). The task points to the features of the engine, that is
+  not meant to be copied. With the fixed control law, the 3D features of the task, that allocate their
+  rotation matrices, are only updated by getTask(), so that setPose() doesn't allocate.
+
+  \code
+  vpServoEngine engine;
+  engine.init(vpServoEngine::HYBRID, tag_points);
+  engine.setLambda(0.8);
+  engine.setDesiredPose(cdMo);
+  while (!quit) {
+    ...
+    engine.setPose(cMo);
+    engine.computeControlLaw(v_c, task_error);
+    robot.setVelocity(vpRobot::CAMERA_FRAME, v_c);
+  }
+  \endcode
+
+*/
+class vpServoEngine
+{
+public:
+  //! Visual features of the task.
+  typedef enum {
+    POSITION_BASED, //!< 3D translation and rotation
+    IMAGE_BASED,    //!< Image points
+    HYBRID          //!< 2 1/2 D: image point and log depth of the target center, 3D rotation
+  } vpServoMode;
+
+  vpServoEngine();
+  virtual ~vpServoEngine();
+
+  static bool checkFixedControlLaw(std::ostream &os, const std::vector<vpPoint> &points,
+                                   const vpHomogeneousMatrix &cdMo, unsigned int nb_poses = 1000,
+                                   double tolerance = 1e-6);
+  void computeControlLaw(vpColVector &v, vpColVector &error);
+  void computeControlLaw(double t, vpColVector &v, vpColVector &error);
+  void computeInteractionMatrix(vpMatrix &L, vpColVector &error);
+
+  void display(const vpCameraParameters &cam, const vpImage<unsigned char> &I) const;
+
+  //! Return the pose of the current camera frame in the desired camera frame set by the last setPose().
+  const vpHomogeneousMatrix &get_cdMc() const { return m_cdMc; }
+  //! Return the desired pose of the target set by setDesiredPose().
+  const vpHomogeneousMatrix &getDesiredPose() const { return m_cdMo; }
+  const vpFeaturePoint &getDesiredPoint(unsigned int i) const;
+  unsigned int getDimension() const;
+  std::string getFeatureName(unsigned int i) const;
+  //! Return the features mode set by init().
+  vpServoMode getMode() const { return m_mode; }
+  static std::string getModeName(vpServoMode mode);
+  //! Return the number of target points.
+  unsigned int getNbPoints() const { return static_cast<unsigned int>(m_points.size()); }
+  const vpFeaturePoint &getPoint(unsigned int i) const;
+  vpServo &getTask();
+
+  void init(vpServoMode mode, const std::vector<vpPoint> &points);
+  static bool parseMode(const std::string &name, vpServoMode &mode);
+
+  void set_eJe(const vpMatrix &eJe);
+  void setDesiredPose(const vpHomogeneousMatrix &cdMo);
+  //! Compute the control law with vpFixedServo instead of vpServo.
+  void setFixedControlLaw(bool fixed) { m_fixed = fixed; }
+  void setJointSpace(const vpVelocityTwistMatrix &cVe);
+  void setLambda(double lambda);
+  void setLambda(const vpAdaptiveGain &lambda);
+  void setPoint(unsigned int i, double x, double y, double Z);
+  void setPose(const vpHomogeneousMatrix &cMo);
+
+protected:
+  void updateFixedFeatures();
+  void updateTaskFeatures();
+
+  vpServoMode m_mode;
+  bool m_fixed;
+  bool m_jointSpace;
+  vpVelocityTwistMatrix m_cVe;
+  vpServo m_task;
+  vpFixedServo<6> m_fixed6; //!< Fixed size law with POSITION_BASED or HYBRID features
+  vpFixedServo<8> m_fixed8; //!< Fixed size law with 4 IMAGE_BASED points
+  std::vector<vpPoint> m_points;
+  vpPoint m_center;         //!< Target center, the mean of the target points
+  vpHomogeneousMatrix m_cdMo;
+  vpHomogeneousMatrix m_cdMc;
+  bool m_taskUpdated;       //!< false when the 3D features of the task are older than m_cdMc
+  vpColVector m_cP, m_xy;   //!< A point in the camera frame and its projection, allocated once
+
+  // Features, pointed by the task
+  vpFeatureTranslation m_t, m_td;
+  vpFeatureThetaU m_tu, m_tud;
+  std::vector<vpFeaturePoint> m_p, m_pd;
+  vpFeaturePoint m_c, m_cd;
+  vpFeatureDepth m_logZ, m_logZd;
+  double m_Zd; //!< Desired depth of the target center
+};
+#endif
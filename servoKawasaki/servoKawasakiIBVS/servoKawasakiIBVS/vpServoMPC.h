@@ -0,0 +1,155 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Model predictive visual servoing under joint and visibility constraints.
+ *
+ *****************************************************************************/
+
+#ifndef vpServoMPC_h
+#define vpServoMPC_h
+
+/*!
+  \file vpServoMPC.h
+  Model predictive visual servoing under joint and visibility constraints.
+*/
+
+#include <vector>
+
+#include <visp3/core/vpConfig.h>
+
+#include <visp3/core/vpCameraParameters.h>
+#include <visp3/core/vpColVector.h>
+#include <visp3/core/vpMatrix.h>
+#include <visp3/core/vpPoint.h>
+#include <visp3/core/vpQuadProg.h>
+#include <visp3/core/vpVelocityTwistMatrix.h>
+
+/*!
+
+  \class vpServoMPC
+  \brief Eye-in-hand visual servoing by model predictive control of the joint velocities.
+
+  The evolution of the task error \f${\bf e}\f$ is predicted over a horizon of \e H sampling periods
+  \f$\Delta t\f$ with the task Jacobian \f${\bf J} = {\bf L}\,{^c}{\bf V}_e\,{^e}{\bf J}_e\f$ of the
+  current iteration:
+  \f[ {\bf e}_{k+1} = {\bf e}_k + \Delta t\, {\bf J}\, \dot{\bf q}_k \f]
+  The joint velocities \f$\dot{\bf q}_0 \ldots \dot{\bf q}_{H-1}\f$ minimize the sum of the squared
+  predicted errors, with a small regularization of the velocities and of their variations, under the
+  following constraints at each step of the horizon:
+  - joint velocity limits, see setJointVelocityLimits();
+  - joint acceleration limits, see setJointAccelerationLimits();
+  - joint position limits, see setJointLimits();
+  - the visibility points stay inside the image, see setImageBounds() and setVisibilityPoints().
+
+  Instead of the exponential decrease of \f$-\lambda {\bf L}^+ {\bf e}\f$, the error is then reduced as
+  fast as the constraints allow. A constraint that is already violated by the current state is relaxed
+  to the current value, so that the robot is only prevented from going further.
+
+  The quadratic program is solved by vpQuadProg. Since the constraints keep the same layout from one
+  iteration to the next, the active set of the previous iteration is used to warm start the solver.
+  Only the first velocity of the horizon is applied. If the problem has no solution, the robot is
+  decelerated within the acceleration limits.
+
+  \code
+  vpServoMPC mpc;
+  mpc.setHorizon(5);
+  mpc.setJointLimits(q_min, q_max);
+  mpc.setJointVelocityLimits(vpColVector(6, robot.getMaxRotationVelocity()));
+  mpc.setImageBounds(cam, I.getWidth(), I.getHeight(), 20);
+  while (1) {
+    ...
+    robot.get_eJe(eJe);
+    robot.getPosition(vpRobot::JOINT_STATE, q);
+    mpc.set_cVe_eJe(cVe, eJe);
+    mpc.setJointState(q, qdot);
+    mpc.setVisibilityPoints(points);
+    mpc.computeControlLaw(task.computeInteractionMatrix(), task.computeError(), qdot);
+    robot.setVelocity(vpRobot::JOINT_STATE, qdot);
+  }
+  \endcode
+
+*/
+class vpServoMPC
+{
+public:
+  vpServoMPC();
+
+  bool computeControlLaw(const vpMatrix &L, const vpColVector &e, vpColVector &qdot);
+
+  //! Return the task error predicted at the end of the horizon by the last call to computeControlLaw().
+  vpColVector getPredictedError() const { return m_predictedError; }
+
+  void reset();
+
+  void set_cVe_eJe(const vpVelocityTwistMatrix &cVe, const vpMatrix &eJe);
+  void setHorizon(unsigned int nb_steps);
+  void setImageBounds(const vpCameraParameters &cam, unsigned int width, unsigned int height, double margin = 0);
+  void setJointAccelerationLimits(const vpColVector &qddot_max);
+  void setJointLimits(const vpColVector &q_min, const vpColVector &q_max);
+  void setJointState(const vpColVector &q, const vpColVector &qdot);
+  void setJointVelocityLimits(const vpColVector &qdot_max);
+  //! Set the sampling period in second used for the prediction.
+  void setSamplingTime(double dt) { m_dt = dt; }
+  void setVisibilityPoints(const std::vector<vpPoint> &points);
+  /*!
+    Set the weights of the joint velocities and of their variations wrt the task error in the cost.
+    Both are relative to the squared error induced by the same velocity during one sampling period.
+   */
+  void setWeights(double velocity_weight, double acceleration_weight)
+  {
+    m_velocityWeight = velocity_weight;
+    m_accelerationWeight = acceleration_weight;
+  }
+
+protected:
+  void addLimit(unsigned int &row, const double *coeffs, unsigned int k, double value, double limit_min,
+                double limit_max);
+
+  unsigned int m_horizon;
+  double m_dt;
+  double m_velocityWeight;
+  double m_accelerationWeight;
+  vpMatrix m_cJe;               //!< Robot Jacobian cVe eJe
+  vpColVector m_q;              //!< Current joint positions
+  vpColVector m_qdot;           //!< Joint velocities applied during the last period
+  vpColVector m_qMin, m_qMax;   //!< Joint limits
+  vpColVector m_qdotMax;        //!< Joint velocity limits
+  vpColVector m_qddotMax;       //!< Joint acceleration limits
+  bool m_visibility;            //!< true when the image bounds are set
+  double m_xMin, m_xMax, m_yMin, m_yMax; //!< Image bounds in normalized coordinates
+  std::vector<vpPoint> m_points;
+  vpQuadProg m_qp;
+  unsigned int m_nbConstraints; //!< Number of inequality constraints used by the last solve
+  vpMatrix m_Q, m_C;
+  vpColVector m_r, m_d, m_x;
+  vpColVector m_predictedError;
+};
+#endif
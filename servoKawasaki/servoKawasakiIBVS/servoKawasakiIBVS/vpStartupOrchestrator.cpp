@@ -0,0 +1,197 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Concurrent startup of the robot, the camera and the vision components.
+ *
+ *****************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+
+#include <visp3/core/vpConfig.h>
+#include <visp3/core/vpException.h>
+#include <visp3/core/vpTime.h>
+
+/*!
+  \file vpStartupOrchestrator.cpp
+  Concurrent startup of the robot, the camera and the vision components.
+*/
+
+#include <vpStartupOrchestrator.h>
+
+/*!
+  Create the orchestrator, starting the deadline.
+
+  \param[in] timeout : Time in second given to all the components to be ready.
+ */
+vpStartupOrchestrator::vpStartupOrchestrator(double timeout)
+  : m_components(), m_startTime(vpTime::measureTimeMs()), m_timeout(timeout)
+{
+}
+
+vpStartupOrchestrator::~vpStartupOrchestrator()
+{
+  for (size_t i = 0; i < m_components.size(); i++) {
+    if (m_components[i]->future.valid()) {
+      m_components[i]->future.wait();
+    }
+  }
+}
+
+/*!
+  Return the startup time of each component, of the whole startup and of a sequential startup.
+ */
+std::string vpStartupOrchestrator::getReport() const
+{
+  std::stringstream ss;
+  double end = 0, sum = 0;
+  ss << "Startup:";
+  for (size_t i = 0; i < m_components.size(); i++) {
+    const vpComponent &component = *m_components[i];
+    ss << (i > 0 ? ", " : " ") << component.name << " ";
+    if (component.ready) {
+      ss << component.duration << " ms";
+      end = std::max(end, component.startTime + component.duration);
+      sum += component.duration;
+    } else {
+      ss << "not ready";
+    }
+  }
+  ss << ". Ready after " << end << " ms instead of " << sum << " ms";
+  return ss.str();
+}
+
+/*!
+  Start a component in a new thread.
+
+  \param[in] name : Name used by wait() and in the report.
+  \param[in] task : Startup of the component, returning false if it fails.
+ */
+void vpStartupOrchestrator::launch(const std::string &name, const std::function<bool()> &task)
+{
+  std::shared_ptr<vpComponent> component = std::make_shared<vpComponent>();
+  component->name = name;
+  component->startTime = vpTime::measureTimeMs() - m_startTime;
+  component->duration = 0;
+  component->waited = false;
+  component->ready = false;
+  vpComponent *timing = component.get();
+  component->future = std::async(std::launch::async, [task, timing]() {
+    double t = vpTime::measureTimeMs();
+    bool ok = false;
+    try {
+      ok = task();
+    } catch (...) {
+      timing->duration = vpTime::measureTimeMs() - t;
+      throw;
+    }
+    timing->duration = vpTime::measureTimeMs() - t;
+    return ok;
+  });
+  m_components.push_back(component);
+}
+
+/*!
+  Start a component in the calling thread, for the components that must be created in the main thread. The
+  component is ready when this function returns, its time is included in the report.
+ */
+void vpStartupOrchestrator::run(const std::string &name, const std::function<bool()> &task)
+{
+  std::shared_ptr<vpComponent> component = std::make_shared<vpComponent>();
+  component->name = name;
+  component->startTime = vpTime::measureTimeMs() - m_startTime;
+  component->waited = false;
+  component->ready = false;
+  double t = vpTime::measureTimeMs();
+  std::promise<bool> result;
+  try {
+    result.set_value(task());
+  } catch (...) {
+    result.set_exception(std::current_exception());
+  }
+  component->duration = vpTime::measureTimeMs() - t;
+  component->future = result.get_future();
+  m_components.push_back(component);
+  wait(*component);
+}
+
+/*!
+  Wait until the component \e name is ready.
+
+  \exception vpException::badValue : No component has this name.
+  \exception vpException::fatalError : The component fails or is not ready before the deadline. An exception
+  thrown by the component is forwarded.
+ */
+void vpStartupOrchestrator::wait(const std::string &name)
+{
+  for (size_t i = 0; i < m_components.size(); i++) {
+    if (m_components[i]->name == name) {
+      wait(*m_components[i]);
+      return;
+    }
+  }
+  throw(vpException(vpException::badValue, "No startup component named %s", name.c_str()));
+}
+
+void vpStartupOrchestrator::wait(vpComponent &component)
+{
+  if (component.waited) {
+    if (!component.ready) {
+      throw(vpException(vpException::fatalError, "Startup of %s failed", component.name.c_str()));
+    }
+    return;
+  }
+
+  double remaining = std::max(0., m_startTime + 1000. * m_timeout - vpTime::measureTimeMs());
+  if (component.future.wait_for(std::chrono::microseconds(static_cast<long long>(1000. * remaining))) !=
+      std::future_status::ready) {
+    throw(vpException(vpException::fatalError, "%s not ready %.1f s after the startup", component.name.c_str(),
+                      m_timeout));
+  }
+  component.waited = true;
+  component.ready = component.future.get();
+  if (!component.ready) {
+    throw(vpException(vpException::fatalError, "Startup of %s failed", component.name.c_str()));
+  }
+}
+
+/*!
+  Wait until all the components are ready.
+
+  \sa wait()
+ */
+void vpStartupOrchestrator::waitAll()
+{
+  for (size_t i = 0; i < m_components.size(); i++) {
+    wait(*m_components[i]);
+  }
+}
@@ -0,0 +1,281 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Sub-pixel refinement of the tag corners by fitting lines on the tag edges.
+ *
+ *****************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <visp3/core/vpConfig.h>
+#include <visp3/core/vpCPUFeatures.h>
+#include <visp3/core/vpTime.h>
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VISP_HAVE_SSE2 1
+#endif
+
+/*!
+  \file vpTagCornerRefinement.cpp
+  Sub-pixel refinement of the tag corners by fitting lines on the tag edges.
+*/
+
+#include <vpTagCornerRefinement.h>
+
+namespace
+{
+// Step in pixel of the gradient profile along the edge normal
+const double profile_step = 1.;
+// Minimal number of edge points to fit a line
+const unsigned int min_nb_edge_points = 5;
+}
+
+/*!
+  Default constructor.
+ */
+vpTagCornerRefinement::vpTagCornerRefinement()
+  : m_minGradient(20.), m_searchRange(2.), m_sampleStep(1.), m_timeBudget(2.), m_maxShift(0), m_roiU(0), m_roiV(0),
+    m_roiWidth(0), m_roiHeight(0), m_Gu(), m_Gv(), m_profile(), m_lines(), m_refined()
+{
+}
+
+/*!
+  Compute the central difference gradient in the bounding box of the polygon, enlarged by the
+  search range.
+ */
+void vpTagCornerRefinement::computeGradient(const vpImage<unsigned char> &I, const std::vector<vpImagePoint> &polygon)
+{
+  double u_min = std::numeric_limits<double>::max(), v_min = std::numeric_limits<double>::max();
+  double u_max = -std::numeric_limits<double>::max(), v_max = -std::numeric_limits<double>::max();
+  for (size_t i = 0; i < polygon.size(); i++) {
+    u_min = std::min(u_min, polygon[i].get_u());
+    u_max = std::max(u_max, polygon[i].get_u());
+    v_min = std::min(v_min, polygon[i].get_v());
+    v_max = std::max(v_max, polygon[i].get_v());
+  }
+  const double margin = m_searchRange + 2;
+  const int width = static_cast<int>(I.getWidth()), height = static_cast<int>(I.getHeight());
+  m_roiU = std::max(1, static_cast<int>(std::floor(u_min - margin)));
+  m_roiV = std::max(1, static_cast<int>(std::floor(v_min - margin)));
+  int u_end = std::min(width - 2, static_cast<int>(std::ceil(u_max + margin)));
+  int v_end = std::min(height - 2, static_cast<int>(std::ceil(v_max + margin)));
+  m_roiWidth = std::max(0, u_end - m_roiU + 1);
+  m_roiHeight = std::max(0, v_end - m_roiV + 1);
+  m_Gu.resize(static_cast<size_t>(m_roiWidth * m_roiHeight));
+  m_Gv.resize(m_Gu.size());
+
+#if VISP_HAVE_SSE2
+  static const bool checkSSE2 = vpCPUFeatures::checkSSE2();
+  const __m128i zero = _mm_setzero_si128();
+#endif
+
+  for (int r = 0; r < m_roiHeight; r++) {
+    const int v = m_roiV + r;
+    const unsigned char *row = I[v], *row_prev = I[v - 1], *row_next = I[v + 1];
+    short *gu = &m_Gu[static_cast<size_t>(r * m_roiWidth)], *gv = &m_Gv[static_cast<size_t>(r * m_roiWidth)];
+    int c = 0;
+
+#if VISP_HAVE_SSE2
+    if (checkSSE2) {
+      // 16 pixels per iteration, the last read pixel (u + 16) should be inside the image
+      for (; c + 16 <= m_roiWidth && m_roiU + c + 16 < width; c += 16) {
+        const int u = m_roiU + c;
+        __m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + u - 1));
+        __m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + u + 1));
+        __m128i up = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row_prev + u));
+        __m128i down = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row_next + u));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(gu + c),
+                         _mm_sub_epi16(_mm_unpacklo_epi8(right, zero), _mm_unpacklo_epi8(left, zero)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(gu + c + 8),
+                         _mm_sub_epi16(_mm_unpackhi_epi8(right, zero), _mm_unpackhi_epi8(left, zero)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(gv + c),
+                         _mm_sub_epi16(_mm_unpacklo_epi8(down, zero), _mm_unpacklo_epi8(up, zero)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(gv + c + 8),
+                         _mm_sub_epi16(_mm_unpackhi_epi8(down, zero), _mm_unpackhi_epi8(up, zero)));
+      }
+    }
+#endif
+
+    for (; c < m_roiWidth; c++) {
+      const int u = m_roiU + c;
+      gu[c] = static_cast<short>(row[u + 1] - row[u - 1]);
+      gv[c] = static_cast<short>(row_next[u] - row_prev[u]);
+    }
+  }
+}
+
+/*!
+  Fit a line n.p = d on the edge between the corners \e a and \e b.
+
+  \param[in] a, b : Extremities of the coarse edge.
+  \param[out] line : Line parameters (nu, nv, d) with a unit normal.
+  \return true if enough edge points were found.
+ */
+bool vpTagCornerRefinement::fitEdge(const vpImagePoint &a, const vpImagePoint &b, double line[3])
+{
+  const double du = b.get_u() - a.get_u(), dv = b.get_v() - a.get_v();
+  const double length = std::sqrt(du * du + dv * dv);
+  if (length < 4 * m_searchRange) {
+    return false;
+  }
+  const double nu = -dv / length, nv = du / length;
+  const int nb_profile = 2 * static_cast<int>(m_searchRange / profile_step) + 1;
+  m_profile.resize(static_cast<size_t>(nb_profile));
+
+  // Weighted moments of the edge points
+  double sw = 0, su = 0, sv = 0, suu = 0, suv = 0, svv = 0;
+  unsigned int nb_points = 0;
+
+  // Skip the edge extremities where the neighbour edges interfere
+  const double t_margin = std::max(0.1, 2 * m_searchRange / length);
+  const double t_step = m_sampleStep / length;
+  for (double t = t_margin; t <= 1 - t_margin; t += t_step) {
+    const double pu = a.get_u() + t * du, pv = a.get_v() + t * dv;
+    int k_max = -1;
+    double g_max = m_minGradient;
+    for (int k = 0; k < nb_profile; k++) {
+      double s = (k - nb_profile / 2) * profile_step;
+      m_profile[static_cast<size_t>(k)] = getNormalGradient(pu + s * nu, pv + s * nv, nu, nv);
+      if (m_profile[static_cast<size_t>(k)] > g_max) {
+        g_max = m_profile[static_cast<size_t>(k)];
+        k_max = k;
+      }
+    }
+    if (k_max <= 0 || k_max >= nb_profile - 1) {
+      // No edge, or edge at the border of the search range
+      continue;
+    }
+    // Gaussian interpolation of the gradient peak, that is a parabola fitted on the log of the gradient
+    double g_prev = m_profile[static_cast<size_t>(k_max - 1)], g_next = m_profile[static_cast<size_t>(k_max + 1)];
+    double offset = 0;
+    if (g_prev > 0 && g_next > 0) {
+      double l_prev = std::log(g_prev), l_max = std::log(g_max), l_next = std::log(g_next);
+      double denom = l_prev - 2 * l_max + l_next;
+      offset = (denom < 0 ? 0.5 * (l_prev - l_next) / denom : 0.);
+    }
+    double s = (k_max - nb_profile / 2 + offset) * profile_step;
+    double eu = pu + s * nu, ev = pv + s * nv;
+
+    sw += g_max;
+    su += g_max * eu;
+    sv += g_max * ev;
+    suu += g_max * eu * eu;
+    suv += g_max * eu * ev;
+    svv += g_max * ev * ev;
+    nb_points++;
+  }
+
+  if (nb_points < min_nb_edge_points) {
+    return false;
+  }
+
+  // Total least squares: the line normal is the eigen vector of the smallest eigen value
+  double cu = su / sw, cv = sv / sw;
+  double cuu = suu / sw - cu * cu, cuv = suv / sw - cu * cv, cvv = svv / sw - cv * cv;
+  double theta = 0.5 * std::atan2(2 * cuv, cuu - cvv); // Direction of the largest eigen value
+  line[0] = -std::sin(theta);
+  line[1] = std::cos(theta);
+  line[2] = line[0] * cu + line[1] * cv;
+  return true;
+}
+
+/*!
+  Bilinear interpolation of the gradient projected on the normal (nu, nv), in absolute value.
+  Return 0 outside the region of interest.
+ */
+double vpTagCornerRefinement::getNormalGradient(double u, double v, double nu, double nv) const
+{
+  double x = u - m_roiU, y = v - m_roiV;
+  int ix = static_cast<int>(std::floor(x)), iy = static_cast<int>(std::floor(y));
+  if (ix < 0 || iy < 0 || ix + 1 >= m_roiWidth || iy + 1 >= m_roiHeight) {
+    return 0.;
+  }
+  double a = x - ix, b = y - iy;
+  size_t k = static_cast<size_t>(iy * m_roiWidth + ix), w = static_cast<size_t>(m_roiWidth);
+  double gu = (1 - b) * ((1 - a) * m_Gu[k] + a * m_Gu[k + 1]) + b * ((1 - a) * m_Gu[k + w] + a * m_Gu[k + w + 1]);
+  double gv = (1 - b) * ((1 - a) * m_Gv[k] + a * m_Gv[k + 1]) + b * ((1 - a) * m_Gv[k + w] + a * m_Gv[k + w + 1]);
+  return std::fabs(nu * gu + nv * gv);
+}
+
+/*!
+  Refine the corners of a tag.
+
+  \param[in] I : Image in which the tag is seen.
+  \param[in,out] polygon : Coarse corners of the tag, like the ones given by
+  vpDetectorAprilTag::getPolygon(), updated with the refined corners.
+  \return true if the corners were refined. When an edge can't be fitted, when a refined corner is
+  too far from the coarse one or when the time budget is exceeded, the polygon is left unchanged and
+  false is returned.
+ */
+bool vpTagCornerRefinement::refine(const vpImage<unsigned char> &I, std::vector<vpImagePoint> &polygon)
+{
+  double t_start = vpTime::measureTimeMs();
+  if (polygon.size() < 3) {
+    return false;
+  }
+
+  computeGradient(I, polygon);
+
+  const size_t nb = polygon.size();
+  m_lines.resize(3 * nb);
+  for (size_t i = 0; i < nb; i++) {
+    if (!fitEdge(polygon[i], polygon[(i + 1) % nb], &m_lines[3 * i])) {
+      return false;
+    }
+    if (vpTime::measureTimeMs() - t_start > m_timeBudget) {
+      return false;
+    }
+  }
+
+  // Corner i is the intersection of the edges i-1 and i
+  m_refined.resize(nb);
+  double max_shift = 0;
+  for (size_t i = 0; i < nb; i++) {
+    const double *l1 = &m_lines[3 * ((i + nb - 1) % nb)], *l2 = &m_lines[3 * i];
+    double det = l1[0] * l2[1] - l1[1] * l2[0];
+    if (std::fabs(det) < 1e-3) {
+      return false;
+    }
+    m_refined[i].set_uv((l1[2] * l2[1] - l1[1] * l2[2]) / det, (l1[0] * l2[2] - l1[2] * l2[0]) / det);
+    double shift = vpImagePoint::distance(m_refined[i], polygon[i]);
+    if (shift > 2 * m_searchRange) {
+      return false;
+    }
+    max_shift = std::max(max_shift, shift);
+  }
+
+  polygon = m_refined;
+  m_maxShift = max_shift;
+  return true;
+}
@@ -0,0 +1,113 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Sub-pixel refinement of the tag corners by fitting lines on the tag edges.
+ *
+ *****************************************************************************/
+
+#ifndef vpTagCornerRefinement_h
+#define vpTagCornerRefinement_h
+
+/*!
+  \file vpTagCornerRefinement.h
+  Sub-pixel refinement of the tag corners by fitting lines on the tag edges.
+*/
+
+#include <vector>
+
+#include <visp3/core/vpConfig.h>
+
+#include <visp3/core/vpImage.h>
+#include <visp3/core/vpImagePoint.h>
+
+/*!
+
+  \class vpTagCornerRefinement
+  \brief Refine the corners of a tag by intersecting lines fitted on its 4 edges.
+
+  The image gradient is computed in the region of interest around the tag. Along each edge of the
+  polygon, the location of the maximal gradient is searched on the edge normal and interpolated at
+  sub-pixel precision. A line is fitted on these edge points by weighted total least squares. The
+  refined corners are the intersections of consecutive lines.
+
+  The refinement is meant to be used near the convergence of the servo, when the coarse corners
+  given by the detector or the tracker are already close to the true ones. It stops as soon as its
+  time budget is exceeded, in which case the polygon is left unchanged.
+
+  \code
+  vpTagCornerRefinement refinement;
+  refinement.setTimeBudget(2.); // ms
+  std::vector<vpImagePoint> polygon = detector.getPolygon(0);
+  refinement.refine(I, polygon);
+  \endcode
+
+*/
+class vpTagCornerRefinement
+{
+public:
+  vpTagCornerRefinement();
+
+  //! Return the largest displacement in pixel of a corner during the last successful refinement.
+  double getMaxCornerShift() const { return m_maxShift; }
+
+  bool refine(const vpImage<unsigned char> &I, std::vector<vpImagePoint> &polygon);
+
+  //! Set the minimal gradient magnitude along the edge normal of a valid edge point.
+  void setMinGradient(double gradient) { m_minGradient = gradient; }
+  //! Set the half length in pixel of the search for the edge along its normal.
+  void setSearchRange(double range) { m_searchRange = range; }
+  //! Set the distance in pixel between two edge points along an edge.
+  void setSampleStep(double step) { m_sampleStep = (step > 0.1 ? step : 0.1); }
+  //! Set the maximal time in ms allowed for a refinement.
+  void setTimeBudget(double budget) { m_timeBudget = budget; }
+
+protected:
+  void computeGradient(const vpImage<unsigned char> &I, const std::vector<vpImagePoint> &polygon);
+  bool fitEdge(const vpImagePoint &a, const vpImagePoint &b, double line[3]);
+  double getNormalGradient(double u, double v, double nu, double nv) const;
+
+  double m_minGradient;
+  double m_searchRange;
+  double m_sampleStep;
+  double m_timeBudget;
+  double m_maxShift;
+  int m_roiU;               //!< Column of the top left pixel of the gradient region of interest
+  int m_roiV;               //!< Row of the top left pixel of the gradient region of interest
+  int m_roiWidth;
+  int m_roiHeight;
+  std::vector<short> m_Gu;  //!< Horizontal gradient in the region of interest
+  std::vector<short> m_Gv;  //!< Vertical gradient in the region of interest
+  // Buffers reused by each refinement
+  std::vector<double> m_profile;        //!< Gradient along the edge normal
+  std::vector<double> m_lines;          //!< Fitted edges
+  std::vector<vpImagePoint> m_refined;  //!< Intersections of the fitted edges
+};
+#endif
@@ -0,0 +1,126 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Tracking of the tag corners between two AprilTag detections.
+ *
+ *****************************************************************************/
+
+#ifndef vpTagCornerTracker_h
+#define vpTagCornerTracker_h
+
+/*!
+  \file vpTagCornerTracker.h
+  Tracking of the tag corners between two AprilTag detections.
+*/
+
+#include <vector>
+
+#include <visp3/core/vpConfig.h>
+
+#include <visp3/core/vpImage.h>
+#include <visp3/core/vpImagePoint.h>
+
+/*!
+
+  \class vpTagCornerTracker
+  \brief Track the corners of a tag with a pyramidal Lucas-Kanade tracker on small patches.
+
+  The tracker is initialized with the tag polygon given by vpDetectorAprilTag. The patch centered on
+  each corner is memorized at each pyramid level as a template. The corners are then tracked from one
+  image to the next one by inverse compositional Lucas-Kanade on the translation, from the coarsest
+  level to the finest one.
+
+  Tracking fails when a corner leaves the image, when the photometric residual of a corner is too
+  large, or when the tracked polygon is no more convex or its area changes too much wrt the detected
+  one. A new detection is then needed to initialize the tracker again.
+
+  \code
+  if (tracker.isInitialized() && tracker.track(I)) {
+    polygon = tracker.getCorners();
+  }
+  else {
+    detector.detect(I);
+    tracker.init(I, detector.getPolygon(0));
+  }
+  \endcode
+
+*/
+class vpTagCornerTracker
+{
+public:
+  vpTagCornerTracker();
+
+  //! Return the corners tracked in the last image, in the same order as the initial polygon.
+  const std::vector<vpImagePoint> &getCorners() const { return m_corners; }
+  //! Return the largest RMS photometric residual of the corners after the last call to track().
+  double getResidual() const { return m_residual; }
+
+  void init(const vpImage<unsigned char> &I, const std::vector<vpImagePoint> &polygon);
+  //! Return true if the tracker was initialized and did not fail since.
+  bool isInitialized() const { return m_initialized; }
+
+  void reset();
+
+  //! Set the maximal number of iterations per pyramid level.
+  void setMaxIterations(unsigned int nb) { m_maxIter = nb; }
+  //! Set the maximal RMS photometric residual of a corner, in gray levels.
+  void setMaxResidual(double residual) { m_maxResidual = residual; }
+  //! Set the number of pyramid levels, to be set before init().
+  void setPyramidLevels(unsigned int nb) { m_nbLevels = (nb > 0 ? nb : 1); }
+
+  bool track(const vpImage<unsigned char> &I);
+
+protected:
+  // Template of a corner at a pyramid level
+  struct vpCornerTemplate {
+    std::vector<float> T;  // Intensities
+    std::vector<float> Gx; // Horizontal gradient
+    std::vector<float> Gy; // Vertical gradient
+    double Hi[3];          // Inverse of the Gauss-Newton matrix (xx, xy, yy)
+  };
+
+  void buildPyramid(const vpImage<unsigned char> &I);
+  const vpImage<unsigned char> &getLevel(const vpImage<unsigned char> &I, unsigned int level) const;
+  bool trackCorner(const vpImage<unsigned char> &I, size_t id, vpImagePoint &corner, double &residual) const;
+
+  unsigned int m_nbLevels;
+  unsigned int m_maxIter;
+  double m_maxResidual;
+  bool m_initialized;
+  double m_initArea;
+  double m_residual;
+  std::vector<vpImagePoint> m_corners;
+  std::vector<std::vector<vpCornerTemplate> > m_templates; //!< Templates per corner and per level
+  std::vector<vpImage<unsigned char> > m_pyramid;          //!< Pyramid levels > 0 of the current image
+  std::vector<float> m_patch;                              //!< Extended patch sampled by init()
+  std::vector<vpImagePoint> m_tracked;                     //!< Corners being tracked by track()
+};
+#endif
@@ -0,0 +1,267 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Handling of the target loss and reacquisition.
+ *
+ *****************************************************************************/
+
+
+#include <cmath>
+
+#include <visp3/core/vpConfig.h>
+#include <visp3/core/vpExponentialMap.h>
+#include <visp3/core/vpMath.h>
+
+/*!
+  \file vpTargetLossHandler.cpp
+  Handling of the target loss and reacquisition.
+*/
+
+#include <vpTargetLossHandler.h>
+
+/*!
+  Default constructor: 5 coasting frames with a 0.7 velocity decay, quad decimation of 1.
+  The handler starts in SEARCHING.
+ */
+vpTargetLossHandler::vpTargetLossHandler()
+  : m_state(SEARCHING), m_nbMissed(0), m_maxCoasting(5), m_decay(0.7), m_thresholdT(0.05), m_thresholdTu(20.),
+    m_decimate(1.f), m_searchDecimations(), m_searchIndex(0), m_t(-1), m_v(), m_cMo(), m_hasPose(false),
+    m_frameMotion(), m_hasSymmetry(false)
+{
+  setQuadDecimate(1.f);
+}
+
+/*!
+  Return the quad decimation to set to the AprilTag detector before the next detection: the nominal one,
+  or one of the search decimations in SEARCHING.
+ */
+float vpTargetLossHandler::getQuadDecimate() const
+{
+  if (m_state == SEARCHING && !m_searchDecimations.empty()) {
+    return m_searchDecimations[m_searchIndex];
+  }
+  return m_decimate;
+}
+
+//! Return the name of a state, for display.
+const char *vpTargetLossHandler::getStateName(vpTrackingState state)
+{
+  switch (state) {
+  case TRACKING:
+    return "tracking";
+  case COASTING:
+    return "coasting";
+  case SEARCHING:
+    return "searching";
+  case REACQUIRED:
+  default:
+    return "reacquired";
+  }
+}
+
+/*!
+  Return the factor to apply to the velocity computed by the control law: 1 when the target is measured,
+  the velocity decay to the power of the number of missed frames in COASTING, 0 in SEARCHING.
+ */
+double vpTargetLossHandler::getVelocityScale() const
+{
+  switch (m_state) {
+  case COASTING:
+    return std::pow(m_decay, static_cast<double>(m_nbMissed));
+  case SEARCHING:
+    return 0;
+  default:
+    return 1;
+  }
+}
+
+/*!
+  Predict the camera motion since the previous update from the camera velocity.
+ */
+void vpTargetLossHandler::predict(double t)
+{
+  double dt = (m_t < 0) ? 0 : t - m_t;
+  m_t = t;
+  m_frameMotion.eye();
+  if (m_v.size() == 6 && dt > 0) {
+    // The exponential map gives the displacement of the camera during dt, points move by its inverse
+    m_frameMotion = vpExponentialMap::direct(m_v, dt).inverse();
+  }
+}
+
+/*!
+  Go back to the initial SEARCHING state. The next detection is a reacquisition and the symmetry of the
+  desired frame is chosen again.
+ */
+void vpTargetLossHandler::reset()
+{
+  m_state = SEARCHING;
+  m_nbMissed = 0;
+  m_searchIndex = 0;
+  m_t = -1;
+  m_v = vpColVector();
+  m_cMo.eye();
+  m_hasPose = false;
+  m_frameMotion.eye();
+  m_hasSymmetry = false;
+}
+
+/*!
+  Set the nominal quad decimation of the AprilTag detector. The search decimations are set to the
+  nominal one, to the full resolution to find a small or far target, and to twice the nominal one
+  to find a close or blurred target faster.
+ */
+void vpTargetLossHandler::setQuadDecimate(float decimate)
+{
+  m_decimate = decimate;
+  std::vector<float> decimations(1, decimate);
+  if (decimate > 1.f) {
+    decimations.push_back(1.f);
+  }
+  decimations.push_back(2.f * decimate);
+  setSearchDecimations(decimations);
+}
+
+void vpTargetLossHandler::setSearchDecimations(const std::vector<float> &decimations)
+{
+  m_searchDecimations = decimations;
+  m_searchIndex = 0;
+}
+
+/*!
+  Update the state with the result of the detection in the current image, without target pose.
+  getFrameMotion() then gives the predicted camera motion to update the features in COASTING.
+
+  \param[in] t : Time of the image in second.
+  \param[in] measured : True if the target was detected or tracked in the image.
+  \return The new state.
+ */
+vpTargetLossHandler::vpTrackingState vpTargetLossHandler::update(double t, bool measured)
+{
+  predict(t);
+
+  if (measured) {
+    m_state = (m_state == SEARCHING) ? REACQUIRED : TRACKING;
+    m_nbMissed = 0;
+    m_searchIndex = 0;
+  }
+  else if (m_state == SEARCHING) {
+    // Next search decimation
+    if (!m_searchDecimations.empty()) {
+      m_searchIndex = (m_searchIndex + 1) % static_cast<unsigned int>(m_searchDecimations.size());
+    }
+  }
+  else if (++m_nbMissed > m_maxCoasting) {
+    m_state = SEARCHING;
+    m_searchIndex = 0;
+    m_v = vpColVector();
+  }
+  else {
+    m_state = COASTING;
+  }
+  return m_state;
+}
+
+/*!
+  Update the state with the result of the detection in the current image.
+
+  \param[in] t : Time of the image in second.
+  \param[in] measured : True if the target pose was measured in the image.
+  \param[in,out] cMo : Measured pose of the target if \e measured is true. Otherwise set to the
+  predicted pose in COASTING, unchanged in SEARCHING.
+  \return The new state. A measured pose far from the predicted one after a missed frame gives
+  REACQUIRED, like a detection after SEARCHING.
+ */
+vpTargetLossHandler::vpTrackingState vpTargetLossHandler::update(double t, bool measured, vpHomogeneousMatrix &cMo)
+{
+  vpTrackingState previous = m_state;
+  update(t, measured);
+
+  if (measured) {
+    if (previous == COASTING && m_hasPose) {
+      // Compare the measured pose to the predicted one
+      vpHomogeneousMatrix cpMc = m_frameMotion * m_cMo * cMo.inverse();
+      double error_t = std::sqrt(cpMc.getTranslationVector().sumSquare());
+      double error_tu = vpMath::deg(std::fabs(cpMc.getThetaUVector().getTheta()));
+      if (error_t > m_thresholdT || error_tu > m_thresholdTu) {
+        m_state = REACQUIRED;
+      }
+    }
+    m_cMo = cMo;
+    m_hasPose = true;
+  }
+  else if (m_state == COASTING && m_hasPose) {
+    m_cMo = m_frameMotion * m_cMo;
+    cMo = m_cMo;
+  }
+  return m_state;
+}
+
+/*!
+  Choose the rotation oMo of the desired target frame, either the identity or a PI rotation around
+  the tag normal, that leads to the smallest camera rotation from the current pose. To be called
+  when the target is REACQUIRED. Once a choice is made, it is only changed if the other rotation
+  is smaller by more than 10 degrees, so that a reacquisition near the half turn doesn't flip the
+  desired frame back and forth.
+
+  \param[in] cdMo : Desired pose of the target.
+  \param[in] cMo : Measured pose of the target.
+  \param[in,out] oMo : Rotation of the desired frame.
+  \return True if \e oMo was modified.
+ */
+bool vpTargetLossHandler::updateSymmetry(const vpHomogeneousMatrix &cdMo, const vpHomogeneousMatrix &cMo,
+                                         vpHomogeneousMatrix &oMo)
+{
+  const double margin = vpMath::rad(10.);
+  std::vector<vpHomogeneousMatrix> v_oMo(2);
+  v_oMo[1].buildFrom(0, 0, 0, 0, 0, M_PI);
+  double theta[2];
+  for (size_t i = 0; i < 2; i++) {
+    theta[i] = std::fabs((cdMo * v_oMo[i] * cMo.inverse()).getThetaUVector().getTheta());
+  }
+  size_t best = (theta[0] < theta[1]) ? 0 : 1;
+  if (m_hasSymmetry) {
+    double theta_current = std::fabs((cdMo * oMo * cMo.inverse()).getThetaUVector().getTheta());
+    if (theta_current <= theta[best] + margin) {
+      return false;
+    }
+  }
+  m_hasSymmetry = true;
+
+  bool modified = false;
+  for (unsigned int i = 0; i < 4 && !modified; i++) {
+    for (unsigned int j = 0; j < 4 && !modified; j++) {
+      modified = std::fabs(oMo[i][j] - v_oMo[best][i][j]) > 1e-6;
+    }
+  }
+  oMo = v_oMo[best];
+  return modified;
+}
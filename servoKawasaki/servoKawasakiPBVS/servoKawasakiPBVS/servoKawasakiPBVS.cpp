@@ -49,16 +49,36 @@
   This file could be obtained following extrinsic camera calibration tutorial:
   https://visp-doc.inria.fr/doxygen/visp-daily/tutorial-calibration-extrinsic.html
 
-  Camera intrinsic parameters are retrieved from the Realsense SDK.
+  The intrinsic parameters are read with vpXmlParserCamera from --intrinsic <camera.xml> file, with the
+  distortion model of the camera named --camera_name <name> calibrated at the 640x480 image size. This
+  file is computed by calibrationKawasaki --calibrate_intrinsic. The files of the D435 and SR300 devices
+  are provided with the examples.
 
   The target is an AprilTag that is by default 12cm large. To print your Kawasaki tag, see
   https://visp-doc.inria.fr/doxygen/visp-daily/tutorial-detection-apriltag.html
   You can specify the size of your tag using --tag_size command line option.
+
+  The other command line options are described by --help. They enable the modules whose class
+  documents the details: vpServoEngine and vpFixedServo for the features and the control law, vpServoMPC,
+  vpLuminanceServo, vpTagBundle, vpModelTracker, vpDepthPoseRefinement, vpTagCornerTracker,
+  vpTagCornerRefinement, vpGainTuner, vpConvergenceMonitor, vpTargetLossHandler, vpOnlineHandEye,
+  vpStartupOrchestrator, vpRealTimeProfile, vpMotionMailbox, vpTrace, vpMetricsServer and vpAllocationCounter.
 */
 
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
 #include <iostream>
+#include <limits>
+#include <memory>
 
 #include <visp3/core/vpCameraParameters.h>
+#include <visp3/core/vpImageConvert.h>
+#include <visp3/core/vpIoTools.h>
+#include <visp3/core/vpMeterPixelConversion.h>
+#include <visp3/core/vpPixelMeterConversion.h>
+#include <visp3/core/vpVelocityTwistMatrix.h>
+#include <visp3/core/vpXmlParserCamera.h>
 #include <visp3/detection/vpDetectorAprilTag.h>
 #include <visp3/gui/vpDisplayGDI.h>
 #include <visp3/gui/vpDisplayX.h>
@@ -66,16 +86,36 @@
 #include <visp3/gui/vpPlot.h>
 #include <visp3/io/vpImageIo.h>
 #include <visp3/sensor/vpRealSense2.h>
+#include <visp3/vision/vpPose.h>
 //#include <visp3/sensor/vpPylonFactory.h>
-#include <visp3/visual_features/vpFeatureThetaU.h>
-#include <visp3/visual_features/vpFeatureTranslation.h>
 #include <visp3/vs/vpServo.h>
 #include <visp3/vs/vpServoDisplay.h>
 #include <IPMCMOTION.h>
+#include <vpAllocationCounter.h>
+#include <vpConvergenceMonitor.h>
+#include <vpDepthPoseRefinement.h>
+#include <vpFramePool.h>
+#include <vpGainTuner.h>
+#include <vpLoopJitter.h>
+#include <vpLuminanceServo.h>
+#include <vpMetrics.h>
+#include <vpMetricsServer.h>
+#include <vpModelTracker.h>
+#include <vpOnlineHandEye.h>
+#include <vpRealTimeProfile.h>
 #include <vpRobotKawasaki.h>
+#include <vpServoEngine.h>
+#include <vpServoMPC.h>
+#include <vpStartupOrchestrator.h>
+#include <vpTagBundle.h>
+#include <vpTagCornerRefinement.h>
+#include <vpTagCornerTracker.h>
+#include <vpTargetLossHandler.h>
+#include <vpTickArena.h>
+#include <vpTrace.h>
 
 #if defined(VISP_HAVE_REALSENSE2) && (VISP_CXX_STANDARD >= VISP_CXX_STANDARD_11) &&                                    \
-    (defined(VISP_HAVE_X11) || defined(VISP_HAVE_GDI))
+    defined(VISP_HAVE_PUGIXML) && (defined(VISP_HAVE_X11) || defined(VISP_HAVE_GDI))
 
 void display_point_trajectory(const vpImage<unsigned char> &I, const std::vector<vpImagePoint> &vip,
                               std::vector<vpImagePoint> *traj_vip)
@@ -97,23 +137,220 @@ void display_point_trajectory(const vpImage<unsigned char> &I, const std::vector
   }
 }
 
+/*
+  Display a printf-like text. The text is formatted in \e text, whose capacity is reserved before the servo loop,
+  so that it is not allocated at each iteration.
+*/
+void display_text(const vpImage<unsigned char> &I, int i, int j, const vpColor &color, std::string &text,
+                  const char *format, ...)
+{
+  char buffer[256];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  text.assign(buffer);
+  vpDisplay::displayText(I, i, j, text, color);
+}
+
+/*
+  Return true if the velocity \e v sent in \e frame is saturated by vpRobotKawasaki::setVelocity().
+*/
+bool is_saturated(const vpRobot &robot, vpRobot::vpControlFrameType frame, const vpColVector &v)
+{
+  for (unsigned int i = 0; i < v.size(); i++) {
+    double v_max = (frame != vpRobot::JOINT_STATE && i < 3) ? robot.getMaxTranslationVelocity()
+                                                            : robot.getMaxRotationVelocity();
+    if (std::fabs(v[i]) > v_max) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+  Photometric servo of --servo photometric, until the convergence or a right click. As with the tag, the robot
+  only moves after a left click.
+*/
+void servo_photometric(vpRobotKawasaki &robot, vpRealSense2 &rs, vpImage<unsigned char> &I, vpLuminanceServo &servo,
+                       double threshold, double settle_time, bool opt_plot, bool opt_verbose)
+{
+  vpPlot *plotter = nullptr;
+  int iter_plot = 0;
+  if (opt_plot) {
+    plotter = new vpPlot(2, static_cast<int>(250 * 2), 500, static_cast<int>(I.getWidth()) + 80, 10,
+                         "Real time curves plotter");
+    plotter->setTitle(0, "Photometric error (RMS gray level)");
+    plotter->setTitle(1, "Camera velocities");
+    plotter->initGraph(0, 1);
+    plotter->initGraph(1, 6);
+    plotter->setLegend(0, 0, "error");
+    plotter->setLegend(1, 0, "vc_x");
+    plotter->setLegend(1, 1, "vc_y");
+    plotter->setLegend(1, 2, "vc_z");
+    plotter->setLegend(1, 3, "wc_x");
+    plotter->setLegend(1, 4, "wc_y");
+    plotter->setLegend(1, 5, "wc_z");
+  }
+
+  vpConvergenceMonitor convergence;
+  convergence.setTolerance(vpColVector(1, threshold));
+  convergence.setSettleTime(settle_time);
+
+  bool final_quit = false;
+  bool has_converged = false;
+  bool send_velocities = false;
+  vpColVector v_c(6), error(1);
+  std::string text;
+  text.reserve(256);
+
+  robot.setRobotState(vpRobot::STATE_VELOCITY_CONTROL);
+
+  while (!has_converged && !final_quit) {
+    double t_start = vpTime::measureTimeMs();
+    rs.acquire(I);
+    vpDisplay::display(I);
+
+    unsigned int level = servo.getLevel();
+    double t_law = vpTime::measureTimeMs();
+    bool observable = servo.computeControlLaw(I, v_c);
+    t_law = vpTime::measureTimeMs() - t_law;
+    if (!send_velocities) {
+      v_c = 0;
+    }
+    robot.setVelocity(vpRobot::CAMERA_FRAME, v_c);
+    error[0] = servo.getError();
+
+    if (opt_plot) {
+      plotter->plot(0, iter_plot, error);
+      plotter->plot(1, iter_plot, v_c);
+      iter_plot++;
+    }
+    if (opt_verbose) {
+      std::cout << "Photometric error: " << servo.getError() << " on level " << level << " (" << servo.getNbFeatures()
+                << " pixels) in " << t_law << " ms" << (observable ? "" : ", not enough texture") << "\nv_c: "
+                << v_c.t() << std::endl;
+    }
+
+    // Only the errors at full resolution are comparable to the threshold
+    if (level == 0) {
+      convergence.addSample(vpTime::measureTimeSecond(), error, v_c.infinityNorm());
+      if (convergence.hasConverged()) {
+        has_converged = true;
+        std::cout << "Servo task has converged in " << convergence.getConvergenceTime() << " s"
+                  << (convergence.isAtNoiseFloor() ? " (error at the noise floor)" : "") << std::endl;
+        vpDisplay::displayText(I, 100, 20, "Servo task has converged", vpColor::red);
+      }
+    }
+
+    display_text(I, 20, 20, vpColor::red, text, "Left click to %s, right click to quit.",
+                 send_velocities ? "stop the robot" : "servo the robot");
+    display_text(I, 40, 20, vpColor::red, text, "Loop time: %g ms", vpTime::measureTimeMs() - t_start);
+    display_text(I, 60, 20, vpColor::red, text, "Photometric error: %g (level %u, %g ms)", servo.getError(), level,
+                 t_law);
+    vpDisplay::flush(I);
+
+    vpMouseButton::vpMouseButtonType button;
+    if (vpDisplay::getClick(I, button, false)) {
+      switch (button) {
+      case vpMouseButton::button1:
+        send_velocities = !send_velocities;
+        // Start again from the coarsest level, the error didn't decrease while the robot was stopped
+        servo.reset();
+        convergence.reset();
+        break;
+
+      case vpMouseButton::button3:
+        final_quit = true;
+        break;
+
+      default:
+        break;
+      }
+    }
+  }
+  std::cout << "Stop the robot " << std::endl;
+  robot.setRobotState(vpRobot::STATE_STOP);
+
+  if (plotter != nullptr) {
+    delete plotter;
+  }
+
+  while (!final_quit) {
+    rs.acquire(I);
+    vpDisplay::display(I);
+    vpDisplay::displayText(I, 20, 20, "Click to quit the program.", vpColor::red);
+    vpDisplay::displayText(I, 40, 20, "Visual servo converged.", vpColor::red);
+    if (vpDisplay::getClick(I, false)) {
+      final_quit = true;
+    }
+    vpDisplay::flush(I);
+  }
+}
+
 int main(int argc, char **argv)
 {
   double opt_tagSize = 0.096;
   std::string opt_eMc_filename = "eMc.yaml";
+  std::string opt_intrinsic_filename = "camera.xml";
+  std::string opt_camera_name = "Camera";
+  std::string opt_tag_bundle_filename = "";
+  std::string opt_model_filename = "";
+  std::string opt_model_config_filename = "";
+  std::string opt_model_init_filename = "";
+  std::string opt_desired_pose_filename = "";
+  std::string opt_online_eMc_filename = "";
+  std::string opt_rt_profile_filename = "";
+  std::string opt_motion_server = "";
+  std::string opt_trace_filename = "";
+  int opt_metrics_port = 0;
+  bool opt_count_allocations = false;
   bool display_tag = true;
   int opt_quad_decimate = 2;
+  int opt_detection_period = 1;
+  double opt_refine_corners = 0.;
+  bool opt_fixed_control_law = false;
+  bool opt_check_control_law = false;
+  bool opt_joint_space = false;
+  bool opt_mpc = false;
+  std::string opt_gain_filename = "";
+  std::string opt_tune_gain_filename = "";
+  double opt_tune_period = 33., opt_tune_latency = 50., opt_tune_noise = 0.5;
   bool opt_verbose = false;
   bool opt_plot = true;
   bool opt_adaptive_gain = false;
   bool opt_task_sequencing = false;
+  bool opt_depth_fusion = false;
+  vpServoEngine::vpServoMode opt_servo_mode = vpServoEngine::POSITION_BASED;
+  bool opt_photometric = false;
+  std::string opt_desired_image_filename = "";
+  std::string opt_save_desired_image_filename = "";
+  double opt_photometric_depth = 0.3;
+  double opt_photometric_threshold = 2.;
   double convergence_threshold_t = 0.0001, convergence_threshold_tu = 0.05; //0.0005    0.5
+  double opt_settle_time = 0.3;
+  int opt_coasting_frames = 5;
+  double opt_startup_timeout = 40.;
 
   for (int i = 1; i < argc; i++) {
     if (std::string(argv[i]) == "--tag_size" && i + 1 < argc) {
       opt_tagSize = std::stod(argv[i + 1]);
     } else if (std::string(argv[i]) == "--eMc" && i + 1 < argc) {
       opt_eMc_filename = std::string(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--intrinsic" && i + 1 < argc) {
+      opt_intrinsic_filename = std::string(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--camera_name" && i + 1 < argc) {
+      opt_camera_name = std::string(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--tag_bundle" && i + 1 < argc) {
+      opt_tag_bundle_filename = std::string(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--model" && i + 1 < argc) {
+      opt_model_filename = std::string(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--model_config" && i + 1 < argc) {
+      opt_model_config_filename = std::string(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--model_init" && i + 1 < argc) {
+      opt_model_init_filename = std::string(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--desired_pose" && i + 1 < argc) {
+      opt_desired_pose_filename = std::string(argv[i + 1]);
     } else if (std::string(argv[i]) == "--verbose") {
       opt_verbose = true;
     } else if (std::string(argv[i]) == "--plot") {
@@ -122,35 +359,220 @@ int main(int argc, char **argv)
       opt_adaptive_gain = true;
     } else if (std::string(argv[i]) == "--task_sequencing") {
       opt_task_sequencing = true;
+    } else if (std::string(argv[i]) == "--fixed_control_law") {
+      opt_fixed_control_law = true;
+    } else if (std::string(argv[i]) == "--check_control_law") {
+      opt_check_control_law = true;
+    } else if (std::string(argv[i]) == "--joint_space") {
+      opt_joint_space = true;
+    } else if (std::string(argv[i]) == "--mpc") {
+      opt_mpc = true;
+      opt_joint_space = true;
+    } else if (std::string(argv[i]) == "--gain" && i + 1 < argc) {
+      opt_gain_filename = std::string(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--tune_gain" && i + 1 < argc) {
+      opt_tune_gain_filename = std::string(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--tune_period" && i + 1 < argc) {
+      opt_tune_period = std::stod(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--tune_latency" && i + 1 < argc) {
+      opt_tune_latency = std::stod(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--tune_noise" && i + 1 < argc) {
+      opt_tune_noise = std::stod(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--servo" && i + 1 < argc) {
+      if (std::string(argv[i + 1]) == "photometric") {
+        opt_photometric = true;
+      } else if (!vpServoEngine::parseMode(std::string(argv[i + 1]), opt_servo_mode)) {
+        std::cout << "Unknown servo " << argv[i + 1] << ", use pbvs, ibvs, 2.5d or photometric" << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else if (std::string(argv[i]) == "--desired_image" && i + 1 < argc) {
+      opt_desired_image_filename = std::string(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--save_desired_image" && i + 1 < argc) {
+      opt_save_desired_image_filename = std::string(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--photometric_depth" && i + 1 < argc) {
+      opt_photometric_depth = std::stod(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--photometric_threshold" && i + 1 < argc) {
+      opt_photometric_threshold = std::stod(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--online_eMc" && i + 1 < argc) {
+      opt_online_eMc_filename = std::string(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--rt_profile" && i + 1 < argc) {
+      opt_rt_profile_filename = std::string(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--motion_server" && i + 1 < argc) {
+      opt_motion_server = std::string(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--trace" && i + 1 < argc) {
+      opt_trace_filename = std::string(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--metrics_port" && i + 1 < argc) {
+      opt_metrics_port = std::stoi(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--count_allocations") {
+      opt_count_allocations = true;
+    } else if (std::string(argv[i]) == "--depth_fusion") {
+      opt_depth_fusion = true;
     } else if (std::string(argv[i]) == "--quad_decimate" && i + 1 < argc) {
       opt_quad_decimate = std::stoi(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--detection_period" && i + 1 < argc) {
+      opt_detection_period = std::max(1, std::stoi(argv[i + 1]));
+    } else if (std::string(argv[i]) == "--refine_corners" && i + 1 < argc) {
+      opt_refine_corners = std::stod(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--settle_time" && i + 1 < argc) {
+      opt_settle_time = std::stod(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--startup_timeout" && i + 1 < argc) {
+      opt_startup_timeout = std::stod(argv[i + 1]);
+    } else if (std::string(argv[i]) == "--coasting_frames" && i + 1 < argc) {
+      opt_coasting_frames = std::max(0, std::stoi(argv[i + 1]));
     } else if (std::string(argv[i]) == "--no-convergence-threshold") {
       convergence_threshold_t = 0.;
       convergence_threshold_tu = 0.;
+      opt_photometric_threshold = 0.;
     } else if (std::string(argv[i]) == "--help" || std::string(argv[i]) == "-h") {
       std::cout
           << argv[0] << " [--ip <default "
           << ">] [--tag_size <marker size in meter; default " << opt_tagSize << ">] [--eMc <eMc extrinsic file>] "
-          << "[--quad_decimate <decimation; default " << opt_quad_decimate
-          << ">] [--adaptive_gain] [--plot] [--task_sequencing] [--no-convergence-threshold] [--verbose] [--help] [-h]"
-          << "\n";
+          << "[--intrinsic <camera xml file; default " << opt_intrinsic_filename << ">] [--camera_name <name; default "
+          << opt_camera_name << ">] [--tag_bundle <tag bundle file>] [--model <cao file>] [--model_config <xml file>] "
+          << "[--model_init <init file>] [--desired_pose <pose file>] [--servo <pbvs|ibvs|2.5d|photometric; default "
+          << vpServoEngine::getModeName(opt_servo_mode) << ">] [--desired_image <image file>] "
+          << "[--save_desired_image <image file>] [--photometric_depth <m; default " << opt_photometric_depth
+          << ">] [--photometric_threshold <gray level; default " << opt_photometric_threshold
+          << ">] [--quad_decimate <decimation; default " << opt_quad_decimate
+          << ">] [--detection_period <period in frames; default " << opt_detection_period << ">] "
+          << "[--refine_corners <translation error in meter>] [--adaptive_gain] [--plot] [--task_sequencing] "
+          << "[--fixed_control_law] [--check_control_law] [--joint_space] [--mpc] [--gain <gain file>] "
+          << "[--tune_gain <gain file>] "
+          << "[--tune_period <ms; default " << opt_tune_period << ">] [--tune_latency <ms; default " << opt_tune_latency
+          << ">] [--tune_noise <pixel; default " << opt_tune_noise << ">] "
+          << "[--depth_fusion] [--online_eMc <eMc output file>] [--settle_time <s; default " << opt_settle_time
+          << ">] [--no-convergence-threshold] [--coasting_frames <n; default " << opt_coasting_frames
+          << ">] [--startup_timeout <s; default " << opt_startup_timeout << ">] [--rt_profile <profile file>] "
+          << "[--motion_server <mailbox name>] [--trace <json file>] [--metrics_port <port>] [--count_allocations] "
+          << "[--verbose] [--help] [-h]"
+          << "\n"
+          << "  --servo <mode>               Visual features: pbvs for the tag pose, ibvs for the tag corners, 2.5d\n"
+          << "                               for the image point and log depth of the tag center with the 3D\n"
+          << "                               rotation, photometric for the intensities of all the pixels compared to\n"
+          << "                               --desired_image\n"
+          << "  --save_desired_image <file>  Save the desired image of --servo photometric, the camera being at the\n"
+          << "                               desired pose in front of a textured, roughly planar scene at\n"
+          << "                               --photometric_depth\n"
+          << "  --photometric_threshold <g>  RMS intensity error that stops --servo photometric\n"
+          << "  --intrinsic <file>           Camera parameters with distortion of --camera_name at 640x480, computed\n"
+          << "                               by calibrationKawasaki --calibrate_intrinsic\n"
+          << "  --tag_bundle <file>          Tags with known poses in the object frame, the other tags are ignored\n"
+          << "  --model <file.cao>           Track an object without tag from its CAD model with the moving edges,\n"
+          << "                               KLT points and dense depth, configured by --model_config; the pose is\n"
+          << "                               initialized by clicking the points of --model_init, again with a middle\n"
+          << "                               click; the desired pose is read from --desired_pose\n"
+          << "  --depth_fusion               Refine the tag pose with a plane fitted on the depth inside the tag\n"
+          << "  --detection_period <n>       Detect the tag every n frames and track its corners in between\n"
+          << "  --refine_corners <error>     Sub-pixel tag corners below this translation error in meter\n"
+          << "  --fixed_control_law          Compute the control law with vpFixedServo, without dynamic allocation\n"
+          << "  --check_control_law          Compare vpFixedServo with vpServo::computeControlLaw() for pbvs, ibvs\n"
+          << "                               and 2.5d, at random poses around the default desired pose, and quit\n"
+          << "  --joint_space                Compute the joint velocities with the task Jacobian L cVe eJe\n"
+          << "  --mpc                        Model predictive control within the joint limits, keeping the tag in the\n"
+          << "                               image; implies --joint_space\n"
+          << "  --gain <file>                Constant or adaptive gain written by --tune_gain\n"
+          << "  --tune_gain <file>           Simulate servo episodes around the current joint positions with\n"
+          << "                               --tune_period, --tune_latency and --tune_noise, and save the gain that\n"
+          << "                               converges the fastest\n"
+          << "  --settle_time <s>            Time the errors have to stay below their thresholds, 0 to stop at once\n"
+          << "  --coasting_frames <n>        Frames servoed on the predicted pose after a tag loss\n"
+          << "  --startup_timeout <s>        Time to start the robot, the camera and the detector concurrently\n"
+          << "  --online_eMc <file>          Refine eMc during the servo, the tag being still, and save it at the end\n"
+          << "  --rt_profile <file>          Real-time scheduling of the threads, checked before the startup\n"
+          << "  --motion_server <name>       Send the velocities to motionKawasaki --name <name> in shared memory\n"
+          << "  --trace <file>               Save a Chrome trace of the iterations, with VP_TRACE defined\n"
+          << "  --metrics_port <port>        Serve the loop metrics at http://127.0.0.1:<port>/metrics\n"
+          << "  --count_allocations          Fail if the image path allocates, or with --fixed_control_law the\n"
+          << "                               features and the control law; print the allocations of the iteration,\n"
+          << "                               with VP_COUNT_ALLOCATIONS defined\n";
       return EXIT_SUCCESS;
     }
   }
 
+  // If --check_control_law is used, compare the fixed control law with vpServo offline and quit
+  if (opt_check_control_law) {
+    std::vector<vpPoint> points(4);
+    points[0].setWorldCoordinates(-opt_tagSize / 2., -opt_tagSize / 2., 0);
+    points[1].setWorldCoordinates( opt_tagSize / 2., -opt_tagSize / 2., 0);
+    points[2].setWorldCoordinates( opt_tagSize / 2.,  opt_tagSize / 2., 0);
+    points[3].setWorldCoordinates(-opt_tagSize / 2.,  opt_tagSize / 2., 0);
+    vpHomogeneousMatrix cdMo(vpTranslationVector(0, 0, opt_tagSize * 3),
+                             vpRotationMatrix({1, 0, 0, 0, -1, 0, 0, 0, -1}));
+    return vpServoEngine::checkFixedControlLaw(std::cout, points, cdMo) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  // Scheduling of the process if --rt_profile is used, before any thread is created
+  vpRealTimeProfile rt_profile;
+  bool use_rt_profile = !opt_rt_profile_filename.empty();
+  if (use_rt_profile) {
+    if (!rt_profile.load(opt_rt_profile_filename)) {
+      std::cout << "Can not read the real-time profile " << opt_rt_profile_filename << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (!rt_profile.preflight(std::cout)) {
+      std::cout << "The real-time profile can not be applied, fix the errors above." << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (!rt_profile.applyProcess()) {
+      std::cout << "Warning: the cores or the memory locking of the real-time profile are not applied." << std::endl;
+    }
+  }
+
+  if (!opt_trace_filename.empty()) {
+    if (!vpTrace::isCompiled()) {
+      std::cout << "Warning: build with VP_TRACE defined to record a trace in " << opt_trace_filename << std::endl;
+    }
+    vpTrace::start();
+  }
+
+  // Metrics of the servo loop, served on localhost if --metrics_port is used
+  vpMetricsRegistry metrics;
+  vpMetricsServer metrics_server(metrics);
+  if (opt_metrics_port > 0) {
+    try {
+      metrics_server.start(static_cast<unsigned short>(opt_metrics_port));
+    } catch (const vpException &e) {
+      std::cout << "Warning: " << e.getStringMessage() << ", the metrics are not served." << std::endl;
+    }
+  }
+
+  if (opt_count_allocations && !vpAllocationCounter::isCompiled()) {
+    std::cout << "Warning: build with VP_COUNT_ALLOCATIONS defined to count the allocations" << std::endl;
+  }
+  bool allocation_test_passed = true;
+
   vpRobotKawasaki robot;
+  if (!opt_motion_server.empty()) {
+    // connect() opens the mailbox of the motion process instead of the motion controller
+    robot.setMotionServer(opt_motion_server);
+  }
 
   try {
-    if (robot.connect() == EXIT_FAILURE)
-	{
-		std::cout << "Can not connect to the robot." << std::endl;
-		return EXIT_FAILURE;
-	}
-	else
-	{
-		std::cout << "Successfully connect to the robot." << std::endl;
-	}
-	
+    // The objects used by the startup threads are declared first, to outlive their threads that the
+    // orchestrator joins when it is destroyed, on an early return or when wait() throws
+    vpRealSense2 rs;
+    rs2::config config;
+    vpDetectorAprilTag::vpAprilTagFamily tagFamily = vpDetectorAprilTag::TAG_36h11;
+    vpDetectorAprilTag::vpPoseEstimationMethod poseEstimationMethod = vpDetectorAprilTag::HOMOGRAPHY_VIRTUAL_VS;
+    // vpDetectorAprilTag::vpPoseEstimationMethod poseEstimationMethod = vpDetectorAprilTag::BEST_RESIDUAL_VIRTUAL_VS;
+    std::unique_ptr<vpDetectorAprilTag> detector_ptr;
+    // Enabling the velocity control takes seconds, do it during the startup if the servo runs
+    bool servo = opt_tune_gain_filename.empty() && opt_save_desired_image_filename.empty();
+
+    // Bring up the robot drives, the camera and the tag detector concurrently
+    vpStartupOrchestrator startup(opt_startup_timeout);
+    startup.launch("robot", [&]() {
+      if (robot.connect() == EXIT_FAILURE) {
+        std::cout << "Can not connect to the robot." << std::endl;
+        return false;
+      }
+      std::cout << "Successfully connect to the robot." << std::endl;
+      if (servo) {
+        robot.setRobotState(vpRobot::STATE_VELOCITY_CONTROL);
+      }
+      return true;
+    });
+
 	//vpPylonFactory &factory = vpPylonFactory::instance();
     //vpPylonGrabber *g;
     //g = factory.createPylonGrabber(vpPylonFactory::BASLER_GIGE);
@@ -158,13 +580,22 @@ int main(int argc, char **argv)
     //vpImage<unsigned char> I(width, height);
     //g->open(I);
 
-	vpRealSense2 rs;
-	rs2::config config;
 	unsigned int width = 640, height = 480;
 	config.enable_stream(RS2_STREAM_COLOR, 640, 480, RS2_FORMAT_RGBA8, 60);
 	config.enable_stream(RS2_STREAM_DEPTH, 640, 480, RS2_FORMAT_Z16, 60);
 	config.enable_stream(RS2_STREAM_INFRARED, 640, 480, RS2_FORMAT_Y8, 60);
-	rs.open(config);
+    startup.launch("camera", [&]() {
+      rs.open(config);
+      return true;
+    });
+
+    startup.launch("detector", [&]() {
+      detector_ptr.reset(new vpDetectorAprilTag(tagFamily));
+      detector_ptr->setAprilTagPoseEstimationMethod(poseEstimationMethod);
+      detector_ptr->setDisplayTag(display_tag);
+      detector_ptr->setAprilTagQuadDecimate(opt_quad_decimate);
+      return true;
+    });
 
     // Get camera extrinsics
 	vpPoseVector ePc;
@@ -179,7 +610,11 @@ int main(int argc, char **argv)
 
     // If provided, read camera extrinsics from --eMc <file>
     if (!opt_eMc_filename.empty()) {
-      ePc.loadYAML(opt_eMc_filename, ePc);
+      if (!vpPoseVector::loadYAML(opt_eMc_filename, ePc)) {
+        std::cout << "Can not read " << opt_eMc_filename << ", compute it with calibrationKawasaki --hand_eye"
+                  << std::endl;
+        return EXIT_FAILURE;
+      }
     } else {
       std::cout << "Warning, opt_eMc_filename is empty! Use hard coded values."
                 << "\n";
@@ -187,58 +622,242 @@ int main(int argc, char **argv)
     vpHomogeneousMatrix eMc(ePc);
     std::cout << "eMc:\n" << eMc << "\n";
 
-    // Get camera intrinsics
-    //vpCameraParameters cam(1188.3968565569203, 1185.5725523445672, 334.056237752453, 230.40394441511046, -0.05535463855804508, 0.055485821355583782);
-	//vpCameraParameters cam = rs.getCameraParameters(RS2_STREAM_COLOR, vpCameraParameters::perspectiveProjWithDistortion);
-	vpCameraParameters cam(611.1634091225, 612.4700916733, 345.5597302213, 235.2964336455, 0.0743932293, -0.0725463672);
-	std::cout << "cam:\n" << cam << "\n";
+    // Get camera intrinsics from --intrinsic <file>
+    //vpCameraParameters cam = rs.getCameraParameters(RS2_STREAM_COLOR, vpCameraParameters::perspectiveProjWithDistortion);
+    vpCameraParameters cam;
+    vpXmlParserCamera parser;
+    if (parser.parse(cam, opt_intrinsic_filename, opt_camera_name, vpCameraParameters::perspectiveProjWithDistortion,
+                     width, height) != vpXmlParserCamera::SEQUENCE_OK) {
+      std::cout << "Can not read the " << width << "x" << height << " camera " << opt_camera_name << " in "
+                << opt_intrinsic_filename << ", compute it with calibrationKawasaki --calibrate_intrinsic" << std::endl;
+      return EXIT_FAILURE;
+    }
+    std::cout << "cam:\n" << cam << "\n";
+
+    // Desired pose to reach
+    vpHomogeneousMatrix cdMo(vpTranslationVector(0, 0, opt_tagSize * 3), // 3 times tag with along camera z axis
+                             vpRotationMatrix({1, 0, 0, 0, -1, 0, 0, 0, -1}));
+    // If provided, read the desired pose from --desired_pose <file>
+    if (!opt_desired_pose_filename.empty()) {
+      vpPoseVector cdPo;
+      if (!vpPoseVector::loadYAML(opt_desired_pose_filename, cdPo)) {
+        std::cout << "Can not read the desired pose file " << opt_desired_pose_filename << std::endl;
+        return EXIT_FAILURE;
+      }
+      cdMo.buildFrom(cdPo);
+    }
+
+    // With --model, the object pose is given by the model-based tracker
+    bool use_model = !opt_model_filename.empty();
+    if (use_model && opt_servo_mode != vpServoEngine::POSITION_BASED) {
+      std::cout << "The model-based tracker only provides the object pose, use pbvs features" << std::endl;
+      opt_servo_mode = vpServoEngine::POSITION_BASED;
+    }
+    if (use_model && opt_depth_fusion) {
+      std::cout << "The model-based tracker already uses the depth, --depth_fusion is ignored" << std::endl;
+      opt_depth_fusion = false;
+    }
+
+    // If --tune_gain is used, tune the gain around the current robot position and quit
+    if (!opt_tune_gain_filename.empty()) {
+      startup.wait("robot");
+      vpColVector q_desired(6);
+      robot.getPosition(vpRobot::JOINT_STATE, q_desired);
+      vpGainTuner::vpServoType tuner_type = vpGainTuner::POSITION_BASED;
+      if (opt_servo_mode == vpServoEngine::IMAGE_BASED) {
+        tuner_type = vpGainTuner::IMAGE_BASED;
+      } else if (opt_servo_mode == vpServoEngine::HYBRID) {
+        tuner_type = vpGainTuner::HYBRID;
+      }
+      vpGainTuner tuner(robot, tuner_type);
+      tuner.setCameraParameters(cam, width, height);
+      tuner.set_eMc(eMc);
+      tuner.setDesiredPose(cdMo);
+      tuner.setJointPosition(q_desired);
+      tuner.setTagSize(opt_tagSize);
+      if (tuner_type != vpGainTuner::IMAGE_BASED) {
+        // Otherwise the simulated servo stops on the image error of the IBVS example
+        tuner.setConvergenceThreshold(convergence_threshold_t, convergence_threshold_tu);
+      }
+      tuner.setSamplingTime(opt_tune_period / 1000.);
+      tuner.setLatency(opt_tune_latency / 1000.);
+      tuner.setImageNoise(opt_tune_noise);
+
+      std::cout << "Tuning the gain..." << std::endl;
+      double t_tune = vpTime::measureTimeMs();
+      bool feasible = tuner.tune();
+      const vpGainTuner::vpGainScore &score = tuner.getBestScore();
+      std::cout << "Tuning done in " << (vpTime::measureTimeMs() - t_tune) / 1000. << " s" << std::endl;
+      if (!feasible) {
+        std::cout << "Warning: no gain satisfies the overshoot and saturation constraints, keep the fastest one"
+                  << std::endl;
+      }
+      std::cout << "Gain: " << tuner.getBestGain() << "\nMean time to converge: " << score.time
+                << " s, converged episodes: " << 100 * score.success << "%, overshoot: " << 100 * score.overshoot
+                << "%, saturated velocities: " << 100 * score.saturation << "%" << std::endl;
+      if (!tuner.saveGain(opt_tune_gain_filename)) {
+        std::cout << "Can not write the gain file " << opt_tune_gain_filename << std::endl;
+        return EXIT_FAILURE;
+      }
+      std::cout << "Gain saved in " << opt_tune_gain_filename << std::endl;
+      return EXIT_SUCCESS;
+    }
 
 	vpImage<unsigned char> I(height, width);
+	vpImage<vpRGBa> Ic(height, width);
+	vpImage<uint16_t> I_depth_raw(height, width);
+	rs2::align align_to(RS2_STREAM_COLOR);
+    // Frames of the servo loop: the one being processed and the one kept by the pipelined model-based tracker
+    vpFramePool frame_pool(3, height, width);
 
+    // The display is created in the main thread while the other components start
 #if defined(VISP_HAVE_X11)
-    vpDisplayX dc(I, 10, 10, "Color image");
+    vpDisplayX dc;
 #elif defined(VISP_HAVE_GDI)
-	vpDisplayGDI dc(I, 10, 10, "Color image");
+    vpDisplayGDI dc;
 #elif defined(VISP_HAVE_OPENCV)
-	vpDisplayOpenCV dc(I, 10, 10, "Color image");
+    vpDisplayOpenCV dc;
 #endif
+    startup.run("display", [&]() {
+      dc.init(I, 10, 10, "Color image");
+      return true;
+    });
+    startup.wait("camera");
+
+    // Refine the tag pose with the depth map if --depth_fusion is used
+    vpDepthPoseRefinement refinement;
+    refinement.setCameraParameters(cam);
+    refinement.setDepthScale(rs.getDepthScale());
+
+    // If --save_desired_image is used, save the image at the desired pose of the photometric servo and quit
+    if (!opt_save_desired_image_filename.empty()) {
+      rs.acquire(I);
+      vpImageIo::write(I, opt_save_desired_image_filename);
+      std::cout << "Desired image saved in " << opt_save_desired_image_filename << std::endl;
+      return EXIT_SUCCESS;
+    }
 
-    vpDetectorAprilTag::vpAprilTagFamily tagFamily = vpDetectorAprilTag::TAG_36h11;
-    vpDetectorAprilTag::vpPoseEstimationMethod poseEstimationMethod = vpDetectorAprilTag::HOMOGRAPHY_VIRTUAL_VS;
-    // vpDetectorAprilTag::vpPoseEstimationMethod poseEstimationMethod = vpDetectorAprilTag::BEST_RESIDUAL_VIRTUAL_VS;
-    vpDetectorAprilTag detector(tagFamily);
-    detector.setAprilTagPoseEstimationMethod(poseEstimationMethod);
-    detector.setDisplayTag(display_tag);
-    detector.setAprilTagQuadDecimate(opt_quad_decimate);
+    // Gain of the control law
+    vpAdaptiveGain lambda;
+    if (!opt_gain_filename.empty()) {
+      // Gain tuned by --tune_gain
+      if (!vpGainTuner::loadGain(opt_gain_filename, lambda)) {
+        std::cout << "Can not read the gain file " << opt_gain_filename << std::endl;
+        return EXIT_FAILURE;
+      }
+      std::cout << "Gain: " << lambda << std::endl;
+    } else if (opt_adaptive_gain) {
+      lambda.initStandard(3, 0.4, 30); // lambda(0)=4, lambda(oo)=0.4 and lambda'(0)=30
+    } else {
+      lambda.initFromConstant(0.8);
+    }
 
-    // Servo
-    vpHomogeneousMatrix cdMc, cMo, oMo;
+    if (opt_photometric) {
+      if (opt_desired_image_filename.empty()) {
+        std::cout << "The photometric servo needs a desired image, use --desired_image <file>" << std::endl;
+        return EXIT_FAILURE;
+      }
+      vpImage<unsigned char> I_desired;
+      vpImageIo::read(I_desired, opt_desired_image_filename);
+      vpLuminanceServo photometric;
+      photometric.setCameraParameters(cam);
+      photometric.setDepth(opt_photometric_depth);
+      photometric.setDesiredImage(I_desired);
+      photometric.setLambda(lambda);
+      std::cout << "Photometric servo with " << vpLuminanceServo::getKernelName() << " kernels" << std::endl;
+
+      startup.wait("robot");
+      std::cout << startup.getReport() << std::endl;
+      robot.set_eMc(eMc);
+      if (use_rt_profile && !rt_profile.applyControlThread()) {
+        std::cout << "Warning: the control thread scheduling of the real-time profile is not applied." << std::endl;
+      }
+      servo_photometric(robot, rs, I, photometric, opt_photometric_threshold, opt_settle_time, opt_plot, opt_verbose);
+      return EXIT_SUCCESS;
+    }
 
-    // Desired pose to reach
-    vpHomogeneousMatrix cdMo(vpTranslationVector(0, 0, opt_tagSize * 3), // 3 times tag with along camera z axis
-                             vpRotationMatrix({1, 0, 0, 0, -1, 0, 0, 0, -1}));
+    startup.wait("detector");
+    vpDetectorAprilTag &detector = *detector_ptr;
 
-    cdMc = cdMo * cMo.inverse();
-    vpFeatureTranslation t(vpFeatureTranslation::cdMc);
-    vpFeatureThetaU tu(vpFeatureThetaU::cdRc);
-    t.buildFrom(cdMc);
-    tu.buildFrom(cdMc);
+    // If provided, read the tag bundle from --tag_bundle <file>. Otherwise a single tag is used
+    vpTagBundle bundle;
+    bool use_bundle = !opt_tag_bundle_filename.empty();
+    if (use_bundle) {
+      if (!bundle.load(opt_tag_bundle_filename)) {
+        std::cout << "Can not read the tag bundle file " << opt_tag_bundle_filename << std::endl;
+        return EXIT_FAILURE;
+      }
+      std::cout << "Tag bundle with " << bundle.getNbTags() << " tags, reference tag id: " << bundle.getReferenceId()
+                << "\n";
+    }
 
-    vpFeatureTranslation td(vpFeatureTranslation::cdMc);
-    vpFeatureThetaU tud(vpFeatureThetaU::cdRc);
+    // If --model is used, track the object from its CAD model
+    vpModelTracker model_tracker;
+    if (use_model) {
+      if (opt_model_init_filename.empty()) {
+        opt_model_init_filename = vpIoTools::getNameWE(opt_model_filename) + ".init";
+        opt_model_init_filename = vpIoTools::createFilePath(vpIoTools::getParent(opt_model_filename),
+                                                            opt_model_init_filename);
+      }
+      model_tracker.loadModel(opt_model_filename, opt_model_config_filename);
+      model_tracker.setCameraParameters(cam);
+      model_tracker.setDepthScale(rs.getDepthScale());
+      rs.acquire(I);
+      vpDisplay::display(I);
+      vpDisplay::flush(I);
+      model_tracker.initClick(I, opt_model_init_filename);
+    }
 
-    vpServo task;
-    task.addFeature(t, td);
-    task.addFeature(tu, tud);
-    task.setServo(vpServo::EYEINHAND_CAMERA);
-    task.setInteractionMatrixType(vpServo::CURRENT);
+    // If --detection_period > 1, track the tag corners between two detections
+    vpTagCornerTracker tracker;
+    int nb_tracked_frames = 0;
+    // If --refine_corners is used, refine the tag corners near the convergence
+    vpTagCornerRefinement corner_refinement;
+    double last_error_t = std::numeric_limits<double>::max();
+    // Corners in the object frame of the tag used for the tracking and the depth fusion
+    std::vector<vpPoint> tag_points(4);
+    tag_points[0].setWorldCoordinates(-opt_tagSize / 2., -opt_tagSize / 2., 0);
+    tag_points[1].setWorldCoordinates( opt_tagSize / 2., -opt_tagSize / 2., 0);
+    tag_points[2].setWorldCoordinates( opt_tagSize / 2.,  opt_tagSize / 2., 0);
+    tag_points[3].setWorldCoordinates(-opt_tagSize / 2.,  opt_tagSize / 2., 0);
+    vpHomogeneousMatrix oMt; // Pose of this tag in the object frame
+
+    // Keep the servo running when the tag is missed, search it when it is lost
+    vpTargetLossHandler loss;
+    loss.setQuadDecimate(static_cast<float>(opt_quad_decimate));
+    loss.setMaxCoastingFrames(static_cast<unsigned int>(opt_coasting_frames));
 
-    if (opt_adaptive_gain) {
-      vpAdaptiveGain lambda(3, 0.4, 30); // lambda(0)=4, lambda(oo)=0.4 and lambda'(0)=30
-      task.setLambda(lambda);
-    } else {
-      task.setLambda(0.8);
+    // Servo
+    vpHomogeneousMatrix cdMc, cMo, oMo;
+
+    // Features selected by --servo, on the corners of the reference tag with a tag bundle
+    vpServoEngine engine;
+    engine.init(opt_servo_mode, use_bundle ? bundle.getTagCorners(bundle.getReferenceId()) : tag_points);
+    engine.setFixedControlLaw(opt_fixed_control_law);
+    // Velocities are computed and sent either in the camera frame or in the joint space
+    vpRobot::vpControlFrameType control_frame = opt_joint_space ? vpRobot::JOINT_STATE : vpRobot::CAMERA_FRAME;
+    vpVelocityTwistMatrix cVe(eMc.inverse());
+    vpMatrix eJe;
+    if (opt_joint_space) {
+      engine.setJointSpace(cVe);
+    }
+
+    // Constrained control law if --mpc is used
+    vpServoMPC mpc;
+    vpColVector q(6), qdot_sent(6);
+    const double max_joint_acceleration = 1.5; // rad/s^2
+    if (opt_mpc) {
+      vpColVector q_min, q_max;
+      robot.getJointLimits(q_min, q_max);
+      mpc.setJointLimits(q_min, q_max);
+      mpc.setJointVelocityLimits(vpColVector(6, robot.getMaxRotationVelocity()));
+      mpc.setJointAccelerationLimits(vpColVector(6, max_joint_acceleration));
+      mpc.setImageBounds(cam, I.getWidth(), I.getHeight(), 20);
     }
+    double t_mpc_prev = 0;
+    bool mpc_feasible = true; // To report the transitions to an infeasible QP only
+
+    engine.setLambda(lambda);
 
     vpPlot *plotter = nullptr;
     int iter_plot = 0;
@@ -247,19 +866,16 @@ int main(int argc, char **argv)
       plotter = new vpPlot(4, static_cast<int>(250 * 2), 500 * 2, static_cast<int>(I.getWidth()) + 80, 10,
                            "Real time curves plotter");
       plotter->setTitle(0, "Visual features error");
-      plotter->setTitle(1, "Camera velocities");
+      plotter->setTitle(1, opt_joint_space ? "Camera velocities (from joint velocities)" : "Camera velocities");
 	  plotter->setTitle(2, "Axis velocities(deg)");
 	  plotter->setTitle(3, "Motor velocities(deg)");
-      plotter->initGraph(0, 6);
+      plotter->initGraph(0, engine.getDimension());
       plotter->initGraph(1, 6);
 	  plotter->initGraph(2, 6);
 	  plotter->initGraph(3, 6);
-      plotter->setLegend(0, 0, "error_feat_tx");
-      plotter->setLegend(0, 1, "error_feat_ty");
-      plotter->setLegend(0, 2, "error_feat_tz");
-      plotter->setLegend(0, 3, "error_theta_ux");
-      plotter->setLegend(0, 4, "error_theta_uy");
-      plotter->setLegend(0, 5, "error_theta_uz");
+      for (unsigned int i = 0; i < engine.getDimension(); i++) {
+        plotter->setLegend(0, i, "error_feat_" + engine.getFeatureName(i));
+      }
       plotter->setLegend(1, 0, "vc_x");
       plotter->setLegend(1, 1, "vc_y");
       plotter->setLegend(1, 2, "vc_z");
@@ -286,53 +902,269 @@ int main(int argc, char **argv)
     bool servo_started = false;
     std::vector<vpImagePoint> *traj_vip = nullptr; // To memorize point trajectory
 
+    // Convergence on the translation and rotation errors
+    vpConvergenceMonitor convergence;
+    vpColVector convergence_tolerance(2), convergence_errors(2);
+    convergence_tolerance[0] = convergence_threshold_t;
+    convergence_tolerance[1] = convergence_threshold_tu;
+    convergence.setTolerance(convergence_tolerance);
+    convergence.setSettleTime(opt_settle_time);
+
     static double t_init_servo = vpTime::measureTimeMs();
 
     robot.set_eMc(eMc); // Set location of the camera wrt end-effector frame
-    robot.setRobotState(vpRobot::STATE_VELOCITY_CONTROL);
+    // Velocity control is enabled by the startup
+    startup.waitAll();
+    std::cout << startup.getReport() << std::endl;
+    frame_pool.setDisplay(I);
+
+    // Refinement of eMc in a background thread if --online_eMc is used
+    bool use_online_eMc = !opt_online_eMc_filename.empty();
+    vpOnlineHandEye online_hand_eye(robot);
+    unsigned int nb_eMc_updates = 0;
+    vpColVector q_image(6), q_image_prev(6);
+    if (use_online_eMc) {
+      online_hand_eye.start(eMc);
+    }
+
+    // The other threads are created, the control loop can take its priority and cores
+    if (use_rt_profile && !rt_profile.applyControlThread()) {
+      std::cout << "Warning: the control thread scheduling of the real-time profile is not applied." << std::endl;
+    }
+    vpLoopJitter jitter(use_rt_profile ? rt_profile.getPeriod() : 33.);
+    VP_TRACE_THREAD("servo");
+
+    vpMetricCounter &metric_frames = metrics.addCounter("servo_frames_total", "Number of processed frames");
+    vpMetricGauge &metric_frame_rate = metrics.addGauge("servo_frame_rate_hz", "Frame rate of the servo loop");
+    vpMetricHistogram &metric_detection = metrics.addHistogram("servo_detection_ms", "Detection and tracking time");
+    vpMetricHistogram &metric_period = metrics.addHistogram("servo_loop_period_ms", "Period of the servo loop");
+    vpMetricHistogram &metric_command_jitter =
+        metrics.addHistogram("servo_command_jitter_ms", "Deviation of the velocity command interval from the period");
+    vpMetricCounter &metric_deadline_misses =
+        metrics.addCounter("servo_deadline_misses_total", "Periods longer than the deadline of the loop");
+    vpMetricCounter &metric_missed_detections =
+        metrics.addCounter("servo_missed_detections_total", "Frames without tag pose");
+    vpMetricCounter &metric_saturations =
+        metrics.addCounter("servo_saturations_total", "Velocity commands saturated by the robot");
+    double expected_period = use_rt_profile ? rt_profile.getPeriod() : 33.;
+    double t_prev = -1, t_command_prev = -1;
+
+    // Containers of each iteration, allocated once
+    std::vector<vpHomogeneousMatrix> cMo_vec;
+    std::vector<vpImagePoint> polygon; // Corners of the tag used for the tracking and the depth fusion
+    cMo_vec.reserve(16);
+    polygon.reserve(4);
+    std::string text;
+    text.reserve(256);
+    vpColVector v_c(6); // Camera velocity, or joint velocity with --joint_space
+    vpColVector v_cam(6), qdot_Axis(ROBOT_DOF), qdot_Motor(ROBOT_DOF);
+    vpColVector task_error(engine.getDimension());
+    vpMatrix L(engine.getDimension(), 6); // Interaction matrix used by the MPC
+    vpPose corner_pose; // Pose updated from the tracked or refined corners
+    std::vector<vpPoint> fusion_points;
+    std::vector<vpPoint> visibility_points(tag_points.size());
+    std::vector<vpImagePoint> vip; // Tag corners and center
+    fusion_points.reserve(use_bundle ? 4 * bundle.getNbTags() : tag_points.size());
+    vip.reserve(polygon.capacity() + 1);
+
+    // Allocations per iteration with --count_allocations, after the warm-up of the detector and the display. The
+    // image path is checked, and the features and the control law with vpFixedServo, since vpServo, the MPC and
+    // the comparison of --verbose allocate their matrices. The detection, the pose and the display of the
+    // features use ViSP temporaries, the allocations of the whole iteration are only printed.
+    const unsigned int allocation_warmup = 30;
+    const bool check_control_allocations = opt_fixed_control_law && !opt_mpc && !opt_verbose;
+    unsigned int nb_counted_iterations = 0;
+    uint64_t max_image_allocations = 0, max_control_allocations = 0;
+    uint64_t max_iteration_allocations = 0, sum_iteration_allocations = 0;
 
     while (!has_converged && !final_quit) {
       double t_start = vpTime::measureTimeMs();
+      jitter.tick(t_start);
+      if (t_prev >= 0) {
+        double period = t_start - t_prev;
+        metric_period.record(period);
+        metric_frame_rate.set(period > 0 ? 1000. / period : 0);
+        if (period > 1.5 * expected_period) {
+          metric_deadline_misses.inc();
+        }
+      }
+      t_prev = t_start;
+      metric_frames.inc();
+      VP_TRACE_SCOPE("iteration");
+      uint64_t nb_allocations = vpAllocationCounter::getCount();
 
       //g->acquire(I);
-	  rs.acquire(I);
+      VP_TRACE_ZONE(zone_acquisition, "acquisition");
+      // The images of the iteration are the ones of a frame of the ring, acquired in place
+      vpFrameHandle frame = frame_pool.acquire();
+      vpImage<unsigned char> &I = frame->I;
+      vpImage<vpRGBa> &Ic = frame->Ic;
+      vpImage<uint16_t> &I_depth_raw = frame->depthRaw;
+      frame->timestamp = t_start;
+      if (opt_depth_fusion || use_model) {
+        rs.acquire(reinterpret_cast<unsigned char *>(Ic.bitmap), reinterpret_cast<unsigned char *>(I_depth_raw.bitmap),
+                   NULL, NULL, &align_to);
+        vpImageConvert::convert(Ic, I);
+      } else {
+        rs.acquire(I);
+      }
+      VP_TRACE_ZONE_END(zone_acquisition);
+      if (use_online_eMc) {
+        // Robot pose at the image acquisition, the model-based tracker gives the pose of the previous image
+        q_image_prev = q_image;
+        robot.getPosition(vpRobot::JOINT_STATE, q_image);
+      }
 
+      VP_TRACE_ZONE(zone_display_image, "display");
       vpDisplay::display(I);
+      VP_TRACE_ZONE_END(zone_display_image);
+      uint64_t nb_image_allocations = vpAllocationCounter::getCount() - nb_allocations;
+
+      cMo_vec.clear();
+      polygon.clear();
+      bool has_pose = false;
+      bool tracked = false;
+      size_t tag_index = 0;
+      double t_detection = vpTime::measureTimeMs();
+      VP_TRACE_ZONE(zone_detection, "detection");
+      if (use_model) {
+        // Pose of the previous frame, the tracking of this one runs during the control law
+        has_pose = model_tracker.track(frame, cMo);
+        if (opt_verbose) {
+          std::cout << "Model-based tracking: " << model_tracker.getTrackingTime()
+                    << " ms, projection error: " << model_tracker.getProjectionError() << " deg" << std::endl;
+        }
+      } else if (tracker.isInitialized() && ++nb_tracked_frames % opt_detection_period != 0) {
+        // Between two detections, only track the tag corners
+        tracked = tracker.track(I);
+        if (tracked) {
+          polygon = tracker.getCorners();
+        }
+      }
 
-      std::vector<vpHomogeneousMatrix> cMo_vec;
-      detector.detect(I, opt_tagSize, cam, cMo_vec);
+      if (!tracked && !use_model) {
+        detector.setAprilTagQuadDecimate(loss.getQuadDecimate());
+        if (use_bundle) {
+          // Fuse the corners of all the bundle tags, other tags are ignored
+          detector.detect(I);
+          has_pose = bundle.computePose(detector, cam, cMo);
+          if (has_pose) {
+            tag_index = static_cast<size_t>(bundle.getMainDetectionIndex());
+            int tag_id = vpTagBundle::getTagId(detector.getMessage(tag_index));
+            tag_points = bundle.getTagCorners(tag_id);
+            oMt = bundle.getTagPose(tag_id);
+          }
+        } else {
+          detector.detect(I, opt_tagSize, cam, cMo_vec);
+          // Only one tag is detected
+          if (cMo_vec.size() == 1) {
+            cMo = cMo_vec[0];
+            has_pose = true;
+          }
+        }
+        if (has_pose) {
+          polygon = detector.getPolygon(tag_index);
+          if (opt_detection_period > 1) {
+            tracker.init(I, polygon);
+            nb_tracked_frames = 0;
+          }
+        }
+      }
+
+      VP_TRACE_ZONE_END(zone_detection);
+      metric_detection.record(vpTime::measureTimeMs() - t_detection);
+
+      VP_TRACE_ZONE(zone_pose, "pose");
+      bool refined_corners = false;
+      if (opt_refine_corners > 0 && !polygon.empty() && last_error_t < opt_refine_corners) {
+        refined_corners = corner_refinement.refine(I, polygon);
+      }
+
+      // Update the measured normalized coordinates of the tag corners
+      for (size_t i = 0; i < polygon.size() && i < tag_points.size(); i++) {
+        double x = 0, y = 0;
+        vpPixelMeterConversion::convertPoint(cam, polygon[i], x, y);
+        tag_points[i].set_x(x);
+        tag_points[i].set_y(y);
+      }
 
-      std::stringstream ss;
-      ss << "Left click to " << (send_velocities ? "stop the robot" : "servo the robot") << ", right click to quit.";
-      vpDisplay::displayText(I, 20, 20, ss.str(), vpColor::red);
+      if (tracked || refined_corners) {
+        // Update the pose from the tracked or refined corners, starting from the previous one
+        vpTagBundle::setPosePoints(corner_pose, tag_points);
+        has_pose = corner_pose.computePose(vpPose::VIRTUAL_VS, cMo);
+      }
+
+      if (has_pose && opt_depth_fusion) {
+        // Tag corners used by the refinement, with their measured normalized coordinates
+        if (use_bundle && !tracked && !refined_corners) {
+          bundle.getDetectedCorners(detector, cam, fusion_points);
+        } else {
+          fusion_points = tag_points;
+        }
+        bool refined = refinement.refine(I_depth_raw, polygon, fusion_points, oMt, cMo);
+        if (opt_verbose) {
+          std::cout << "Depth fusion: " << (refined ? "done" : "skipped") << " with " << refinement.getNbDepthPoints()
+                    << " depth points, plane residual: " << refinement.getPlaneResidual() << " m" << std::endl;
+        }
+      }
 
-      vpColVector v_c(6);
+      VP_TRACE_ZONE_END(zone_pose);
+      if (!has_pose) {
+        metric_missed_detections.inc();
+      }
 
-      // Only one tag is detected
-      if (cMo_vec.size() == 1) {
-        cMo = cMo_vec[0];
+      // Without measure, cMo is predicted while coasting
+      vpTargetLossHandler::vpTrackingState previous_state = loss.getState();
+      vpTargetLossHandler::vpTrackingState state = loss.update(vpTime::measureTimeSecond(), has_pose, cMo);
+      if (state != previous_state &&
+          (opt_verbose || state == vpTargetLossHandler::SEARCHING || state == vpTargetLossHandler::REACQUIRED)) {
+        std::cout << "Tag " << vpTargetLossHandler::getStateName(state) << std::endl;
+      }
 
-        static bool first_time = true;
-        if (first_time) {
-          // Introduce security wrt tag positionning in order to avoid PI rotation
-          std::vector<vpHomogeneousMatrix> v_oMo(2), v_cdMc(2);
-          v_oMo[1].buildFrom(0, 0, 0, 0, 0, M_PI);
-          for (size_t i = 0; i < 2; i++) {
-            v_cdMc[i] = cdMo * v_oMo[i] * cMo.inverse();
+      if (use_online_eMc) {
+        if (state == vpTargetLossHandler::TRACKING && has_pose) {
+          online_hand_eye.addMeasurement(use_model ? q_image_prev : q_image, cMo);
+        } else if (state == vpTargetLossHandler::SEARCHING && previous_state != vpTargetLossHandler::SEARCHING) {
+          // The tag may be moved before being found again
+          online_hand_eye.reset();
+        }
+        if (online_hand_eye.getNbUpdates() != nb_eMc_updates) {
+          // The robot already uses the new eMc, update the joint space control law
+          nb_eMc_updates = online_hand_eye.getNbUpdates();
+          eMc = online_hand_eye.get_eMc();
+          cVe.buildFrom(eMc.inverse());
+          if (opt_joint_space) {
+            engine.setJointSpace(cVe);
           }
-          if (std::fabs(v_cdMc[0].getThetaUVector().getTheta()) < std::fabs(v_cdMc[1].getThetaUVector().getTheta())) {
-            oMo = v_oMo[0];
-          } else {
+          if (opt_verbose) {
+            std::cout << "eMc update " << nb_eMc_updates << ": " << vpPoseVector(eMc).t() << std::endl;
+          }
+        }
+      }
+
+      display_text(I, 20, 20, vpColor::red, text, "Left click to %s, right click to quit%s",
+                   send_velocities ? "stop the robot" : "servo the robot",
+                   use_model ? ", middle click to initialize the model." : ".");
+
+      v_c = 0;
+
+      uint64_t nb_control_allocations = 0;
+      if (state != vpTargetLossHandler::SEARCHING) {
+        if (state == vpTargetLossHandler::REACQUIRED) {
+          // Introduce security wrt tag positionning in order to avoid PI rotation, again after each loss
+          if (!use_model && loss.updateSymmetry(cdMo, cMo, oMo)) {
             std::cout << "Desired frame modified to avoid PI rotation of the camera" << std::endl;
-            oMo = v_oMo[1]; // Introduce PI rotation
           }
+          engine.setDesiredPose(cdMo * oMo);
+          convergence.reset();
         }
 
         // Update visual features
-        cdMc = cdMo * oMo * cMo.inverse();
-        t.buildFrom(cdMc);
-        tu.buildFrom(cdMc);
+        uint64_t nb_allocations_features = vpAllocationCounter::getCount();
+        engine.setPose(cMo);
+        cdMc = engine.get_cdMc();
 
+        double t_sequencing = 0;
         if (opt_task_sequencing) {
           if (!servo_started) {
             if (send_velocities) {
@@ -340,65 +1172,121 @@ int main(int argc, char **argv)
             }
             t_init_servo = vpTime::measureTimeMs();
           }
-          v_c = task.computeControlLaw((vpTime::measureTimeMs() - t_init_servo) / 1000.);
+          t_sequencing = (vpTime::measureTimeMs() - t_init_servo) / 1000.;
+        }
+
+        if (opt_joint_space) {
+          robot.get_eJe(eJe);
+          engine.set_eJe(eJe);
+        }
+
+        VP_TRACE_ZONE(zone_control_law, "control law");
+        if (opt_mpc) {
+          // Predict over the measured loop period
+          double t_mpc = vpTime::measureTimeMs();
+          if (t_mpc_prev > 0) {
+            mpc.setSamplingTime(std::min(std::max((t_mpc - t_mpc_prev) / 1000., 0.01), 0.1));
+          }
+          t_mpc_prev = t_mpc;
+
+          robot.getPosition(vpRobot::JOINT_STATE, q);
+          mpc.set_cVe_eJe(cVe, eJe);
+          mpc.setJointState(q, qdot_sent);
+          // Tag corners that have to stay visible
+          for (size_t i = 0; i < visibility_points.size(); i++) {
+            visibility_points[i].setWorldCoordinates(tag_points[i].get_oX(), tag_points[i].get_oY(),
+                                                     tag_points[i].get_oZ());
+            visibility_points[i].track(cMo);
+          }
+          mpc.setVisibilityPoints(visibility_points);
+
+          engine.computeInteractionMatrix(L, task_error);
+          bool feasible = mpc.computeControlLaw(L, task_error, v_c);
+          if (!feasible && (mpc_feasible || opt_verbose)) {
+            std::cout << "MPC: no feasible solution, decelerate" << std::endl;
+          }
+          mpc_feasible = feasible;
+          if (opt_verbose) {
+            std::cout << "MPC: " << vpTime::measureTimeMs() - t_mpc
+                      << " ms, predicted error: " << mpc.getPredictedError().t() << std::endl;
+          }
         } else {
-          v_c = task.computeControlLaw();
+          if (opt_task_sequencing) {
+            engine.computeControlLaw(t_sequencing, v_c, task_error);
+          } else {
+            engine.computeControlLaw(v_c, task_error);
+          }
+        }
+        VP_TRACE_ZONE_END(zone_control_law);
+        nb_control_allocations = vpAllocationCounter::getCount() - nb_allocations_features;
+        if (state == vpTargetLossHandler::COASTING) {
+          // Keep moving towards the predicted pose while slowing down
+          v_c *= loss.getVelocityScale();
         }
 
-        // Display desired and current pose features
+        // Display desired and current pose features, and the image features of the other modes
+        VP_TRACE_ZONE(zone_display_features, "display");
+        engine.display(cam, I);
         vpDisplay::displayFrame(I, cdMo * oMo, cam, opt_tagSize / 1.5, vpColor::none, 3);
         vpDisplay::displayFrame(I, cMo, cam, opt_tagSize / 2, vpColor::none, 3);
         // Get tag corners
-        std::vector<vpImagePoint> vip = detector.getPolygon(0);
+        vip = polygon;
         // Get the tag cog corresponding to the projection of the tag frame in the image
-        vip.push_back(detector.getCog(0));
+        if (use_model || tracked || state == vpTargetLossHandler::COASTING) {
+          vpHomogeneousMatrix cMt = cMo * oMt;
+          vpImagePoint cog;
+          vpMeterPixelConversion::convertPoint(cam, cMt[0][3] / cMt[2][3], cMt[1][3] / cMt[2][3], cog);
+          vip.push_back(cog);
+        } else {
+          vip.push_back(detector.getCog(tag_index));
+        }
         // Display the trajectory of the points
-        if (first_time) {
+        if (traj_vip == nullptr) {
           traj_vip = new std::vector<vpImagePoint>[vip.size()];
         }
         //display_point_trajectory(I, vip, traj_vip);
-
-		vpColVector qdot_Axis = robot.getAxisVelocity(vpRobot::CAMERA_FRAME, v_c);
-		vpColVector qdot_Motor = robot.getMotorVelocity(vpRobot::CAMERA_FRAME, v_c);
+        VP_TRACE_ZONE_END(zone_display_features);
 
 		if (opt_plot) {
-			plotter->plot(0, iter_plot, task.getError());
-			plotter->plot(1, iter_plot, v_c);
+			// The saturation is printed by setVelocity()
+			robot.getAxisVelocity(control_frame, v_c, qdot_Axis, false);
+			qdot_Motor = robot.getMotorVelocity(control_frame, v_c);
+			plotter->plot(0, iter_plot, task_error);
+			plotter->plot(1, iter_plot, opt_joint_space ? vpColVector(cVe * eJe * v_c) : v_c);
 			plotter->plot(2, iter_plot, qdot_Axis);
 			plotter->plot(3, iter_plot, qdot_Motor);
 			iter_plot++;
 		}
 
         if (opt_verbose) {
-          std::cout << "v_c: " << v_c.t() << std::endl;
+          std::cout << (opt_joint_space ? "qdot: " : "v_c: ") << v_c.t() << std::endl;
         }
 
         vpTranslationVector cd_t_c = cdMc.getTranslationVector();
         vpThetaUVector cd_tu_c = cdMc.getThetaUVector();
         double error_t = sqrt(cd_t_c.sumSquare());
         double error_tu = vpMath::deg(sqrt(cd_tu_c.sumSquare()));
+        last_error_t = error_t;
 
-        ss.str("");
-        ss << "error_t: " << error_t;
-        vpDisplay::displayText(I, 20, static_cast<int>(I.getWidth()) - 150, ss.str(), vpColor::red);
-        ss.str("");
-        ss << "error_tu: " << error_tu;
-        vpDisplay::displayText(I, 40, static_cast<int>(I.getWidth()) - 150, ss.str(), vpColor::red);
+        display_text(I, 20, static_cast<int>(I.getWidth()) - 150, vpColor::red, text, "error_t: %g", error_t);
+        display_text(I, 40, static_cast<int>(I.getWidth()) - 150, vpColor::red, text, "error_tu: %g", error_tu);
 
         if (opt_verbose)
           std::cout << "error translation: " << error_t << " ; error rotation: " << error_tu << std::endl;
 
-        if (error_t < convergence_threshold_t && error_tu < convergence_threshold_tu) {
+        convergence_errors[0] = error_t;
+        convergence_errors[1] = error_tu;
+        if (state != vpTargetLossHandler::COASTING) {
+          // Predicted errors are not measures
+          convergence.addSample(vpTime::measureTimeSecond(), convergence_errors, v_c.infinityNorm());
+        }
+        if (convergence.hasConverged()) {
           has_converged = true;
-          std::cout << "Servo task has converged" << std::endl;
-          ;
+          std::cout << "Servo task has converged in " << convergence.getConvergenceTime() << " s"
+                    << (convergence.isAtNoiseFloor() ? " (error at the noise floor)" : "") << std::endl;
           vpDisplay::displayText(I, 100, 20, "Servo task has converged", vpColor::red);
         }
-
-        if (first_time) {
-          first_time = false;
-        }
-      } // end if (cMo_vec.size() == 1)
+      } // end if (state != vpTargetLossHandler::SEARCHING)
       else {
         v_c = 0;
       }
@@ -410,18 +1298,47 @@ int main(int argc, char **argv)
 
 
       // Send to the robot
-      robot.setVelocity(vpRobot::CAMERA_FRAME, v_c);
+      VP_TRACE_ZONE(zone_velocity, "setVelocity");
+      robot.setVelocity(control_frame, v_c);
+      VP_TRACE_ZONE_END(zone_velocity);
+      double t_command = vpTime::measureTimeMs();
+      if (t_command_prev >= 0) {
+        metric_command_jitter.record(std::fabs(t_command - t_command_prev - expected_period));
+      }
+      t_command_prev = t_command;
+      if (is_saturated(robot, control_frame, v_c)) {
+        metric_saturations.inc();
+      }
+      qdot_sent = v_c;
+      // Camera velocity used to predict the tag pose if the next detection is missed
+      if (opt_joint_space && eJe.getRows() == 6) {
+        vpTickArena &arena = vpTickArena::getThreadArena();
+        vpTickArena::vpScope scope(arena);
+        vpTickArena::copy(arena.multiply(arena.view(cVe), arena.multiply(arena.view(eJe), arena.view(v_c))), v_cam);
+        loss.setCameraVelocity(v_cam);
+      } else {
+        loss.setCameraVelocity(v_c);
+      }
 
-      ss.str("");
-      ss << "Loop time: " << vpTime::measureTimeMs() - t_start << " ms";
-      vpDisplay::displayText(I, 40, 20, ss.str(), vpColor::red);
+      display_text(I, 40, 20, vpColor::red, text, "Loop time: %g ms", vpTime::measureTimeMs() - t_start);
+      display_text(I, 60, 20, vpColor::red, text, "Tag: %s", vpTargetLossHandler::getStateName(state));
+      VP_TRACE_ZONE(zone_flush, "display");
       vpDisplay::flush(I);
+      VP_TRACE_ZONE_END(zone_flush);
 
       vpMouseButton::vpMouseButtonType button;
       if (vpDisplay::getClick(I, button, false)) {
         switch (button) {
         case vpMouseButton::button1:
           send_velocities = !send_velocities;
+          convergence.reset();
+          break;
+
+        case vpMouseButton::button2:
+          if (use_model) {
+            model_tracker.initClick(I, opt_model_init_filename);
+            loss.reset();
+          }
           break;
 
         case vpMouseButton::button3:
@@ -433,17 +1350,72 @@ int main(int argc, char **argv)
           break;
         }
       }
+
+      if (opt_count_allocations && metric_frames.get() > allocation_warmup) {
+        uint64_t nb_iteration_allocations = vpAllocationCounter::getCount() - nb_allocations;
+        max_image_allocations = std::max(max_image_allocations, nb_image_allocations);
+        max_control_allocations = std::max(max_control_allocations, nb_control_allocations);
+        max_iteration_allocations = std::max(max_iteration_allocations, nb_iteration_allocations);
+        sum_iteration_allocations += nb_iteration_allocations;
+        nb_counted_iterations++;
+        if (check_control_allocations && nb_control_allocations > 0 && allocation_test_passed) {
+          std::cout << "Allocation test failed: " << nb_control_allocations << " allocations in the features and "
+                    << "the control law at iteration " << metric_frames.get() << std::endl;
+          allocation_test_passed = false;
+        } else if (nb_image_allocations > 0 && allocation_test_passed) {
+          std::cout << "Allocation test failed: " << nb_image_allocations << " allocations in the acquisition and "
+                    << "the display of the image at iteration " << metric_frames.get() << std::endl;
+          allocation_test_passed = false;
+        }
+      }
     }
     std::cout << "Stop the robot " << std::endl;
     robot.setRobotState(vpRobot::STATE_STOP);
 
+    if (use_rt_profile || opt_verbose) {
+      std::cout << jitter.getReport() << std::endl;
+    }
+
+    if (opt_count_allocations && nb_counted_iterations > 0) {
+      std::cout << "Allocations per iteration over " << nb_counted_iterations
+                << " iterations: image acquisition and display max " << max_image_allocations
+                << ", features and control law max " << max_control_allocations << ", whole iteration mean "
+                << static_cast<double>(sum_iteration_allocations) / nb_counted_iterations << ", max "
+                << max_iteration_allocations << std::endl;
+      std::cout << "Tick arena peak usage: " << vpTickArena::getThreadArena().getPeak() << " bytes of "
+                << vpTickArena::getThreadArena().getCapacity() << std::endl;
+    }
+
+    if (use_online_eMc) {
+      online_hand_eye.stop();
+      double error_t = 0, error_tu = 0;
+      online_hand_eye.getResidual(error_t, error_tu);
+      std::cout << "eMc updated " << online_hand_eye.getNbUpdates() << " times with " << online_hand_eye.getNbSamples()
+                << " robot poses, residual: " << error_t << " m, " << vpMath::deg(error_tu) << " deg" << std::endl;
+      vpPoseVector ePc_refined(online_hand_eye.get_eMc());
+      if (online_hand_eye.getNbUpdates() > 0) {
+        if (vpPoseVector::saveYAML(opt_online_eMc_filename, ePc_refined)) {
+          std::cout << "eMc saved in " << opt_online_eMc_filename << ": " << ePc_refined.t() << std::endl;
+        } else {
+          std::cout << "Can not write " << opt_online_eMc_filename << std::endl;
+        }
+      }
+    }
+
+    if (!opt_trace_filename.empty()) {
+      vpTrace::stop();
+      if (vpTrace::save(opt_trace_filename)) {
+        std::cout << "Trace saved in " << opt_trace_filename << std::endl;
+      } else {
+        std::cout << "Can not write " << opt_trace_filename << std::endl;
+      }
+    }
+
     if (opt_plot && plotter != nullptr) {
       delete plotter;
       plotter = nullptr;
     }
 
-    task.kill();
-
     if (!final_quit) {
       while (!final_quit) {
         //g->acquire(I);
@@ -483,7 +1455,7 @@ int main(int argc, char **argv)
 	  return EXIT_FAILURE;
   }
 
-  return 0;
+  return allocation_test_passed ? 0 : EXIT_FAILURE;
 }
 #else
 int main()
@@ -491,6 +1463,9 @@ int main()
 #if !defined(VISP_HAVE_REALSENSE2)
 	std::cout << "Install librealsense-2.x" << std::endl;
 #endif
+#if !defined(VISP_HAVE_PUGIXML)
+  std::cout << "Build ViSP with pugixml to read the camera parameters" << std::endl;
+#endif
 #if (VISP_CXX_STANDARD < VISP_CXX_STANDARD_11)
   std::cout << "Build ViSP with c++11 or higher compiler flag (cmake -DUSE_CXX_STANDARD=11)." << std::endl;
 #endif
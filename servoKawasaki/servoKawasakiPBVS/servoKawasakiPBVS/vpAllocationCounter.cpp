@@ -0,0 +1,124 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Count of the heap allocations of each thread.
+ *
+ *****************************************************************************/
+
+#include <cstddef>
+#if defined(VP_COUNT_ALLOCATIONS) && defined(_MSC_VER)
+#include <crtdbg.h>
+#endif
+
+/*!
+  \file vpAllocationCounter.cpp
+  Count of the heap allocations of each thread.
+*/
+
+#include <vpAllocationCounter.h>
+
+#if defined(VP_COUNT_ALLOCATIONS)
+#if defined(_MSC_VER) && !defined(_DEBUG)
+#error "VP_COUNT_ALLOCATIONS needs the debug CRT, whose allocation hook counts the allocations"
+#endif
+
+namespace
+{
+// Plain integers, so that they are usable before the thread initialization and during its exit
+thread_local uint64_t nb_allocations = 0;
+thread_local uint64_t nb_bytes = 0;
+
+inline void countAllocation(std::size_t size)
+{
+  nb_allocations++;
+  nb_bytes += size;
+}
+} // namespace
+
+#if defined(_MSC_VER)
+namespace
+{
+// Called by the debug CRT for each malloc(), realloc() and free(), including those of operator new and of the
+// ViSP DLLs, which share the debug CRT. The _CRT_BLOCK allocations are the CRT internal ones.
+int allocationHook(int type, void *, std::size_t size, int block, long, const unsigned char *, int)
+{
+  if (block != _CRT_BLOCK && (type == _HOOK_ALLOC || type == _HOOK_REALLOC)) {
+    countAllocation(size);
+  }
+  return TRUE;
+}
+
+const _CRT_ALLOC_HOOK previous_hook = _CrtSetAllocHook(allocationHook);
+} // namespace
+#elif defined(__GLIBC__)
+// The C++ and ViSP allocations all end up in these functions, operator new included.
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t n, std::size_t size);
+void *__libc_realloc(void *p, std::size_t size);
+
+void *malloc(std::size_t size)
+{
+  countAllocation(size);
+  return __libc_malloc(size);
+}
+
+void *calloc(std::size_t n, std::size_t size)
+{
+  countAllocation(n * size);
+  return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, std::size_t size)
+{
+  countAllocation(size);
+  return __libc_realloc(p, size);
+}
+}
+#else
+#error "VP_COUNT_ALLOCATIONS is only implemented with the MSVC debug CRT and with the glibc"
+#endif
+
+//! Return the number of bytes allocated by the calling thread since its start.
+uint64_t vpAllocationCounter::getBytes() { return nb_bytes; }
+
+//! Return the number of allocations of the calling thread since its start.
+uint64_t vpAllocationCounter::getCount() { return nb_allocations; }
+
+//! Return true if the allocations are counted, see VP_COUNT_ALLOCATIONS.
+bool vpAllocationCounter::isCompiled() { return true; }
+#else
+uint64_t vpAllocationCounter::getBytes() { return 0; }
+
+uint64_t vpAllocationCounter::getCount() { return 0; }
+
+bool vpAllocationCounter::isCompiled() { return false; }
+#endif
@@ -0,0 +1,76 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Count of the heap allocations of each thread.
+ *
+ *****************************************************************************/
+
+#ifndef vpAllocationCounter_h
+#define vpAllocationCounter_h
+
+/*!
+  \file vpAllocationCounter.h
+  Count of the heap allocations of each thread.
+*/
+
+#include <cstdint>
+
+#include <visp3/core/vpConfig.h>
+
+/*!
+
+  \class vpAllocationCounter
+  \brief Count the heap allocations of the calling thread, to check that the steady-state stages of the servo
+  loop don't allocate.
+
+  The counted allocations are those of malloc(), calloc() and realloc(), so operator new and the ViSP arrays
+  (vpArray2D allocates with malloc) are both counted. With MSVC, they are counted by an allocation hook of the
+  debug CRT, which also sees the ViSP DLLs built with the same CRT; with the glibc, malloc() is replaced. This
+  is only compiled when VP_COUNT_ALLOCATIONS is defined, as in the Debug|x64 configuration. Otherwise
+  isCompiled() returns false and the counts stay at zero.
+
+  \code
+  uint64_t nb_allocations = vpAllocationCounter::getCount();
+  rs.acquire(frame->I);
+  if (vpAllocationCounter::getCount() != nb_allocations) {
+    std::cout << "The acquisition allocates" << std::endl;
+  }
+  \endcode
+
+*/
+class vpAllocationCounter
+{
+public:
+  static uint64_t getBytes();
+  static uint64_t getCount();
+  static bool isCompiled();
+};
+#endif
@@ -0,0 +1,216 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Detection of the servo convergence on a sliding window of errors.
+ *
+ *****************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+
+#include <visp3/core/vpConfig.h>
+#include <visp3/core/vpException.h>
+
+/*!
+  \file vpConvergenceMonitor.cpp
+  Detection of the servo convergence on a sliding window of errors.
+*/
+
+#include <vpConvergenceMonitor.h>
+
+namespace
+{
+double median(std::vector<double> &v)
+{
+  size_t n = v.size() / 2;
+  std::nth_element(v.begin(), v.begin() + n, v.end());
+  double m = v[n];
+  if (v.size() % 2 == 0) {
+    m = (m + *std::max_element(v.begin(), v.begin() + n)) / 2.;
+  }
+  return m;
+}
+}
+
+/*!
+  Default constructor: 0.3 second settle time, 2 standard errors confidence and no velocity tolerance.
+  The tolerance has to be set with setTolerance().
+ */
+vpConvergenceMonitor::vpConvergenceMonitor()
+  : m_tolerance(), m_settleTime(0.3), m_confidence(2.), m_velocityTolerance(0), m_window(), m_first(0), m_size(0),
+    m_t0(-1), m_converged(false), m_atNoiseFloor(false), m_convergenceTime(-1), m_mean(), m_noise(), m_diff()
+{
+}
+
+/*!
+  Add a new sample and update the convergence.
+
+  \param[in] t : Time of the sample in second.
+  \param[in] errors : Error measures, with the same size as the tolerance.
+  \param[in] velocity : Norm of the velocity sent to the robot.
+ */
+void vpConvergenceMonitor::addSample(double t, const vpColVector &errors, double velocity)
+{
+  if (errors.getRows() != m_tolerance.getRows()) {
+    throw(vpException(vpException::dimensionError, "Cannot monitor %d error measures with %d tolerances",
+                      errors.getRows(), m_tolerance.getRows()));
+  }
+  if (m_converged) {
+    return;
+  }
+  if (m_t0 < 0) {
+    m_t0 = t;
+  }
+
+  if (m_size == m_window.size()) {
+    // Grow the ring until it covers the settle time, the samples then reuse their buffers
+    std::rotate(m_window.begin(), m_window.begin() + static_cast<std::ptrdiff_t>(m_first), m_window.end());
+    m_window.resize(std::max<size_t>(2 * m_window.size(), 16));
+    m_first = 0;
+  }
+  vpSample &sample = m_window[(m_first + m_size) % m_window.size()];
+  m_size++;
+  sample.t = t;
+  sample.velocity = velocity;
+  sample.errors.assign(errors.data, errors.data + errors.getRows());
+  // Keep the samples of the last settle time, plus the one just before
+  while (m_size > 1 && getSample(1).t <= t - m_settleTime) {
+    m_first = (m_first + 1) % m_window.size();
+    m_size--;
+  }
+
+  bool converged = (t - getSample(0).t >= m_settleTime);
+  bool at_noise_floor = false;
+  for (unsigned int i = 0; i < m_tolerance.getRows(); i++) {
+    bool raised = false;
+    converged = isInside(i, raised) && converged;
+    at_noise_floor = at_noise_floor || raised;
+  }
+  if (m_velocityTolerance > 0) {
+    double velocity_mean = 0;
+    for (size_t k = 0; k < m_size; k++) {
+      velocity_mean += getSample(k).velocity;
+    }
+    converged = converged && (velocity_mean / m_size <= m_velocityTolerance);
+  }
+
+  if (converged) {
+    m_converged = true;
+    m_atNoiseFloor = at_noise_floor;
+    m_convergenceTime = getSample(0).t - m_t0;
+  }
+}
+
+/*
+  Update the statistics of error measure i over the window and return true if it is inside its tolerance.
+  raised is set to true if the tolerance was raised to the noise floor.
+ */
+bool vpConvergenceMonitor::isInside(unsigned int i, bool &raised)
+{
+  const size_t n = m_size;
+  double mean = 0, t_mean = 0;
+  for (size_t k = 0; k < n; k++) {
+    mean += getSample(k).errors[i];
+    t_mean += getSample(k).t;
+  }
+  mean /= n;
+  t_mean /= n;
+
+  double var = 0, cov = 0, t_var = 0;
+  for (size_t k = 0; k < n; k++) {
+    double de = getSample(k).errors[i] - mean, dt = getSample(k).t - t_mean;
+    var += de * de;
+    cov += de * dt;
+    t_var += dt * dt;
+  }
+  double std_error = (n > 1 ? std::sqrt(var / (n - 1) / n) : 0.);
+
+  double noise = 0;
+  bool stationary = false;
+  if (n >= 3) {
+    // Noise from the differences between consecutive samples, robust to the trend
+    m_diff.resize(n - 1);
+    for (size_t k = 0; k + 1 < n; k++) {
+      m_diff[k] = getSample(k + 1).errors[i] - getSample(k).errors[i];
+    }
+    double diff_median = median(m_diff);
+    for (size_t k = 0; k < m_diff.size(); k++) {
+      m_diff[k] = std::fabs(m_diff[k] - diff_median);
+    }
+    noise = 1.4826 * median(m_diff) / std::sqrt(2.);
+
+    // The error doesn't decrease if the regression slope is not significantly negative
+    if (t_var > 0) {
+      double slope = cov / t_var;
+      double residual = std::max(var - slope * cov, 0.) / (n - 2);
+      stationary = (slope > -2. * std::sqrt(residual / t_var));
+    }
+  }
+
+  m_mean.resize(m_tolerance.getRows(), false);
+  m_noise.resize(m_tolerance.getRows(), false);
+  m_mean[i] = mean;
+  m_noise[i] = noise;
+
+  if (m_tolerance[i] <= 0) {
+    return false;
+  }
+  double tolerance = m_tolerance[i];
+  if (stationary && 3. * noise > tolerance) {
+    tolerance = 3. * noise;
+    raised = true;
+  }
+  return mean + m_confidence * std_error <= tolerance;
+}
+
+/*!
+  Clear the window and the convergence. The time to converge is then measured from the next sample.
+ */
+void vpConvergenceMonitor::reset()
+{
+  m_first = 0;
+  m_size = 0;
+  m_t0 = -1;
+  m_converged = false;
+  m_atNoiseFloor = false;
+  m_convergenceTime = -1;
+}
+
+/*!
+  Set the tolerance of each error measure. A zero tolerance disables the convergence.
+ */
+void vpConvergenceMonitor::setTolerance(const vpColVector &tolerance)
+{
+  m_tolerance = tolerance;
+  m_mean.resize(tolerance.getRows());
+  m_noise.resize(tolerance.getRows());
+  reset();
+}
@@ -0,0 +1,142 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Detection of the servo convergence on a sliding window of errors.
+ *
+ *****************************************************************************/
+
+#ifndef vpConvergenceMonitor_h
+#define vpConvergenceMonitor_h
+
+/*!
+  \file vpConvergenceMonitor.h
+  Detection of the servo convergence on a sliding window of errors.
+*/
+
+#include <vector>
+
+#include <visp3/core/vpConfig.h>
+
+#include <visp3/core/vpColVector.h>
+
+/*!
+
+  \class vpConvergenceMonitor
+  \brief Decide that the servo has converged once the errors are statistically inside their tolerance
+  during a settle time.
+
+  Each sample gives one or more error measures (like the translation and rotation errors) and the norm
+  of the velocity sent to the robot. The samples of the last settle time are kept in a sliding window.
+  For each error measure, the window gives:
+  - the mean and its standard error;
+  - the noise floor, estimated by the median absolute deviation of the differences between consecutive
+    samples, that is insensitive to the error decrease;
+  - the trend, given by a linear regression over the time.
+
+  The servo has converged when the window covers the settle time and, for each measure, the mean plus
+  \e z times its standard error is below the tolerance. When the error doesn't decrease anymore, the
+  tolerance is raised to 3 times the noise floor, so that a tolerance below the measurement noise doesn't
+  keep the servo running forever. An optional tolerance on the mean velocity can also be set.
+  A zero tolerance disables the convergence. With a zero settle time, the convergence is decided on a
+  single sample like a simple threshold.
+
+  \code
+  vpConvergenceMonitor monitor;
+  monitor.setTolerance(tolerance); // [0.0001 m, 0.05 deg]
+  monitor.setSettleTime(0.3);
+  while (!monitor.hasConverged()) {
+    ...
+    errors[0] = error_t;
+    errors[1] = error_tu;
+    monitor.addSample(vpTime::measureTimeSecond(), errors, v_c.infinityNorm());
+  }
+  std::cout << "Converged in " << monitor.getConvergenceTime() << " s" << std::endl;
+  \endcode
+
+*/
+class vpConvergenceMonitor
+{
+public:
+  vpConvergenceMonitor();
+
+  void addSample(double t, const vpColVector &errors, double velocity = 0);
+
+  /*!
+    Return the time in second between the first sample and the beginning of the settle time that led
+    to the convergence, or -1 if the servo has not converged.
+   */
+  double getConvergenceTime() const { return m_convergenceTime; }
+  //! Return the mean of each error measure over the window.
+  vpColVector getMean() const { return m_mean; }
+  //! Return the noise standard deviation of each error measure estimated over the window.
+  vpColVector getNoiseFloor() const { return m_noise; }
+  //! Return true once the servo has converged, until reset() is called.
+  bool hasConverged() const { return m_converged; }
+  //! Return true if the convergence was decided on the noise floor instead of the tolerance.
+  bool isAtNoiseFloor() const { return m_atNoiseFloor; }
+
+  void reset();
+
+  //! Set the number of standard errors between the mean error and the tolerance. Default is 2.
+  void setConfidence(double z) { m_confidence = z; }
+  //! Set the duration in second during which the errors have to stay inside the tolerance.
+  void setSettleTime(double settle_time) { m_settleTime = settle_time; }
+  void setTolerance(const vpColVector &tolerance);
+  //! Set the tolerance on the mean velocity norm, 0 to disable it.
+  void setVelocityTolerance(double tolerance) { m_velocityTolerance = tolerance; }
+
+protected:
+  struct vpSample {
+    double t;
+    double velocity;
+    std::vector<double> errors;
+  };
+
+  //! Return the sample \e k of the window, from the oldest one.
+  const vpSample &getSample(size_t k) const { return m_window[(m_first + k) % m_window.size()]; }
+  bool isInside(unsigned int i, bool &raised);
+
+  vpColVector m_tolerance;
+  double m_settleTime;
+  double m_confidence;
+  double m_velocityTolerance;
+  std::vector<vpSample> m_window; //!< Ring of the samples of the window
+  size_t m_first;                 //!< Index of the oldest sample in the ring
+  size_t m_size;                  //!< Number of samples in the window
+  double m_t0;              //!< Time of the first sample
+  bool m_converged;
+  bool m_atNoiseFloor;
+  double m_convergenceTime;
+  vpColVector m_mean;
+  vpColVector m_noise;
+  std::vector<double> m_diff; //!< Differences between consecutive errors, reused by isInside()
+};
+#endif
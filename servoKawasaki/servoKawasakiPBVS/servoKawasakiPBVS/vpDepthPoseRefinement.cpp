@@ -0,0 +1,445 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Refinement of the target pose using the depth map aligned on the color image.
+ *
+ *****************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <visp3/core/vpConfig.h>
+#include <visp3/core/vpCPUFeatures.h>
+#include <visp3/core/vpExponentialMap.h>
+#include <visp3/core/vpMatrix.h>
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VISP_HAVE_SSE2 1
+#endif
+
+/*!
+  \file vpDepthPoseRefinement.cpp
+  Refinement of the target pose using the depth map aligned on the color image.
+*/
+
+#include <vpDepthPoseRefinement.h>
+
+namespace
+{
+// Minimal number of depth points to fit a plane
+const unsigned int min_nb_points = 30;
+
+#if VISP_HAVE_SSE2
+inline double hsum(const __m128 &a)
+{
+  float t[4];
+  _mm_storeu_ps(t, a);
+  return static_cast<double>(t[0]) + t[1] + t[2] + t[3];
+}
+#endif
+
+/*
+  Plane fitted on the centered depth points, with its normal given by the eigen vector
+  associated to the smallest eigen value of the covariance matrix. The plane is n.P = d
+  with d > 0 expressed in the camera frame.
+*/
+bool solvePlane(double n, double sx, double sy, double sz, double sxx, double sxy, double sxz, double syy, double syz,
+                double szz, const vpColVector &cP_ref, vpColVector &plane, double &rms, double &spread)
+{
+  if (n < min_nb_points) {
+    return false;
+  }
+  double cx = sx / n, cy = sy / n, cz = sz / n;
+  vpMatrix C(3, 3);
+  C[0][0] = sxx / n - cx * cx;
+  C[0][1] = C[1][0] = sxy / n - cx * cy;
+  C[0][2] = C[2][0] = sxz / n - cx * cz;
+  C[1][1] = syy / n - cy * cy;
+  C[1][2] = C[2][1] = syz / n - cy * cz;
+  C[2][2] = szz / n - cz * cz;
+
+  vpColVector evalue;
+  vpMatrix evector;
+  C.eigenValues(evalue, evector);
+
+  unsigned int i_min = 0;
+  for (unsigned int i = 1; i < 3; i++) {
+    if (evalue[i] < evalue[i_min]) {
+      i_min = i;
+    }
+  }
+
+  plane.resize(4, false);
+  double d = 0;
+  for (unsigned int i = 0; i < 3; i++) {
+    plane[i] = evector[i][i_min];
+  }
+  d = plane[0] * (cx + cP_ref[0]) + plane[1] * (cy + cP_ref[1]) + plane[2] * (cz + cP_ref[2]);
+  if (d < 0) {
+    for (unsigned int i = 0; i < 3; i++) {
+      plane[i] = -plane[i];
+    }
+    d = -d;
+  }
+  plane[3] = d;
+
+  rms = std::sqrt(std::max(evalue[i_min], 0.));
+  spread = std::sqrt(std::max(evalue.sum() - evalue[i_min], 0.));
+  return true;
+}
+}
+
+/*!
+  Default constructor.
+ */
+vpDepthPoseRefinement::vpDepthPoseRefinement()
+  : m_cam(), m_depthScale(0.001), m_sigmaPixel(0.5), m_margin(0.1), m_minZ(0.1), m_maxZ(2.0), m_maxIter(10),
+    m_step(2), m_nbPoints(0), m_planeResidual(0), m_sigmaNormal(0), m_sigmaDistance(0), m_shrunk()
+{
+}
+
+/*!
+  Accumulate the moments of the valid depth points inside the shrunk polygon. The points are
+  centered on \e cP_ref to keep the single precision accumulation accurate. If \e plane is not
+  NULL, only the points closer than \e threshold to the centered plane (nx, ny, nz, d) are used.
+ */
+void vpDepthPoseRefinement::accumulate(const vpImage<uint16_t> &I_depth_raw, const std::vector<vpImagePoint> &polygon,
+                                       const vpColVector &cP_ref, const double *plane, double threshold,
+                                       vpPlaneMoments &m)
+{
+  m.n = m.x = m.y = m.z = m.xx = m.xy = m.xz = m.yy = m.yz = m.zz = 0;
+
+  // Shrink the polygon towards its center
+  m_shrunk.resize(polygon.size());
+  double cog_u = 0, cog_v = 0;
+  for (size_t i = 0; i < polygon.size(); i++) {
+    cog_u += polygon[i].get_u() / polygon.size();
+    cog_v += polygon[i].get_v() / polygon.size();
+  }
+  double v_min = std::numeric_limits<double>::max(), v_max = -std::numeric_limits<double>::max();
+  for (size_t i = 0; i < polygon.size(); i++) {
+    m_shrunk[i].set_uv(cog_u + (polygon[i].get_u() - cog_u) * (1. - m_margin),
+                   cog_v + (polygon[i].get_v() - cog_v) * (1. - m_margin));
+    v_min = std::min(v_min, m_shrunk[i].get_v());
+    v_max = std::max(v_max, m_shrunk[i].get_v());
+  }
+
+  int v_begin = std::max(0, static_cast<int>(std::ceil(v_min)));
+  int v_end = std::min(static_cast<int>(I_depth_raw.getHeight()) - 1, static_cast<int>(std::floor(v_max)));
+
+  const float scale = static_cast<float>(m_depthScale);
+  const float min_Z = static_cast<float>(m_minZ), max_Z = static_cast<float>(m_maxZ);
+  const float u0 = static_cast<float>(m_cam.get_u0()), inv_px = static_cast<float>(m_cam.get_px_inverse());
+  const float xr = static_cast<float>(cP_ref[0]), yr = static_cast<float>(cP_ref[1]), zr = static_cast<float>(cP_ref[2]);
+  const bool use_plane = (plane != NULL);
+  float nx = 0, ny = 0, nz = 0, dr = 0;
+  if (use_plane) {
+    nx = static_cast<float>(plane[0]);
+    ny = static_cast<float>(plane[1]);
+    nz = static_cast<float>(plane[2]);
+    dr = static_cast<float>(plane[3]);
+  }
+  const float thr = static_cast<float>(threshold);
+
+#if VISP_HAVE_SSE2
+  static const bool checkSSE2 = vpCPUFeatures::checkSSE2();
+#endif
+
+  for (int v = v_begin; v <= v_end; v += static_cast<int>(m_step)) {
+    // The polygon is convex: intersect the row with its edges
+    double u_min = std::numeric_limits<double>::max(), u_max = -std::numeric_limits<double>::max();
+    for (size_t i = 0; i < m_shrunk.size(); i++) {
+      const vpImagePoint &a = m_shrunk[i], &b = m_shrunk[(i + 1) % m_shrunk.size()];
+      if (a.get_v() == b.get_v()) {
+        continue;
+      }
+      if ((a.get_v() <= v && b.get_v() >= v) || (b.get_v() <= v && a.get_v() >= v)) {
+        double u = a.get_u() + (v - a.get_v()) * (b.get_u() - a.get_u()) / (b.get_v() - a.get_v());
+        u_min = std::min(u_min, u);
+        u_max = std::max(u_max, u);
+      }
+    }
+    if (u_min > u_max) {
+      continue;
+    }
+    int u_begin = std::max(0, static_cast<int>(std::ceil(u_min)));
+    int u_end = std::min(static_cast<int>(I_depth_raw.getWidth()) - 1, static_cast<int>(std::floor(u_max)));
+    if (u_begin > u_end) {
+      continue;
+    }
+
+    const uint16_t *row = I_depth_raw[v];
+    const float y = static_cast<float>((v - m_cam.get_v0()) * m_cam.get_py_inverse());
+    double sn = 0, sx = 0, sy = 0, sz = 0, sxx = 0, sxy = 0, sxz = 0, syy = 0, syz = 0, szz = 0;
+    int u = u_begin;
+
+#if VISP_HAVE_SSE2
+    if (checkSSE2 && u_end - u_begin >= 3) {
+      const __m128 v_scale = _mm_set1_ps(scale), v_min_Z = _mm_set1_ps(min_Z), v_max_Z = _mm_set1_ps(max_Z);
+      const __m128 v_u0 = _mm_set1_ps(u0), v_inv_px = _mm_set1_ps(inv_px), v_y = _mm_set1_ps(y);
+      const __m128 v_xr = _mm_set1_ps(xr), v_yr = _mm_set1_ps(yr), v_zr = _mm_set1_ps(zr);
+      const __m128 v_nx = _mm_set1_ps(nx), v_ny = _mm_set1_ps(ny), v_nz = _mm_set1_ps(nz), v_dr = _mm_set1_ps(dr);
+      const __m128 v_thr = _mm_set1_ps(thr), v_one = _mm_set1_ps(1.f), v_four = _mm_set1_ps(4.f);
+      const __m128 v_abs = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+      const __m128i v_zero = _mm_setzero_si128();
+
+      __m128 v_u = _mm_set_ps(u + 3.f, u + 2.f, u + 1.f, static_cast<float>(u));
+      __m128 a_n = _mm_setzero_ps(), a_x = _mm_setzero_ps(), a_y = _mm_setzero_ps(), a_z = _mm_setzero_ps();
+      __m128 a_xx = _mm_setzero_ps(), a_xy = _mm_setzero_ps(), a_xz = _mm_setzero_ps();
+      __m128 a_yy = _mm_setzero_ps(), a_yz = _mm_setzero_ps(), a_zz = _mm_setzero_ps();
+
+      for (; u + 3 <= u_end; u += 4) {
+        __m128i raw = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(row + u));
+        __m128 Z = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(raw, v_zero)), v_scale);
+        __m128 mask = _mm_and_ps(_mm_cmpgt_ps(Z, v_min_Z), _mm_cmplt_ps(Z, v_max_Z));
+        __m128 X = _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(_mm_sub_ps(v_u, v_u0), v_inv_px), Z), v_xr);
+        __m128 Y = _mm_sub_ps(_mm_mul_ps(v_y, Z), v_yr);
+        Z = _mm_sub_ps(Z, v_zr);
+        if (use_plane) {
+          __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(v_nx, X), _mm_mul_ps(v_ny, Y)), _mm_mul_ps(v_nz, Z));
+          r = _mm_and_ps(_mm_sub_ps(r, v_dr), v_abs);
+          mask = _mm_and_ps(mask, _mm_cmplt_ps(r, v_thr));
+        }
+        X = _mm_and_ps(mask, X);
+        Y = _mm_and_ps(mask, Y);
+        Z = _mm_and_ps(mask, Z);
+        a_n = _mm_add_ps(a_n, _mm_and_ps(mask, v_one));
+        a_x = _mm_add_ps(a_x, X);
+        a_y = _mm_add_ps(a_y, Y);
+        a_z = _mm_add_ps(a_z, Z);
+        a_xx = _mm_add_ps(a_xx, _mm_mul_ps(X, X));
+        a_xy = _mm_add_ps(a_xy, _mm_mul_ps(X, Y));
+        a_xz = _mm_add_ps(a_xz, _mm_mul_ps(X, Z));
+        a_yy = _mm_add_ps(a_yy, _mm_mul_ps(Y, Y));
+        a_yz = _mm_add_ps(a_yz, _mm_mul_ps(Y, Z));
+        a_zz = _mm_add_ps(a_zz, _mm_mul_ps(Z, Z));
+        v_u = _mm_add_ps(v_u, v_four);
+      }
+
+      sn = hsum(a_n);
+      sx = hsum(a_x);
+      sy = hsum(a_y);
+      sz = hsum(a_z);
+      sxx = hsum(a_xx);
+      sxy = hsum(a_xy);
+      sxz = hsum(a_xz);
+      syy = hsum(a_yy);
+      syz = hsum(a_yz);
+      szz = hsum(a_zz);
+    }
+#endif
+
+    for (; u <= u_end; u++) {
+      float Z = row[u] * scale;
+      if (Z <= min_Z || Z >= max_Z) {
+        continue;
+      }
+      float X = (u - u0) * inv_px * Z - xr;
+      float Y = y * Z - yr;
+      Z -= zr;
+      if (use_plane && std::fabs(nx * X + ny * Y + nz * Z - dr) >= thr) {
+        continue;
+      }
+      sn += 1;
+      sx += X;
+      sy += Y;
+      sz += Z;
+      sxx += X * X;
+      sxy += X * Y;
+      sxz += X * Z;
+      syy += Y * Y;
+      syz += Y * Z;
+      szz += Z * Z;
+    }
+
+    m.n += sn;
+    m.x += sx;
+    m.y += sy;
+    m.z += sz;
+    m.xx += sxx;
+    m.xy += sxy;
+    m.xz += sxz;
+    m.yy += syy;
+    m.yz += syz;
+    m.zz += szz;
+  }
+}
+
+/*!
+  Fit a plane on the depth points inside the tag polygon.
+
+  \param[in] I_depth_raw : Raw depth map aligned on the color image.
+  \param[in] polygon : Tag corners in the color image.
+  \param[in] cP_ref : 3-dim point close to the tag center in the camera frame, like the tag position
+  given by the pose. Used to center the points.
+  \param[out] plane : 4-dim vector (nx, ny, nz, d) of the plane n.P = d in the camera frame, with d > 0.
+  \return true if enough valid depth points were found, false otherwise.
+ */
+bool vpDepthPoseRefinement::fitPlane(const vpImage<uint16_t> &I_depth_raw, const std::vector<vpImagePoint> &polygon,
+                                     const vpColVector &cP_ref, vpColVector &plane)
+{
+  m_nbPoints = 0;
+  if (polygon.size() < 3) {
+    return false;
+  }
+
+  vpPlaneMoments m;
+  double rms = 0, spread = 0;
+  accumulate(I_depth_raw, polygon, cP_ref, NULL, 0, m);
+  if (!solvePlane(m.n, m.x, m.y, m.z, m.xx, m.xy, m.xz, m.yy, m.yz, m.zz, cP_ref, plane, rms, spread)) {
+    return false;
+  }
+
+  // Fit again on the inliers, with the plane expressed wrt the centering point
+  double centered_plane[4] = {plane[0], plane[1], plane[2],
+                              plane[3] - (plane[0] * cP_ref[0] + plane[1] * cP_ref[1] + plane[2] * cP_ref[2])};
+  double threshold = std::max(3. * rms, 0.002);
+  accumulate(I_depth_raw, polygon, cP_ref, centered_plane, threshold, m);
+  if (!solvePlane(m.n, m.x, m.y, m.z, m.xx, m.xy, m.xz, m.yy, m.yz, m.zz, cP_ref, plane, rms, spread)) {
+    return false;
+  }
+
+  m_nbPoints = static_cast<unsigned int>(m.n);
+  m_planeResidual = rms;
+  // Keep a floor on the noise to never trust the depth more than its quantization
+  double sigma = std::max(rms, 0.0005) / std::sqrt(m.n);
+  m_sigmaDistance = sigma;
+  m_sigmaNormal = sigma / std::max(spread, 1e-3);
+
+  return true;
+}
+
+/*!
+  Refine the pose by virtual visual servoing on the image coordinates of the points and the plane
+  fitted on the depth map.
+
+  \param[in] I_depth_raw : Raw depth map aligned on the color image.
+  \param[in] polygon : Image region used to fit the plane, like the tag corners.
+  \param[in] points : Points with their coordinates in the object frame and their measured normalized
+  coordinates (x, y) set.
+  \param[in] oMp : Pose in the object frame of a frame whose z = 0 plane is the plane seen in \e polygon.
+  Identity for a single tag.
+  \param[in,out] cMo : Initial pose, updated with the refined pose.
+  \return true if the pose was refined, false if not enough depth points or image points are available.
+ */
+bool vpDepthPoseRefinement::refine(const vpImage<uint16_t> &I_depth_raw, const std::vector<vpImagePoint> &polygon,
+                                   const std::vector<vpPoint> &points, const vpHomogeneousMatrix &oMp,
+                                   vpHomogeneousMatrix &cMo)
+{
+  if (points.size() < 3) {
+    return false;
+  }
+
+  vpHomogeneousMatrix cMp = cMo * oMp;
+  vpColVector cP_ref(3);
+  for (unsigned int i = 0; i < 3; i++) {
+    cP_ref[i] = cMp[i][3];
+  }
+
+  vpColVector plane;
+  if (!fitPlane(I_depth_raw, polygon, cP_ref, plane)) {
+    return false;
+  }
+
+  const double w_n = (m_sigmaPixel * m_cam.get_px_inverse()) / m_sigmaNormal;
+  const double w_d = (m_sigmaPixel * m_cam.get_px_inverse()) / m_sigmaDistance;
+  const unsigned int nb_rows = 2 * static_cast<unsigned int>(points.size()) + 4;
+  vpMatrix L(nb_rows, 6);
+  vpColVector e(nb_rows);
+
+  for (unsigned int iter = 0; iter < m_maxIter; iter++) {
+    for (unsigned int i = 0; i < points.size(); i++) {
+      vpColVector cP;
+      vpPoint P = points[i];
+      P.changeFrame(cMo, cP);
+      double Z = cP[2];
+      double x = cP[0] / Z, y = cP[1] / Z;
+      e[2 * i] = x - points[i].get_x();
+      e[2 * i + 1] = y - points[i].get_y();
+
+      double *Lx = L[2 * i], *Ly = L[2 * i + 1];
+      Lx[0] = -1 / Z;
+      Lx[1] = 0;
+      Lx[2] = x / Z;
+      Lx[3] = x * y;
+      Lx[4] = -(1 + x * x);
+      Lx[5] = y;
+      Ly[0] = 0;
+      Ly[1] = -1 / Z;
+      Ly[2] = y / Z;
+      Ly[3] = 1 + y * y;
+      Ly[4] = -x * y;
+      Ly[5] = -x;
+    }
+
+    // Plane n.P = d predicted by the pose, with dn/dt = [n]x w and dd/dt = -n.v
+    cMp = cMo * oMp;
+    double n[3] = {cMp[0][2], cMp[1][2], cMp[2][2]};
+    double d = n[0] * cMp[0][3] + n[1] * cMp[1][3] + n[2] * cMp[2][3];
+    if (d < 0) {
+      for (unsigned int i = 0; i < 3; i++) {
+        n[i] = -n[i];
+      }
+      d = -d;
+    }
+
+    unsigned int k = 2 * static_cast<unsigned int>(points.size());
+    for (unsigned int i = 0; i < 3; i++) {
+      e[k + i] = w_n * (n[i] - plane[i]);
+      for (unsigned int j = 0; j < 6; j++) {
+        L[k + i][j] = 0;
+      }
+    }
+    L[k][4] = -w_n * n[2];
+    L[k][5] = w_n * n[1];
+    L[k + 1][3] = w_n * n[2];
+    L[k + 1][5] = -w_n * n[0];
+    L[k + 2][3] = -w_n * n[1];
+    L[k + 2][4] = w_n * n[0];
+
+    e[k + 3] = w_d * (d - plane[3]);
+    for (unsigned int j = 0; j < 3; j++) {
+      L[k + 3][j] = -w_d * n[j];
+      L[k + 3][j + 3] = 0;
+    }
+
+    vpColVector v = -(L.pseudoInverse() * e);
+    cMo = vpExponentialMap::direct(v).inverse() * cMo;
+
+    if (v.sumSquare() < 1e-16) {
+      break;
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,138 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Refinement of the target pose using the depth map aligned on the color image.
+ *
+ *****************************************************************************/
+
+#ifndef vpDepthPoseRefinement_h
+#define vpDepthPoseRefinement_h
+
+/*!
+  \file vpDepthPoseRefinement.h
+  Refinement of the target pose using the depth map aligned on the color image.
+*/
+
+#include <vector>
+
+#include <visp3/core/vpConfig.h>
+
+#include <visp3/core/vpCameraParameters.h>
+#include <visp3/core/vpColVector.h>
+#include <visp3/core/vpHomogeneousMatrix.h>
+#include <visp3/core/vpImage.h>
+#include <visp3/core/vpImagePoint.h>
+#include <visp3/core/vpPoint.h>
+
+/*!
+
+  \class vpDepthPoseRefinement
+  \brief Fuse the depth map with the tag corners to refine the target pose.
+
+  The raw depth map aligned on the color image is only read inside the tag polygon. The depth
+  points are fitted by a least-squares plane, followed by a second fit on the inliers. The pose
+  cMo is then refined by virtual visual servoing on both the image coordinates of the corners and
+  the measured plane. Each kind of feature is weighted by the inverse of its estimated noise, so
+  that the depth mainly constrains the distance and the orientation of the tag.
+
+  \code
+  vpDepthPoseRefinement refinement;
+  refinement.setCameraParameters(cam);
+  refinement.setDepthScale(rs.getDepthScale());
+  // points: object frame corners with their measured normalized coordinates (x, y)
+  refinement.refine(I_depth_raw, detector.getPolygon(0), points, vpHomogeneousMatrix(), cMo);
+  \endcode
+
+*/
+class vpDepthPoseRefinement
+{
+public:
+  vpDepthPoseRefinement();
+
+  bool fitPlane(const vpImage<uint16_t> &I_depth_raw, const std::vector<vpImagePoint> &polygon,
+                const vpColVector &cP_ref, vpColVector &plane);
+
+  //! Return the number of depth points used by the last plane fit.
+  unsigned int getNbDepthPoints() const { return m_nbPoints; }
+  //! Return the RMS distance in meter of the depth points to the last fitted plane.
+  double getPlaneResidual() const { return m_planeResidual; }
+
+  bool refine(const vpImage<uint16_t> &I_depth_raw, const std::vector<vpImagePoint> &polygon,
+              const std::vector<vpPoint> &points, const vpHomogeneousMatrix &oMp, vpHomogeneousMatrix &cMo);
+
+  void setCameraParameters(const vpCameraParameters &cam) { m_cam = cam; }
+  /*!
+    Set the factor that converts raw depth values in meter, given by vpRealSense2::getDepthScale().
+   */
+  void setDepthScale(double depth_scale) { m_depthScale = depth_scale; }
+  /*!
+    Set the noise of the corner location in pixel, used to weight the image features wrt the plane.
+   */
+  void setImageNoise(double sigma_pixel) { m_sigmaPixel = sigma_pixel; }
+  /*!
+    Set the ratio used to shrink the tag polygon towards its center, to avoid mixing tag border and
+    background depth values.
+   */
+  void setMargin(double margin) { m_margin = margin; }
+  //! Set the depth range in meter that is considered as valid.
+  void setDepthRange(double min_Z, double max_Z)
+  {
+    m_minZ = min_Z;
+    m_maxZ = max_Z;
+  }
+  //! Set the maximal number of virtual visual servoing iterations.
+  void setMaxIterations(unsigned int nb) { m_maxIter = nb; }
+  //! Only one depth row out of \e step is read.
+  void setStep(unsigned int step) { m_step = (step > 0 ? step : 1); }
+
+protected:
+  struct vpPlaneMoments {
+    double n, x, y, z, xx, xy, xz, yy, yz, zz;
+  };
+
+  void accumulate(const vpImage<uint16_t> &I_depth_raw, const std::vector<vpImagePoint> &polygon,
+                  const vpColVector &cP_ref, const double *plane, double threshold, vpPlaneMoments &m);
+
+  vpCameraParameters m_cam;
+  double m_depthScale;
+  double m_sigmaPixel;
+  double m_margin;
+  double m_minZ;
+  double m_maxZ;
+  unsigned int m_maxIter;
+  unsigned int m_step;
+  unsigned int m_nbPoints;
+  double m_planeResidual;
+  double m_sigmaNormal;   //!< Standard deviation of the normal of the last fitted plane
+  double m_sigmaDistance; //!< Standard deviation of the distance of the last fitted plane
+  std::vector<vpImagePoint> m_shrunk; //!< Polygon shrunk by the margin, reused by accumulate()
+};
+#endif
@@ -0,0 +1,146 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Ring of preallocated camera frames shared by reference-counted handles.
+ *
+ *****************************************************************************/
+
+#ifndef vpFramePool_h
+#define vpFramePool_h
+
+/*!
+  \file vpFramePool.h
+  Ring of preallocated camera frames shared by reference-counted handles.
+*/
+
+#include <atomic>
+#include <memory>
+
+#include <visp3/core/vpConfig.h>
+
+#include <visp3/core/vpImage.h>
+#include <visp3/core/vpRGBa.h>
+
+/*!
+  Images of one camera frame: the gray image processed by the servo, and the color and aligned depth images
+  acquired together when the depth is used.
+*/
+struct vpFrame {
+  vpImage<unsigned char> I;
+  vpImage<vpRGBa> Ic;
+  vpImage<uint16_t> depthRaw;
+  double timestamp; //!< Acquisition time in ms
+};
+
+//! Frame of a vpFramePool with the number of handles on it.
+struct vpFrameSlot {
+  vpFrame frame;
+  std::atomic<unsigned int> useCount;
+};
+
+/*!
+
+  \class vpFrameHandle
+  \brief Reference-counted handle on a frame of a vpFramePool.
+
+  The frame goes back to the pool when its last handle is destroyed or reset. Copying a handle is an atomic
+  increment, so that a frame can be passed to another thread, like the pipelined vpModelTracker, without
+  copying the images.
+
+*/
+class vpFrameHandle
+{
+public:
+  vpFrameHandle() : m_slot(nullptr) {}
+  vpFrameHandle(const vpFrameHandle &handle);
+  vpFrameHandle(vpFrameHandle &&handle) : m_slot(handle.m_slot) { handle.m_slot = nullptr; }
+  vpFrameHandle &operator=(vpFrameHandle handle);
+  ~vpFrameHandle() { reset(); }
+
+  vpFrame &operator*() const { return m_slot->frame; }
+  vpFrame *operator->() const { return &m_slot->frame; }
+
+  //! Return true if the handle refers to a frame.
+  bool isValid() const { return m_slot != nullptr; }
+  void reset();
+
+private:
+  friend class vpFramePool;
+  explicit vpFrameHandle(vpFrameSlot *slot) : m_slot(slot) {}
+
+  vpFrameSlot *m_slot;
+};
+
+/*!
+
+  \class vpFramePool
+  \brief Ring of camera frames allocated once, at the resolution of the camera, and reused by the servo loop.
+
+  acquire() returns the oldest frame without handle, so that the camera writes in place in its images and no
+  image is allocated nor copied in the loop. The gray images share the display of the image given to
+  setDisplay(), so that they can be displayed, annotated and clicked like this image.
+
+  A pipeline of \e n stages that keep a frame needs a ring of \e n + 1 frames: with the pipelined
+  vpModelTracker, the loop holds the frame being acquired while the tracker holds the previous one.
+
+  \code
+  vpFramePool frames(3, height, width);
+  frames.setDisplay(I); // I is attached to the display
+  while (servo) {
+    vpFrameHandle frame = frames.acquire();
+    rs.acquire(frame->I);
+    vpDisplay::display(frame->I);
+    ...
+  }
+  \endcode
+
+*/
+class vpFramePool
+{
+public:
+  vpFramePool(unsigned int nb_frames, unsigned int height, unsigned int width);
+  vpFramePool(const vpFramePool &) = delete;
+  vpFramePool &operator=(const vpFramePool &) = delete;
+
+  vpFrameHandle acquire();
+
+  //! Return the number of frames of the ring.
+  unsigned int getNbFrames() const { return m_nbFrames; }
+  unsigned int getNbFramesInUse() const;
+
+  void setDisplay(const vpImage<unsigned char> &I);
+
+protected:
+  std::unique_ptr<vpFrameSlot[]> m_slots;
+  unsigned int m_nbFrames;
+  unsigned int m_next; //!< Oldest frame of the ring
+};
+#endif
@@ -0,0 +1,502 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Tuning of the servo gain by simulated closed-loop episodes.
+ *
+ *****************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <thread>
+
+#include <visp3/core/vpConfig.h>
+#include <visp3/core/vpArray2D.h>
+#include <visp3/core/vpException.h>
+#include <visp3/core/vpMath.h>
+#include <visp3/core/vpMatrix.h>
+#include <visp3/core/vpVelocityTwistMatrix.h>
+
+/*!
+  \file vpGainTuner.cpp
+  Tuning of the servo gain by simulated closed-loop episodes.
+*/
+
+#include <vpFixedServo.h>
+#include <vpGainTuner.h>
+
+namespace
+{
+vpGainTuner::vpGainScore makeScore(double gain_at_zero, double gain_at_infinity, double slope_at_zero)
+{
+  vpGainTuner::vpGainScore score;
+  score.gain_at_zero = gain_at_zero;
+  score.gain_at_infinity = gain_at_infinity;
+  score.slope_at_zero = slope_at_zero;
+  score.time = 0;
+  score.success = 0;
+  score.overshoot = 0;
+  score.saturation = 0;
+  score.feasible = false;
+  return score;
+}
+
+void initGain(const vpGainTuner::vpGainScore &score, vpAdaptiveGain &lambda)
+{
+  if (score.gain_at_zero <= score.gain_at_infinity || score.slope_at_zero <= 0) {
+    lambda.initFromConstant(score.gain_at_infinity);
+  } else {
+    lambda.initStandard(score.gain_at_zero, score.gain_at_infinity, score.slope_at_zero);
+  }
+}
+
+// true if score a is better than score b: feasible first, then the fastest
+bool isBetter(const vpGainTuner::vpGainScore &a, const vpGainTuner::vpGainScore &b)
+{
+  if (a.feasible != b.feasible) {
+    return a.feasible;
+  }
+  return a.time < b.time;
+}
+}
+
+/*!
+  Constructor.
+
+  \param[in] robot : Robot that gives the kinematics, the joint limits and the maximal velocities.
+  It doesn't need to be connected.
+  \param[in] type : Kind of servo to simulate.
+ */
+vpGainTuner::vpGainTuner(const vpRobotKawasaki &robot, vpServoType type)
+  : m_robot(robot), m_type(type), m_cam(), m_width(640), m_height(480), m_eMc(), m_cdMo(), m_q(), m_qMin(),
+    m_qMax(), m_fMo(), m_tagSize(0.096), m_thresholdT(type == IMAGE_BASED ? 0.00005 : 0.0001),
+    m_thresholdTu(0.05), m_dt(0.033), m_latency(0.05), m_noise(0.5), m_displacement(vpMath::rad(10)),
+    m_maxDuration(20), m_maxOvershoot(0.1), m_maxSaturation(0.3), m_minSuccess(0.95), m_nbEpisodes(64),
+    m_nbCandidates(48), m_nbThreads(0), m_qInit(), m_best(makeScore(0, 0, 0))
+{
+}
+
+/*!
+  Evaluate the gains on all the episodes, in parallel.
+ */
+void vpGainTuner::evaluate(std::vector<vpGainScore> &scores)
+{
+  const size_t nb_jobs = scores.size() * m_nbEpisodes;
+  std::vector<vpEpisodeResult> results(nb_jobs);
+  std::atomic<size_t> next_job(0);
+
+  unsigned int nb_threads = m_nbThreads;
+  if (nb_threads == 0) {
+    nb_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  auto worker = [&]() {
+    for (size_t job = next_job++; job < nb_jobs; job = next_job++) {
+      try {
+        results[job] = simulate(scores[job / m_nbEpisodes], static_cast<unsigned int>(job % m_nbEpisodes));
+      } catch (...) {
+        vpEpisodeResult failed = {false, m_maxDuration, 0, 0};
+        results[job] = failed;
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned int i = 0; i < nb_threads; i++) {
+    threads.push_back(std::thread(worker));
+  }
+  for (size_t i = 0; i < threads.size(); i++) {
+    threads[i].join();
+  }
+
+  for (size_t i = 0; i < scores.size(); i++) {
+    vpGainScore &score = scores[i];
+    score.time = score.success = score.overshoot = score.saturation = 0;
+    for (unsigned int e = 0; e < m_nbEpisodes; e++) {
+      const vpEpisodeResult &result = results[i * m_nbEpisodes + e];
+      score.time += result.time;
+      score.success += (result.converged ? 1 : 0);
+      score.overshoot = std::max(score.overshoot, result.overshoot);
+      score.saturation += result.saturation;
+    }
+    score.time /= m_nbEpisodes;
+    score.success /= m_nbEpisodes;
+    score.saturation /= m_nbEpisodes;
+    score.feasible = (score.success >= m_minSuccess && score.overshoot <= m_maxOvershoot &&
+                      score.saturation <= m_maxSaturation);
+  }
+}
+
+/*!
+  Return the selected gain after tune().
+ */
+vpAdaptiveGain vpGainTuner::getBestGain() const
+{
+  vpAdaptiveGain lambda;
+  initGain(m_best, lambda);
+  return lambda;
+}
+
+/*!
+  Draw the initial joint positions of the episodes around the desired ones, within the joint limits and
+  with the tag visible.
+ */
+bool vpGainTuner::initEpisodes()
+{
+  if (m_q.getRows() != ROBOT_DOF) {
+    throw(vpException(vpException::notInitialized, "Desired joint positions not set. Call setJointPosition() first"));
+  }
+  m_robot.getJointLimits(m_qMin, m_qMax);
+  vpHomogeneousMatrix fMe;
+  m_robot.get_fMe(m_q, fMe);
+  m_fMo = fMe * m_eMc * m_cdMo;
+
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> uniform(-m_displacement, m_displacement);
+  m_qInit.clear();
+  for (unsigned int attempt = 0; attempt < 1000 * m_nbEpisodes && m_qInit.size() < m_nbEpisodes; attempt++) {
+    vpColVector q = m_q;
+    bool in_limits = true;
+    for (unsigned int i = 0; i < ROBOT_DOF; i++) {
+      q[i] += uniform(rng);
+      in_limits = in_limits && q[i] > m_qMin[i] && q[i] < m_qMax[i];
+    }
+    if (!in_limits) {
+      continue;
+    }
+    m_robot.get_fMe(q, fMe);
+    if (isVisible((fMe * m_eMc).inverse() * m_fMo)) {
+      m_qInit.push_back(q);
+    }
+  }
+  return m_qInit.size() == m_nbEpisodes;
+}
+
+/*!
+  Return true if the 4 tag corners are in front of the camera and inside the image.
+ */
+bool vpGainTuner::isVisible(const vpHomogeneousMatrix &cMo) const
+{
+  double x[4], y[4], Z[4];
+  projectCorners(cMo, x, y, Z);
+  for (unsigned int i = 0; i < 4; i++) {
+    double u = m_cam.get_u0() + x[i] * m_cam.get_px(), v = m_cam.get_v0() + y[i] * m_cam.get_py();
+    if (Z[i] <= 0 || u < 0 || v < 0 || u > m_width - 1 || v > m_height - 1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*!
+  Load a gain saved by saveGain().
+
+  \param[in] filename : YAML file.
+  \param[out] lambda : Constant or adaptive gain.
+  \return true if the file was successfully read, false otherwise.
+ */
+bool vpGainTuner::loadGain(const std::string &filename, vpAdaptiveGain &lambda)
+{
+  vpArray2D<double> data;
+  if (!vpArray2D<double>::loadYAML(filename, data)) {
+    return false;
+  }
+  if (data.getRows() != 1 || data.getCols() != 3) {
+    throw(vpException(vpException::dimensionError,
+                      "Gain file %s should have 1 row [gain_at_zero, gain_at_infinity, slope_at_zero]",
+                      filename.c_str()));
+  }
+  initGain(makeScore(data[0][0], data[0][1], data[0][2]), lambda);
+  return true;
+}
+
+/*!
+  Compute the normalized coordinates and the depth of the 4 tag corners, in the same order as
+  vpDetectorAprilTag::getPolygon().
+ */
+void vpGainTuner::projectCorners(const vpHomogeneousMatrix &cMo, double x[4], double y[4], double Z[4]) const
+{
+  const double s = m_tagSize / 2.;
+  const double oX[4] = {-s, s, s, -s}, oY[4] = {-s, -s, s, s};
+  for (unsigned int i = 0; i < 4; i++) {
+    double cX = cMo[0][0] * oX[i] + cMo[0][1] * oY[i] + cMo[0][3];
+    double cY = cMo[1][0] * oX[i] + cMo[1][1] * oY[i] + cMo[1][3];
+    Z[i] = cMo[2][0] * oX[i] + cMo[2][1] * oY[i] + cMo[2][3];
+    x[i] = cX / Z[i];
+    y[i] = cY / Z[i];
+  }
+}
+
+/*!
+  Save the selected gain in a YAML file that can be read by loadGain().
+ */
+bool vpGainTuner::saveGain(const std::string &filename) const
+{
+  vpArray2D<double> data(1, 3);
+  data[0][0] = m_best.gain_at_zero;
+  data[0][1] = m_best.gain_at_infinity;
+  data[0][2] = m_best.slope_at_zero;
+  return vpArray2D<double>::saveYAML(filename, data, "# gain: [gain_at_zero, gain_at_infinity, slope_at_zero]\n");
+}
+
+/*!
+  Simulate one episode of the servo loop with a given gain.
+ */
+vpGainTuner::vpEpisodeResult vpGainTuner::simulate(const vpGainScore &gain, unsigned int episode) const
+{
+  vpEpisodeResult result = {false, m_maxDuration, 0, 0};
+
+  vpAdaptiveGain lambda;
+  initGain(gain, lambda);
+  vpFixedServo<6> pbvs;
+  vpFixedServo<8> ibvs;
+  pbvs.setLambda(lambda);
+  ibvs.setLambda(lambda);
+
+  // Same noise for all the gains
+  std::mt19937 rng(1000 + episode);
+  std::normal_distribution<double> normal(0, 1);
+
+  double xd[4], yd[4], Zd[4];
+  projectCorners(m_cdMo, xd, yd, Zd);
+
+  // Poses measured in the past to simulate the latency
+  const unsigned int delay = static_cast<unsigned int>(vpMath::round(m_latency / m_dt));
+  std::vector<vpHomogeneousMatrix> history(delay + 1);
+
+  const unsigned int N = (m_type == IMAGE_BASED ? 8 : 6);
+  // First component of the groups of error components with the same unit, followed by N
+  std::vector<unsigned int> groups;
+  const unsigned int pose_groups[3] = {0, 3, 6}, point_groups[2] = {0, 8}, hybrid_groups[4] = {0, 2, 3, 6};
+  if (m_type == POSITION_BASED) {
+    groups.assign(pose_groups, pose_groups + 3);
+  } else if (m_type == IMAGE_BASED) {
+    groups.assign(point_groups, point_groups + 2);
+  } else {
+    groups.assign(hybrid_groups, hybrid_groups + 4);
+  }
+  // Desired target center for the 2 1/2 D features
+  const double xcd = m_cdMo[0][3] / m_cdMo[2][3], ycd = m_cdMo[1][3] / m_cdMo[2][3], Zcd = m_cdMo[2][3];
+  double e0[8], e0_norm[8];
+  const double vel_max[6] = {m_robot.getMaxTranslationVelocity(), m_robot.getMaxTranslationVelocity(),
+                             m_robot.getMaxTranslationVelocity(), m_robot.getMaxRotationVelocity(),
+                             m_robot.getMaxRotationVelocity(),    m_robot.getMaxRotationVelocity()};
+  const vpVelocityTwistMatrix eVc(m_eMc);
+
+  vpColVector q = m_qInit[episode], v(6);
+  vpMatrix eJe;
+  vpHomogeneousMatrix fMe;
+  unsigned int nb_iter = 0, nb_saturated = 0;
+
+  for (unsigned int k = 0; k * m_dt < m_maxDuration; k++) {
+    m_robot.get_fMe(q, fMe);
+    vpHomogeneousMatrix cMo = (fMe * m_eMc).inverse() * m_fMo;
+
+    // True error, used for the overshoot
+    double e[8], x[4], y[4], Z[4];
+    if (m_type == POSITION_BASED) {
+      vpHomogeneousMatrix cdMc = m_cdMo * cMo.inverse();
+      vpThetaUVector tu = cdMc.getThetaUVector();
+      for (unsigned int i = 0; i < 3; i++) {
+        e[i] = cdMc[i][3];
+        e[i + 3] = tu[i];
+      }
+    } else if (m_type == HYBRID) {
+      if (!isVisible(cMo)) {
+        break;
+      }
+      vpThetaUVector tu = (m_cdMo * cMo.inverse()).getThetaUVector();
+      e[0] = cMo[0][3] / cMo[2][3] - xcd;
+      e[1] = cMo[1][3] / cMo[2][3] - ycd;
+      e[2] = std::log(cMo[2][3] / Zcd);
+      for (unsigned int i = 0; i < 3; i++) {
+        e[i + 3] = tu[i];
+      }
+    } else {
+      if (!isVisible(cMo)) {
+        break;
+      }
+      projectCorners(cMo, x, y, Z);
+      for (unsigned int i = 0; i < 4; i++) {
+        e[2 * i] = x[i] - xd[i];
+        e[2 * i + 1] = y[i] - yd[i];
+      }
+    }
+    for (unsigned int i = 0; i < N; i++) {
+      if (k == 0) {
+        e0[i] = e[i];
+      } else {
+        double overshoot = (e0[i] > 0 ? -e[i] : e[i]) / e0_norm[i];
+        result.overshoot = std::max(result.overshoot, overshoot);
+      }
+    }
+    if (k == 0) {
+      for (size_t g = 0; g + 1 < groups.size(); g++) {
+        double norm = 0;
+        for (unsigned int j = groups[g]; j < groups[g + 1]; j++) {
+          norm = std::max(norm, std::fabs(e0[j]));
+        }
+        for (unsigned int j = groups[g]; j < groups[g + 1]; j++) {
+          e0_norm[j] = std::max(norm, std::numeric_limits<double>::epsilon());
+        }
+      }
+      for (unsigned int i = 0; i <= delay; i++) {
+        history[i] = cMo;
+      }
+    }
+
+    // Measure with latency and noise
+    history[k % (delay + 1)] = cMo;
+    vpHomogeneousMatrix cMo_meas = history[(k + 1) % (delay + 1)];
+    bool converged = false;
+    if (m_type != IMAGE_BASED) {
+      // First order noise of a pose estimated from the 4 corners
+      double sigma = m_noise / m_cam.get_px() / 2., Zt = cMo_meas[2][3];
+      double sigma_t = sigma * Zt, sigma_z = sigma * Zt * Zt / m_tagSize, sigma_r = sigma * Zt / m_tagSize;
+      vpHomogeneousMatrix cnMc(sigma_t * normal(rng), sigma_t * normal(rng), sigma_z * normal(rng),
+                               sigma_r * normal(rng), sigma_r * normal(rng), sigma_r * normal(rng));
+      vpHomogeneousMatrix cnMo = cnMc * cMo_meas;
+      vpHomogeneousMatrix cdMc = m_cdMo * cnMo.inverse();
+      if (m_type == POSITION_BASED) {
+        pbvs.setPoseFeatures(cdMc);
+      } else {
+        // The target center is the origin of the tag frame
+        pbvs.setHybridFeatures(cnMo[0][3] / cnMo[2][3], cnMo[1][3] / cnMo[2][3], cnMo[2][3], xcd, ycd, Zcd, cdMc);
+      }
+      pbvs.computeControlLaw(v);
+      converged = (cdMc.getTranslationVector().sumSquare() < m_thresholdT * m_thresholdT &&
+                   vpMath::deg(cdMc.getThetaUVector().getTheta()) < m_thresholdTu);
+    } else {
+      projectCorners(cMo_meas, x, y, Z);
+      double error = 0;
+      for (unsigned int i = 0; i < 4; i++) {
+        x[i] += m_noise / m_cam.get_px() * normal(rng);
+        y[i] += m_noise / m_cam.get_py() * normal(rng);
+        ibvs.setPointFeature(i, x[i], y[i], Z[i], xd[i], yd[i]);
+        error += vpMath::sqr(x[i] - xd[i]) + vpMath::sqr(y[i] - yd[i]);
+      }
+      ibvs.computeControlLaw(v);
+      converged = (error < m_thresholdT);
+    }
+    if (converged) {
+      result.converged = true;
+      result.time = k * m_dt;
+      break;
+    }
+
+    // Saturation done by vpRobotKawasaki::setVelocity()
+    double ratio = 1;
+    for (unsigned int i = 0; i < 6; i++) {
+      ratio = std::max(ratio, std::fabs(v[i]) / vel_max[i]);
+    }
+    if (ratio > 1) {
+      v /= ratio;
+      nb_saturated++;
+    }
+    nb_iter++;
+
+    // Joint velocities as computed by vpRobotKawasaki::setCartVelocity()
+    m_robot.get_eJe(q, eJe);
+    vpColVector qdot = eJe.pseudoInverse() * (eVc * v);
+    q += qdot * m_dt;
+    bool in_limits = true;
+    for (unsigned int i = 0; i < ROBOT_DOF; i++) {
+      in_limits = in_limits && q[i] > m_qMin[i] && q[i] < m_qMax[i];
+    }
+    if (!in_limits) {
+      break;
+    }
+  }
+  result.saturation = (nb_iter > 0 ? static_cast<double>(nb_saturated) / nb_iter : 0.);
+  return result;
+}
+
+/*!
+  Search the gain with the shortest mean time to converge among the feasible ones.
+  About (16 + number of candidates + 16) x number of episodes episodes are simulated.
+
+  \return true if a feasible gain was found. Otherwise the fastest gain is selected.
+ */
+bool vpGainTuner::tune()
+{
+  if (m_thresholdT <= 0 || (m_type != IMAGE_BASED && m_thresholdTu <= 0)) {
+    throw(vpException(vpException::badValue, "The gain tuning needs a convergence threshold"));
+  }
+  if (!initEpisodes()) {
+    throw(vpException(vpException::badValue, "Cannot find initial joint positions with the tag in the image"));
+  }
+
+  std::vector<vpGainScore> scores;
+  // Constant gains from 0.05 to 4
+  for (unsigned int i = 0; i < 16; i++) {
+    double c = 0.05 * std::pow(80., i / 15.);
+    scores.push_back(makeScore(c, c, 0));
+  }
+  // Random adaptive gains
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  for (unsigned int i = 0; i < m_nbCandidates; i++) {
+    double gain_at_infinity = 0.05 * std::pow(40., uniform(rng));
+    double gain_at_zero = gain_at_infinity * (1.5 + 8.5 * uniform(rng));
+    double slope_at_zero = std::pow(100., uniform(rng));
+    scores.push_back(makeScore(gain_at_zero, gain_at_infinity, slope_at_zero));
+  }
+  evaluate(scores);
+  m_best = scores[0];
+  for (size_t i = 1; i < scores.size(); i++) {
+    if (isBetter(scores[i], m_best)) {
+      m_best = scores[i];
+    }
+  }
+
+  // Refinement around the best gain
+  std::vector<vpGainScore> local;
+  bool constant = (m_best.gain_at_zero <= m_best.gain_at_infinity);
+  for (unsigned int i = 0; i < 16; i++) {
+    double gain_at_infinity = m_best.gain_at_infinity * std::exp(0.6 * uniform(rng) - 0.3);
+    if (constant) {
+      local.push_back(makeScore(gain_at_infinity, gain_at_infinity, 0));
+    } else {
+      double gain_at_zero = std::max(m_best.gain_at_zero * std::exp(0.6 * uniform(rng) - 0.3), 1.1 * gain_at_infinity);
+      double slope_at_zero = m_best.slope_at_zero * std::exp(0.6 * uniform(rng) - 0.3);
+      local.push_back(makeScore(gain_at_zero, gain_at_infinity, slope_at_zero));
+    }
+  }
+  evaluate(local);
+  for (size_t i = 0; i < local.size(); i++) {
+    if (isBetter(local[i], m_best)) {
+      m_best = local[i];
+    }
+  }
+
+  return m_best.feasible;
+}
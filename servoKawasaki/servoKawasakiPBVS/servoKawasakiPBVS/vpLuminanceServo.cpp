@@ -0,0 +1,503 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Photometric visual servoing on the image intensities.
+ *
+ *****************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+#include <visp3/core/vpConfig.h>
+#include <visp3/core/vpCPUFeatures.h>
+#include <visp3/core/vpException.h>
+
+/*!
+  \file vpLuminanceServo.cpp
+  Photometric visual servoing on the image intensities.
+*/
+
+#include <vpLuminanceServo.h>
+
+// SSE2 and AVX2 kernels are compiled for x86 whatever the architecture flags, and only called
+// when vpCPUFeatures reports the instruction set
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define VP_LUMINANCE_SIMD
+#define VP_TARGET_SSE2 __attribute__((target("sse2")))
+#define VP_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#define VP_LUMINANCE_SIMD
+#define VP_TARGET_SSE2
+#define VP_TARGET_AVX2
+#endif
+
+namespace
+{
+// Accumulated sums: the 21 terms of the upper triangle of L^T L, the 6 terms of L^T e and e^T e
+const unsigned int nb_sums = 28;
+// Smallest number of image rows per thread
+const unsigned int min_rows_per_thread = 16;
+// Iterations without decrease of the error after which the next finer level is used
+const unsigned int max_stagnant_iterations = 10;
+
+//! Pointers and constants of the pixels of an image row used by a kernel.
+struct vpRow {
+  const float *gp, *g, *gn; //!< Rows r-1, r and r+1 of the image the gradients are computed on
+  const float *I, *Id;      //!< Row r of the current and desired images
+  unsigned int c0, c1;      //!< First and past the last column
+  float x0, dx;             //!< Normalized coordinate x of the column 0 and between two columns
+  float y;                  //!< Normalized coordinate y of the row
+  float Zinv;
+  float half_px, half_py;   //!< Central differences in pixel to gradients in normalized coordinates
+};
+
+typedef void (*vpRowKernel)(const vpRow &row, double sums[nb_sums]);
+
+inline void accumulatePixel(const vpRow &row, unsigned int c, float acc[nb_sums])
+{
+  const float Ix = (row.g[c + 1] - row.g[c - 1]) * row.half_px;
+  const float Iy = (row.gn[c] - row.gp[c]) * row.half_py;
+  const float x = row.x0 + c * row.dx;
+  const float y = row.y;
+  const float e = row.I[c] - row.Id[c];
+
+  // Interaction matrix row of vpFeatureLuminance
+  float L[6];
+  L[0] = Ix * row.Zinv;
+  L[1] = Iy * row.Zinv;
+  L[2] = -(x * Ix + y * Iy) * row.Zinv;
+  L[3] = -Ix * x * y - (1 + y * y) * Iy;
+  L[4] = (1 + x * x) * Ix + Iy * x * y;
+  L[5] = Iy * x - Ix * y;
+
+  unsigned int k = 0;
+  for (unsigned int i = 0; i < 6; i++) {
+    for (unsigned int j = i; j < 6; j++) {
+      acc[k++] += L[i] * L[j];
+    }
+  }
+  for (unsigned int i = 0; i < 6; i++) {
+    acc[k++] += L[i] * e;
+  }
+  acc[k] += e * e;
+}
+
+// The sums of a row are kept in float, then added in double
+void accumulateRowScalar(const vpRow &row, double sums[nb_sums])
+{
+  float acc[nb_sums] = {0};
+  for (unsigned int c = row.c0; c < row.c1; c++) {
+    accumulatePixel(row, c, acc);
+  }
+  for (unsigned int k = 0; k < nb_sums; k++) {
+    sums[k] += acc[k];
+  }
+}
+
+#if defined(VP_LUMINANCE_SIMD)
+VP_TARGET_SSE2 void accumulateRowSSE2(const vpRow &row, double sums[nb_sums])
+{
+  __m128 acc[nb_sums];
+  for (unsigned int k = 0; k < nb_sums; k++) {
+    acc[k] = _mm_setzero_ps();
+  }
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.f);
+  const __m128 half_px = _mm_set1_ps(row.half_px);
+  const __m128 half_py = _mm_set1_ps(row.half_py);
+  const __m128 Zinv = _mm_set1_ps(row.Zinv);
+  const __m128 y = _mm_set1_ps(row.y);
+  const __m128 one_y2 = _mm_set1_ps(1.f + row.y * row.y);
+  const __m128 lane_dx = _mm_setr_ps(0.f, row.dx, 2.f * row.dx, 3.f * row.dx);
+
+  unsigned int c = row.c0;
+  for (; c + 4 <= row.c1; c += 4) {
+    const __m128 Ix = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(row.g + c + 1), _mm_loadu_ps(row.g + c - 1)), half_px);
+    const __m128 Iy = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(row.gn + c), _mm_loadu_ps(row.gp + c)), half_py);
+    const __m128 e = _mm_sub_ps(_mm_loadu_ps(row.I + c), _mm_loadu_ps(row.Id + c));
+    const __m128 x = _mm_add_ps(_mm_set1_ps(row.x0 + c * row.dx), lane_dx);
+    const __m128 xy = _mm_mul_ps(x, y);
+
+    __m128 L[6];
+    L[0] = _mm_mul_ps(Ix, Zinv);
+    L[1] = _mm_mul_ps(Iy, Zinv);
+    L[2] = _mm_mul_ps(_mm_sub_ps(zero, _mm_add_ps(_mm_mul_ps(x, Ix), _mm_mul_ps(y, Iy))), Zinv);
+    L[3] = _mm_sub_ps(_mm_sub_ps(zero, _mm_mul_ps(Ix, xy)), _mm_mul_ps(one_y2, Iy));
+    L[4] = _mm_add_ps(_mm_mul_ps(_mm_add_ps(one, _mm_mul_ps(x, x)), Ix), _mm_mul_ps(Iy, xy));
+    L[5] = _mm_sub_ps(_mm_mul_ps(Iy, x), _mm_mul_ps(Ix, y));
+
+    unsigned int k = 0;
+    for (unsigned int i = 0; i < 6; i++) {
+      for (unsigned int j = i; j < 6; j++, k++) {
+        acc[k] = _mm_add_ps(acc[k], _mm_mul_ps(L[i], L[j]));
+      }
+    }
+    for (unsigned int i = 0; i < 6; i++, k++) {
+      acc[k] = _mm_add_ps(acc[k], _mm_mul_ps(L[i], e));
+    }
+    acc[k] = _mm_add_ps(acc[k], _mm_mul_ps(e, e));
+  }
+
+  // Remaining pixels of the row
+  float tail[nb_sums] = {0};
+  for (; c < row.c1; c++) {
+    accumulatePixel(row, c, tail);
+  }
+  float lanes[4];
+  for (unsigned int k = 0; k < nb_sums; k++) {
+    _mm_storeu_ps(lanes, acc[k]);
+    sums[k] += static_cast<double>(lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + tail[k];
+  }
+}
+
+VP_TARGET_AVX2 void accumulateRowAVX2(const vpRow &row, double sums[nb_sums])
+{
+  __m256 acc[nb_sums];
+  for (unsigned int k = 0; k < nb_sums; k++) {
+    acc[k] = _mm256_setzero_ps();
+  }
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.f);
+  const __m256 half_px = _mm256_set1_ps(row.half_px);
+  const __m256 half_py = _mm256_set1_ps(row.half_py);
+  const __m256 Zinv = _mm256_set1_ps(row.Zinv);
+  const __m256 y = _mm256_set1_ps(row.y);
+  const __m256 one_y2 = _mm256_set1_ps(1.f + row.y * row.y);
+  const __m256 lane_dx = _mm256_setr_ps(0.f, row.dx, 2.f * row.dx, 3.f * row.dx, 4.f * row.dx, 5.f * row.dx,
+                                        6.f * row.dx, 7.f * row.dx);
+
+  unsigned int c = row.c0;
+  for (; c + 8 <= row.c1; c += 8) {
+    const __m256 Ix =
+        _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(row.g + c + 1), _mm256_loadu_ps(row.g + c - 1)), half_px);
+    const __m256 Iy = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(row.gn + c), _mm256_loadu_ps(row.gp + c)), half_py);
+    const __m256 e = _mm256_sub_ps(_mm256_loadu_ps(row.I + c), _mm256_loadu_ps(row.Id + c));
+    const __m256 x = _mm256_add_ps(_mm256_set1_ps(row.x0 + c * row.dx), lane_dx);
+    const __m256 xy = _mm256_mul_ps(x, y);
+
+    __m256 L[6];
+    L[0] = _mm256_mul_ps(Ix, Zinv);
+    L[1] = _mm256_mul_ps(Iy, Zinv);
+    L[2] = _mm256_mul_ps(_mm256_sub_ps(zero, _mm256_add_ps(_mm256_mul_ps(x, Ix), _mm256_mul_ps(y, Iy))), Zinv);
+    L[3] = _mm256_sub_ps(_mm256_sub_ps(zero, _mm256_mul_ps(Ix, xy)), _mm256_mul_ps(one_y2, Iy));
+    L[4] = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(one, _mm256_mul_ps(x, x)), Ix), _mm256_mul_ps(Iy, xy));
+    L[5] = _mm256_sub_ps(_mm256_mul_ps(Iy, x), _mm256_mul_ps(Ix, y));
+
+    unsigned int k = 0;
+    for (unsigned int i = 0; i < 6; i++) {
+      for (unsigned int j = i; j < 6; j++, k++) {
+        acc[k] = _mm256_add_ps(acc[k], _mm256_mul_ps(L[i], L[j]));
+      }
+    }
+    for (unsigned int i = 0; i < 6; i++, k++) {
+      acc[k] = _mm256_add_ps(acc[k], _mm256_mul_ps(L[i], e));
+    }
+    acc[k] = _mm256_add_ps(acc[k], _mm256_mul_ps(e, e));
+  }
+
+  // Remaining pixels of the row
+  float tail[nb_sums] = {0};
+  for (; c < row.c1; c++) {
+    accumulatePixel(row, c, tail);
+  }
+  float lanes[8];
+  for (unsigned int k = 0; k < nb_sums; k++) {
+    _mm256_storeu_ps(lanes, acc[k]);
+    sums[k] += static_cast<double>((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) +
+               ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7])) + tail[k];
+  }
+  // Avoid the AVX to SSE transition penalty in the caller
+  _mm256_zeroupper();
+}
+#endif
+
+vpRowKernel selectKernel()
+{
+#if defined(VP_LUMINANCE_SIMD)
+  if (vpCPUFeatures::checkAVX2()) {
+    return accumulateRowAVX2;
+  }
+  if (vpCPUFeatures::checkSSE2()) {
+    return accumulateRowSSE2;
+  }
+#endif
+  return accumulateRowScalar;
+}
+
+vpRowKernel rowKernel()
+{
+  static const vpRowKernel kernel = selectKernel();
+  return kernel;
+}
+} // namespace
+
+vpLuminanceServo::vpLuminanceServo()
+  : m_cam(), m_Z(0.3), m_type(vpServo::MEAN), m_lambda(0.8), m_mu(0.01), m_border(10), m_nbThreads(0),
+    m_levelThreshold(10.), m_nbLevels(3), m_levels(), m_level(0), m_hasDesired(false), m_error(0),
+    m_minError(std::numeric_limits<double>::max()), m_nbStagnant(0), m_nbFeatures(0), m_H(6, 6), m_LTe(6)
+{
+}
+
+/*!
+  Accumulate \f${\bf L}^\top{\bf L}\f$, \f${\bf L}^\top{\bf e}\f$ and \f${\bf e}^\top{\bf e}\f$ over the pixels
+  of the pyramid level \e l, split by groups of rows between the threads.
+ */
+void vpLuminanceServo::accumulate(unsigned int l, double sums[28]) const
+{
+  const vpLevel &level = m_levels[l];
+  const std::vector<float> &G = (m_type == vpServo::DESIRED) ? level.Id : (m_type == vpServo::MEAN ? level.G : level.I);
+
+  // Camera parameters of the level, the pixel (u, v) being the mean of the pixels (2u, 2v) to (2u+1, 2v+1)
+  const double scale = 1. / (1 << l);
+  const double px = m_cam.get_px() * scale, py = m_cam.get_py() * scale;
+  const double u0 = (m_cam.get_u0() + 0.5) * scale - 0.5, v0 = (m_cam.get_v0() + 0.5) * scale - 0.5;
+
+  const unsigned int border = std::max(1u, m_border >> l);
+  const unsigned int r0 = border, r1 = level.height - border;
+  const unsigned int nb_rows = r1 - r0;
+
+  unsigned int nb_threads = m_nbThreads;
+  if (nb_threads == 0) {
+    nb_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  nb_threads = std::max(1u, std::min(nb_threads, nb_rows / min_rows_per_thread));
+
+  std::vector<double> partial(nb_sums * nb_threads, 0.);
+  const vpRowKernel kernel = rowKernel();
+  auto worker = [&](unsigned int t) {
+    vpRow row;
+    row.c0 = border;
+    row.c1 = level.width - border;
+    row.x0 = static_cast<float>(-u0 / px);
+    row.dx = static_cast<float>(1. / px);
+    row.Zinv = static_cast<float>(1. / m_Z);
+    row.half_px = static_cast<float>(0.5 * px);
+    row.half_py = static_cast<float>(0.5 * py);
+    for (unsigned int r = r0 + t * nb_rows / nb_threads; r < r0 + (t + 1) * nb_rows / nb_threads; r++) {
+      const size_t offset = static_cast<size_t>(r) * level.width;
+      row.gp = &G[offset - level.width];
+      row.g = &G[offset];
+      row.gn = &G[offset + level.width];
+      row.I = &level.I[offset];
+      row.Id = &level.Id[offset];
+      row.y = static_cast<float>((r - v0) / py);
+      kernel(row, &partial[nb_sums * t]);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned int t = 1; t < nb_threads; t++) {
+    threads.push_back(std::thread(worker, t));
+  }
+  worker(0);
+  for (size_t i = 0; i < threads.size(); i++) {
+    threads[i].join();
+  }
+
+  for (unsigned int k = 0; k < nb_sums; k++) {
+    sums[k] = 0;
+    for (unsigned int t = 0; t < nb_threads; t++) {
+      sums[k] += partial[nb_sums * t + k];
+    }
+  }
+}
+
+/*!
+  Convert the image \e I in the current or desired images of the pyramid levels 0 to \e last. Each level
+  is the mean of 2x2 pixels of the previous one.
+ */
+void vpLuminanceServo::buildPyramid(const vpImage<unsigned char> &I, bool desired, unsigned int last)
+{
+  for (unsigned int l = 0; l <= last; l++) {
+    vpLevel &level = m_levels[l];
+    std::vector<float> &dst = desired ? level.Id : level.I;
+    dst.resize(static_cast<size_t>(level.width) * level.height);
+    if (l == 0) {
+      for (size_t i = 0; i < dst.size(); i++) {
+        dst[i] = I.bitmap[i];
+      }
+    } else {
+      const vpLevel &prev = m_levels[l - 1];
+      const std::vector<float> &src = desired ? prev.Id : prev.I;
+      for (unsigned int r = 0; r < level.height; r++) {
+        const float *s0 = &src[static_cast<size_t>(2 * r) * prev.width];
+        const float *s1 = s0 + prev.width;
+        float *d = &dst[static_cast<size_t>(r) * level.width];
+        for (unsigned int c = 0; c < level.width; c++) {
+          d[c] = 0.25f * (s0[2 * c] + s0[2 * c + 1] + s1[2 * c] + s1[2 * c + 1]);
+        }
+      }
+    }
+  }
+}
+
+/*!
+  Compute the camera velocity that brings the image \e I to the desired image.
+
+  \return false if the image is not textured enough to observe the 6 degrees of freedom. The velocity is
+  then only computed on the observable ones.
+ */
+bool vpLuminanceServo::computeControlLaw(const vpImage<unsigned char> &I, vpColVector &v)
+{
+  if (!m_hasDesired) {
+    throw(vpException(vpException::notInitialized, "The desired image of the photometric servo is not set"));
+  }
+  if (I.getWidth() != m_levels[0].width || I.getHeight() != m_levels[0].height) {
+    throw(vpException(vpException::dimensionError, "The image size %dx%d differs from the desired image size %dx%d",
+                      I.getWidth(), I.getHeight(), m_levels[0].width, m_levels[0].height));
+  }
+
+  buildPyramid(I, false, m_level);
+  vpLevel &level = m_levels[m_level];
+  if (m_type == vpServo::MEAN) {
+    level.G.resize(level.I.size());
+    for (size_t i = 0; i < level.G.size(); i++) {
+      level.G[i] = 0.5f * (level.I[i] + level.Id[i]);
+    }
+  }
+
+  double sums[nb_sums];
+  accumulate(m_level, sums);
+  unsigned int k = 0;
+  for (unsigned int i = 0; i < 6; i++) {
+    for (unsigned int j = i; j < 6; j++) {
+      m_H[i][j] = m_H[j][i] = sums[k++];
+    }
+  }
+  for (unsigned int i = 0; i < 6; i++) {
+    m_LTe[i] = sums[k++];
+  }
+  const unsigned int border = std::max(1u, m_border >> m_level);
+  m_nbFeatures = (level.width - 2 * border) * (level.height - 2 * border);
+  m_error = std::sqrt(sums[k] / m_nbFeatures);
+
+  // Levenberg-Marquardt step
+  vpMatrix Hs = m_H;
+  for (unsigned int i = 0; i < 6; i++) {
+    Hs[i][i] += m_mu * m_H[i][i];
+  }
+  vpMatrix Hs_inv;
+  unsigned int rank = Hs.pseudoInverse(Hs_inv);
+  v = -m_lambda(m_error) * Hs_inv * m_LTe;
+
+  updateLevel();
+
+  return rank == 6;
+}
+
+//! Return the name of the kernel selected for this CPU: "AVX2", "SSE2" or "scalar".
+std::string vpLuminanceServo::getKernelName()
+{
+#if defined(VP_LUMINANCE_SIMD)
+  if (rowKernel() == accumulateRowAVX2) {
+    return "AVX2";
+  }
+  if (rowKernel() == accumulateRowSSE2) {
+    return "SSE2";
+  }
+#endif
+  return "scalar";
+}
+
+//! Restart the servo on the coarsest pyramid level, for instance when the robot starts moving.
+void vpLuminanceServo::reset()
+{
+  m_level = m_levels.empty() ? 0 : static_cast<unsigned int>(m_levels.size()) - 1;
+  m_minError = std::numeric_limits<double>::max();
+  m_nbStagnant = 0;
+}
+
+void vpLuminanceServo::setCameraParameters(const vpCameraParameters &cam) { m_cam = cam; }
+
+//! Set the depth in meter of the scene, assumed to be constant over the image.
+void vpLuminanceServo::setDepth(double Z)
+{
+  if (Z <= 0) {
+    throw(vpException(vpException::badValue, "The depth of the photometric servo has to be positive"));
+  }
+  m_Z = Z;
+}
+
+//! Set the desired image and build its pyramid, then restart the servo on the coarsest level.
+void vpLuminanceServo::setDesiredImage(const vpImage<unsigned char> &Id)
+{
+  unsigned int width = Id.getWidth(), height = Id.getHeight();
+  if (width < 40 || height < 30) {
+    throw(vpException(vpException::dimensionError, "The desired image %dx%d is too small", width, height));
+  }
+  m_levels.clear();
+  while (m_levels.size() < m_nbLevels && width >= 40 && height >= 30) {
+    vpLevel level;
+    level.width = width;
+    level.height = height;
+    m_levels.push_back(level);
+    width /= 2;
+    height /= 2;
+  }
+  buildPyramid(Id, true, static_cast<unsigned int>(m_levels.size()) - 1);
+  m_hasDesired = true;
+  reset();
+}
+
+/*!
+  Set the image the gradients of the interaction matrix are computed on: vpServo::CURRENT, vpServo::DESIRED
+  or vpServo::MEAN (default).
+ */
+void vpLuminanceServo::setInteractionMatrixType(vpServo::vpServoIteractionMatrixType type)
+{
+  if (type != vpServo::CURRENT && type != vpServo::DESIRED && type != vpServo::MEAN) {
+    throw(vpException(vpException::badValue, "Unsupported interaction matrix type of the photometric servo"));
+  }
+  m_type = type;
+}
+
+// Go to the next finer level once the error is small enough or stops decreasing
+void vpLuminanceServo::updateLevel()
+{
+  if (m_level == 0) {
+    return;
+  }
+  if (m_error < 0.99 * m_minError) {
+    m_minError = m_error;
+    m_nbStagnant = 0;
+  } else {
+    m_nbStagnant++;
+  }
+  if (m_error < m_levelThreshold || m_nbStagnant >= max_stagnant_iterations) {
+    m_level--;
+    m_minError = std::numeric_limits<double>::max();
+    m_nbStagnant = 0;
+  }
+}
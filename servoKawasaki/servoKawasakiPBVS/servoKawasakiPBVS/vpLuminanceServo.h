@@ -0,0 +1,166 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Photometric visual servoing on the image intensities.
+ *
+ *****************************************************************************/
+
+
+#ifndef vpLuminanceServo_h
+#define vpLuminanceServo_h
+
+/*!
+  \file vpLuminanceServo.h
+  Photometric visual servoing on the image intensities.
+*/
+
+#include <string>
+#include <vector>
+
+#include <visp3/core/vpConfig.h>
+
+#include <visp3/core/vpCameraParameters.h>
+#include <visp3/core/vpColVector.h>
+#include <visp3/core/vpImage.h>
+#include <visp3/core/vpMatrix.h>
+#include <visp3/vs/vpAdaptiveGain.h>
+#include <visp3/vs/vpServo.h>
+
+/*!
+
+  \class vpLuminanceServo
+  \brief Eye-in-hand photometric visual servo, where the visual features are the intensities of all the
+  pixels of the image, compared to a desired image. No target has to be detected, the scene only has to be
+  textured and roughly planar at the depth set by setDepth().
+
+  The interaction matrix row of a pixel is the one of vpFeatureLuminance:
+  \f[ {\bf L}_I = -(I_x {\bf L}_x + I_y {\bf L}_y) \f]
+  where \f$I_x, I_y\f$ are the image gradients in normalized coordinates. With thousands of rows, the
+  matrix is never built: \f${\bf H} = {\bf L}^\top{\bf L}\f$ and \f${\bf L}^\top{\bf e}\f$ are accumulated
+  row by row, with SSE2 or AVX2 kernels selected at runtime by vpCPUFeatures, on all the cores. The
+  velocity is then given by the Levenberg-Marquardt control law of the photometric servo
+  \f[ {\bf v} = -\lambda ({\bf H} + \mu\, \mbox{diag}({\bf H}))^{-1} {\bf L}^\top{\bf e} \f]
+
+  Like with vpServo::setInteractionMatrixType(), the gradients are computed on the current image
+  (vpServo::CURRENT), on the desired image (vpServo::DESIRED) or on their mean (vpServo::MEAN), which
+  gives the largest convergence domain.
+
+  The servo starts on the coarsest level of an image pyramid, where the cost function is smooth and
+  a few hundred pixels are enough, and goes to the next finer level once the RMS error is below
+  the level threshold or stops decreasing. The full resolution is only used near the convergence.
+
+  \code
+  vpLuminanceServo servo;
+  servo.setCameraParameters(cam);
+  servo.setDepth(0.3);
+  servo.setDesiredImage(Id);
+  servo.setLambda(0.8);
+  while (!quit) {
+    rs.acquire(I);
+    servo.computeControlLaw(I, v_c);
+    robot.setVelocity(vpRobot::CAMERA_FRAME, v_c);
+  }
+  \endcode
+
+*/
+class vpLuminanceServo
+{
+public:
+  vpLuminanceServo();
+
+  bool computeControlLaw(const vpImage<unsigned char> &I, vpColVector &v);
+
+  //! Return the RMS intensity error of the last computeControlLaw(), in gray level.
+  double getError() const { return m_error; }
+  //! Return \f${\bf L}^\top{\bf L}\f$ computed by the last computeControlLaw().
+  const vpMatrix &getHessian() const { return m_H; }
+  static std::string getKernelName();
+  //! Return the pyramid level used by the next computeControlLaw(), 0 being the full resolution.
+  unsigned int getLevel() const { return m_level; }
+  //! Return the number of pixels used by the last computeControlLaw().
+  unsigned int getNbFeatures() const { return m_nbFeatures; }
+
+  void reset();
+
+  //! Set the number of pixels at full resolution that are ignored along the image border.
+  void setBorder(unsigned int border) { m_border = border; }
+  void setCameraParameters(const vpCameraParameters &cam);
+  void setDepth(double Z);
+  void setDesiredImage(const vpImage<unsigned char> &Id);
+  void setInteractionMatrixType(vpServo::vpServoIteractionMatrixType type);
+  void setLambda(double c) { m_lambda.initFromConstant(c); }
+  void setLambda(const vpAdaptiveGain &lambda) { m_lambda = lambda; }
+  //! Set the RMS error in gray level below which the next finer pyramid level is used.
+  void setLevelThreshold(double threshold) { m_levelThreshold = threshold; }
+  //! Set the Levenberg-Marquardt damping \f$\mu\f$.
+  void setMu(double mu) { m_mu = mu; }
+  //! Set the number of threads, 0 to use all the cores.
+  void setNbThreads(unsigned int nb) { m_nbThreads = nb; }
+  /*!
+    Set the number of pyramid levels, 1 to only use the full resolution. To call before setDesiredImage().
+    Levels smaller than 40x30 pixels are not used.
+   */
+  void setPyramidLevels(unsigned int nb) { m_nbLevels = (nb > 0 ? nb : 1); }
+
+protected:
+  //! Images of a pyramid level.
+  struct vpLevel {
+    unsigned int width;
+    unsigned int height;
+    std::vector<float> I;  //!< Current image
+    std::vector<float> Id; //!< Desired image
+    std::vector<float> G;  //!< Image of the gradients with vpServo::MEAN
+  };
+
+  void accumulate(unsigned int l, double sums[28]) const;
+  void buildPyramid(const vpImage<unsigned char> &I, bool desired, unsigned int last);
+  void updateLevel();
+
+  vpCameraParameters m_cam;
+  double m_Z;
+  vpServo::vpServoIteractionMatrixType m_type;
+  vpAdaptiveGain m_lambda;
+  double m_mu;
+  unsigned int m_border;
+  unsigned int m_nbThreads;
+  double m_levelThreshold;
+  unsigned int m_nbLevels;
+  std::vector<vpLevel> m_levels;
+  unsigned int m_level;
+  bool m_hasDesired;
+  double m_error;
+  double m_minError;          //!< Smallest error on the current level
+  unsigned int m_nbStagnant;  //!< Iterations without decrease of the error on the current level
+  unsigned int m_nbFeatures;
+  vpMatrix m_H;
+  vpColVector m_LTe;
+};
+#endif
@@ -0,0 +1,204 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * HTTP exporter of the servo metrics on localhost.
+ *
+ *****************************************************************************/
+
+#include <cstring>
+#include <string>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <windows.h>
+#elif defined(__linux__)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <visp3/core/vpException.h>
+
+/*!
+  \file vpMetricsServer.cpp
+  HTTP exporter of the servo metrics on localhost.
+*/
+
+#include <vpMetricsServer.h>
+#include <vpTrace.h>
+
+namespace
+{
+#if defined(_WIN32)
+typedef SOCKET socket_t;
+const socket_t invalid_socket = INVALID_SOCKET;
+void closeSocket(socket_t s) { closesocket(s); }
+#else
+typedef int socket_t;
+const socket_t invalid_socket = -1;
+void closeSocket(socket_t s) { close(s); }
+#endif
+
+#if defined(__linux__)
+// Return an error instead of raising SIGPIPE, that kills the servo process, when the scraper closes early
+const int send_flags = MSG_NOSIGNAL;
+#else
+const int send_flags = 0;
+#endif
+
+// Time between two checks of stop()
+const long poll_timeout_us = 100000;
+
+// Run the calling thread only when the cores are idle
+void lowerPriority()
+{
+#if defined(_WIN32)
+  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#elif defined(__linux__)
+  sched_param param;
+  param.sched_priority = 0;
+  pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+}
+
+// Wait at most poll_timeout_us for \e s to be readable
+bool waitReadable(socket_t s)
+{
+  fd_set set;
+  FD_ZERO(&set);
+  FD_SET(s, &set);
+  timeval timeout;
+  timeout.tv_sec = 0;
+  timeout.tv_usec = poll_timeout_us;
+  return select(static_cast<int>(s) + 1, &set, nullptr, nullptr, &timeout) > 0;
+}
+
+void sendAll(socket_t s, const std::string &data)
+{
+  size_t sent = 0;
+  while (sent < data.size()) {
+    int n = send(s, data.c_str() + sent, static_cast<int>(data.size() - sent), send_flags);
+    if (n <= 0) {
+      return;
+    }
+    sent += static_cast<size_t>(n);
+  }
+}
+} // namespace
+
+vpMetricsServer::vpMetricsServer(const vpMetricsRegistry &metrics)
+  : m_metrics(metrics), m_thread(), m_running(false), m_socket(static_cast<uintptr_t>(invalid_socket))
+{
+}
+
+vpMetricsServer::~vpMetricsServer() { stop(); }
+
+/*!
+  Listen on 127.0.0.1:\e port and start the server thread.
+ */
+void vpMetricsServer::start(unsigned short port)
+{
+  stop();
+#if defined(_WIN32)
+  WSADATA wsa_data;
+  if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
+    throw(vpException(vpException::ioError, "Cannot initialize Winsock"));
+  }
+#endif
+  socket_t s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (s == invalid_socket) {
+    throw(vpException(vpException::ioError, "Cannot create the metrics socket"));
+  }
+  int reuse = 1;
+  setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&reuse), sizeof(reuse));
+  sockaddr_in address;
+  std::memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+  if (bind(s, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(s, 4) != 0) {
+    closeSocket(s);
+    throw(vpException(vpException::ioError, "Cannot listen on 127.0.0.1:%u", port));
+  }
+  m_socket = static_cast<uintptr_t>(s);
+  m_running = true;
+  m_thread = std::thread(&vpMetricsServer::run, this);
+}
+
+/*!
+  Stop the server thread and close the socket.
+ */
+void vpMetricsServer::stop()
+{
+  m_running = false;
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+  if (static_cast<socket_t>(m_socket) != invalid_socket) {
+    closeSocket(static_cast<socket_t>(m_socket));
+    m_socket = static_cast<uintptr_t>(invalid_socket);
+#if defined(_WIN32)
+    WSACleanup();
+#endif
+  }
+}
+
+void vpMetricsServer::run()
+{
+  lowerPriority();
+  VP_TRACE_THREAD("metrics");
+  socket_t s = static_cast<socket_t>(m_socket);
+  char request[1024];
+  while (m_running) {
+    if (!waitReadable(s)) {
+      continue;
+    }
+    socket_t client = accept(s, nullptr, nullptr);
+    if (client == invalid_socket) {
+      continue;
+    }
+    // The request is read to be polite with the client, but its path is ignored
+    if (waitReadable(client)) {
+      recv(client, request, sizeof(request), 0);
+    }
+    std::string body = m_metrics.getText();
+    sendAll(client, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                        std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body);
+    closeSocket(client);
+  }
+}
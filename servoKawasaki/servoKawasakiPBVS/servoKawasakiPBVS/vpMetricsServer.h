@@ -0,0 +1,89 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * HTTP exporter of the servo metrics on localhost.
+ *
+ *****************************************************************************/
+
+#ifndef vpMetricsServer_h
+#define vpMetricsServer_h
+
+/*!
+  \file vpMetricsServer.h
+  HTTP exporter of the servo metrics on localhost.
+*/
+
+#include <atomic>
+#include <thread>
+
+#include <visp3/core/vpConfig.h>
+
+#include <vpMetrics.h>
+
+/*!
+
+  \class vpMetricsServer
+  \brief Serve the text of a vpMetricsRegistry on http://127.0.0.1:<port>/ for a Prometheus scraper or curl.
+
+  The server runs in a thread of the lowest priority, like vpOnlineHandEye, and only reads the atomic values
+  of the metrics: a scrape never blocks nor delays the servo loop. Any request path returns the metrics.
+
+  \code
+  vpMetricsRegistry metrics;
+  vpMetricsServer server(metrics);
+  server.start(9100);
+  // curl http://127.0.0.1:9100/metrics
+  server.stop();
+  \endcode
+
+*/
+class vpMetricsServer
+{
+public:
+  explicit vpMetricsServer(const vpMetricsRegistry &metrics);
+  vpMetricsServer(const vpMetricsServer &) = delete;
+  vpMetricsServer &operator=(const vpMetricsServer &) = delete;
+  ~vpMetricsServer();
+
+  //! Return true if the server thread is running.
+  bool isRunning() const { return m_running; }
+  void start(unsigned short port);
+  void stop();
+
+protected:
+  void run();
+
+  const vpMetricsRegistry &m_metrics;
+  std::thread m_thread;
+  std::atomic<bool> m_running;
+  uintptr_t m_socket; //!< Listening socket, SOCKET on Windows and file descriptor on Linux
+};
+#endif
@@ -0,0 +1,347 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Model-based tracking of the target with edges, KLT points and depth.
+ *
+ *****************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+
+#include <visp3/core/vpConfig.h>
+#include <visp3/core/vpException.h>
+#include <visp3/core/vpExponentialMap.h>
+#include <visp3/core/vpMath.h>
+#include <visp3/core/vpPixelMeterConversion.h>
+#include <visp3/core/vpTime.h>
+#include <visp3/core/vpTrackingException.h>
+
+/*!
+  \file vpModelTracker.cpp
+  Model-based tracking of the target with edges, KLT points and depth.
+*/
+
+#include <vpModelTracker.h>
+
+namespace
+{
+// Drift of the KLT pose wrt the fused pose above which the KLT tracker restarts from the fused pose
+const double klt_max_drift_t = 0.005; // m
+const double klt_max_drift_tu = vpMath::rad(2.);
+
+// Track with a single feature tracker, false if it lost its features
+bool trackOne(vpMbGenericTracker &tracker, const vpImage<unsigned char> &I, vpHomogeneousMatrix &cMo,
+              vpMatrix &covariance)
+{
+  try {
+    tracker.track(I);
+  } catch (const vpException &) {
+    return false;
+  }
+  tracker.getPose(cMo);
+  covariance = tracker.getCovarianceMatrix();
+  return true;
+}
+
+// Copy in the buffer of \e dst, that is only allocated when the size changes
+template <class Type> void copyImage(const vpImage<Type> &src, vpImage<Type> &dst)
+{
+  dst.resize(src.getHeight(), src.getWidth());
+  std::copy(src.bitmap, src.bitmap + src.getSize(), dst.bitmap);
+}
+} // namespace
+
+vpModelTracker::vpModelTracker()
+  : m_edge(1, vpMbGenericTracker::EDGE_TRACKER), m_klt(1, vpMbGenericTracker::KLT_TRACKER),
+    m_depth(1, vpMbGenericTracker::DEPTH_DENSE_TRACKER), m_cam(), m_depthScale(0.001), m_display(true),
+    m_pipelined(true), m_maxProjectionError(30.), m_I(), m_depthRaw(), m_frame(), m_trackedI(&m_I),
+    m_trackedDepth(&m_depthRaw), m_pointCloud(), m_xy(), m_job(),
+    m_tracked(false), m_cMo(), m_projectionError(0), m_trackingTime(0)
+{
+  m_edge.setCovarianceComputation(true);
+  m_klt.setCovarianceComputation(true);
+  m_depth.setCovarianceComputation(true);
+}
+
+vpModelTracker::~vpModelTracker() { wait(); }
+
+/*!
+  Fuse the poses of the trackers that succeeded, weighted by the inverse of their covariance. The
+  covariance of vpMbTracker being the one of the camera velocity of the virtual visual servoing, the poses
+  are expressed as the velocity that moves the camera from the reference pose.
+
+  \return false if no tracker succeeded.
+ */
+bool vpModelTracker::fuse(const std::vector<vpHomogeneousMatrix> &poses, const std::vector<vpMatrix> &covariances,
+                          const std::vector<bool> &tracked, vpHomogeneousMatrix &cMo) const
+{
+  // Reference pose: the first tracked one, the edges being the most accurate
+  size_t ref = 0;
+  while (ref < poses.size() && !tracked[ref]) {
+    ref++;
+  }
+  if (ref == poses.size()) {
+    return false;
+  }
+
+  vpMatrix W_sum(6, 6);
+  vpColVector Wv_sum(6);
+  for (size_t i = ref; i < poses.size(); i++) {
+    if (!tracked[i]) {
+      continue;
+    }
+    // cMo_i = direct(v_i)^-1 cMo_ref, as in the pose update of vpMbTracker
+    vpColVector v = vpExponentialMap::inverse(poses[ref] * poses[i].inverse());
+    vpMatrix W;
+    if (covariances[i].getRows() == 6 && covariances[i].getCols() == 6) {
+      covariances[i].pseudoInverse(W);
+    } else {
+      W.eye(6);
+    }
+    W_sum += W;
+    Wv_sum += W * v;
+  }
+  vpColVector v = W_sum.pseudoInverse() * Wv_sum;
+  cMo = vpExponentialMap::direct(v).inverse() * poses[ref];
+  return true;
+}
+
+//! Initialize the pose by clicking on the points of the \e init_file, see vpMbTracker::initClick().
+void vpModelTracker::initClick(const vpImage<unsigned char> &I, const std::string &init_file)
+{
+  wait();
+  m_edge.initClick(I, init_file, true);
+  vpHomogeneousMatrix cMo;
+  m_edge.getPose(cMo);
+  initFromPose(I, cMo);
+}
+
+//! Initialize or reset the pose of all the trackers, for instance after a loss of the target.
+void vpModelTracker::initFromPose(const vpImage<unsigned char> &I, const vpHomogeneousMatrix &cMo)
+{
+  wait();
+  m_edge.initFromPose(I, cMo);
+  m_klt.initFromPose(I, cMo);
+  m_depth.initFromPose(I, cMo);
+  m_cMo = cMo;
+  m_tracked = false;
+}
+
+/*!
+  Load the CAD model of the target in the vpMbGenericTracker formats (.cao or .wrl) and the optional XML
+  configuration file.
+ */
+void vpModelTracker::loadModel(const std::string &model_file, const std::string &config_file)
+{
+  wait();
+  if (!config_file.empty()) {
+    m_edge.loadConfigFile(config_file);
+    m_klt.loadConfigFile(config_file);
+    m_depth.loadConfigFile(config_file);
+  }
+  m_edge.loadModel(model_file);
+  m_klt.loadModel(model_file);
+  m_depth.loadModel(model_file);
+  // The configuration file may contain other camera parameters
+  setCameraParameters(m_cam);
+}
+
+void vpModelTracker::setCameraParameters(const vpCameraParameters &cam)
+{
+  wait();
+  m_cam = cam;
+  m_edge.setCameraParameters(cam);
+  m_klt.setCameraParameters(cam);
+  m_depth.setCameraParameters(cam);
+  m_xy.clear();
+}
+
+/*!
+  Track the target in the color image \e I and the depth image \e depth_raw aligned on it.
+
+  \param[in] I : Gray level image.
+  \param[in] depth_raw : Raw depth image, in unit of the depth scale.
+  \param[out] cMo : Pose of the target, of the previous frame with setPipelined().
+  \return true if the pose is tracked.
+ */
+bool vpModelTracker::track(const vpImage<unsigned char> &I, const vpImage<uint16_t> &depth_raw,
+                           vpHomogeneousMatrix &cMo)
+{
+  if (I.getWidth() != depth_raw.getWidth() || I.getHeight() != depth_raw.getHeight()) {
+    throw(vpException(vpException::dimensionError, "The depth image has to be aligned on the color image"));
+  }
+  // Result of the previous frame
+  wait();
+  copyImage(I, m_I);
+  copyImage(depth_raw, m_depthRaw);
+  m_frame.reset();
+  m_trackedI = &m_I;
+  m_trackedDepth = &m_depthRaw;
+  return startTracking(I, cMo);
+}
+
+/*!
+  Track the target in the gray and depth images of a frame of a vpFramePool, without copying them. With
+  setPipelined(), the frame is kept until the next call to track().
+
+  \param[in] frame : Frame whose depth image is aligned on its gray image.
+  \param[out] cMo : Pose of the target, of the previous frame with setPipelined().
+  \return true if the pose is tracked.
+ */
+bool vpModelTracker::track(const vpFrameHandle &frame, vpHomogeneousMatrix &cMo)
+{
+  if (frame->I.getWidth() != frame->depthRaw.getWidth() || frame->I.getHeight() != frame->depthRaw.getHeight()) {
+    throw(vpException(vpException::dimensionError, "The depth image has to be aligned on the color image"));
+  }
+  // Result of the previous frame, that can then be released
+  wait();
+  m_frame = frame;
+  m_trackedI = &frame->I;
+  m_trackedDepth = &frame->depthRaw;
+  return startTracking(frame->I, cMo);
+}
+
+// Track the images given by track(), in the background with setPipelined()
+bool vpModelTracker::startTracking(const vpImage<unsigned char> &I, vpHomogeneousMatrix &cMo)
+{
+  if (m_pipelined) {
+    // Read the result before the tracking of this frame updates it
+    if (m_display && m_tracked) {
+      m_edge.display(I, m_cMo, m_cam, vpColor::red, 2);
+    }
+    cMo = m_cMo;
+    bool tracked = m_tracked;
+    m_job = std::async(std::launch::async, &vpModelTracker::trackFrame, this);
+    return tracked;
+  }
+
+  m_tracked = trackFrame();
+  m_frame.reset();
+  if (m_display && m_tracked) {
+    m_edge.display(I, m_cMo, m_cam, vpColor::red, 2);
+  }
+  cMo = m_cMo;
+  return m_tracked;
+}
+
+//! Track the images given by track() with the three trackers in parallel, then fuse their poses.
+bool vpModelTracker::trackFrame()
+{
+  double t_start = vpTime::measureTimeMs();
+
+  std::vector<vpHomogeneousMatrix> poses(3);
+  std::vector<vpMatrix> covariances(3);
+  std::vector<bool> tracked(3, false);
+
+  std::future<bool> edge = std::async(std::launch::async, trackOne, std::ref(m_edge), std::cref(*m_trackedI),
+                                      std::ref(poses[0]), std::ref(covariances[0]));
+  std::future<bool> klt = std::async(std::launch::async, trackOne, std::ref(m_klt), std::cref(*m_trackedI),
+                                     std::ref(poses[1]), std::ref(covariances[1]));
+
+  // The point cloud and the depth tracking run in this thread
+  updatePointCloud();
+  const std::string name = m_depth.getCameraNames().front();
+  std::map<std::string, const vpImage<unsigned char> *> mapOfImages;
+  std::map<std::string, const std::vector<vpColVector> *> mapOfPointClouds;
+  std::map<std::string, unsigned int> mapOfWidths, mapOfHeights;
+  mapOfImages[name] = m_trackedI;
+  mapOfPointClouds[name] = &m_pointCloud;
+  mapOfWidths[name] = m_trackedI->getWidth();
+  mapOfHeights[name] = m_trackedI->getHeight();
+  try {
+    m_depth.track(mapOfImages, mapOfPointClouds, mapOfWidths, mapOfHeights);
+    m_depth.getPose(poses[2]);
+    covariances[2] = m_depth.getCovarianceMatrix();
+    tracked[2] = true;
+  } catch (const vpException &) {
+  }
+
+  tracked[0] = edge.get();
+  tracked[1] = klt.get();
+
+  vpHomogeneousMatrix cMo;
+  bool has_pose = fuse(poses, covariances, tracked, cMo);
+  if (has_pose) {
+    m_projectionError = m_edge.computeCurrentProjectionError(*m_trackedI, cMo, m_cam);
+    has_pose = (m_projectionError < m_maxProjectionError);
+  }
+
+  if (has_pose) {
+    // Restart from the fused pose
+    m_edge.setPose(*m_trackedI, cMo);
+    m_depth.setPose(*m_trackedI, cMo);
+    vpHomogeneousMatrix cMc_klt = cMo * poses[1].inverse();
+    if (!tracked[1] || std::sqrt(cMc_klt.getTranslationVector().sumSquare()) > klt_max_drift_t ||
+        std::sqrt(cMc_klt.getThetaUVector().sumSquare()) > klt_max_drift_tu) {
+      m_klt.setPose(*m_trackedI, cMo);
+    }
+    m_cMo = cMo;
+  }
+
+  m_trackingTime = vpTime::measureTimeMs() - t_start;
+  return has_pose;
+}
+
+// Point cloud of the aligned depth image, as needed by the depth dense tracker
+void vpModelTracker::updatePointCloud()
+{
+  const vpImage<uint16_t> &depth_raw = *m_trackedDepth;
+  const unsigned int width = depth_raw.getWidth(), height = depth_raw.getHeight();
+  const size_t size = static_cast<size_t>(width) * height;
+  if (m_xy.size() != 2 * size) {
+    m_xy.resize(2 * size);
+    for (unsigned int i = 0; i < height; i++) {
+      for (unsigned int j = 0; j < width; j++) {
+        const size_t k = static_cast<size_t>(i) * width + j;
+        vpPixelMeterConversion::convertPoint(m_cam, j, i, m_xy[2 * k], m_xy[2 * k + 1]);
+      }
+    }
+    m_pointCloud.assign(size, vpColVector(3));
+  }
+
+  for (size_t k = 0; k < size; k++) {
+    const double Z = depth_raw.bitmap[k] * m_depthScale;
+    vpColVector &point = m_pointCloud[k];
+    point[0] = m_xy[2 * k] * Z;
+    point[1] = m_xy[2 * k + 1] * Z;
+    point[2] = Z;
+  }
+}
+
+// Wait for the tracking of the previous frame
+void vpModelTracker::wait()
+{
+  if (m_job.valid()) {
+    m_tracked = m_job.get();
+  }
+}
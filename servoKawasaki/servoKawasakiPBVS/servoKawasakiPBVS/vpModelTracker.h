@@ -0,0 +1,156 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Model-based tracking of the target with edges, KLT points and depth.
+ *
+ *****************************************************************************/
+
+
+#ifndef vpModelTracker_h
+#define vpModelTracker_h
+
+/*!
+  \file vpModelTracker.h
+  Model-based tracking of the target with edges, KLT points and depth.
+*/
+
+#include <future>
+#include <string>
+#include <vector>
+
+#include <visp3/core/vpConfig.h>
+
+#include <visp3/core/vpCameraParameters.h>
+#include <visp3/core/vpColVector.h>
+#include <visp3/core/vpHomogeneousMatrix.h>
+#include <visp3/core/vpImage.h>
+#include <visp3/mbt/vpMbGenericTracker.h>
+
+#include <vpFramePool.h>
+
+/*!
+
+  \class vpModelTracker
+  \brief Track a target without tag from its CAD model, with the moving edges and the KLT points of the
+  color image and the dense depth of the aligned depth image.
+
+  Each kind of feature has its own vpMbGenericTracker, so that the edge, KLT and depth trackers run in
+  parallel threads on the same frame. Their poses are fused with the inverse of their covariance, in the
+  tangent space of the edge pose: a tracker that lost its features gets a small weight. The edge and depth
+  trackers then restart from the fused pose at each frame, the KLT tracker only when it drifted away, since
+  setting its pose reinitializes its points.
+
+  With setPipelined(), track() starts the tracking of the given frame in the background and returns the
+  pose of the previous frame, so that the acquisition of the next frame and the control law overlap the
+  tracking. The pose has then one frame of latency. The frames of a vpFramePool are tracked without copy, the
+  tracker keeping a handle on the frame until the next call to track().
+
+  The configuration file is the XML file of vpMbGenericTracker, with the \c ecm, \c klt and \c depth_dense
+  sections. The same camera parameters are used for the depth, that has to be aligned on the color image.
+
+  \code
+  vpModelTracker tracker;
+  tracker.loadModel("part.cao", "part.xml");
+  tracker.setCameraParameters(cam);
+  tracker.setDepthScale(rs.getDepthScale());
+  tracker.initClick(I, "part.init");
+  while (!quit) {
+    rs.acquire((unsigned char *)Ic.bitmap, (unsigned char *)I_depth_raw.bitmap, NULL, NULL, &align_to);
+    vpImageConvert::convert(Ic, I);
+    if (tracker.track(I, I_depth_raw, cMo)) {
+      ...
+    }
+  }
+  \endcode
+
+*/
+class vpModelTracker
+{
+public:
+  vpModelTracker();
+  virtual ~vpModelTracker();
+
+  //! Return the projection error in degree of the last tracked pose, see vpMbTracker::getProjectionError().
+  double getProjectionError() const { return m_projectionError; }
+  //! Return the duration in ms of the last tracking, without the acquisition.
+  double getTrackingTime() const { return m_trackingTime; }
+
+  void initClick(const vpImage<unsigned char> &I, const std::string &init_file);
+  void initFromPose(const vpImage<unsigned char> &I, const vpHomogeneousMatrix &cMo);
+
+  void loadModel(const std::string &model_file, const std::string &config_file = "");
+
+  void setCameraParameters(const vpCameraParameters &cam);
+  //! Set the scale in meter of the raw depth values.
+  void setDepthScale(double scale) { m_depthScale = scale; }
+  //! Draw the model with the last tracked pose in the image given to track().
+  void setDisplay(bool display) { m_display = display; }
+  //! Set the largest projection error in degree of a tracked pose.
+  void setMaxProjectionError(double error) { m_maxProjectionError = error; }
+  //! Track in the background and return the pose of the previous frame.
+  void setPipelined(bool pipelined) { m_pipelined = pipelined; }
+
+  bool track(const vpImage<unsigned char> &I, const vpImage<uint16_t> &depth_raw, vpHomogeneousMatrix &cMo);
+  bool track(const vpFrameHandle &frame, vpHomogeneousMatrix &cMo);
+
+protected:
+  bool fuse(const std::vector<vpHomogeneousMatrix> &poses, const std::vector<vpMatrix> &covariances,
+            const std::vector<bool> &tracked, vpHomogeneousMatrix &cMo) const;
+  bool startTracking(const vpImage<unsigned char> &I, vpHomogeneousMatrix &cMo);
+  void updatePointCloud();
+  bool trackFrame();
+  void wait();
+
+  vpMbGenericTracker m_edge;
+  vpMbGenericTracker m_klt;
+  vpMbGenericTracker m_depth;
+  vpCameraParameters m_cam;
+  double m_depthScale;
+  bool m_display;
+  bool m_pipelined;
+  double m_maxProjectionError;
+
+  // Images copied by track() when they are not in a frame of a vpFramePool
+  vpImage<unsigned char> m_I;
+  vpImage<uint16_t> m_depthRaw;
+  vpFrameHandle m_frame;                   //!< Frame being tracked, kept without copy
+  const vpImage<unsigned char> *m_trackedI; //!< Gray image being tracked, of m_frame or m_I
+  const vpImage<uint16_t> *m_trackedDepth;  //!< Depth image being tracked, of m_frame or m_depthRaw
+  std::vector<vpColVector> m_pointCloud;
+  std::vector<double> m_xy; //!< Normalized coordinates of the pixels
+
+  std::future<bool> m_job;
+  bool m_tracked;           //!< Result of the last tracking
+  vpHomogeneousMatrix m_cMo; //!< Pose of the last tracking
+  double m_projectionError;
+  double m_trackingTime;
+};
+#endif
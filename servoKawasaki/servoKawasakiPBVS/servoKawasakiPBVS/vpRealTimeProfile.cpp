@@ -0,0 +1,393 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Real-time scheduling profile of the servo process.
+ *
+ *****************************************************************************/
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#include <visp3/core/vpConfig.h>
+
+/*!
+  \file vpRealTimeProfile.cpp
+  Real-time scheduling profile of the servo process.
+*/
+
+#include <vpRealTimeProfile.h>
+
+namespace
+{
+const size_t page_size = 4096;
+
+// Parse a list of cores "0,2-3" like in /sys/devices/system/cpu
+bool parseCpus(const std::string &text, std::vector<int> &cpus)
+{
+  cpus.clear();
+  std::stringstream ss(text);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    item.erase(std::remove_if(item.begin(), item.end(), ::isspace), item.end());
+    if (item.empty()) {
+      continue;
+    }
+    int first = 0, last = 0;
+    char sep = 0;
+    std::stringstream range(item);
+    range >> first;
+    if (range.fail()) {
+      return false;
+    }
+    last = first;
+    if (range >> sep) {
+      if (sep != '-' || !(range >> last) || last < first) {
+        return false;
+      }
+    }
+    for (int cpu = first; cpu <= last; cpu++) {
+      cpus.push_back(cpu);
+    }
+  }
+  return true;
+}
+
+std::string cpusToString(const std::vector<int> &cpus)
+{
+  if (cpus.empty()) {
+    return "all";
+  }
+  std::stringstream ss;
+  for (size_t i = 0; i < cpus.size(); i++) {
+    ss << (i > 0 ? "," : "") << cpus[i];
+  }
+  return ss.str();
+}
+
+// Touch each page of the stack frames down to size bytes below the caller
+#if defined(_MSC_VER)
+__declspec(noinline)
+#elif defined(__GNUC__)
+__attribute__((noinline))
+#endif
+void touchStack(size_t size)
+{
+  volatile unsigned char buffer[16 * page_size];
+  for (size_t i = 0; i < sizeof(buffer); i += page_size) {
+    buffer[i] = 0;
+  }
+  if (size > sizeof(buffer)) {
+    touchStack(size - sizeof(buffer));
+  }
+  // Prevents the tail call that would reuse this frame
+  buffer[0] = buffer[0];
+}
+
+#if defined(__linux__)
+bool readFirstLine(const std::string &filename, std::string &line)
+{
+  std::ifstream file(filename.c_str());
+  return file.is_open() && static_cast<bool>(std::getline(file, line));
+}
+
+bool setAffinity(pthread_t thread, const std::vector<int> &cpus)
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (size_t i = 0; i < cpus.size(); i++) {
+    CPU_SET(cpus[i], &set);
+  }
+  return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+#elif defined(_WIN32)
+DWORD_PTR cpuMask(const std::vector<int> &cpus)
+{
+  DWORD_PTR mask = 0;
+  for (size_t i = 0; i < cpus.size(); i++) {
+    mask |= static_cast<DWORD_PTR>(1) << cpus[i];
+  }
+  return mask;
+}
+
+// Windows thread priority of a SCHED_FIFO priority
+int threadPriority(int priority)
+{
+  if (priority >= 90) {
+    return THREAD_PRIORITY_TIME_CRITICAL;
+  } else if (priority >= 50) {
+    return THREAD_PRIORITY_HIGHEST;
+  }
+  return THREAD_PRIORITY_ABOVE_NORMAL;
+}
+#endif
+} // namespace
+
+vpRealTimeProfile::vpRealTimeProfile()
+  : m_controlPriority(0), m_controlCpus(), m_otherCpus(), m_lockMemory(false), m_stackPrefault(512 * 1024),
+    m_period(33.)
+{
+}
+
+/*!
+  Apply the priority and the cores of the control thread to the calling thread, and pre-fault its stack.
+
+  \return false if the scheduling can not be changed, see preflight().
+ */
+bool vpRealTimeProfile::applyControlThread() const
+{
+  prefaultStack(m_stackPrefault);
+  bool ok = true;
+#if defined(__linux__)
+  if (m_controlPriority > 0) {
+    sched_param param;
+    param.sched_priority = m_controlPriority;
+    ok = (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0) && ok;
+  }
+  if (!m_controlCpus.empty()) {
+    ok = setAffinity(pthread_self(), m_controlCpus) && ok;
+  }
+#elif defined(_WIN32)
+  if (m_controlPriority > 0) {
+    ok = (SetPriorityClass(GetCurrentProcess(), HIGH_PRIORITY_CLASS) != 0) && ok;
+    ok = (SetThreadPriority(GetCurrentThread(), threadPriority(m_controlPriority)) != 0) && ok;
+  }
+  if (!m_controlCpus.empty()) {
+    ok = (SetThreadAffinityMask(GetCurrentThread(), cpuMask(m_controlCpus)) != 0) && ok;
+  }
+#endif
+  return ok;
+}
+
+/*!
+  Apply the cores of the other threads to the calling thread, inherited by the threads it creates next, and
+  lock the memory. To call at the beginning of the main thread.
+
+  On Windows the affinity of a thread is a subset of the one of the process, so the process keeps the control
+  and the other cores: only the main thread is restricted to the other cores, and the working set is enlarged
+  instead of locking all the memory.
+
+  \return false if the scheduling can not be changed, see preflight().
+ */
+bool vpRealTimeProfile::applyProcess() const
+{
+  bool ok = true;
+#if defined(__linux__)
+  if (!m_otherCpus.empty()) {
+    ok = setAffinity(pthread_self(), m_otherCpus) && ok;
+  }
+  if (m_lockMemory) {
+    ok = (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) && ok;
+  }
+#elif defined(_WIN32)
+  if (!m_otherCpus.empty()) {
+    std::vector<int> cpus = m_otherCpus;
+    cpus.insert(cpus.end(), m_controlCpus.begin(), m_controlCpus.end());
+    if (!m_controlCpus.empty()) {
+      ok = (SetProcessAffinityMask(GetCurrentProcess(), cpuMask(cpus)) != 0) && ok;
+    }
+    ok = (SetThreadAffinityMask(GetCurrentThread(), cpuMask(m_otherCpus)) != 0) && ok;
+  }
+  if (m_lockMemory) {
+    const SIZE_T min_working_set = 256 * 1024 * 1024, max_working_set = 1024 * 1024 * 1024;
+    ok = (SetProcessWorkingSetSize(GetCurrentProcess(), min_working_set, max_working_set) != 0) && ok;
+  }
+#endif
+  return ok;
+}
+
+/*!
+  Read the profile file, see the class description for its content.
+
+  \return false if the file can not be read or contains an invalid line.
+ */
+bool vpRealTimeProfile::load(const std::string &filename)
+{
+  std::ifstream file(filename.c_str());
+  if (!file.is_open()) {
+    return false;
+  }
+  std::string line;
+  while (std::getline(file, line)) {
+    line = line.substr(0, line.find('#'));
+    size_t sep = line.find(':');
+    if (sep == std::string::npos) {
+      if (line.find_first_not_of(" \t\r") != std::string::npos) {
+        return false;
+      }
+      continue;
+    }
+    std::string key = line.substr(0, sep);
+    key.erase(std::remove_if(key.begin(), key.end(), ::isspace), key.end());
+    std::string value = line.substr(sep + 1);
+    std::stringstream ss(value);
+    if (key == "control_priority") {
+      ss >> m_controlPriority;
+    } else if (key == "control_cpus") {
+      if (!parseCpus(value, m_controlCpus)) {
+        return false;
+      }
+    } else if (key == "other_cpus") {
+      if (!parseCpus(value, m_otherCpus)) {
+        return false;
+      }
+    } else if (key == "lock_memory") {
+      ss >> m_lockMemory;
+    } else if (key == "stack_prefault") {
+      ss >> m_stackPrefault;
+    } else if (key == "period") {
+      ss >> m_period;
+    } else {
+      return false;
+    }
+    if (ss.fail() && key != "control_cpus" && key != "other_cpus") {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*!
+  Touch \e size bytes of the stack of the calling thread, so that the pages are mapped, and locked with
+  lock_memory, before the control loop.
+ */
+void vpRealTimeProfile::prefaultStack(size_t size)
+{
+  if (size > 0) {
+    touchStack(size);
+  }
+}
+
+/*!
+  Check that the profile can be applied on this platform, print the profile, the errors and the warnings.
+
+  \return false if the profile can not be applied.
+ */
+bool vpRealTimeProfile::preflight(std::ostream &os) const
+{
+  bool ok = true;
+  os << "Real-time profile: control thread priority " << m_controlPriority << " on cores "
+     << cpusToString(m_controlCpus) << ", other threads on cores " << cpusToString(m_otherCpus)
+     << (m_lockMemory ? ", memory locked" : "") << ", period " << m_period << " ms" << std::endl;
+
+  const int nb_cpus = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+  std::vector<int> cpus = m_controlCpus;
+  cpus.insert(cpus.end(), m_otherCpus.begin(), m_otherCpus.end());
+  for (size_t i = 0; i < cpus.size(); i++) {
+    if (cpus[i] < 0 || cpus[i] >= nb_cpus) {
+      os << "Error: core " << cpus[i] << " doesn't exist, " << nb_cpus << " cores" << std::endl;
+      ok = false;
+    }
+  }
+  for (size_t i = 0; i < m_controlCpus.size(); i++) {
+    if (std::find(m_otherCpus.begin(), m_otherCpus.end(), m_controlCpus[i]) != m_otherCpus.end()) {
+      os << "Warning: core " << m_controlCpus[i] << " is shared by the control thread and the other threads"
+         << std::endl;
+    }
+  }
+
+#if defined(__linux__)
+  if (m_controlPriority < 0 || m_controlPriority > 99) {
+    os << "Error: SCHED_FIFO priority " << m_controlPriority << " is not in [1, 99]" << std::endl;
+    ok = false;
+  }
+  if (geteuid() != 0) {
+    rlimit limit;
+    if (m_controlPriority > 0 && getrlimit(RLIMIT_RTPRIO, &limit) == 0 &&
+        limit.rlim_cur < static_cast<rlim_t>(m_controlPriority)) {
+      os << "Error: RLIMIT_RTPRIO is " << limit.rlim_cur << ", raise rtprio in /etc/security/limits.conf"
+         << std::endl;
+      ok = false;
+    }
+    if (m_lockMemory && getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+      os << "Error: RLIMIT_MEMLOCK is " << limit.rlim_cur << " bytes, set memlock to unlimited in "
+         << "/etc/security/limits.conf" << std::endl;
+      ok = false;
+    }
+  }
+
+  std::string line;
+  if (!readFirstLine("/sys/kernel/realtime", line) || line != "1") {
+    os << "Warning: the kernel is not PREEMPT_RT, expect larger latencies" << std::endl;
+  }
+  if (readFirstLine("/proc/sys/kernel/sched_rt_runtime_us", line) && line != "-1") {
+    os << "Warning: real-time threads are throttled, sched_rt_runtime_us is " << line << std::endl;
+  }
+  std::vector<int> isolated;
+  if (!readFirstLine("/sys/devices/system/cpu/isolated", line) || !parseCpus(line, isolated)) {
+    isolated.clear();
+  }
+  for (size_t i = 0; i < m_controlCpus.size(); i++) {
+    const int cpu = m_controlCpus[i];
+    if (std::find(isolated.begin(), isolated.end(), cpu) == isolated.end()) {
+      os << "Warning: core " << cpu << " is not isolated, add it to isolcpus and nohz_full" << std::endl;
+    }
+    std::stringstream governor_file;
+    governor_file << "/sys/devices/system/cpu/cpu" << cpu << "/cpufreq/scaling_governor";
+    if (readFirstLine(governor_file.str(), line) && line != "performance") {
+      os << "Warning: core " << cpu << " frequency governor is " << line << ", use performance" << std::endl;
+    }
+  }
+#elif defined(_WIN32)
+  DWORD_PTR process_mask = 0, system_mask = 0;
+  if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask)) {
+    for (size_t i = 0; i < cpus.size(); i++) {
+      if (cpus[i] >= 0 && cpus[i] < static_cast<int>(8 * sizeof(DWORD_PTR)) &&
+          !(system_mask & (static_cast<DWORD_PTR>(1) << cpus[i]))) {
+        os << "Error: core " << cpus[i] << " is not available to the process" << std::endl;
+        ok = false;
+      }
+    }
+  }
+  if (m_controlPriority > 0) {
+    os << "Windows: high priority class, control thread priority " << threadPriority(m_controlPriority)
+       << ". Other threads can run on the control cores" << std::endl;
+  }
+#else
+  os << "Warning: real-time scheduling is not supported on this platform" << std::endl;
+#endif
+  return ok;
+}
@@ -36,6 +36,8 @@
  *
  *****************************************************************************/
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 
 #include <visp3/core/vpConfig.h>
@@ -47,10 +49,116 @@
 */
 
 #include <visp3/core/vpHomogeneousMatrix.h>
+#include <vpMotionMailbox.h>
 #include <vpRobotKawasaki.h>
+#include <vpTrace.h>
+// The vendor header of the IPMC motion card uses WINAPI without including windows.h
+#include <windows.h>
 #include <IPMCMOTION.h>
 
 using namespace std;
+
+static_assert(vpKawasakiArm::dof == ROBOT_DOF, "The arm description doesn't match the robot");
+
+namespace
+{
+/*!
+  Saturate the velocity \e v in \e v_sat like vpRobot::saturateVelocities(), without allocation: all the
+  components are scaled by the same factor so that none of them exceeds its maximal value in \e v_max.
+ */
+void saturateVelocity(const vpColVector &v, const double *v_max, double *v_sat, bool verbose)
+{
+  double scale = 1;
+  int imax = -1;
+  for (unsigned int i = 0; i < v.size(); i++) {
+    double v_i = std::fabs(v[i]);
+    double v_max_i = std::fabs(v_max[i]);
+    if (v_i > v_max_i) {
+      double alpha_i = v_max_i / v_i;
+      if (alpha_i < scale) {
+        scale = alpha_i;
+        imax = static_cast<int>(i);
+      }
+    }
+  }
+  for (unsigned int i = 0; i < v.size(); i++) {
+    v_sat[i] = v[i] * scale;
+  }
+  if (imax >= 0 && verbose) {
+    std::cout << "Excess velocity " << v[static_cast<unsigned int>(imax)] << " axis nr. " << imax << std::endl;
+  }
+}
+
+/*!
+  Cancel in the inverse Jacobian \e J the terms that diverge near the singularities of the wrist (s5 = 0), of
+  the elbow (c3 = 0) and of the shoulder. Return true if the joint positions \e q are near a singularity.
+ */
+template <typename Matrix> bool removeSingularDirections(const vpColVector &q, Matrix &J, double a2, double d4)
+{
+	double q2 = q[1];
+	double q3 = q[2];
+	double q5 = q[4];
+	
+	double c2 = cos(q2);
+	double c3 = cos(q3);
+	double s23 = sin(q2 + q3);
+	double s5 = sin(q5);
+	
+	bool cond1 = fabs(s5) < 1e-1;
+	bool cond2 = fabs(c3) < 1e-1;
+	bool cond3 = fabs(c2 * a2 + s23 * d4) < 1e-1;
+
+	if (cond1) 
+	{
+		J[3][0] = 0;
+		J[5][0] = 0;
+		J[3][1] = 0;
+		J[5][1] = 0;
+		J[3][2] = 0;
+		J[5][2] = 0;
+		J[3][3] = 0;
+		J[5][3] = 0;
+		J[3][4] = 0;
+		J[5][4] = 0;
+		J[3][5] = 0;
+		J[5][5] = 0;
+		return true;	
+	}
+	if (cond2)
+	{
+		J[1][0] = 0;
+		J[2][0] = 0;
+		J[3][0] = 0;
+		J[4][0] = 0;
+		J[5][0] = 0;
+		J[1][1] = 0;
+		J[2][1] = 0;
+		J[3][1] = 0;
+		J[4][1] = 0;
+		J[5][1] = 0;
+		J[1][2] = 0;
+		J[2][2] = 0;
+		J[3][2] = 0;
+		J[4][2] = 0;
+		J[5][2] = 0;
+		return true;
+	}
+	if (cond3) 
+	{
+		J[0][0] = 0;
+		J[3][0] = 0;
+		J[4][0] = 0;
+		J[5][0] = 0;
+		J[0][1] = 0;
+		J[3][1] = 0;
+		J[4][1] = 0;
+		J[5][1] = 0;
+		return true;
+	}
+	return false;
+}
+} // namespace
+
 /*!
   Basic initialization.
  */
@@ -69,24 +177,96 @@ void vpRobotKawasaki::init()
 /*!
   Default constructor.
  */
-vpRobotKawasaki::vpRobotKawasaki() { vpRobotKawasaki::init(); }
+vpRobotKawasaki::vpRobotKawasaki()
+  : m_motionServer(), m_motionTimeout(200.), m_mailbox(), m_motionQ(), m_motionState(vpRobot::STATE_STOP),
+    m_heartbeat(0), m_heartbeatTime(0)
+{
+  vpRobotKawasaki::init();
+}
 
 /*!
   Destructor.
  */
 vpRobotKawasaki::~vpRobotKawasaki()
 {
+  if (m_mailbox) {
+    // Don't wait for the motion process, it stops the robot by itself
+    m_mailbox->requestRobotState(vpRobot::STATE_STOP);
+    return;
+  }
   vpRobotKawasaki::setRobotState(vpRobot::STATE_STOP);
   IPMCCloseDevice();
 }
 
-void vpRobotKawasaki::set_eMc(vpHomogeneousMatrix &eMc) { m_eMc = eMc; }
+/*!
+  Control the drives through the motion process that created the mailbox \e name, instead of the IPMC motion
+  controller. To call before connect().
 
-vpHomogeneousMatrix vpRobotKawasaki::get_eMc() { return m_eMc; }
+  \param name : Name of the mailbox, see motionKawasaki.cpp.
+  \param timeout : Largest time in ms without heartbeat of the motion process.
+ */
+void vpRobotKawasaki::setMotionServer(const std::string &name, double timeout)
+{
+  m_motionServer = name;
+  m_motionTimeout = timeout;
+}
+
+/*!
+  Set the transformation between end-effector and camera frame. It can be called from another thread while
+  the robot is controlled, the next velocity is converted with the new transformation.
+ */
+void vpRobotKawasaki::set_eMc(const vpHomogeneousMatrix &eMc)
+{
+  std::lock_guard<std::mutex> lock(m_eMcMutex);
+  m_eMc = eMc;
+}
+
+vpHomogeneousMatrix vpRobotKawasaki::get_eMc() const
+{
+  std::lock_guard<std::mutex> lock(m_eMcMutex);
+  return m_eMc;
+}
+
+/*!
+  Return the velocity twist matrix that transforms a velocity twist from tool (or camera) frame into
+  end-effector frame, built from m_eMc in \e arena as vpVelocityTwistMatrix(get_eMc()).
+ */
+vpArenaMatrix vpRobotKawasaki::get_eVc(vpTickArena &arena) const
+{
+  vpArenaMatrix eVc = arena.matrix(6, 6);
+  std::lock_guard<std::mutex> lock(m_eMcMutex);
+  const double t[3] = {m_eMc[0][3], m_eMc[1][3], m_eMc[2][3]};
+  // eVc = [eRc [t]x*eRc; 0 eRc]
+  for (unsigned int j = 0; j < 3; j++) {
+    for (unsigned int i = 0; i < 3; i++) {
+      eVc[i][j] = eVc[i + 3][j + 3] = m_eMc[i][j];
+    }
+    eVc[0][j + 3] = t[1] * m_eMc[2][j] - t[2] * m_eMc[1][j];
+    eVc[1][j + 3] = t[2] * m_eMc[0][j] - t[0] * m_eMc[2][j];
+    eVc[2][j + 3] = t[0] * m_eMc[1][j] - t[1] * m_eMc[0][j];
+  }
+  return eVc;
+}
 
 //ӻ˿
 int vpRobotKawasaki::connect()
 {
+  if (isRemote()) {
+    // The motion process enables the drives before creating its mailbox
+    m_mailbox.reset(new vpMotionMailbox);
+    double time_initial = vpTime::measureTimeSecond();
+    while (!m_mailbox->open(m_motionServer)) {
+      if (vpTime::measureTimeSecond() - time_initial > 30) {
+        m_mailbox.reset();
+        return EXIT_FAILURE;
+      }
+      vpTime::sleepMs(10);
+    }
+    m_heartbeatTime = vpTime::measureTimeMs();
+    readMotionState();
+    return EXIT_SUCCESS;
+  }
+
   IPMCOpenDevice();
   bool enable = false;
   double time_initial = vpTime::measureTimeSecond();
@@ -101,11 +281,15 @@ int vpRobotKawasaki::connect()
     }
 	
 	double time_connect= vpTime::measureTimeSecond();
-	if ((time_connect - time_initial) > 30)
+	if (!enable && (time_connect - time_initial) > 30)
 	{
 		IPMCCloseDevice();
 		return EXIT_FAILURE;
 	}
+	if (!enable) {
+	  // Poll the drives without burning a core, their enabling takes seconds
+	  vpTime::sleepMs(10);
+	}
   }
   return EXIT_SUCCESS;
 }
@@ -127,185 +311,72 @@ int vpRobotKawasaki::connect()
 */
 void vpRobotKawasaki::get_eJe(vpMatrix &eJe)
 {
-  eJe.resize(6, ROBOT_DOF);
-  vpColVector q(ROBOT_DOF);
-  vpRobotKawasaki::getJointPosition(q);
-
-  //任
-  vpMatrix T01(4, 4), T12(4, 4), T23(4, 4), T34(4, 4), T45(4, 4), T56(4, 4);
-  T01[0][0] = cos(q[0]);
-  T01[0][1] = -sin(q[0]);
-  T01[1][0] = sin(q[0]);
-  T01[1][1] = cos(q[0]);
-  T01[2][2] = 1;
-  T01[2][3] = d1;
-  T01[3][3] = 1;
-  T12[0][0] = cos(q[1]);
-  T12[0][1] = -sin(q[1]);
-  T12[1][2] = -1;
-  T12[2][0] = sin(q[1]);
-  T12[2][1] = cos(q[1]);
-  T12[3][3] = 1;
-  T23[0][0] = cos(q[2]);
-  T23[0][1] = -sin(q[2]);
-  T23[0][3] = a2;
-  T23[1][0] = sin(q[2]);
-  T23[1][1] = cos(q[2]);
-  T23[2][2] = 1;
-  T23[3][3] = 1;
-  T34[0][0] = cos(q[3]);
-  T34[0][1] = -sin(q[3]);
-  T34[1][2] = -1;
-  T34[1][3] = -d4;
-  T34[2][0] = sin(q[3]);
-  T34[2][1] = cos(q[3]);
-  T34[3][3] = 1;
-  T45[0][0] = cos(q[4]);
-  T45[0][1] = -sin(q[4]);
-  T45[1][2] = 1;
-  T45[2][0] = -sin(q[4]);
-  T45[2][1] = -cos(q[4]);
-  T45[3][3] = 1;
-  T56[0][0] = cos(q[5]);
-  T56[0][1] = -sin(q[5]);
-  T56[1][2] = -1;
-  T56[1][3] = -d6;
-  T56[2][0] = sin(q[5]);
-  T56[2][1] = cos(q[5]);
-  T56[3][3] = 1;
-
-  //ʸſ˱Ⱦ
-  vpMatrix R01(T01, 0, 0, 3, 3), R12(T12, 0, 0, 3, 3), R23(T23, 0, 0, 3, 3), R34(T34, 0, 0, 3, 3), R45(T45, 0, 0, 3, 3), R56(T56, 0, 0, 3, 3);
-  vpMatrix T46 = T45 * T56, T36 = T34 * T46, T26 = T23 * T36, T16 = T12 * T26;
-  vpMatrix R02 = R01 * R12, R03 = R02 * R23, R04  =R03 * R34, R05 = R04 * R45, R06 = R05 * R56;
-  
-  
-  vpColVector z(3), z1(3), z2(3), z3(3), z4(3), z5(3), z6(3);
-  z[2] = 1;
-  z1 = R01 * z;
-  z2 = R02 * z;
-  z3 = R03 * z;
-  z4 = R04 * z;
-  z5 = R05 * z;
-  z6 = R06 * z;
-
-  vpColVector t(4), t16(4), t26(4), t36(4), t46(4), t56(4), t66(4);
-  t[3] = 1;
-  t16 = T16 * t;
-  t26 = T26 * t;
-  t36 = T36 * t;
-  t46 = T46 * t;
-  t56 = T56 * t;
-  t66 = t;
-
-  vpMatrix p16(t16, 0, 0, 3, 1), p26(t26, 0, 0, 3, 1), p36(t36, 0, 0, 3, 1), p46(t46, 0, 0, 3, 1), p56(t56, 0, 0, 3, 1), p66(t66, 0, 0, 3, 1);
-  vpColVector p16_0(3), p26_0(3), p36_0(3), p46_0(3), p56_0(3), p66_0(3);
-  p16_0 = R01 * p16;
-  p26_0 = R02 * p26;
-  p36_0 = R03 * p36;
-  p46_0 = R04 * p46;
-  p56_0 = R05 * p56;
-  p66_0 = R06 * p66;
-
-  vpColVector JL1(3), JL2(3), JL3(3), JL4(3), JL5(3), JL6(3);
-  //JL1[0] = z1[1] * p16_0[2] - p16_0[1] * z1[2];
-  //JL1[1] = z1[2] * p16_0[0] - p16_0[2] * z1[0];
-  //JL1[2] = z1[0] * p16_0[1] - p16_0[0] * z1[1];
-  //JL2[0] = z2[1] * p26_0[2] - p26_0[1] * z2[2];
-  //JL2[1] = z2[2] * p26_0[0] - p26_0[2] * z2[0];
-  //JL2[2] = z2[0] * p26_0[1] - p26_0[0] * z2[1];
-  //JL3[0] = z3[1] * p36_0[2] - p36_0[1] * z3[2];
-  //JL3[1] = z3[2] * p36_0[0] - p36_0[2] * z3[0];
-  //JL3[2] = z3[0] * p36_0[1] - p36_0[0] * z3[1];
-  //JL4[0] = z4[1] * p46_0[2] - p46_0[1] * z4[2];
-  //JL4[1] = z4[2] * p46_0[0] - p46_0[2] * z4[0];
-  //JL4[2] = z4[0] * p46_0[1] - p46_0[0] * z4[1];
-  //JL5[0] = z5[1] * p56_0[2] - p56_0[1] * z5[2];
-  //JL5[1] = z5[2] * p56_0[0] - p56_0[2] * z5[0];
-  //JL5[2] = z5[0] * p56_0[1] - p56_0[0] * z5[1];
-  //JL6[0] = z6[1] * p66_0[2] - p66_0[1] * z6[2];
-  //JL6[1] = z6[2] * p66_0[0] - p66_0[2] * z6[0];
-  //JL6[2] = z6[0] * p66_0[1] - p66_0[0] * z6[1];
-
-  JL1 = vpColVector::cross(z1, p16_0);
-  JL2 = vpColVector::cross(z2, p26_0);
-  JL3 = vpColVector::cross(z3, p36_0);
-  JL4 = vpColVector::cross(z4, p46_0);
-  JL5 = vpColVector::cross(z5, p56_0);
-  JL6 = vpColVector::cross(z6, p66_0);
-
-  vpMatrix fJe(6, ROBOT_DOF);
-
-  for (int i = 0; i < 3; i++) {
-    fJe[i][0] = JL1[i];
-    fJe[i][1] = JL2[i];
-    fJe[i][2] = JL3[i];
-    fJe[i][3] = JL4[i];
-    fJe[i][4] = JL5[i];
-    fJe[i][5] = JL6[i];
-    fJe[i + 3][0] = z1[i];
-    fJe[i + 3][1] = z2[i];
-    fJe[i + 3][2] = z3[i];
-    fJe[i + 3][3] = z4[i];
-    fJe[i + 3][4] = z5[i];
-    fJe[i + 3][5] = z6[i];
-  }
+  m_q.resize(ROBOT_DOF, false);
+  vpRobotKawasaki::getJointPosition(m_q);
+  get_eJe(m_q, eJe);
+}
 
-  vpMatrix R06_t = R06.t();
+/*!
+  Get the robot Jacobian expressed in the end-effector frame for given joint positions.
+  It doesn't need the robot to be connected.
 
-  for (int i = 0; i < 3; i++)
-  {
-	  for (int j = 0; j < 3; j++)
-	  {
-		  eJe[i][j] = R06_t[i][j];
-		  eJe[i+3][j+3]= R06_t[i][j];
-	  }
-  }
+  \param[in] q : Joint positions in rad.
+  \param[out] eJe : End-effector frame Jacobian.
+*/
+void vpRobotKawasaki::get_eJe(const vpColVector &q, vpMatrix &eJe) const
+{
+  VP_TRACE_SCOPE("get_eJe");
+  vpTickArena &arena = vpTickArena::getThreadArena();
+  vpTickArena::vpScope scope(arena);
+  vpTickArena::copy(get_eJe(arena, q), eJe);
+}
 
-  eJe = eJe * fJe;
-
-  //eJe[0][0] = d6 * (sin(q[4])*(cos(q[0])*sin(q[3]) + cos(q[3])*(sin(q[0])*sin(q[1])*sin(q[2]) - cos(q[1])*cos(q[2])*sin(q[0]))) - cos(q[4])*(cos(q[1])*sin(q[0])*sin(q[2]) + cos(q[2])*sin(q[0])*sin(q[1]))) - d4 * (cos(q[1])*sin(q[0])*sin(q[2]) + cos(q[2])*sin(q[0])*sin(q[1])) - a2 * cos(q[1])*sin(q[0]);
-  //eJe[0][1] = -d4 * (cos(q[0])*sin(q[1])*sin(q[2]) - cos(q[0])*cos(q[1])*cos(q[2])) - d6 * (cos(q[4])*(cos(q[0])*sin(q[1])*sin(q[2]) - cos(q[0])*cos(q[1])*cos(q[2])) + cos(q[3])*sin(q[4])*(cos(q[0])*cos(q[1])*sin(q[2]) + cos(q[0])*cos(q[2])*sin(q[1]))) - a2 * cos(q[0])*sin(q[1]);
-  //eJe[0][2] = -d4 * (cos(q[0])*sin(q[1])*sin(q[2]) - cos(q[0])*cos(q[1])*cos(q[2])) - d6 * (cos(q[4])*(cos(q[0])*sin(q[1])*sin(q[2]) - cos(q[0])*cos(q[1])*cos(q[2])) + cos(q[3])*sin(q[4])*(cos(q[0])*cos(q[1])*sin(q[2]) + cos(q[0])*cos(q[2])*sin(q[1])));
-  //eJe[0][3] = d6 * sin(q[4])*(cos(q[3])*sin(q[0]) + sin(q[3])*(cos(q[0])*sin(q[1])*sin(q[2]) - cos(q[0])*cos(q[1])*cos(q[2])));
-  //eJe[0][4] = d6 * (cos(q[4])*(sin(q[0])*sin(q[3]) - cos(q[3])*(cos(q[0])*sin(q[1])*sin(q[2]) - cos(q[0])*cos(q[1])*cos(q[2]))) - sin(q[4])*(cos(q[0])*cos(q[1])*sin(q[2]) + cos(q[0])*cos(q[2])*sin(q[1])));
-  //eJe[0][5] = 0;
-  //eJe[1][0] = d6 * (sin(q[4])*(sin(q[0])*sin(q[3]) - cos(q[3])*(cos(q[0])*sin(q[1])*sin(q[2]) - cos(q[0])*cos(q[1])*cos(q[2]))) + cos(q[4])*(cos(q[0])*cos(q[1])*sin(q[2]) + cos(q[0])*cos(q[2])*sin(q[1]))) + d4 * (cos(q[0])*cos(q[1])*sin(q[2]) + cos(q[0])*cos(q[2])*sin(q[1])) + a2 * cos(q[0])*cos(q[1]);
-  //eJe[1][1] = -d4 * (sin(q[0])*sin(q[1])*sin(q[2]) - cos(q[1])*cos(q[2])*sin(q[0])) - d6 * (cos(q[4])*(sin(q[0])*sin(q[1])*sin(q[2]) - cos(q[1])*cos(q[2])*sin(q[0])) + cos(q[3])*sin(q[4])*(cos(q[1])*sin(q[0])*sin(q[2]) + cos(q[2])*sin(q[0])*sin(q[1]))) - a2 * sin(q[0])*sin(q[1]);
-  //eJe[1][2] = -d4 * (sin(q[0])*sin(q[1])*sin(q[2]) - cos(q[1])*cos(q[2])*sin(q[0])) - d6 * (cos(q[4])*(sin(q[0])*sin(q[1])*sin(q[2]) - cos(q[1])*cos(q[2])*sin(q[0])) + cos(q[3])*sin(q[4])*(cos(q[1])*sin(q[0])*sin(q[2]) + cos(q[2])*sin(q[0])*sin(q[1])));
-  //eJe[1][3] = -d6 * sin(q[4])*(cos(q[0])*cos(q[3]) - sin(q[3])*(sin(q[0])*sin(q[1])*sin(q[2]) - cos(q[1])*cos(q[2])*sin(q[0])));
-  //eJe[1][4] = -d6 * (cos(q[4])*(cos(q[0])*sin(q[3]) + cos(q[3])*(sin(q[0])*sin(q[1])*sin(q[2]) - cos(q[1])*cos(q[2])*sin(q[0]))) + sin(q[4])*(cos(q[1])*sin(q[0])*sin(q[2]) + cos(q[2])*sin(q[0])*sin(q[1])));
-  //eJe[1][5] = 0;
-  //eJe[2][0] = 0;
-  //eJe[2][1] = d4 * (cos(q[1])*sin(q[2]) + cos(q[2])*sin(q[1])) + a2 * cos(q[1]) + d6 * (cos(q[4])*(cos(q[1])*sin(q[2]) + cos(q[2])*sin(q[1])) + cos(q[3])*sin(q[4])*(cos(q[1])*cos(q[2]) - sin(q[1])*sin(q[2])));
-  //eJe[2][2] = d4 * (cos(q[1])*sin(q[2]) + cos(q[2])*sin(q[1])) + d6 * (cos(q[4])*(cos(q[1])*sin(q[2]) + cos(q[2])*sin(q[1])) + cos(q[3])*sin(q[4])*(cos(q[1])*cos(q[2]) - sin(q[1])*sin(q[2])));
-  //eJe[2][3] = -d6 * sin(q[3])*sin(q[4])*(cos(q[1])*sin(q[2]) + cos(q[2])*sin(q[1]));
-  //eJe[2][4] = d6 * (sin(q[4])*(cos(q[1])*cos(q[2]) - sin(q[1])*sin(q[2])) + cos(q[3])*cos(q[4])*(cos(q[1])*sin(q[2]) + cos(q[2])*sin(q[1])));
-  //eJe[2][5] = 0;
-  //eJe[3][0] = 0;
-  //eJe[3][1] = sin(q[0]);
-  //eJe[3][2] = sin(q[0]);
-  //eJe[3][3] = cos(q[0])*cos(q[1])*sin(q[2]) + cos(q[0])*cos(q[2])*sin(q[1]);
-  //eJe[3][4] = cos(q[3])*sin(q[0]) + sin(q[3])*(cos(q[0])*sin(q[1])*sin(q[2]) - cos(q[0])*cos(q[1])*cos(q[2]));
-  //eJe[3][5] = sin(q[4])*(sin(q[0])*sin(q[3]) - cos(q[3])*(cos(q[0])*sin(q[1])*sin(q[2]) - cos(q[0])*cos(q[1])*cos(q[2]))) + cos(q[4])*(cos(q[0])*cos(q[1])*sin(q[2]) + cos(q[0])*cos(q[2])*sin(q[1]));
-  //eJe[4][0] = 0;
-  //eJe[4][1] = -cos(q[0]);
-  //eJe[4][2] = -cos(q[0]);
-  //eJe[4][3] = cos(q[1])*sin(q[0])*sin(q[2]) + cos(q[2])*sin(q[0])*sin(q[1]);
-  //eJe[4][4] = sin(q[3])*(sin(q[0])*sin(q[1])*sin(q[2]) - cos(q[1])*cos(q[2])*sin(q[0])) - cos(q[0])*cos(q[3]);
-  //eJe[4][5] = cos(q[4])*(cos(q[1])*sin(q[0])*sin(q[2]) + cos(q[2])*sin(q[0])*sin(q[1])) - sin(q[4])*(cos(q[0])*sin(q[3]) + cos(q[3])*(sin(q[0])*sin(q[1])*sin(q[2]) - cos(q[1])*cos(q[2])*sin(q[0])));
-  //eJe[5][0] = 1;
-  //eJe[5][1] = 0;
-  //eJe[5][2] = 0;
-  //eJe[5][3] = sin(q[1])*sin(q[2]) - cos(q[1])*cos(q[2]);
-  //eJe[5][4] = -sin(q[3])*(cos(q[1])*sin(q[2]) + cos(q[2])*sin(q[1]));
-  //eJe[5][5] = cos(q[3])*sin(q[4])*(cos(q[1])*sin(q[2]) + cos(q[2])*sin(q[1])) - cos(q[4])*(cos(q[1])*cos(q[2]) - sin(q[1])*sin(q[2]));
-
-  //vpMatrix kerAt;
-  //if (eJe.kernel(kerAt, 0.003)!=6)
-  //{
-	 // cout << "eJe is singular." << endl;
-  //}
+/*!
+  Return the robot Jacobian expressed in the end-effector frame for given joint positions, allocated in
+  \e arena.
+
+  \param[in] arena : Arena of the calling thread.
+  \param[in] q : Joint positions in rad.
+*/
+vpArenaMatrix vpRobotKawasaki::get_eJe(vpTickArena &arena, const vpColVector &q) const
+{
+  vpArenaMatrix eJe = arena.matrix(6, ROBOT_DOF);
+  vpArmKinematics::get_eJe(q.data, eJe.data);
+  return eJe;
+}
+
+/*!
+  Get the transformation between the robot reference frame and the end-effector frame for given joint
+  positions. It doesn't need the robot to be connected.
+
+  \param[in] q : Joint positions in rad.
+  \param[out] fMe : Forward kinematics.
+*/
+void vpRobotKawasaki::get_fMe(const vpColVector &q, vpHomogeneousMatrix &fMe) const
+{
+  vpArmKinematics::get_fMe(q.data, fMe.data);
+}
+
+/*!
+  Get the joint positions that reach a transformation between the robot reference frame and the end-effector
+  frame, the closest to the given joint positions. It doesn't need the robot to be connected.
+
+  \param[in] fMe : Transformation to reach.
+  \param[in,out] q : Initial joint positions in rad, replaced by the solution.
+  \return true if the transformation is reached, false if \e q is left unchanged.
+*/
+bool vpRobotKawasaki::getInverseKinematics(const vpHomogeneousMatrix &fMe, vpColVector &q) const
+{
+  if (q.size() != ROBOT_DOF) {
+    throw(vpException(vpException::dimensionError, "Cannot start the inverse kinematics from a %d-dim vector",
+                      q.size()));
+  }
+  double q_ik[ROBOT_DOF];
+  if (!vpArmKinematics::inverse(fMe.data, q.data, q_ik)) {
+    return false;
+  }
+  std::copy(q_ik, q_ik + ROBOT_DOF, q.data);
+  return true;
 }
 
 /*!
@@ -338,26 +409,29 @@ void vpRobotKawasaki::get_fJe(vpMatrix &fJe)
 */
 void vpRobotKawasaki::setCartVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &v)
 {
+  VP_TRACE_SCOPE("setCartVelocity");
   if (v.size() != 6) {
     throw(vpException(vpException::fatalError,
                       "Cannot send a velocity twist vector in tool frame that is not 6-dim (%d)", v.size()));
   }
 
-  vpColVector v_e; // This is the velocity that the robot is able to apply in the end-effector frame
+  vpTickArena &arena = vpTickArena::getThreadArena();
+  vpTickArena::vpScope scope(arena);
+  // This is the velocity that the robot is able to apply in the end-effector frame
+  vpArenaMatrix v_e = arena.vector(0);
   switch (frame) {
   case vpRobot::TOOL_FRAME: {
     // We have to transform the requested velocity in the end-effector frame.
     // Knowing that the constant transformation between the tool frame and the end-effector frame obtained
     // by extrinsic calibration is set in m_eMc we can compute the velocity twist matrix eVc that transform
     // a velocity twist from tool (or camera) frame into end-effector frame
-    vpVelocityTwistMatrix eVc(m_eMc);	
-	v_e = eVc * v;
+    v_e = arena.multiply(get_eVc(arena), arena.view(v));
     break;
   }
 
   case vpRobot::END_EFFECTOR_FRAME:
   case vpRobot::REFERENCE_FRAME: {
-    v_e = v;
+    v_e = arena.view(v);
     break;
   }
   case vpRobot::JOINT_STATE:
@@ -393,17 +467,25 @@ void vpRobotKawasaki::setCartVelocity(const vpRobot::vpControlFrameType frame, c
   // std::cout << "\t the frame transformation  between tool or camera frame ";
   // std::cout << "and end-effector frame (cMe)" << std::endl;
 
-  vpMatrix eJe;
-  vpRobotKawasaki::get_eJe(eJe);
-  eJe = eJe.inverseByLUEigen3();
+  if (m_mailbox) {
+    // The motion process converts the twist with its own joint positions, fresher than ours
+    vpTickArena::copy(v_e, m_velocity);
+    m_mailbox->writeSetPoint(vpRobot::END_EFFECTOR_FRAME, m_velocity);
+    return;
+  }
+
+  m_q.resize(ROBOT_DOF, false);
+  vpRobotKawasaki::getJointPosition(m_q);
+  vpArenaMatrix eJe = get_eJe(arena, m_q);
+  VP_TRACE_ZONE(zone_inverse, "eJe inverse");
+  vpArenaMatrix eJe_inv = arena.inverse(eJe);
+  VP_TRACE_ZONE_END(zone_inverse);
 
-  vpColVector q(ROBOT_DOF);
-  vpRobotKawasaki::getJointPosition(q);
-  isSingular(q, eJe);
+  isSingular(m_q, eJe_inv);
 
-  vpColVector qdot = eJe * v_e;
+  vpTickArena::copy(arena.multiply(eJe_inv, v_e), m_qdot);
 
-  vpRobotKawasaki::setJointVelocity(qdot);
+  vpRobotKawasaki::setJointVelocity(m_qdot);
 }
 
 /*!
@@ -412,10 +494,17 @@ void vpRobotKawasaki::setCartVelocity(const vpRobot::vpControlFrameType frame, c
  */
 void vpRobotKawasaki::setJointVelocity(const vpColVector &qdot)
 {
+  VP_TRACE_SCOPE("IPMCSetVelCommand");
+  if (m_mailbox) {
+    m_mailbox->writeSetPoint(vpRobot::JOINT_STATE, qdot);
+    return;
+  }
   // Implement your stuff here to send the joint velocities qdot
   //ofstream out("MotorPulse.txt", ios::app);
+  double encoder_velocity[ROBOT_DOF];
+  vpArmKinematics::jointToEncoderVelocity(qdot.data, encoder_velocity);
   for (int i = 0; i < ROBOT_DOF; i++) {
-    long velocity2pulse = (long)((qdot[i] * direction6[i] * reductionRatio6[i] * encoderResolution) / (2 * PI) );
+    long velocity2pulse = (long)encoder_velocity[i];
 	//out << velocity2pulse << "  ";
 	IPMCSetVelCommand(i, velocity2pulse);
   }
@@ -441,8 +530,6 @@ void vpRobotKawasaki::setVelocity(const vpRobot::vpControlFrameType frame, const
                            "entering your control loop.");
   }
 
-  vpColVector vel_sat(6);
-
   // Velocity saturation
   switch (frame) {
   // Saturation in cartesian space
@@ -454,16 +541,17 @@ void vpRobotKawasaki::setVelocity(const vpRobot::vpControlFrameType frame, const
       throw(vpException(vpException::dimensionError,
                         "Cannot apply a Cartesian velocity that is not a 6-dim vector (%d)", vel.size()));
     }
-    vpColVector vel_max(6);
+    double vel_max[6];
 
     for (unsigned int i = 0; i < 3; i++)
       vel_max[i] = vpRobot::getMaxTranslationVelocity();
     for (unsigned int i = 3; i < 6; i++)
       vel_max[i] = vpRobot::getMaxRotationVelocity();
 
-    vel_sat = vpRobot::saturateVelocities(vel, vel_max, true);
+    m_velSat.resize(6, false);
+    saturateVelocity(vel, vel_max, m_velSat.data, true);
 
-    vpRobotKawasaki::setCartVelocity(frame, vel_sat);
+    vpRobotKawasaki::setCartVelocity(frame, m_velSat);
     break;
   }
   // Saturation in joint space
@@ -472,14 +560,15 @@ void vpRobotKawasaki::setVelocity(const vpRobot::vpControlFrameType frame, const
       throw(vpException(vpException::dimensionError, "Cannot apply a joint velocity that is not a %-dim vector (%d)",
                         nDof, vel.size()));
     }
-    vpColVector vel_max(vel.size());
+    double vel_max[ROBOT_DOF];
 
     // Since the robot has only rotation axis all the joint max velocities are set to getMaxRotationVelocity()
-    vel_max = vpRobot::getMaxRotationVelocity();
+    std::fill(vel_max, vel_max + ROBOT_DOF, vpRobot::getMaxRotationVelocity());
 
-    vel_sat = vpRobot::saturateVelocities(vel, vel_max, true);
+    m_velSat.resize(ROBOT_DOF, false);
+    saturateVelocity(vel, vel_max, m_velSat.data, true);
 
-    vpRobotKawasaki::setJointVelocity(vel_sat);
+    vpRobotKawasaki::setJointVelocity(m_velSat);
   }
   }
 }
@@ -497,16 +586,49 @@ void vpRobotKawasaki::setVelocity(const vpRobot::vpControlFrameType frame, const
  */
 void vpRobotKawasaki:: getJointPosition(vpColVector &q)
 {
+  VP_TRACE_SCOPE("IPMCGetDriverPos");
+  if (m_mailbox) {
+    readMotionState();
+    for (int i = 0; i < ROBOT_DOF; i++) {
+      q[i] = m_motionQ[i];
+    }
+    return;
+  }
+
   long dJointCurrentPos[ROBOT_DOF] = {0};
 
   for (int i = 0; i < ROBOT_DOF; i++) {
     IPMCGetDriverPos(i, &dJointCurrentPos[i]);
   }
 
-  for (int i = 0; i < ROBOT_DOF; i++) {
-	  q[i] = ((dJointCurrentPos[i] - jointHome6[i]) * direction6[i] * 2 * PI) / (encoderResolution  * reductionRatio6[i]) + homeTheta6[i];
+  vpArmKinematics::encoderToJoint(dJointCurrentPos, q.data);
+}
+
+/*!
+  Read the joint positions and the robot state published by the motion process.
+
+  \exception vpRobotException::communicationError : The heartbeat of the motion process didn't change for
+  more than the timeout given to setMotionServer().
+ */
+void vpRobotKawasaki::readMotionState()
+{
+  vpMotionMailbox::vpMotionState state;
+  double t = vpTime::measureTimeMs();
+  // A failed read means that the motion process is writing, or stalled while writing: keep the last state
+  if (m_mailbox->readState(state)) {
+    for (int i = 0; i < ROBOT_DOF; i++) {
+      m_motionQ[i] = state.q[i];
+    }
+    m_motionState = state.robotState;
+    if (state.heartbeat != m_heartbeat) {
+      m_heartbeat = state.heartbeat;
+      m_heartbeatTime = t;
+    }
+  }
+  if (t - m_heartbeatTime > m_motionTimeout) {
+    throw vpRobotException(vpRobotException::communicationError, "The motion process %s doesn't answer since %.0f ms",
+                           m_motionServer.c_str(), t - m_heartbeatTime);
   }
-  q[5] = 0.01248916 * q[4] + q[5];
 }
 
 /*!
@@ -524,6 +646,22 @@ void vpRobotKawasaki::getPosition(const vpRobot::vpControlFrameType frame, vpCol
   }
 }
 
+/*!
+  Get the joint limits.
+
+  \param[out] q_min : Minimal joint positions in rad.
+  \param[out] q_max : Maximal joint positions in rad.
+ */
+void vpRobotKawasaki::getJointLimits(vpColVector &q_min, vpColVector &q_max) const
+{
+  q_min.resize(ROBOT_DOF);
+  q_max.resize(ROBOT_DOF);
+  for (int i = 0; i < ROBOT_DOF; i++) {
+    q_min[i] = vpKawasakiArm::jointMin[i] * Deg2Rad;
+    q_max[i] = vpKawasakiArm::jointMax[i] * Deg2Rad;
+  }
+}
+
 /*!
   Set a position to reach.
 
@@ -552,6 +690,24 @@ void vpRobotKawasaki::getDisplacement(const vpRobot::vpControlFrameType frame, v
 
 vpRobot::vpRobotStateType vpRobotKawasaki::setRobotState(vpRobot::vpRobotStateType newState)
 {
+  VP_TRACE_SCOPE("setRobotState");
+  if (m_mailbox) {
+    // The motion process changes the control mode of the drives, it takes seconds
+    m_mailbox->requestRobotState(newState);
+    double time_initial = vpTime::measureTimeSecond();
+    do {
+      vpTime::sleepMs(10);
+      if (vpTime::measureTimeSecond() - time_initial > 30) {
+        throw vpRobotException(vpRobotException::stateModificationError,
+                               "The motion process didn't change the robot state");
+      }
+      // Its heartbeat stops while the drives are switched
+      m_heartbeatTime = vpTime::measureTimeMs();
+      readMotionState();
+    } while (m_motionState != newState);
+    return vpRobot::setRobotState(newState);
+  }
+
   switch (newState) {
   case vpRobot::STATE_STOP: {
     if (vpRobot::STATE_VELOCITY_CONTROL == vpRobot::getRobotState()) {
@@ -592,6 +748,10 @@ vpRobot::vpRobotStateType vpRobotKawasaki::setRobotState(vpRobot::vpRobotStateTy
     break;
   }
   case vpRobot::STATE_VELOCITY_CONTROL: {
+    if (vpRobot::STATE_VELOCITY_CONTROL == vpRobot::getRobotState()) {
+      // Already enabled, e.g. during the startup, don't wait again for the drives
+      break;
+    }
     if (vpRobot::STATE_STOP == vpRobot::getRobotState()) {
       std::cout << "Change the control mode from stop to velocity control." << std::endl;
     } 
@@ -618,6 +778,18 @@ vpRobot::vpRobotStateType vpRobotKawasaki::setRobotState(vpRobot::vpRobotStateTy
 }
 
 vpColVector vpRobotKawasaki::getAxisVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &vel)
+{
+	vpColVector qdot_Axis;
+	getAxisVelocity(frame, vel, qdot_Axis);
+	return qdot_Axis;
+}
+
+/*!
+  Get the joint velocities in deg/s that setVelocity() would send for the velocity \e vel, in \e qdot_axis
+  that is only allocated if its size changes. With \e verbose, the saturated velocities are printed.
+ */
+void vpRobotKawasaki::getAxisVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &vel,
+                                      vpColVector &qdot_axis, bool verbose)
 {
 	if (vpRobot::STATE_VELOCITY_CONTROL != vpRobot::getRobotState()) {
 		throw vpRobotException(vpRobotException::wrongStateError,
@@ -626,7 +798,8 @@ vpColVector vpRobotKawasaki::getAxisVelocity(const vpRobot::vpControlFrameType f
 			"entering your control loop.");
 	}
 
-	vpColVector vel_sat(6);
+	vpTickArena &arena = vpTickArena::getThreadArena();
+	vpTickArena::vpScope scope(arena);
 
 	// Velocity saturation
 	switch (frame) {
@@ -639,38 +812,30 @@ vpColVector vpRobotKawasaki::getAxisVelocity(const vpRobot::vpControlFrameType f
 			throw(vpException(vpException::dimensionError,
 				"Cannot apply a Cartesian velocity that is not a 6-dim vector (%d)", vel.size()));
 		}
-		vpColVector vel_max(6);
+		double vel_max[6];
 
 		for (unsigned int i = 0; i < 3; i++)
 			vel_max[i] = vpRobot::getMaxTranslationVelocity();
 		for (unsigned int i = 3; i < 6; i++)
 			vel_max[i] = vpRobot::getMaxRotationVelocity();
 
-		vel_sat = vpRobot::saturateVelocities(vel, vel_max, true);
-
-		vpColVector v_e(6);
-		vpVelocityTwistMatrix eVc(m_eMc);
+		vpArenaMatrix v_e = arena.vector(6);
+		saturateVelocity(vel, vel_max, v_e.data, verbose);
 
 		if (frame == vpRobot::TOOL_FRAME)
 		{
-			v_e = eVc * vel_sat;
-	    }
-		else
-		{
-			v_e = vel_sat;
+			v_e = arena.multiply(get_eVc(arena), v_e);
 		}
 
-		vpMatrix eJe;
-		vpRobotKawasaki::get_eJe(eJe);
-		eJe = eJe.inverseByLUEigen3();
-		
-		//vpColVector q(ROBOT_DOF);
-		//vpRobotKawasaki::getJointPosition(q);
-		//isSingular(q, eJe);
+		m_q.resize(ROBOT_DOF, false);
+		vpRobotKawasaki::getJointPosition(m_q);
+		vpArenaMatrix eJe_inv = arena.inverse(get_eJe(arena, m_q));
 
-		vpColVector qdot_Axis = eJe * v_e;
+		//isSingular(m_q, eJe_inv);
 
-		return (qdot_Axis * Rad2Deg);
+		vpTickArena::copy(arena.multiply(eJe_inv, v_e), qdot_axis);
+		qdot_axis *= Rad2Deg;
+		break;
 	}
     // Saturation in joint space
 	case vpRobot::JOINT_STATE: {
@@ -678,94 +843,40 @@ vpColVector vpRobotKawasaki::getAxisVelocity(const vpRobot::vpControlFrameType f
 			throw(vpException(vpException::dimensionError, "Cannot apply a joint velocity that is not a %-dim vector (%d)",
 				nDof, vel.size()));
 		}
-		vpColVector vel_max(vel.size());
+		double vel_max[ROBOT_DOF];
 
 		// Since the robot has only rotation axis all the joint max velocities are set to getMaxRotationVelocity()
-		vel_max = vpRobot::getMaxRotationVelocity();
-
-		vel_sat = vpRobot::saturateVelocities(vel, vel_max, true);
+		std::fill(vel_max, vel_max + ROBOT_DOF, vpRobot::getMaxRotationVelocity());
 
-		vpColVector qdot_Axis = vel_sat;
-		
-		return (qdot_Axis * Rad2Deg);
+		qdot_axis.resize(ROBOT_DOF, false);
+		saturateVelocity(vel, vel_max, qdot_axis.data, verbose);
+		qdot_axis *= Rad2Deg;
+		break;
 	}
 	}
-
 }
 
 vpColVector vpRobotKawasaki::getMotorVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &vel)
 {
-	vpColVector qdot_Axis = getAxisVelocity(frame, vel);
+	// Already printed by getAxisVelocity() if the velocity is saturated
+	vpColVector qdot_Axis;
+	getAxisVelocity(frame, vel, qdot_Axis, false);
 	vpColVector qdot_Motor(ROBOT_DOF);
 	for (int i = 0; i < ROBOT_DOF; i++) 
 	{
-		qdot_Motor[i] = (qdot_Axis[i] * direction6[i] * reductionRatio6[i]);
+		qdot_Motor[i] = (qdot_Axis[i] * vpKawasakiArm::drive[i].direction * vpKawasakiArm::drive[i].reductionRatio);
 	}
 
-	return (qdot_Axis * Rad2Deg);
+	return qdot_Motor;
 }
 
 bool vpRobotKawasaki::isSingular(const vpColVector &q, vpMatrix &J)
 {
-	double q2 = q[1];
-	double q3 = q[2];
-	double q5 = q[4];
-	
-	double c2 = cos(q2);
-	double c3 = cos(q3);
-	double s23 = sin(q2 + q3);
-	double s5 = sin(q5);
-	
-	bool cond1 = fabs(s5) < 1e-1;
-	bool cond2 = fabs(c3) < 1e-1;
-	bool cond3 = fabs(c2 * a2 + s23 * d4) < 1e-1;
+  return removeSingularDirections(q, J, vpKawasakiArm::link[2].a, vpKawasakiArm::link[3].d);
+}
 
-	if (cond1) 
-	{
-		J[3][0] = 0;
-		J[5][0] = 0;
-		J[3][1] = 0;
-		J[5][1] = 0;
-		J[3][2] = 0;
-		J[5][2] = 0;
-		J[3][3] = 0;
-		J[5][3] = 0;
-		J[3][4] = 0;
-		J[5][4] = 0;
-		J[3][5] = 0;
-		J[5][5] = 0;
-		return true;	
-	}
-	if (cond2)
-	{
-		J[1][0] = 0;
-		J[2][0] = 0;
-		J[3][0] = 0;
-		J[4][0] = 0;
-		J[5][0] = 0;
-		J[1][1] = 0;
-		J[2][1] = 0;
-		J[3][1] = 0;
-		J[4][1] = 0;
-		J[5][1] = 0;
-		J[1][2] = 0;
-		J[2][2] = 0;
-		J[3][2] = 0;
-		J[4][2] = 0;
-		J[5][2] = 0;
-		return true;
-	}
-	if (cond3) 
-	{
-		J[0][0] = 0;
-		J[3][0] = 0;
-		J[4][0] = 0;
-		J[5][0] = 0;
-		J[0][1] = 0;
-		J[3][1] = 0;
-		J[4][1] = 0;
-		J[5][1] = 0;
-		return true;
-	}
-	return false;
-}
\ No newline at end of file
+//! Same as isSingular() for an inverse Jacobian computed in a vpTickArena.
+bool vpRobotKawasaki::isSingular(const vpColVector &q, const vpArenaMatrix &J) const
+{
+  return removeSingularDirections(q, J, vpKawasakiArm::link[2].a, vpKawasakiArm::link[3].d);
+}
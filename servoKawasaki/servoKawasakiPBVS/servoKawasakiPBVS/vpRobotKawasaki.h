@@ -51,17 +51,39 @@
   Defines a robot just to show which function you must implement.
 */
 
+#include <memory>
+#include <mutex>
+#include <string>
+
 #include <visp3/core/vpConfig.h>
 
 #include <visp3/core/vpHomogeneousMatrix.h>
 #include <visp3/robot/vpRobot.h>
 
+#include <vpDHKinematics.h>
+#include <vpTickArena.h>
+
+class vpMotionMailbox;
+
 /*!
 
   \class vpRobotKawasaki
   \ingroup group_robot_real_Kawasaki
   \brief Class that defines a robot just to show which function you must implement.
 
+  By default the drives are controlled by this process through the IPMC motion controller. After
+  setMotionServer(), connect() opens the mailbox of a motion process (see vpMotionMailbox and
+  motionKawasaki.cpp) that owns the drives: the velocities are sent to it as end-effector twists or joint
+  velocities, the joint positions and the robot state are read from it. A vpRobotException is thrown if the
+  motion process stops publishing its heartbeat.
+
+  The link parameters, the drives and the coupling of the joints are described by vpKawasakiArm, from which
+  vpDHKinematics generates the forward and inverse kinematics, the Jacobian and the encoder mapping.
+
+  The Jacobian, its inverse and the velocity conversions of an iteration are computed in the vpTickArena of
+  the calling thread. The vectors that cross the API keep their size from one iteration to the next, so that
+  setVelocity() doesn't allocate once the first command is sent.
+
 */
 class vpRobotKawasaki : public vpRobot
 {
@@ -73,22 +95,26 @@ public:
 
 
   void get_eJe(vpMatrix &eJe);
+  void get_eJe(const vpColVector &q, vpMatrix &eJe) const;
   void get_fJe(vpMatrix &fJe);
+  void get_fMe(const vpColVector &q, vpHomogeneousMatrix &fMe) const;
+  bool getInverseKinematics(const vpHomogeneousMatrix &fMe, vpColVector &q) const;
 
   /*!
     Return constant transformation between end-effector and tool frame.
     If your tool is a camera, this transformation is obtained by hand-eye calibration.
    */
-  vpHomogeneousMatrix get_eMc();
+  vpHomogeneousMatrix get_eMc() const;
 
   void getDisplacement(const vpRobot::vpControlFrameType frame, vpColVector &q);
+  void getJointLimits(vpColVector &q_min, vpColVector &q_max) const;
   void getPosition(const vpRobot::vpControlFrameType frame, vpColVector &q);
 
   /*!
     Set constant transformation between end-effector and tool frame.
     If your tool is a camera, this transformation is obtained by hand-eye calibration.
    */
-  void set_eMc(vpHomogeneousMatrix &eMc);
+  void set_eMc(const vpHomogeneousMatrix &eMc);
   void setPosition(const vpRobot::vpControlFrameType frame, const vpColVector &q);
   void setVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &vel);
 
@@ -96,40 +122,45 @@ public:
 
   vpColVector getMotorVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &vel);
   vpColVector getAxisVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &vel);
+  void getAxisVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &vel, vpColVector &qdot_axis,
+                       bool verbose = true);
 
   bool isSingular(const vpColVector &q, vpMatrix &J);
 
+  //! Return true if the drives are controlled by a motion process, see setMotionServer().
+  bool isRemote() const { return !m_motionServer.empty(); }
+  void setMotionServer(const std::string &name, double timeout = 200.);
+
 protected:
   void init();
+  vpArenaMatrix get_eJe(vpTickArena &arena, const vpColVector &q) const;
+  vpArenaMatrix get_eVc(vpTickArena &arena) const;
   void getJointPosition(vpColVector &q);
+  bool isSingular(const vpColVector &q, const vpArenaMatrix &J) const;
   void setCartVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &v);
   void setJointVelocity(const vpColVector &qdot);
+  void readMotionState();
 
   double imPulse = 0.001; //嵱
 
-  //˲
-  double a2 = 0.355, d1 = 0.36, d4 = 0.375, d6 = 0.078;
-
-  //ʱʵתĽǶ
-  double homeTheta6[6] = { 0, 90 * Deg2Rad, 90 * Deg2Rad, 0, 0, 0 };
-
-  //Сλ
-  double jointMax6[6] = { 180, 135, 155, 200, 125, 360 };
-  double jointMin6[6] = { -180, -135, -155, -200, -125, -360 };
-
-  //ʱλãλInc
-  long jointHome6[6] = {103319, 92992, 116630, 31953, 111221, 91157};
-
-  //ٱ
-  double reductionRatio6[6] = {80.008, 99.902, 78.433, 50.001, 64.001, 40.000};
-
-  //˶
-  int direction6[6] = {1, 1, -1, 1, -1, 1};
-
-  //ֱ
-  long encoderResolution = 131072;
-  //long encoderResolution = 8388608;
+  //! Kinematics and drives of the arm
+  typedef vpDHKinematics<vpKawasakiArm> vpArmKinematics;
 
   vpHomogeneousMatrix m_eMc; //!< Constant transformation between end-effector and tool (or camera) frame
+  mutable std::mutex m_eMcMutex; //!< Protects m_eMc, updated online by vpOnlineHandEye
+
+  // Allocated by the first command, then reused
+  vpColVector m_q;        //!< Joint positions of the last velocity conversion
+  vpColVector m_qdot;     //!< Joint velocities sent by setCartVelocity()
+  vpColVector m_velocity; //!< End-effector twist sent to the motion process
+  vpColVector m_velSat;   //!< Saturated velocity of setVelocity()
+
+  std::string m_motionServer;                 //!< Mailbox name of the motion process, empty to use the IPMC
+  double m_motionTimeout;                     //!< Largest time in ms without heartbeat of the motion process
+  std::unique_ptr<vpMotionMailbox> m_mailbox; //!< Opened by connect()
+  double m_motionQ[ROBOT_DOF];                //!< Last joint positions published by the motion process
+  vpRobot::vpRobotStateType m_motionState;    //!< Last robot state published by the motion process
+  unsigned int m_heartbeat;                   //!< Last heartbeat of the motion process
+  double m_heartbeatTime;                     //!< Time in ms of the last heartbeat change
 };
 #endif
@@ -0,0 +1,332 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Model predictive visual servoing under joint and visibility constraints.
+ *
+ *****************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+
+#include <visp3/core/vpConfig.h>
+#include <visp3/core/vpException.h>
+
+/*!
+  \file vpServoMPC.cpp
+  Model predictive visual servoing under joint and visibility constraints.
+*/
+
+#include <vpServoMPC.h>
+
+/*!
+  Default constructor: 5 steps horizon with a 40 ms sampling period, no constraint except the ones
+  that are set afterwards.
+ */
+vpServoMPC::vpServoMPC()
+  : m_horizon(5), m_dt(0.04), m_velocityWeight(1e-3), m_accelerationWeight(1e-2), m_cJe(), m_q(), m_qdot(),
+    m_qMin(), m_qMax(), m_qdotMax(), m_qddotMax(), m_visibility(false), m_xMin(0), m_xMax(0), m_yMin(0), m_yMax(0),
+    m_points(), m_qp(), m_nbConstraints(0), m_Q(), m_C(), m_r(), m_d(), m_x(), m_predictedError()
+{
+}
+
+/*
+  Add the two constraints limit_min <= value + dt * coeffs^T (x_0 + ... + x_k) <= limit_max.
+  Limits already violated by the current value are relaxed to this value.
+ */
+void vpServoMPC::addLimit(unsigned int &row, const double *coeffs, unsigned int k, double value, double limit_min,
+                          double limit_max)
+{
+  double upper = std::max(limit_max, value) - value;
+  double lower = value - std::min(limit_min, value);
+  for (unsigned int j = 0; j <= k; j++) {
+    for (unsigned int c = 0; c < 6; c++) {
+      m_C[row][6 * j + c] = m_dt * coeffs[c];
+      m_C[row + 1][6 * j + c] = -m_dt * coeffs[c];
+    }
+  }
+  m_d[row] = upper;
+  m_d[row + 1] = lower;
+  row += 2;
+}
+
+/*!
+  Compute the joint velocities to apply until the next iteration.
+
+  \param[in] L : Interaction matrix of the task, with 6 columns.
+  \param[in] e : Task error.
+  \param[out] qdot : First joint velocities of the optimal sequence.
+  \return true if the quadratic program was solved, false if the robot is only decelerated.
+ */
+bool vpServoMPC::computeControlLaw(const vpMatrix &L, const vpColVector &e, vpColVector &qdot)
+{
+  if (m_cJe.getRows() != 6) {
+    throw(vpException(vpException::notInitialized, "Robot Jacobian not set. Call set_cVe_eJe() first"));
+  }
+  if (L.getCols() != 6 || L.getRows() != e.getRows()) {
+    throw(vpException(vpException::dimensionError, "Cannot use a %dx%d interaction matrix with a %d-dim error",
+                      L.getRows(), L.getCols(), e.getRows()));
+  }
+  if (m_qdot.getRows() != 6) {
+    m_qdot.resize(6, true);
+  }
+
+  const unsigned int H = m_horizon, N = e.getRows(), n = 6 * H;
+  const vpMatrix J = L * m_cJe;
+
+  // Cost: sum of the predicted squared errors, plus the weighted velocities and velocity variations
+  m_Q.resize(N * H + 12 * H, n);
+  m_r.resize(N * H + 12 * H);
+  for (unsigned int k = 0; k < H; k++) {
+    for (unsigned int i = 0; i < N; i++) {
+      for (unsigned int j = 0; j <= k; j++) {
+        for (unsigned int c = 0; c < 6; c++) {
+          m_Q[k * N + i][6 * j + c] = m_dt * J[i][c];
+        }
+      }
+      m_r[k * N + i] = -e[i];
+    }
+  }
+  double scale = m_dt * J.frobeniusNorm() / std::sqrt(6.);
+  double wv = scale * std::sqrt(m_velocityWeight), wa = scale * std::sqrt(m_accelerationWeight);
+  for (unsigned int k = 0; k < H; k++) {
+    for (unsigned int c = 0; c < 6; c++) {
+      unsigned int row = N * H + 6 * k + c;
+      m_Q[row][6 * k + c] = wv;
+      row += 6 * H;
+      m_Q[row][6 * k + c] = wa;
+      if (k > 0) {
+        m_Q[row][6 * (k - 1) + c] = -wa;
+      } else {
+        m_r[row] = wa * m_qdot[c];
+      }
+    }
+  }
+
+  // Constraints C x <= d
+  const bool has_velocity = (m_qdotMax.getRows() == 6);
+  const bool has_acceleration = (m_qddotMax.getRows() == 6);
+  const bool has_joint = (m_qMin.getRows() == 6 && m_q.getRows() == 6);
+  const bool has_visibility = (m_visibility && !m_points.empty());
+  const unsigned int nb_constraints = (has_velocity ? 12 * H : 0) + (has_acceleration ? 12 * H : 0) +
+                                      (has_joint ? 12 * H : 0) +
+                                      (has_visibility ? 4 * static_cast<unsigned int>(m_points.size()) * H : 0);
+  if (nb_constraints != m_nbConstraints) {
+    // The previous active set doesn't match the constraints anymore
+    m_qp.resetActiveSet();
+    m_nbConstraints = nb_constraints;
+  }
+  m_C.resize(nb_constraints, n);
+  m_d.resize(nb_constraints);
+
+  unsigned int row = 0;
+  for (unsigned int k = 0; k < H; k++) {
+    for (unsigned int c = 0; c < 6; c++) {
+      if (has_velocity) {
+        m_C[row][6 * k + c] = 1;
+        m_d[row++] = m_qdotMax[c];
+        m_C[row][6 * k + c] = -1;
+        m_d[row++] = m_qdotMax[c];
+      }
+      if (has_acceleration) {
+        double dq = m_qddotMax[c] * m_dt;
+        m_C[row][6 * k + c] = 1;
+        m_C[row + 1][6 * k + c] = -1;
+        if (k > 0) {
+          m_C[row][6 * (k - 1) + c] = -1;
+          m_C[row + 1][6 * (k - 1) + c] = 1;
+          m_d[row] = dq;
+          m_d[row + 1] = dq;
+        } else {
+          m_d[row] = dq + m_qdot[c];
+          m_d[row + 1] = dq - m_qdot[c];
+        }
+        row += 2;
+      }
+      if (has_joint) {
+        double unit[6] = {0, 0, 0, 0, 0, 0};
+        unit[c] = 1;
+        addLimit(row, unit, k, m_q[c], m_qMin[c], m_qMax[c]);
+      }
+    }
+    if (has_visibility) {
+      for (size_t i = 0; i < m_points.size(); i++) {
+        double x = m_points[i].get_x(), y = m_points[i].get_y(), Z = m_points[i].get_Z();
+        if (Z <= 0) {
+          Z = 1;
+        }
+        // Point feature interaction matrix
+        const double Lx[6] = {-1 / Z, 0, x / Z, x * y, -(1 + x * x), y};
+        const double Ly[6] = {0, -1 / Z, y / Z, 1 + y * y, -x * y, -x};
+        double Jx[6], Jy[6];
+        for (unsigned int c = 0; c < 6; c++) {
+          Jx[c] = Jy[c] = 0;
+          for (unsigned int l = 0; l < 6; l++) {
+            Jx[c] += Lx[l] * m_cJe[l][c];
+            Jy[c] += Ly[l] * m_cJe[l][c];
+          }
+        }
+        addLimit(row, Jx, k, x, m_xMin, m_xMax);
+        addLimit(row, Jy, k, y, m_yMin, m_yMax);
+      }
+    }
+  }
+
+  bool solved = false;
+  if (nb_constraints > 0) {
+    solved = m_qp.solveQPi(m_Q, m_r, m_C, m_d, m_x);
+  } else {
+    solved = vpQuadProg().solveQPe(m_Q, m_r, m_x);
+  }
+
+  qdot.resize(6, false);
+  if (solved && m_x.getRows() == n) {
+    vpColVector sum(6);
+    for (unsigned int k = 0; k < H; k++) {
+      for (unsigned int c = 0; c < 6; c++) {
+        sum[c] += m_x[6 * k + c];
+      }
+    }
+    m_predictedError = e + m_dt * (J * sum);
+    for (unsigned int c = 0; c < 6; c++) {
+      qdot[c] = m_x[c];
+    }
+  } else {
+    // No feasible solution: decelerate within the acceleration limits
+    m_qp.resetActiveSet();
+    m_predictedError = e;
+    for (unsigned int c = 0; c < 6; c++) {
+      double dq = has_acceleration ? m_qddotMax[c] * m_dt : std::fabs(m_qdot[c]);
+      if (m_qdot[c] > 0) {
+        qdot[c] = std::max(m_qdot[c] - dq, 0.);
+      } else {
+        qdot[c] = std::min(m_qdot[c] + dq, 0.);
+      }
+    }
+    solved = false;
+  }
+  return solved;
+}
+
+/*!
+  Forget the active set of the last solve and the last applied velocities.
+ */
+void vpServoMPC::reset()
+{
+  m_qp.resetActiveSet();
+  m_nbConstraints = 0;
+  m_qdot.resize(6, true);
+}
+
+/*!
+  Set the robot Jacobian \f${^c}{\bf V}_e\,{^e}{\bf J}_e\f$ of a 6 joints robot, to be updated at each iteration.
+ */
+void vpServoMPC::set_cVe_eJe(const vpVelocityTwistMatrix &cVe, const vpMatrix &eJe)
+{
+  if (eJe.getRows() != 6 || eJe.getCols() != 6) {
+    throw(vpException(vpException::dimensionError, "Cannot use a %dx%d robot Jacobian, 6x6 expected", eJe.getRows(),
+                      eJe.getCols()));
+  }
+  m_cJe = cVe * eJe;
+}
+
+/*!
+  Set the number of sampling periods of the prediction horizon.
+ */
+void vpServoMPC::setHorizon(unsigned int nb_steps)
+{
+  m_horizon = (nb_steps > 0 ? nb_steps : 1);
+  m_qp.resetActiveSet();
+  m_nbConstraints = 0;
+}
+
+/*!
+  Keep the visibility points inside the image, with a margin in pixel along the image borders.
+  The bounds are converted in normalized coordinates without distortion.
+ */
+void vpServoMPC::setImageBounds(const vpCameraParameters &cam, unsigned int width, unsigned int height, double margin)
+{
+  m_xMin = (margin - cam.get_u0()) / cam.get_px();
+  m_xMax = (width - 1 - margin - cam.get_u0()) / cam.get_px();
+  m_yMin = (margin - cam.get_v0()) / cam.get_py();
+  m_yMax = (height - 1 - margin - cam.get_v0()) / cam.get_py();
+  m_visibility = true;
+}
+
+/*!
+  Set the maximal joint accelerations in rad/s^2.
+ */
+void vpServoMPC::setJointAccelerationLimits(const vpColVector &qddot_max)
+{
+  if (qddot_max.getRows() != 6) {
+    throw(vpException(vpException::dimensionError, "Cannot use %d acceleration limits, 6 expected", qddot_max.getRows()));
+  }
+  m_qddotMax = qddot_max;
+}
+
+/*!
+  Set the joint limits in rad.
+ */
+void vpServoMPC::setJointLimits(const vpColVector &q_min, const vpColVector &q_max)
+{
+  if (q_min.getRows() != 6 || q_max.getRows() != 6) {
+    throw(vpException(vpException::dimensionError, "Cannot use %d and %d joint limits, 6 expected", q_min.getRows(),
+                      q_max.getRows()));
+  }
+  m_qMin = q_min;
+  m_qMax = q_max;
+}
+
+/*!
+  Set the current joint positions in rad and the joint velocities in rad/s that were applied since the
+  previous iteration, used by the acceleration limits and the velocity variation cost.
+ */
+void vpServoMPC::setJointState(const vpColVector &q, const vpColVector &qdot)
+{
+  m_q = q;
+  m_qdot = qdot;
+}
+
+/*!
+  Set the maximal joint velocities in rad/s.
+ */
+void vpServoMPC::setJointVelocityLimits(const vpColVector &qdot_max)
+{
+  if (qdot_max.getRows() != 6) {
+    throw(vpException(vpException::dimensionError, "Cannot use %d velocity limits, 6 expected", qdot_max.getRows()));
+  }
+  m_qdotMax = qdot_max;
+}
+
+/*!
+  Set the points that have to stay visible, with their normalized coordinates (x, y) and their depth Z
+  in the camera frame, as updated by vpPoint::track(). Used only once the image bounds are set.
+ */
+void vpServoMPC::setVisibilityPoints(const std::vector<vpPoint> &points) { m_points = points; }
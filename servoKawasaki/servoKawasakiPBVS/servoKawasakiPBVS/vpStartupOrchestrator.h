@@ -0,0 +1,113 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Concurrent startup of the robot, the camera and the vision components.
+ *
+ *****************************************************************************/
+
+#ifndef vpStartupOrchestrator_h
+#define vpStartupOrchestrator_h
+
+/*!
+  \file vpStartupOrchestrator.h
+  Concurrent startup of the robot, the camera and the vision components.
+*/
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <visp3/core/vpConfig.h>
+
+/*!
+
+  \class vpStartupOrchestrator
+  \brief Start independent components concurrently, each in its own thread, and wait for them before
+  they are used, with a single deadline for the whole startup.
+
+  A component is a function returning false if it fails. launch() starts it in a new thread, run() executes
+  it in the calling thread, e.g. to create a display window. wait() blocks until the component is ready and
+  throws a vpException if it fails, if it throws itself or if the deadline given to the constructor is passed.
+  The report gives the startup time of each component, so the total time is the one of the slowest component
+  instead of the sum of all of them.
+
+  The destructor waits for the components still running, that must end by themselves, e.g. with their own
+  timeout, since a thread can not be cancelled. The objects used by the components have to be declared before
+  the orchestrator, so that they are destroyed after it, even on an early return or an exception thrown by
+  wait().
+
+  \code
+  vpRealSense2 rs;
+  vpStartupOrchestrator startup(40.);
+  startup.launch("robot", [&]() { return robot.connect() == EXIT_SUCCESS; });
+  startup.launch("camera", [&]() { rs.open(config); return true; });
+  startup.run("display", [&]() { display.init(I); return true; });
+  startup.wait("camera");
+  ...
+  startup.waitAll();
+  std::cout << startup.getReport() << std::endl;
+  \endcode
+
+*/
+class vpStartupOrchestrator
+{
+public:
+  explicit vpStartupOrchestrator(double timeout = 40.);
+  virtual ~vpStartupOrchestrator();
+
+  std::string getReport() const;
+
+  void launch(const std::string &name, const std::function<bool()> &task);
+  void run(const std::string &name, const std::function<bool()> &task);
+
+  void wait(const std::string &name);
+  void waitAll();
+
+protected:
+  //! State of a component, the timings being written by its thread before the future is ready.
+  struct vpComponent {
+    std::string name;
+    std::future<bool> future;
+    double startTime; //!< ms since the orchestrator creation
+    double duration;  //!< ms
+    bool waited;
+    bool ready;
+  };
+
+  void wait(vpComponent &component);
+
+  std::vector<std::shared_ptr<vpComponent> > m_components;
+  double m_startTime; //!< ms
+  double m_timeout;   //!< s
+};
+#endif
@@ -0,0 +1,310 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Target made of several AprilTags rigidly attached to the object frame.
+ *
+ *****************************************************************************/
+
+#include <algorithm>
+#include <cstdlib>
+#include <list>
+
+#include <visp3/core/vpConfig.h>
+#include <visp3/core/vpArray2D.h>
+#include <visp3/core/vpException.h>
+#include <visp3/core/vpPixelMeterConversion.h>
+#include <visp3/core/vpPoseVector.h>
+#include <visp3/vision/vpPose.h>
+
+/*!
+  \file vpTagBundle.cpp
+  Target made of several AprilTags rigidly attached to the object frame.
+*/
+
+#include <vpTagBundle.h>
+
+/*!
+  Default constructor. The bundle is empty.
+ */
+vpTagBundle::vpTagBundle()
+  : m_ids(), m_size(), m_oMt(), m_corners(), m_detectedIndex(), m_mainIndex(-1), m_pose(), m_detectedCorners()
+{
+}
+
+/*!
+  Add a tag to the bundle.
+
+  \param[in] id : Tag id as encoded in the AprilTag message.
+  \param[in] size : Tag size in meter.
+  \param[in] oMt : Pose of the tag frame in the object frame.
+ */
+void vpTagBundle::addTag(int id, double size, const vpHomogeneousMatrix &oMt)
+{
+  if (hasTag(id)) {
+    throw(vpException(vpException::badValue, "Tag %d is already part of the bundle", id));
+  }
+  if (size <= 0) {
+    throw(vpException(vpException::badValue, "Tag %d has a wrong size (%f)", id, size));
+  }
+
+  // Same corner order as the one returned by vpDetectorAprilTag::getPolygon()
+  std::vector<vpPoint> corners(4);
+  corners[0].setWorldCoordinates(-size / 2., -size / 2., 0);
+  corners[1].setWorldCoordinates( size / 2., -size / 2., 0);
+  corners[2].setWorldCoordinates( size / 2.,  size / 2., 0);
+  corners[3].setWorldCoordinates(-size / 2.,  size / 2., 0);
+  for (size_t i = 0; i < corners.size(); i++) {
+    vpColVector oP;
+    corners[i].changeFrame(oMt, oP);
+    corners[i].setWorldCoordinates(oP[0], oP[1], oP[2]);
+  }
+
+  m_ids.push_back(id);
+  m_size[id] = size;
+  m_oMt[id] = oMt;
+  m_corners[id] = corners;
+  // The detections and their corners are then kept without allocation
+  m_detectedIndex.reserve(m_ids.size());
+  m_detectedCorners.reserve(4 * m_ids.size());
+}
+
+/*!
+  Remove all the tags from the bundle.
+ */
+void vpTagBundle::clear()
+{
+  m_ids.clear();
+  m_size.clear();
+  m_oMt.clear();
+  m_corners.clear();
+  m_detectedIndex.clear();
+  m_mainIndex = -1;
+  m_detectedCorners.clear();
+}
+
+/*!
+  Estimate the pose of the object frame from all the bundle tags found by the last call to
+  vpDetectorAprilTag::detect().
+
+  The pose is initialized from the tag that has the largest area in the image. When more than one
+  bundle tag is visible, the corners of all of them are used to refine the pose by virtual visual servoing.
+
+  \param[in] detector : Detector on which detect() was called.
+  \param[in] cam : Camera parameters.
+  \param[out] cMo : Pose of the object frame in the camera frame.
+  \return true if at least one bundle tag was detected, false otherwise.
+ */
+bool vpTagBundle::computePose(vpDetectorAprilTag &detector, const vpCameraParameters &cam, vpHomogeneousMatrix &cMo)
+{
+  m_detectedIndex.clear();
+  m_mainIndex = -1;
+
+  int init_id = -1;
+  double init_area = 0;
+  for (size_t i = 0; i < detector.getNbObjects(); i++) {
+    int id = getTagId(detector.getMessage(i));
+    if (!hasTag(id) || getDetectionIndex(id) >= 0) {
+      // Tag not part of the bundle, or same id seen twice
+      continue;
+    }
+    // Sorted by id
+    std::pair<int, int> detection(id, static_cast<int>(i));
+    m_detectedIndex.insert(std::upper_bound(m_detectedIndex.begin(), m_detectedIndex.end(), detection), detection);
+    double area = detector.getBBox(i).getArea();
+    if (area > init_area || init_id < 0) {
+      init_area = area;
+      init_id = id;
+      m_mainIndex = static_cast<int>(i);
+    }
+  }
+
+  if (m_detectedIndex.empty()) {
+    return false;
+  }
+
+  vpHomogeneousMatrix cMt;
+  if (!detector.getPose(static_cast<size_t>(m_mainIndex), m_size[init_id], cam, cMt)) {
+    return false;
+  }
+  cMo = cMt * m_oMt[init_id].inverse();
+
+  if (m_detectedIndex.size() == 1) {
+    return true;
+  }
+
+  getDetectedCorners(detector, cam, m_detectedCorners);
+  setPosePoints(m_pose, m_detectedCorners);
+
+  vpHomogeneousMatrix cMo_vvs = cMo;
+  if (m_pose.computePose(vpPose::VIRTUAL_VS, cMo_vvs)) {
+    cMo = cMo_vvs;
+  }
+
+  return true;
+}
+
+/*!
+  Return the index in the detector of the tag \e id found during the last call to computePose(),
+  or -1 if this tag was not detected.
+ */
+int vpTagBundle::getDetectionIndex(int id) const
+{
+  std::vector<std::pair<int, int> >::const_iterator it =
+      std::lower_bound(m_detectedIndex.begin(), m_detectedIndex.end(), std::make_pair(id, -1));
+  if (it == m_detectedIndex.end() || it->first != id) {
+    return -1;
+  }
+  return it->second;
+}
+
+/*!
+  Get the corners of all the bundle tags used during the last call to computePose(), with their
+  coordinates in the object frame and their measured normalized coordinates (x, y) set.
+
+  \param[in] detector : Detector on which computePose() was called.
+  \param[in] cam : Camera parameters.
+  \param[out] points : Corners, the capacity of the vector is reused.
+ */
+void vpTagBundle::getDetectedCorners(vpDetectorAprilTag &detector, const vpCameraParameters &cam,
+                                     std::vector<vpPoint> &points) const
+{
+  points.clear();
+  for (std::vector<std::pair<int, int> >::const_iterator it = m_detectedIndex.begin(); it != m_detectedIndex.end();
+       ++it) {
+    const std::vector<vpImagePoint> &polygon = detector.getPolygon(static_cast<size_t>(it->second));
+    const std::vector<vpPoint> &corners = getTagCorners(it->first);
+    for (size_t i = 0; i < corners.size() && i < polygon.size(); i++) {
+      double x = 0, y = 0;
+      vpPixelMeterConversion::convertPoint(cam, polygon[i], x, y);
+      points.push_back(corners[i]);
+      points.back().set_x(x);
+      points.back().set_y(y);
+    }
+  }
+}
+
+/*!
+  Return the 4 corners of tag \e id with their coordinates expressed in the object frame.
+  The corners are ordered like the ones returned by vpDetectorAprilTag::getPolygon().
+ */
+const std::vector<vpPoint> &vpTagBundle::getTagCorners(int id) const
+{
+  std::map<int, std::vector<vpPoint> >::const_iterator it = m_corners.find(id);
+  if (it == m_corners.end()) {
+    throw(vpException(vpException::badValue, "Tag %d is not part of the bundle", id));
+  }
+  return it->second;
+}
+
+/*!
+  Return the pose oMt of tag \e id in the object frame.
+ */
+vpHomogeneousMatrix vpTagBundle::getTagPose(int id) const
+{
+  std::map<int, vpHomogeneousMatrix>::const_iterator it = m_oMt.find(id);
+  if (it == m_oMt.end()) {
+    throw(vpException(vpException::badValue, "Tag %d is not part of the bundle", id));
+  }
+  return it->second;
+}
+
+/*!
+  Return the size in meter of tag \e id.
+ */
+double vpTagBundle::getTagSize(int id) const
+{
+  std::map<int, double>::const_iterator it = m_size.find(id);
+  if (it == m_size.end()) {
+    throw(vpException(vpException::badValue, "Tag %d is not part of the bundle", id));
+  }
+  return it->second;
+}
+
+/*!
+  Extract the tag id from a message returned by vpDetectorAprilTag::getMessage(), like "36h11 id: 3".
+  \return The tag id, or -1 if the message doesn't contain an id.
+ */
+int vpTagBundle::getTagId(const std::string &message)
+{
+  std::size_t tag_id_pos = message.find("id: ");
+  if (tag_id_pos == std::string::npos) {
+    return -1;
+  }
+  return std::atoi(message.c_str() + tag_id_pos + 4);
+}
+
+bool vpTagBundle::hasTag(int id) const { return m_size.find(id) != m_size.end(); }
+
+/*!
+  Load the bundle from a YAML file. See the class description for the file format.
+  The tags already in the bundle are removed.
+
+  \return true if the file was successfully read, false otherwise.
+ */
+bool vpTagBundle::load(const std::string &filename)
+{
+  vpArray2D<double> data;
+  if (!vpArray2D<double>::loadYAML(filename, data)) {
+    return false;
+  }
+  if (data.getCols() != 8 || data.getRows() == 0) {
+    throw(vpException(vpException::dimensionError,
+                      "Tag bundle %s should have 8 columns [id, size, tx, ty, tz, tux, tuy, tuz]", filename.c_str()));
+  }
+
+  clear();
+  for (unsigned int i = 0; i < data.getRows(); i++) {
+    vpPoseVector oPt(data[i][2], data[i][3], data[i][4], data[i][5], data[i][6], data[i][7]);
+    addTag(vpMath::round(data[i][0]), data[i][1], vpHomogeneousMatrix(oPt));
+  }
+  return true;
+}
+
+/*!
+  Set the points of a pose, in place when their number doesn't change so that the nodes of the list of
+  vpPose are not reallocated at each iteration.
+
+  \param[in,out] pose : Pose whose points are set.
+  \param[in] points : Points with their coordinates in the object frame and their measured normalized
+  coordinates.
+ */
+void vpTagBundle::setPosePoints(vpPose &pose, const std::vector<vpPoint> &points)
+{
+  if (pose.listP.size() != points.size()) {
+    pose.clearPoint();
+    pose.addPoints(points);
+    return;
+  }
+  std::vector<vpPoint>::const_iterator it_point = points.begin();
+  for (std::list<vpPoint>::iterator it = pose.listP.begin(); it != pose.listP.end(); ++it, ++it_point) {
+    *it = *it_point;
+  }
+}
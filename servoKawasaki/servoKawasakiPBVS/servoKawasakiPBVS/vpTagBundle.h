@@ -0,0 +1,134 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Target made of several AprilTags rigidly attached to the object frame.
+ *
+ *****************************************************************************/
+
+#ifndef vpTagBundle_h
+#define vpTagBundle_h
+
+/*!
+  \file vpTagBundle.h
+  Target made of several AprilTags rigidly attached to the object frame.
+*/
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <visp3/core/vpConfig.h>
+
+#include <visp3/core/vpCameraParameters.h>
+#include <visp3/core/vpHomogeneousMatrix.h>
+#include <visp3/core/vpPoint.h>
+#include <visp3/detection/vpDetectorAprilTag.h>
+#include <visp3/vision/vpPose.h>
+
+/*!
+
+  \class vpTagBundle
+  \brief Tag bundle target model: a set of AprilTag ids with known poses in the object frame.
+
+  The corners of all the bundle tags that are detected in the image are fused in a single
+  pose estimation of the object frame. Tags with an id that is not part of the bundle are ignored.
+
+  The bundle is loaded from a YAML file that contains one row per tag:
+  [id, size, tx, ty, tz, tux, tuy, tuz] where size is the tag size in meter and (t, tu) is the
+  pose oMt of the tag frame in the object frame, in the same format as eMc.yaml:
+  \code
+rows: 2
+cols: 8
+data:
+  - [0, 0.096, 0, 0, 0, 0, 0, 0]
+  - [1, 0.096, 0.15, 0, 0, 0, 0, 0]
+  \endcode
+  The first tag of the file is the reference tag of the bundle.
+
+*/
+class vpTagBundle
+{
+public:
+  vpTagBundle();
+
+  void addTag(int id, double size, const vpHomogeneousMatrix &oMt = vpHomogeneousMatrix());
+  void clear();
+
+  bool computePose(vpDetectorAprilTag &detector, const vpCameraParameters &cam, vpHomogeneousMatrix &cMo);
+
+  /*!
+    Return the index in the detector of the tag \e id found during the last call to computePose(),
+    or -1 if this tag was not detected.
+   */
+  int getDetectionIndex(int id) const;
+  void getDetectedCorners(vpDetectorAprilTag &detector, const vpCameraParameters &cam,
+                          std::vector<vpPoint> &points) const;
+  /*!
+    Return the index in the detector of the bundle tag with the largest area in the image during the
+    last call to computePose(), or -1 if no bundle tag was detected. This tag initializes the pose.
+   */
+  int getMainDetectionIndex() const { return m_mainIndex; }
+  /*!
+    Return the number of bundle tags used during the last call to computePose().
+   */
+  size_t getNbDetectedTags() const { return m_detectedIndex.size(); }
+  /*!
+    Return the number of tags in the bundle.
+   */
+  size_t getNbTags() const { return m_ids.size(); }
+  /*!
+    Return the id of the reference tag, that is the first one added to the bundle.
+   */
+  int getReferenceId() const { return m_ids.empty() ? -1 : m_ids[0]; }
+  const std::vector<vpPoint> &getTagCorners(int id) const;
+  vpHomogeneousMatrix getTagPose(int id) const;
+  double getTagSize(int id) const;
+
+  static int getTagId(const std::string &message);
+
+  bool hasTag(int id) const;
+  bool load(const std::string &filename);
+
+  static void setPosePoints(vpPose &pose, const std::vector<vpPoint> &points);
+
+protected:
+  std::vector<int> m_ids;                               //!< Tag ids in insertion order
+  std::map<int, double> m_size;                         //!< Tag size in meter
+  std::map<int, vpHomogeneousMatrix> m_oMt;             //!< Tag pose in the object frame
+  std::map<int, std::vector<vpPoint> > m_corners;       //!< Tag corners in the object frame
+  std::vector<std::pair<int, int> > m_detectedIndex;  //!< Id and index in the detector of the tags used in the
+                                                      //!< last pose, sorted by id
+  int m_mainIndex;                                      //!< Index in the detector of the largest tag
+  vpPose m_pose;                                        //!< Pose of the bundle refined from the fused corners
+  std::vector<vpPoint> m_detectedCorners;               //!< Corners used by the last refinement
+};
+#endif
@@ -0,0 +1,360 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Tracking of the tag corners between two AprilTag detections.
+ *
+ *****************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+
+#include <visp3/core/vpConfig.h>
+#include <visp3/core/vpCPUFeatures.h>
+#include <visp3/core/vpImageFilter.h>
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VISP_HAVE_SSE2 1
+#endif
+
+/*!
+  \file vpTagCornerTracker.cpp
+  Tracking of the tag corners between two AprilTag detections.
+*/
+
+#include <vpTagCornerTracker.h>
+
+namespace
+{
+// Size of the square patch centered on a corner
+const int patch_size = 16;
+const int patch_area = patch_size * patch_size;
+
+#if VISP_HAVE_SSE2
+// Convert 16 unsigned char in 4 x 4 floats
+inline void load16(const unsigned char *p, __m128 v[4])
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+  __m128i lo = _mm_unpacklo_epi8(a, zero), hi = _mm_unpackhi_epi8(a, zero);
+  v[0] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero));
+  v[1] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero));
+  v[2] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero));
+  v[3] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero));
+}
+
+inline double hsum(const __m128 &a)
+{
+  float t[4];
+  _mm_storeu_ps(t, a);
+  return static_cast<double>(t[0]) + t[1] + t[2] + t[3];
+}
+#endif
+
+/*
+  Bilinear interpolation of a n x n patch whose top left sample is at (u, v). All the samples share
+  the same sub-pixel weights. Return false if the patch is not entirely inside the image.
+*/
+bool samplePatch(const vpImage<unsigned char> &I, double u, double v, int n, float *patch)
+{
+  int iu = static_cast<int>(std::floor(u)), iv = static_cast<int>(std::floor(v));
+  if (iu < 0 || iv < 0 || iu + n > static_cast<int>(I.getWidth()) - 1 || iv + n > static_cast<int>(I.getHeight()) - 1) {
+    return false;
+  }
+  const float a = static_cast<float>(u - iu), b = static_cast<float>(v - iv);
+  const float w00 = (1 - a) * (1 - b), w01 = a * (1 - b), w10 = (1 - a) * b, w11 = a * b;
+
+#if VISP_HAVE_SSE2
+  static const bool checkSSE2 = vpCPUFeatures::checkSSE2();
+  if (checkSSE2 && n == patch_size) {
+    const __m128 v_w00 = _mm_set1_ps(w00), v_w01 = _mm_set1_ps(w01), v_w10 = _mm_set1_ps(w10), v_w11 = _mm_set1_ps(w11);
+    __m128 p00[4], p01[4], p10[4], p11[4];
+    for (int r = 0; r < n; r++) {
+      const unsigned char *row0 = I[iv + r] + iu, *row1 = I[iv + r + 1] + iu;
+      load16(row0, p00);
+      load16(row0 + 1, p01);
+      load16(row1, p10);
+      load16(row1 + 1, p11);
+      for (int k = 0; k < 4; k++) {
+        __m128 s = _mm_add_ps(_mm_mul_ps(v_w00, p00[k]), _mm_mul_ps(v_w01, p01[k]));
+        s = _mm_add_ps(s, _mm_add_ps(_mm_mul_ps(v_w10, p10[k]), _mm_mul_ps(v_w11, p11[k])));
+        _mm_storeu_ps(patch + r * n + 4 * k, s);
+      }
+    }
+    return true;
+  }
+#endif
+
+  for (int r = 0; r < n; r++) {
+    const unsigned char *row0 = I[iv + r] + iu, *row1 = I[iv + r + 1] + iu;
+    for (int c = 0; c < n; c++) {
+      patch[r * n + c] = w00 * row0[c] + w01 * row0[c + 1] + w10 * row1[c] + w11 * row1[c + 1];
+    }
+  }
+  return true;
+}
+
+/*
+  Compute the steepest descent terms sum(Gx.e), sum(Gy.e) and the sum of squared errors e = W - T.
+*/
+void computeError(const float *W, const float *T, const float *Gx, const float *Gy, double &bx, double &by,
+                  double &sse)
+{
+  int i = 0;
+  bx = by = sse = 0;
+
+#if VISP_HAVE_SSE2
+  static const bool checkSSE2 = vpCPUFeatures::checkSSE2();
+  if (checkSSE2) {
+    __m128 a_x = _mm_setzero_ps(), a_y = _mm_setzero_ps(), a_e = _mm_setzero_ps();
+    for (; i + 4 <= patch_area; i += 4) {
+      __m128 e = _mm_sub_ps(_mm_loadu_ps(W + i), _mm_loadu_ps(T + i));
+      a_x = _mm_add_ps(a_x, _mm_mul_ps(_mm_loadu_ps(Gx + i), e));
+      a_y = _mm_add_ps(a_y, _mm_mul_ps(_mm_loadu_ps(Gy + i), e));
+      a_e = _mm_add_ps(a_e, _mm_mul_ps(e, e));
+    }
+    bx = hsum(a_x);
+    by = hsum(a_y);
+    sse = hsum(a_e);
+  }
+#endif
+
+  for (; i < patch_area; i++) {
+    double e = W[i] - T[i];
+    bx += Gx[i] * e;
+    by += Gy[i] * e;
+    sse += e * e;
+  }
+}
+
+// Signed area of a polygon
+double polygonArea(const std::vector<vpImagePoint> &polygon)
+{
+  double area = 0;
+  for (size_t i = 0; i < polygon.size(); i++) {
+    const vpImagePoint &a = polygon[i], &b = polygon[(i + 1) % polygon.size()];
+    area += a.get_u() * b.get_v() - b.get_u() * a.get_v();
+  }
+  return area / 2.;
+}
+
+bool isConvex(const std::vector<vpImagePoint> &polygon)
+{
+  int sign = 0;
+  for (size_t i = 0; i < polygon.size(); i++) {
+    const vpImagePoint &a = polygon[i], &b = polygon[(i + 1) % polygon.size()],
+                       &c = polygon[(i + 2) % polygon.size()];
+    double cross = (b.get_u() - a.get_u()) * (c.get_v() - b.get_v()) - (b.get_v() - a.get_v()) * (c.get_u() - b.get_u());
+    int s = (cross > 0 ? 1 : (cross < 0 ? -1 : 0));
+    if (s == 0 || (sign != 0 && s != sign)) {
+      return false;
+    }
+    sign = s;
+  }
+  return true;
+}
+}
+
+/*!
+  Default constructor.
+ */
+vpTagCornerTracker::vpTagCornerTracker()
+  : m_nbLevels(2), m_maxIter(10), m_maxResidual(20.), m_initialized(false), m_initArea(0), m_residual(0), m_corners(),
+    m_templates(), m_pyramid(), m_patch(), m_tracked()
+{
+}
+
+void vpTagCornerTracker::buildPyramid(const vpImage<unsigned char> &I)
+{
+  m_pyramid.resize(m_nbLevels - 1);
+  for (unsigned int l = 1; l < m_nbLevels; l++) {
+    vpImageFilter::getGaussPyramidal(getLevel(I, l - 1), m_pyramid[l - 1]);
+  }
+}
+
+const vpImage<unsigned char> &vpTagCornerTracker::getLevel(const vpImage<unsigned char> &I, unsigned int level) const
+{
+  return (level == 0 ? I : m_pyramid[level - 1]);
+}
+
+/*!
+  Initialize the tracker with the corners of a detected tag. The templates of the corners are
+  extracted from the image \e I.
+
+  \param[in] I : Image in which the tag was detected.
+  \param[in] polygon : Tag corners given by vpDetectorAprilTag::getPolygon().
+ */
+void vpTagCornerTracker::init(const vpImage<unsigned char> &I, const std::vector<vpImagePoint> &polygon)
+{
+  reset();
+  buildPyramid(I);
+
+  const int ext_size = patch_size + 2;
+  m_patch.resize(static_cast<size_t>(ext_size * ext_size));
+  // The templates keep their buffers from one initialization to the next
+  if (m_templates.size() < polygon.size()) {
+    m_templates.resize(polygon.size());
+  }
+  for (size_t i = 0; i < polygon.size(); i++) {
+    m_templates[i].resize(m_nbLevels);
+    for (unsigned int l = 0; l < m_nbLevels; l++) {
+      double scale = 1. / (1 << l);
+      // Patch extended by one pixel to compute the gradient
+      if (!samplePatch(getLevel(I, l), polygon[i].get_u() * scale - (patch_size + 1) / 2.,
+                       polygon[i].get_v() * scale - (patch_size + 1) / 2., ext_size, &m_patch[0])) {
+        return;
+      }
+      vpCornerTemplate &tmpl = m_templates[i][l];
+      tmpl.T.resize(patch_area);
+      tmpl.Gx.resize(patch_area);
+      tmpl.Gy.resize(patch_area);
+      double hxx = 0, hxy = 0, hyy = 0;
+      for (int r = 0; r < patch_size; r++) {
+        for (int c = 0; c < patch_size; c++) {
+          const float *e = &m_patch[(r + 1) * ext_size + c + 1];
+          int k = r * patch_size + c;
+          tmpl.T[k] = e[0];
+          tmpl.Gx[k] = (e[1] - e[-1]) / 2.f;
+          tmpl.Gy[k] = (e[ext_size] - e[-ext_size]) / 2.f;
+          hxx += tmpl.Gx[k] * tmpl.Gx[k];
+          hxy += tmpl.Gx[k] * tmpl.Gy[k];
+          hyy += tmpl.Gy[k] * tmpl.Gy[k];
+        }
+      }
+      double det = hxx * hyy - hxy * hxy;
+      if (det < 1e-6 * (hxx + hyy) * (hxx + hyy) || det <= 0) {
+        // Not enough texture around the corner
+        return;
+      }
+      tmpl.Hi[0] = hyy / det;
+      tmpl.Hi[1] = -hxy / det;
+      tmpl.Hi[2] = hxx / det;
+    }
+  }
+
+  m_corners = polygon;
+  m_initArea = polygonArea(polygon);
+  m_initialized = true;
+}
+
+/*!
+  Reset the tracker. init() should then be called before track().
+ */
+void vpTagCornerTracker::reset()
+{
+  m_initialized = false;
+  m_initArea = 0;
+  m_residual = 0;
+  m_corners.clear();
+}
+
+/*!
+  Track the corners in a new image.
+
+  \param[in] I : New image.
+  \return true if the corners were tracked, false if the tracking failed. In that case the tracker
+  is reset and should be initialized again from a detection.
+ */
+bool vpTagCornerTracker::track(const vpImage<unsigned char> &I)
+{
+  if (!m_initialized) {
+    return false;
+  }
+  buildPyramid(I);
+
+  m_tracked = m_corners;
+  m_residual = 0;
+  for (size_t i = 0; i < m_corners.size(); i++) {
+    double residual = 0;
+    if (!trackCorner(I, i, m_tracked[i], residual)) {
+      reset();
+      return false;
+    }
+    m_residual = std::max(m_residual, residual);
+  }
+
+  double area_ratio = polygonArea(m_tracked) / m_initArea;
+  if (m_residual > m_maxResidual || !isConvex(m_tracked) || area_ratio < 0.5 || area_ratio > 2.) {
+    reset();
+    return false;
+  }
+
+  m_corners.swap(m_tracked);
+  return true;
+}
+
+/*!
+  Track a corner from the coarsest pyramid level to the finest one.
+
+  \param[in] I : Image at the finest level.
+  \param[in] id : Index of the corner.
+  \param[in,out] corner : Location of the corner in the previous image, updated with the new location.
+  \param[out] residual : RMS photometric residual of the patch at the finest level.
+ */
+bool vpTagCornerTracker::trackCorner(const vpImage<unsigned char> &I, size_t id, vpImagePoint &corner,
+                                     double &residual) const
+{
+  float W[patch_area];
+  double du = 0, dv = 0; // Displacement at the current level
+  double u = 0, v = 0;
+
+  for (int l = static_cast<int>(m_nbLevels) - 1; l >= 0; l--) {
+    const vpImage<unsigned char> &Il = getLevel(I, static_cast<unsigned int>(l));
+    const vpCornerTemplate &tmpl = m_templates[id][static_cast<size_t>(l)];
+    double scale = 1. / (1 << l);
+    u = corner.get_u() * scale + du;
+    v = corner.get_v() * scale + dv;
+
+    for (unsigned int iter = 0; iter < m_maxIter; iter++) {
+      if (!samplePatch(Il, u - (patch_size - 1) / 2., v - (patch_size - 1) / 2., patch_size, W)) {
+        return false;
+      }
+      double bx, by, sse;
+      computeError(W, &tmpl.T[0], &tmpl.Gx[0], &tmpl.Gy[0], bx, by, sse);
+      residual = std::sqrt(sse / patch_area);
+
+      // Inverse compositional update of the translation
+      double dx = tmpl.Hi[0] * bx + tmpl.Hi[1] * by;
+      double dy = tmpl.Hi[1] * bx + tmpl.Hi[2] * by;
+      u -= dx;
+      v -= dy;
+      if (dx * dx + dy * dy < 1e-4) {
+        break;
+      }
+    }
+
+    du = 2 * (u - corner.get_u() * scale);
+    dv = 2 * (v - corner.get_v() * scale);
+  }
+
+  corner.set_uv(u, v);
+  return true;
+}
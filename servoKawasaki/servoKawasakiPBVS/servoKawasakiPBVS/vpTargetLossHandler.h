@@ -0,0 +1,165 @@
+/****************************************************************************
+ *
+ * ViSP, open source Visual Servoing Platform software.
+ * Copyright (C) 2005 - 2019 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://visp.inria.fr for more information.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Description:
+ * Handling of the target loss and reacquisition.
+ *
+ *****************************************************************************/
+
+
+#ifndef vpTargetLossHandler_h
+#define vpTargetLossHandler_h
+
+/*!
+  \file vpTargetLossHandler.h
+  Handling of the target loss and reacquisition.
+*/
+
+#include <vector>
+
+#include <visp3/core/vpConfig.h>
+
+#include <visp3/core/vpColVector.h>
+#include <visp3/core/vpHomogeneousMatrix.h>
+
+/*!
+
+  \class vpTargetLossHandler
+  \brief State machine that keeps the servo running when the target detection is missed, and searches
+  the target once it is lost.
+
+  The states are:
+  - TRACKING: the target is measured in the current image;
+  - COASTING: the target is missed since a few frames. Its pose is predicted from the last measured one
+    and from the camera velocity sent to the robot, and the servo keeps running on the predicted pose
+    with a velocity that decays at each frame. An occasional missed detection doesn't stop the robot;
+  - SEARCHING: the target is missed for too long. The robot is stopped and the detection runs on the
+    full image, with a different quad decimation at each frame to find a small or a far target;
+  - REACQUIRED: the target is measured again after a search, or with a pose too far from the predicted
+    one. The rotation of the desired frame has to be chosen again with updateSymmetry(). The next
+    measured frame goes back to TRACKING.
+
+  The handler starts in SEARCHING, so that the first detection is a reacquisition.
+
+  \code
+  vpTargetLossHandler loss;
+  loss.setQuadDecimate(2);
+  while (!quit) {
+    detector.setAprilTagQuadDecimate(loss.getQuadDecimate());
+    bool has_pose = detector.detect(I, tag_size, cam, cMo_vec) && cMo_vec.size() == 1;
+    if (has_pose) cMo = cMo_vec[0];
+    if (loss.update(vpTime::measureTimeSecond(), has_pose, cMo) == vpTargetLossHandler::REACQUIRED) {
+      loss.updateSymmetry(cdMo, cMo, oMo);
+    }
+    if (loss.getState() != vpTargetLossHandler::SEARCHING) {
+      v_c = loss.getVelocityScale() * control_law(cdMo * oMo * cMo.inverse());
+    }
+    else {
+      v_c = 0;
+    }
+    robot.setVelocity(vpRobot::CAMERA_FRAME, v_c);
+    loss.setCameraVelocity(v_c);
+  }
+  \endcode
+
+*/
+class vpTargetLossHandler
+{
+public:
+  //! State of the target tracking.
+  typedef enum {
+    TRACKING,  //!< Target measured in the current image
+    COASTING,  //!< Target missed, pose predicted and velocity decaying
+    SEARCHING, //!< Target lost, robot stopped and detection on the full image
+    REACQUIRED //!< Target measured again after a loss
+  } vpTrackingState;
+
+  vpTargetLossHandler();
+
+  /*!
+    Return the motion of the camera since the previous frame, predicted from the camera velocity: a point
+    expressed in the previous camera frame is expressed in the current one by this transformation.
+   */
+  const vpHomogeneousMatrix &getFrameMotion() const { return m_frameMotion; }
+  //! Return the number of consecutive frames without target measurement.
+  unsigned int getNbMissedFrames() const { return m_nbMissed; }
+  //! Return the measured or predicted pose of the target after the last update().
+  const vpHomogeneousMatrix &getPose() const { return m_cMo; }
+  float getQuadDecimate() const;
+  //! Return the current state.
+  vpTrackingState getState() const { return m_state; }
+  static const char *getStateName(vpTrackingState state);
+  double getVelocityScale() const;
+
+  void reset();
+
+  //! Set the camera velocity sent to the robot after the last update(), used to predict the next pose.
+  void setCameraVelocity(const vpColVector &v) { m_v = v; }
+  //! Set the number of missed frames before SEARCHING. Default is 5.
+  void setMaxCoastingFrames(unsigned int nb) { m_maxCoasting = nb; }
+  void setQuadDecimate(float decimate);
+  /*!
+    Set the largest translation in meter and rotation in degree between the predicted and the measured
+    poses for a detection during COASTING to go back to TRACKING. Above, the target is REACQUIRED.
+    Default is 0.05 m and 20 degrees.
+   */
+  void setReacquisitionThresholds(double threshold_t, double threshold_tu)
+  {
+    m_thresholdT = threshold_t;
+    m_thresholdTu = threshold_tu;
+  }
+  //! Set the quad decimations used in turn during SEARCHING.
+  void setSearchDecimations(const std::vector<float> &decimations);
+  //! Set the factor applied to the velocity at each COASTING frame. Default is 0.7.
+  void setVelocityDecay(double decay) { m_decay = decay; }
+
+  vpTrackingState update(double t, bool measured);
+  vpTrackingState update(double t, bool measured, vpHomogeneousMatrix &cMo);
+  bool updateSymmetry(const vpHomogeneousMatrix &cdMo, const vpHomogeneousMatrix &cMo, vpHomogeneousMatrix &oMo);
+
+protected:
+  void predict(double t);
+
+  vpTrackingState m_state;
+  unsigned int m_nbMissed;
+  unsigned int m_maxCoasting;
+  double m_decay;
+  double m_thresholdT, m_thresholdTu;
+  float m_decimate;
+  std::vector<float> m_searchDecimations;
+  unsigned int m_searchIndex;
+  double m_t;                        //!< Time of the last update(), -1 before the first one
+  vpColVector m_v;                   //!< Camera velocity sent after the last update()
+  vpHomogeneousMatrix m_cMo;
+  bool m_hasPose;
+  vpHomogeneousMatrix m_frameMotion;
+  bool m_hasSymmetry;                //!< True once updateSymmetry() has chosen the desired frame
+};
+#endif